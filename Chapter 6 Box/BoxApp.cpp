@@ -156,12 +156,13 @@ void BoxApp::Update(const GameTimer& gt)
 	XMMATRIX proj = XMLoadFloat4x4(&_proj);
 	XMMATRIX worldViewProj = world * view * proj;
 
-	ObjectConstants objConstants;
-	XMStoreFloat4x4(&objConstants.WorldViewProj, XMMatrixTranspose(worldViewProj));
-	XMStoreFloat4(&objConstants.PulseColor, Colors::Chocolate);
-	objConstants.Time = gt.TotalTime();
-
-	_objectCB->CopyData(0, objConstants);
+	// Build the constants in a staging copy and stream them to the mapped buffer.
+	_objectCB->EmplaceData(0, 1, [&](UINT, ObjectConstants& objConstants)
+	{
+		XMStoreFloat4x4(&objConstants.WorldViewProj, XMMatrixTranspose(worldViewProj));
+		XMStoreFloat4(&objConstants.PulseColor, Colors::Chocolate);
+		objConstants.Time = gt.TotalTime();
+	});
 }
 
 void BoxApp::Draw(const GameTimer& gt)
@@ -156,7 +156,8 @@ void PyramidApp::Update(const GameTimer& gt)
 	ObjectConstants objConstants;
 	XMStoreFloat4x4(&objConstants.WorldViewProj, XMMatrixTranspose(worldViewProj));
 
-	_objectCB->CopyData(0, objConstants);
+	// Streams the whole 256-byte element, padding included, in full bursts.
+	_objectCB->CopyData(0, &objConstants, 1);
 }
 
 void PyramidApp::Draw(const GameTimer& gt)
@@ -1,6 +1,6 @@
 #include "FrameResource.h"
 
-FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount)
+FrameResource::FrameResource(ID3D12Device* device)
 {
 	ThrowIfFailed
 	(
@@ -10,9 +10,6 @@ FrameResource::FrameResource(ID3D12Device* device, UINT passCount, UINT objectCo
 			IID_PPV_ARGS(CmdListAlloc.GetAddressOf())
 		)
 	);
-
-	PassCB = std::make_unique<UploadBuffer<PassConstants>>(device, passCount, true);
-	ObjectCB = std::make_unique<UploadBuffer<ObjectConstants>>(device, objectCount, true);
 }
 
 FrameResource::~FrameResource() { }
@@ -2,7 +2,6 @@
 
 #include "../Common/d3dUtil.h"
 #include "../Common/MathHelper.h"
-#include "../Common/UploadBuffer.h"
 
 struct ObjectConstants
 {
@@ -27,16 +26,18 @@ struct PassConstants
 	float DeltaTime = 0.0f;
 };
 
+// Compact vertex: the position is quantized to 16-bit unorm (see VertexQuantizer)
+// and the color is 8-bit BGRA.  12 bytes instead of 28.
 struct Vertex
 {
-	DirectX::XMFLOAT3 Pos;
-	DirectX::XMFLOAT4 Color;
+	DirectX::PackedVector::XMUSHORTN4 Pos;
+	DirectX::PackedVector::XMCOLOR Color;
 };
 
 struct FrameResource
 {
 public:
-	FrameResource(ID3D12Device* device, UINT passCount, UINT objectCount);
+	FrameResource(ID3D12Device* device);
 	FrameResource(const FrameResource& rhs) = delete;
 	FrameResource& operator=(const FrameResource& rhs) = delete;
 	~FrameResource();
@@ -45,10 +46,8 @@ public:
 	// allocator until the GPU is done processing the commands.
 	Microsoft::WRL::ComPtr<ID3D12CommandAllocator> CmdListAlloc;
 
-	// Each frame needs their own cbuffers, because we can't reset the 
-	// allocator until the GPU is done processing the commands that reference it.
-	std::unique_ptr<UploadBuffer<PassConstants>> PassCB = nullptr;
-	std::unique_ptr<UploadBuffer<ObjectConstants>> ObjectCB = nullptr;
+	// Constants are not kept here: they are written to ShapesApp's upload ring,
+	// which frees them once this frame's fence completes.
 
 	// Fence value that lets up check if these frame resources are
 	// still in use by the GPU.
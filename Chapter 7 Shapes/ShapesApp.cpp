@@ -2,8 +2,15 @@
 
 #include "../Common/d3dApp.h"
 #include "../Common/MathHelper.h"
-#include "../Common/UploadBuffer.h"
+#include "../Common/MathBatch.h"
+#include "../Common/FrustumCuller.h"
 #include "../Common/GeometryGenerator.h"
+#include "../Common/MeshFile.h"
+#include "../Common/OcclusionCuller.h"
+#include "../Common/Terrain.h"
+#include "../Common/TransformHierarchy.h"
+#include "../Common/UploadRing.h"
+#include "../Common/VertexQuantizer.h"
 #include "FrameResource.h"
 
 using Microsoft::WRL::ComPtr;
@@ -12,23 +19,27 @@ using namespace DirectX::PackedVector;
 
 const int gNumFrameResources = 3;
 
+// Content version of the geometry files.  Bump it whenever the vertex format or
+// the generated geometry changes, so files from older builds are rebuilt.
+const std::uint32_t gGeometryVersion = 1;
+
+// Terrain chunks kept cached, with their buffers.  Also the number of chunks the
+// upload ring starts with constants for.
+const UINT gTerrainCachedChunks = 256;
+
 // Lightweight structure stores parameters to draw a shape
 struct RenderItem
 {
 	RenderItem() = default;
 
-	// World matrix of the shape that describes the object's local space
-	// relative to the world space, which defines the position, orientation,
-	// and scale of the object in the world.
-	XMFLOAT4X4 World = MathHelper::Identity4x4();
-
-	// Dirty flag indicating the object data has changed and we need to update the constant buffer.
-	// Because we have an object cbuffer for each FrameResource, we have to apply the
-	// update to each FrameResource. Thus, when we modify obect data we should set 
-	// NumFramesDirty = gNumFrameResources so that each frame resource gets the update.
-	int NumFramesDirty = gNumFrameResources;
+	// Node in ShapesApp::mTransforms whose world matrix describes the object's
+	// local space relative to the world space, which defines the position,
+	// orientation, and scale of the object in the world.  Moving the node, or one
+	// of its ancestors, updates the item's world bounds.
+	TransformHierarchy::uint32 Node = TransformHierarchy::None;
 
-	// Index into GPU constant buffer corresponding to the ObjectCB for this render item.
+	// Index of the item in mOpaqueRitems, in the cullers and among the transform
+	// slots.  Its object constants are written each frame it is visible.
 	UINT ObjCBIndex = -1;
 
 	MeshGeometry* Geo = nullptr;
@@ -40,6 +51,30 @@ struct RenderItem
 	UINT IndexCount = 0;
 	UINT StartIndexLocation = 0;
 	int BaseVertexLocation = 0;
+
+	// Bounds of the submesh, in the space the node's world matrix maps from.
+	BoundingBox Bounds;
+
+	// Drawn into the software depth buffer that hides the other items.
+	bool IsOccluder = false;
+};
+
+// A terrain chunk in its own default buffers.  It is quantized and uploaded the
+// first time it is selected, and released after the terrain evicts its mesh.
+struct TerrainChunkGeometry
+{
+	MeshGeometry Geo;
+	UINT IndexCount = 0;
+
+	// The dequantization, which is the chunk's whole world matrix.
+	ObjectConstants Constants;
+};
+
+// A terrain chunk to draw in the current frame.
+struct TerrainDraw
+{
+	const TerrainChunkGeometry* Chunk = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS ObjectCBAddress = 0;
 };
 
 class ShapesApp : public D3DApp
@@ -63,18 +98,24 @@ private:
 
 	void OnKeyboardInput(const GameTimer& gt);
 	void UpdateCamera(const GameTimer& gt);
+	void UpdateTransforms(const GameTimer& gt);
 	void UpdateObjectCBs(const GameTimer& gt);
 	void UpdateMainPassCB(const GameTimer& gt);
+	void UpdateTerrain();
 
-	void BuildDescriptorHeaps();
-	void BuildConstantBufferViews();
 	void BuildRootSignature();
 	void BuildShadersAndInputLayout();
-	void BuildShapeGeometry();
+	bool BuildShapeGeometry();
+	void BuildTerrain();
+	std::unique_ptr<TerrainChunkGeometry> BuildTerrainChunk(const GeometryGenerator::MeshData& mesh);
+	void UploadTerrainChunks(ID3D12GraphicsCommandList* cmdList);
+	void ReleaseEvictedTerrainChunks();
+	bool LoadGeometry(const std::wstring& filename);
 	void BuildPSOs();
 	void BuildFrameResources();
 	void BuildRenderItems();
 	void DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems);
+	void DrawTerrain(ID3D12GraphicsCommandList* cmdList);
 
 private:
 
@@ -82,8 +123,10 @@ private:
 	FrameResource* mCurrFrameResource = nullptr;
 	int mCurrFrameResourceIndex = 0;
 
+	// Per-frame constants, retired as the frames' fences complete.
+	std::unique_ptr<UploadRing> mUploadRing;
+
 	ComPtr<ID3D12RootSignature> mRootSignature = nullptr;
-	ComPtr<ID3D12DescriptorHeap> mCbvHeap = nullptr;
 
 	ComPtr<ID3D12DescriptorHeap> mSrvDescriptorHeap = nullptr;
 
@@ -91,6 +134,10 @@ private:
 	std::unordered_map<std::string, ComPtr<ID3DBlob>> mShaders;
 	std::unordered_map<std::string, ComPtr<ID3D12PipelineState>> mPSOs;
 
+	// Maps each submesh's quantized positions back to local space.  Render items
+	// fold it into their world matrix.
+	std::unordered_map<std::string, DirectX::XMFLOAT4X4> mDequantize;
+
 	std::vector<D3D12_INPUT_ELEMENT_DESC> mInputLayout;
 
 	// List of all the render items.
@@ -99,12 +146,53 @@ private:
 	// Render items divided by PSO.
 	std::vector<RenderItem*> mOpaqueRitems;
 
+	// World matrices of the render items, and the object constant slots the last
+	// update changed.
+	TransformHierarchy mTransforms;
+	std::vector<TransformHierarchy::uint32> mChangedSlots;
+
+	// The box turns in place: its node's local matrix is mBoxLocal, turned by the
+	// time and then raised onto the ground.
+	TransformHierarchy::uint32 mBoxNode = TransformHierarchy::None;
+	XMFLOAT4X4 mBoxLocal = MathHelper::Identity4x4();
+
+	// World-space bounds of mOpaqueRitems, and the items that passed the last cull.
+	FrustumCuller mCuller;
+	OcclusionCuller mOcclusionCuller;
+	std::vector<BoundingBox> mWorldBounds;
+	std::vector<FrustumCuller::uint32> mVisibleIndices;
+	std::vector<RenderItem*> mVisibleRitems;
+	std::vector<const XMFLOAT4X4*> mVisibleWorlds;
+
+	// The ground.  Its chunks are selected every frame from the eye and the view
+	// frustum.  Each chunk keeps its buffers while the terrain caches its mesh, so
+	// only the object constants go through the upload ring every frame.
+	std::unique_ptr<Terrain> mTerrain;
+	std::vector<Terrain::Chunk> mTerrainChunks;
+	std::vector<TerrainDraw> mTerrainDraws;
+	std::unordered_map<Terrain::Key, std::unique_ptr<TerrainChunkGeometry>> mTerrainGeometry;
+
+	// Chunks whose copies the next Draw records, and chunks the terrain evicted
+	// since the last Draw.
+	std::vector<TerrainChunkGeometry*> mPendingTerrainUploads;
+	std::vector<Terrain::Key> mEvictedTerrainChunks;
+
+	// Uploaders of copied chunks and buffers of evicted ones, released once the
+	// fence passes the value paired with them.
+	std::vector<std::pair<UINT64, ComPtr<ID3D12Resource>>> mRetiredTerrainBuffers;
+
 	PassConstants mMainPassCB;
 
-	UINT mPassCbvOffset = 0;
+	// Where this frame's pass constants, and the object constants of
+	// mVisibleRitems in order, were written.
+	D3D12_GPU_VIRTUAL_ADDRESS mPassCBAddress = 0;
+	D3D12_GPU_VIRTUAL_ADDRESS mObjectCBAddress = 0;
 
 	bool mIsWireframe = false;
 
+	// Pressing '2' toggles a 60 fps frame rate limit, which is off by default.
+	bool mFrameLimitKeyDown = false;
+
 	XMFLOAT3 mEyePos = { 0.0f, 0.0f, 0.0f };
 	XMFLOAT4X4 mView = MathHelper::Identity4x4();
 	XMFLOAT4X4 mProj = MathHelper::Identity4x4();
@@ -148,6 +236,17 @@ ShapesApp::~ShapesApp()
 {
 	if (md3dDevice != nullptr)
 		FlushCommandQueue();
+
+#if defined(DEBUG) | defined(_DEBUG)
+	// Report how much of the upload ring the run needed, for sizing its Desc.
+	if (mUploadRing != nullptr)
+	{
+		std::wstring text = L"Upload ring high-water mark: " + std::to_wstring(mUploadRing->GetHighWaterMark()) +
+			L" of " + std::to_wstring(mUploadRing->GetCapacity()) + L" bytes, grown " +
+			std::to_wstring(mUploadRing->GetGrowCount()) + L" times\n";
+		::OutputDebugStringW(text.c_str());
+	}
+#endif
 }
 
 bool ShapesApp::Initialize()
@@ -160,11 +259,11 @@ bool ShapesApp::Initialize()
 
 	BuildRootSignature();
 	BuildShadersAndInputLayout();
-	BuildShapeGeometry();
+	if (!BuildShapeGeometry())
+		return false;
+	BuildTerrain();
 	BuildRenderItems();
 	BuildFrameResources();
-	BuildDescriptorHeaps();
-	BuildConstantBufferViews();
 	BuildPSOs();
 
 	// Execute the initialization commands.
@@ -200,14 +299,66 @@ void ShapesApp::Update(const GameTimer& gt)
 	// If not, wait until the GPU has completed commands up to this fence point.
 	if (mCurrFrameResource->Fence != 0 && mFence->GetCompletedValue() < mCurrFrameResource->Fence)
 	{
+		PROFILE_SCOPE("WaitForFrameResource");
+
 		HANDLE eventHandle = CreateEventEx(nullptr, false, false, EVENT_ALL_ACCESS);
 		ThrowIfFailed(mFence->SetEventOnCompletion(mCurrFrameResource->Fence, eventHandle));
 		WaitForSingleObject(eventHandle, INFINITE);
 		CloseHandle(eventHandle);
 	}
 
-	UpdateObjectCBs(gt);
+	// Upload memory of the frames the GPU has finished can be reused, and the
+	// terrain buffers they retired can be released.
+	UINT64 completedFence = mFence->GetCompletedValue();
+	mUploadRing->Retire(completedFence);
+
+	mRetiredTerrainBuffers.erase(std::remove_if(mRetiredTerrainBuffers.begin(), mRetiredTerrainBuffers.end(),
+		[completedFence](const std::pair<UINT64, ComPtr<ID3D12Resource>>& retired)
+		{
+			return retired.first <= completedFence;
+		}), mRetiredTerrainBuffers.end());
+
+	UpdateTransforms(gt);
 	UpdateMainPassCB(gt);
+
+	// Cull against the frustum the pass constants were just built for.
+	XMMATRIX viewProj = XMMatrixTranspose(XMLoadFloat4x4(&mMainPassCB.ViewProj));
+	{
+		PROFILE_SCOPE("FrustumCull");
+		mCuller.Cull(viewProj, mVisibleIndices);
+	}
+
+	// Then drop what the occluders hide.  They are drawn on the CPU from the
+	// system memory copies of the geometry.  Wireframe shows what is behind
+	// them, so nothing is hidden there.
+	if (!mIsWireframe)
+	{
+		PROFILE_SCOPE("OcclusionCull");
+
+		mOcclusionCuller.Begin(viewProj);
+		for (auto i : mVisibleIndices)
+		{
+			auto ri = mOpaqueRitems[i];
+			if (!ri->IsOccluder)
+				continue;
+
+			SubmeshGeometry submesh;
+			submesh.IndexCount = ri->IndexCount;
+			submesh.StartIndexLocation = ri->StartIndexLocation;
+			submesh.BaseVertexLocation = ri->BaseVertexLocation;
+			mOcclusionCuller.AddOccluder(*ri->Geo, submesh, DXGI_FORMAT_R16G16B16A16_UNORM,
+				XMLoadFloat4x4(&mTransforms.GetWorld(ri->Node)));
+		}
+		mOcclusionCuller.Rasterize();
+		mOcclusionCuller.Cull(mWorldBounds, mVisibleIndices);
+	}
+
+	mVisibleRitems.clear();
+	for (auto i : mVisibleIndices)
+		mVisibleRitems.push_back(mOpaqueRitems[i]);
+
+	UpdateObjectCBs(gt);
+	UpdateTerrain();
 }
 
 void ShapesApp::Draw(const GameTimer& gt)
@@ -229,6 +380,8 @@ void ShapesApp::Draw(const GameTimer& gt)
 		ThrowIfFailed(mCommandList->Reset(cmdListAlloc.Get(), mPSOs["opaque"].Get()));
 	}
 
+	UploadTerrainChunks(mCommandList.Get());
+
 	mCommandList->RSSetViewports(1, &mScreenViewport);
 	mCommandList->RSSetScissorRects(1, &mScissorRect);
 
@@ -250,17 +403,12 @@ void ShapesApp::Draw(const GameTimer& gt)
 	// Specify the buffers we are going to render to.
 	mCommandList->OMSetRenderTargets(1, &CurrentBackBufferView(), true, &DepthStencilView());
 
-	ID3D12DescriptorHeap* descriptorHeaps[] = { mCbvHeap.Get() };
-	mCommandList->SetDescriptorHeaps(_countof(descriptorHeaps), descriptorHeaps);
-
 	mCommandList->SetGraphicsRootSignature(mRootSignature.Get());
 
-	int passCbvIndex = mPassCbvOffset + mCurrFrameResourceIndex;
-	auto passCbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-	passCbvHandle.Offset(passCbvIndex, mCbvSrvUavDescriptorSize);
-	mCommandList->SetGraphicsRootDescriptorTable(1, passCbvHandle);
+	mCommandList->SetGraphicsRootConstantBufferView(1, mPassCBAddress);
 
-	DrawRenderItems(mCommandList.Get(), mOpaqueRitems);
+	DrawRenderItems(mCommandList.Get(), mVisibleRitems);
+	DrawTerrain(mCommandList.Get());
 
 	// Indicate a state transition on the resource usage.
 	mCommandList->ResourceBarrier
@@ -287,6 +435,11 @@ void ShapesApp::Draw(const GameTimer& gt)
 	// Because we are on the GPU timeline, the new fence point won't be 
 	// set until the GPU finishes processing all the commands prior to this Signal().
 	mCommandQueue->Signal(mFence.Get(), mCurrentFence);
+
+	// Everything uploaded this frame stays in use until the same fence point.
+	mUploadRing->EndFrame(mCurrentFence);
+
+	ReleaseEvictedTerrainChunks();
 }
 
 void ShapesApp::OnMouseDown(WPARAM btnState, int x, int y)
@@ -340,6 +493,11 @@ void ShapesApp::OnKeyboardInput(const GameTimer& gt)
 		mIsWireframe = true;
 	else
 		mIsWireframe = false;
+
+	bool frameLimitKeyDown = (GetAsyncKeyState('2') & 0x8000) != 0;
+	if (frameLimitKeyDown && !mFrameLimitKeyDown)
+		SetFrameRateLimit(GetFrameRateLimit() > 0.0 ? 0.0 : 60.0);
+	mFrameLimitKeyDown = frameLimitKeyDown;
 }
 
 void ShapesApp::UpdateCamera(const GameTimer& gt)
@@ -358,41 +516,69 @@ void ShapesApp::UpdateCamera(const GameTimer& gt)
 	XMStoreFloat4x4(&mView, view);
 }
 
-void ShapesApp::UpdateObjectCBs(const GameTimer& gt)
+void ShapesApp::UpdateTransforms(const GameTimer& gt)
 {
-	auto currObjectCB = mCurrFrameResource->ObjectCB.get();
-	for (auto& e : mAllRitems)
-	{
-		// Only update the cbuffer data if the constants have changed.  
-		// This needs to be tracked per frame resource.
-		if (e->NumFramesDirty > 0)
-		{
-			XMMATRIX world = XMLoadFloat4x4(&e->World);
+	PROFILE_SCOPE("UpdateTransforms");
 
-			ObjectConstants objConstants;
-			XMStoreFloat4x4(&objConstants.World, XMMatrixTranspose(world));
+	// Only the box's node is set, so only it is recomputed; the rest of the tree
+	// is left as it was.
+	mTransforms.SetLocal(mBoxNode, XMLoadFloat4x4(&mBoxLocal)*
+		XMMatrixRotationY(0.5f*gt.TotalTime())*XMMatrixTranslation(0.0f, 0.5f, 0.0f));
 
-			currObjectCB->CopyData(e->ObjCBIndex, objConstants);
+	// Recompute the world matrices of whatever moved since the last frame.
+	mTransforms.Update(mChangedSlots);
 
-			// Next FrameResource need to be updated too.
-			e->NumFramesDirty--;
-		}
+	// An item's ObjCBIndex is also its index in mOpaqueRitems and in the cullers.
+	for (auto slot : mChangedSlots)
+	{
+		auto ri = mOpaqueRitems[slot];
+		ri->Bounds.Transform(mWorldBounds[slot], XMLoadFloat4x4(&mTransforms.GetWorld(ri->Node)));
+		mCuller.Set(slot, mWorldBounds[slot]);
 	}
 }
 
+void ShapesApp::UpdateObjectCBs(const GameTimer& gt)
+{
+	PROFILE_SCOPE("UpdateObjectCBs");
+
+	if (mVisibleRitems.empty())
+		return;
+
+	// The constants of the visible items are written to one block of the upload
+	// ring, in draw order, so the number of objects can change from frame to frame
+	// without resizing anything.  World is the first member of ObjectConstants, so
+	// the worlds are transposed straight into the block with one batch call, using
+	// streaming stores since the block is write-combined.
+	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	auto objectCB = mUploadRing->Allocate((UINT64)objCBByteSize*mVisibleRitems.size(),
+		D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+
+	mVisibleWorlds.clear();
+	for (auto ri : mVisibleRitems)
+		mVisibleWorlds.push_back(&mTransforms.GetWorld(ri->Node));
+
+	MathBatch::StreamTransposed(objectCB.CpuAddress, objCBByteSize,
+		mVisibleWorlds.data(), mVisibleWorlds.size());
+
+	mObjectCBAddress = objectCB.GpuAddress;
+}
+
 void ShapesApp::UpdateMainPassCB(const GameTimer& gt)
 {
-	XMMATRIX view = XMLoadFloat4x4(&mView);
-	XMMATRIX proj = XMLoadFloat4x4(&mProj);
+	TaggedMatrix view(XMLoadFloat4x4(&mView), MatrixKind::Rigid);
+	TaggedMatrix proj(XMLoadFloat4x4(&mProj), MatrixKind::Perspective);
+
+	// Both inverses are rearrangements of the matrices, and (V*P)^-1 = P^-1*V^-1
+	// avoids inverting the general view-projection matrix.
+	XMMATRIX invView = view.Inverse().Load();
+	XMMATRIX invProj = proj.Inverse().Load();
+	XMMATRIX invViewProj = XMMatrixMultiply(invProj, invView);
 
-	XMMATRIX viewProj = XMMatrixMultiply(view, proj);
-	XMMATRIX invView = XMMatrixInverse(&XMMatrixDeterminant(view), view);
-	XMMATRIX invProj = XMMatrixInverse(&XMMatrixDeterminant(proj), proj);
-	XMMATRIX invViewProj = XMMatrixInverse(&XMMatrixDeterminant(viewProj), viewProj);
+	XMMATRIX viewProj = XMMatrixMultiply(view.Load(), proj.Load());
 
-	XMStoreFloat4x4(&mMainPassCB.View, XMMatrixTranspose(view));
+	XMStoreFloat4x4(&mMainPassCB.View, XMMatrixTranspose(view.Load()));
 	XMStoreFloat4x4(&mMainPassCB.InvView, XMMatrixTranspose(invView));
-	XMStoreFloat4x4(&mMainPassCB.Proj, XMMatrixTranspose(proj));
+	XMStoreFloat4x4(&mMainPassCB.Proj, XMMatrixTranspose(proj.Load()));
 	XMStoreFloat4x4(&mMainPassCB.InvProj, XMMatrixTranspose(invProj));
 	XMStoreFloat4x4(&mMainPassCB.ViewProj, XMMatrixTranspose(viewProj));
 	XMStoreFloat4x4(&mMainPassCB.InvViewProj, XMMatrixTranspose(invViewProj));
@@ -404,94 +590,56 @@ void ShapesApp::UpdateMainPassCB(const GameTimer& gt)
 	mMainPassCB.TotalTime = gt.TotalTime();
 	mMainPassCB.DeltaTime = gt.DeltaTime();
 
-	auto currPassCB = mCurrFrameResource->PassCB.get();
-	currPassCB->CopyData(0, mMainPassCB);
+	mPassCBAddress = mUploadRing->UploadConstants(mMainPassCB);
 }
 
-void ShapesApp::BuildDescriptorHeaps()
+void ShapesApp::UpdateTerrain()
 {
-	UINT objCount = (UINT)mOpaqueRitems.size();
+	PROFILE_SCOPE("UpdateTerrain");
 
-	// Need a CBV descriptor for each object for each frame resource,
-	// +1 for the perPass CBV for each frame resource.
-	UINT numDescriptors = (objCount + 1) * gNumFrameResources;
+	// Select the chunks for this frame's eye, against the view frustum in world
+	// space.  The terrain keeps the chunk meshes cached between frames.
+	TaggedMatrix view(XMLoadFloat4x4(&mView), MatrixKind::Rigid);
 
-	// Save an offset to the start of the pass CBVs.  These are the last 3 descriptors.
-	mPassCbvOffset = objCount * gNumFrameResources;
+	BoundingFrustum viewFrustum;
+	BoundingFrustum::CreateFromMatrix(viewFrustum, XMLoadFloat4x4(&mProj));
 
-	D3D12_DESCRIPTOR_HEAP_DESC cbvHeapDesc;
-	cbvHeapDesc.NumDescriptors = numDescriptors;
-	cbvHeapDesc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-	cbvHeapDesc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
-	cbvHeapDesc.NodeMask = 0;
-	ThrowIfFailed(md3dDevice->CreateDescriptorHeap(&cbvHeapDesc, IID_PPV_ARGS(&mCbvHeap)));
-}
+	BoundingFrustum frustum;
+	viewFrustum.Transform(frustum, view.Inverse().Load());
 
-void ShapesApp::BuildConstantBufferViews()
-{
-	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
-
-	UINT objCount = (UINT)mOpaqueRitems.size();
+	mTerrain->Select(mEyePos, &frustum, mTerrainChunks);
 
-	// Need a CBV descriptor for each object for each frame resource.
-	for (int frameIndex = 0; frameIndex < gNumFrameResources; ++frameIndex)
+	// Chunks selected for the first time are built now and copied into their
+	// buffers when Draw records the frame.  Every frame only writes the object
+	// constants of the chunks.
+	mTerrainDraws.clear();
+	for (const Terrain::Chunk& chunk : mTerrainChunks)
 	{
-		auto objectCB = mFrameResources[frameIndex]->ObjectCB->Resource();
-		for (UINT i = 0; i < objCount; ++i)
+		std::unique_ptr<TerrainChunkGeometry>& geometry = mTerrainGeometry[Terrain::MakeKey(chunk.Id)];
+		if (geometry == nullptr)
 		{
-			D3D12_GPU_VIRTUAL_ADDRESS cbAddress = objectCB->GetGPUVirtualAddress();
-
-			// Offset to the ith object constant buffer in the buffer.
-			cbAddress += i * objCBByteSize;
-
-			// Offset to the object cbv in the descriptor heap.
-			int heapIndex = frameIndex * objCount + i;
-			auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
-			handle.Offset(heapIndex, mCbvSrvUavDescriptorSize);
-
-			D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
-			cbvDesc.BufferLocation = cbAddress;
-			cbvDesc.SizeInBytes = objCBByteSize;
-
-			md3dDevice->CreateConstantBufferView(&cbvDesc, handle);
+			geometry = BuildTerrainChunk(*chunk.Mesh);
+			mPendingTerrainUploads.push_back(geometry.get());
 		}
-	}
-
-	UINT passCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants));
-
-	// Last three descriptors are the pass CBVs for each frame resource.
-	for (int frameIndex = 0; frameIndex < gNumFrameResources; ++frameIndex)
-	{
-		auto passCB = mFrameResources[frameIndex]->PassCB->Resource();
-		D3D12_GPU_VIRTUAL_ADDRESS cbAddress = passCB->GetGPUVirtualAddress();
 
-		// Offset to the pass cbv in the descriptor heap.
-		int heapIndex = mPassCbvOffset + frameIndex;
-		auto handle = CD3DX12_CPU_DESCRIPTOR_HANDLE(mCbvHeap->GetCPUDescriptorHandleForHeapStart());
-		handle.Offset(heapIndex, mCbvSrvUavDescriptorSize);
-
-		D3D12_CONSTANT_BUFFER_VIEW_DESC cbvDesc;
-		cbvDesc.BufferLocation = cbAddress;
-		cbvDesc.SizeInBytes = passCBByteSize;
-
-		md3dDevice->CreateConstantBufferView(&cbvDesc, handle);
+		TerrainDraw draw;
+		draw.Chunk = geometry.get();
+		draw.ObjectCBAddress = mUploadRing->UploadConstants(geometry->Constants);
+		mTerrainDraws.push_back(draw);
 	}
 }
 
 void ShapesApp::BuildRootSignature()
 {
-	CD3DX12_DESCRIPTOR_RANGE cbvTable0;
-	cbvTable0.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0);
-
-	CD3DX12_DESCRIPTOR_RANGE cbvTable1;
-	cbvTable1.Init(D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 1);
+	PROFILE_SCOPE("BuildRootSignature");
 
 	// Root parameter can be a table, root descriptor or root constants.
 	CD3DX12_ROOT_PARAMETER slotRootParameter[2];
 
-	// Create root CBVs.
-	slotRootParameter[0].InitAsDescriptorTable(1, &cbvTable0);
-	slotRootParameter[1].InitAsDescriptorTable(1, &cbvTable1);
+	// Create root CBVs.  The constants live in the upload ring and move every
+	// frame, so they are bound by address rather than through descriptors.
+	slotRootParameter[0].InitAsConstantBufferView(0);
+	slotRootParameter[1].InitAsConstantBufferView(1);
 
 	// A root signature is an array of root parameters.
 	CD3DX12_ROOT_SIGNATURE_DESC rootSigDesc
@@ -527,23 +675,35 @@ void ShapesApp::BuildRootSignature()
 
 void ShapesApp::BuildShadersAndInputLayout()
 {
+	PROFILE_SCOPE("BuildShadersAndInputLayout");
+
 	mShaders["standardVS"] = d3dUtil::CompileShader(L"Shaders\\color.hlsl", nullptr, "VS", "vs_5_1");
 	mShaders["opaquePS"] = d3dUtil::CompileShader(L"Shaders\\color.hlsl", nullptr, "PS", "ps_5_1");
 
-	mInputLayout =
-	{
-		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-		{ "COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 },
-	};
+	// Quantized positions followed by an XMCOLOR, which is BGRA in memory.
+	mInputLayout = VertexQuantizer::GetInputLayout(VertexQuantizer::AttributePosition);
+	mInputLayout.push_back(
+		{ "COLOR", 0, DXGI_FORMAT_B8G8R8A8_UNORM, 0, sizeof(Vertex::Pos), D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
 }
 
-void ShapesApp::BuildShapeGeometry()
+bool ShapesApp::BuildShapeGeometry()
 {
-	GeometryGenerator geoGen;
-	GeometryGenerator::MeshData box = geoGen.CreateBox(1.5f, 0.5f, 1.5f, 3);
-	GeometryGenerator::MeshData grid = geoGen.CreateGrid(20.0f, 30.0f, 60, 40);
-	GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 20, 20);
-	GeometryGenerator::MeshData cylinder = geoGen.CreateCylinder(0.5f, 0.3f, 3.0f, 20, 20);
+	PROFILE_SCOPE("BuildShapeGeometry");
+
+	// Geometry built by an earlier run is mapped from disk instead.
+	if (LoadGeometry(L"ShapeGeometry.bin"))
+		return true;
+
+	GeometryGenerator::ShapeDesc shapes[] =
+	{
+		GeometryGenerator::ShapeDesc::Box(1.5f, 0.5f, 1.5f, 3),
+		GeometryGenerator::ShapeDesc::Sphere(0.5f, 20, 20),
+		GeometryGenerator::ShapeDesc::Cylinder(0.5f, 0.3f, 3.0f, 20, 20)
+	};
+
+	GeometryGenerator::MeshSize box = GeometryGenerator::GetSize(shapes[0]);
+	GeometryGenerator::MeshSize sphere = GeometryGenerator::GetSize(shapes[1]);
+	GeometryGenerator::MeshSize cylinder = GeometryGenerator::GetSize(shapes[2]);
 
 	//
 	// We are concatenating all the geometry into one big vertex/index buffer.  So
@@ -552,82 +712,109 @@ void ShapesApp::BuildShapeGeometry()
 
 	// Cache the vertex offsets to each object in the concatenated vertex buffer.
 	UINT boxVertexOffset = 0;
-	UINT gridVertexOffset = (UINT)box.Vertices.size();
-	UINT sphereVertexOffset = gridVertexOffset + (UINT)grid.Vertices.size();
-	UINT cylinderVertexOffset = sphereVertexOffset + (UINT)sphere.Vertices.size();
+	UINT sphereVertexOffset = box.VertexCount;
+	UINT cylinderVertexOffset = sphereVertexOffset + sphere.VertexCount;
 
 	// Cache the starting index for each object in the concatenated index buffer.
 	UINT boxIndexOffset = 0;
-	UINT gridIndexOffset = (UINT)box.Indices32.size();
-	UINT sphereIndexOffset = gridIndexOffset + (UINT)grid.Indices32.size();
-	UINT cylinderIndexOffset = sphereIndexOffset + (UINT)sphere.Indices32.size();
+	UINT sphereIndexOffset = box.IndexCount;
+	UINT cylinderIndexOffset = sphereIndexOffset + sphere.IndexCount;
 
 	// Define the SubmeshGeometry that cover different 
 	// regions of the vertex/index buffers.
 
 	SubmeshGeometry boxSubmesh;
-	boxSubmesh.IndexCount = (UINT)box.Indices32.size();
+	boxSubmesh.IndexCount = box.IndexCount;
 	boxSubmesh.StartIndexLocation = boxIndexOffset;
 	boxSubmesh.BaseVertexLocation = boxVertexOffset;
 
-	SubmeshGeometry gridSubmesh;
-	gridSubmesh.IndexCount = (UINT)grid.Indices32.size();
-	gridSubmesh.StartIndexLocation = gridIndexOffset;
-	gridSubmesh.BaseVertexLocation = gridVertexOffset;
-
 	SubmeshGeometry sphereSubmesh;
-	sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
+	sphereSubmesh.IndexCount = sphere.IndexCount;
 	sphereSubmesh.StartIndexLocation = sphereIndexOffset;
 	sphereSubmesh.BaseVertexLocation = sphereVertexOffset;
 
 	SubmeshGeometry cylinderSubmesh;
-	cylinderSubmesh.IndexCount = (UINT)cylinder.Indices32.size();
+	cylinderSubmesh.IndexCount = cylinder.IndexCount;
 	cylinderSubmesh.StartIndexLocation = cylinderIndexOffset;
 	cylinderSubmesh.BaseVertexLocation = cylinderVertexOffset;
 
 	//
-	// Extract the vertex elements we are interested in and pack the
-	// vertices of all the meshes into one vertex buffer.
+	// Generate the meshes straight into one position and index buffer.  Our vertex
+	// format only uses the position, so that is the only attribute we ask for.
 	//
 
-	auto totalVertexCount =
-		box.Vertices.size() +
-		grid.Vertices.size() +
-		sphere.Vertices.size() +
-		cylinder.Vertices.size();
+	UINT totalVertexCount = cylinderVertexOffset + cylinder.VertexCount;
+	UINT totalIndexCount = cylinderIndexOffset + cylinder.IndexCount;
 
-	std::vector<Vertex> vertices(totalVertexCount);
+	std::vector<XMFLOAT3> positions(totalVertexCount);
+	std::vector<std::uint16_t> indices(totalIndexCount);
 
-	UINT k = 0;
-	for (size_t i = 0; i < box.Vertices.size(); ++i, ++k)
+	auto shapeStreams = [&](SubmeshGeometry& submesh)
 	{
-		vertices[k].Pos = box.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::DarkGreen);
-	}
+		GeometryGenerator::MeshStreams streams;
+		streams.Position.Data = &positions[submesh.BaseVertexLocation];
+		streams.Position.Stride = sizeof(XMFLOAT3);
+		streams.Indices16 = &indices[submesh.StartIndexLocation];
+		streams.Bounds = &submesh.Bounds;
+		return streams;
+	};
 
-	for (size_t i = 0; i < grid.Vertices.size(); ++i, ++k)
+	GeometryGenerator::MeshStreams outputs[] =
 	{
-		vertices[k].Pos = grid.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::ForestGreen);
-	}
+		shapeStreams(boxSubmesh),
+		shapeStreams(sphereSubmesh),
+		shapeStreams(cylinderSubmesh)
+	};
 
-	for (size_t i = 0; i < sphere.Vertices.size(); ++i, ++k)
+	// The shapes write to disjoint regions, so they can be generated concurrently.
+	// Only the first run gets here; later runs map ShapeGeometry.bin above.
+	// The batch writes nothing when a shape needs more vertices than the 16-bit
+	// indices can address, and the serial Create functions would refuse it too.
+	GeometryGenerator geoGen;
+	if (!geoGen.CreateBatch(shapes, outputs, _countof(shapes)))
 	{
-		vertices[k].Pos = sphere.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::Crimson);
+		MessageBox(0, L"Shape geometry does not fit 16-bit indices.", 0, 0);
+		return false;
 	}
 
-	for (size_t i = 0; i < cylinder.Vertices.size(); ++i, ++k)
+	//
+	// Quantize each shape's positions against its own bounds, so small shapes keep
+	// their precision.
+	//
+
+	std::vector<Vertex> vertices(totalVertexCount);
+
+	auto quantize = [&](const std::string& name, SubmeshGeometry& submesh, UINT vertexCount)
 	{
-		vertices[k].Pos = cylinder.Vertices[i].Position;
-		vertices[k].Color = XMFLOAT4(DirectX::Colors::SteelBlue);
-	}
+		UINT vertexOffset = submesh.BaseVertexLocation;
+
+		VertexQuantizer::Dequantization dequantization = VertexQuantizer::ComputeDequantization(
+			&positions[vertexOffset], sizeof(XMFLOAT3), vertexCount);
 
-	std::vector<std::uint16_t> indices;
-	indices.insert(indices.end(), std::begin(box.GetIndices16()), std::end(box.GetIndices16()));
-	indices.insert(indices.end(), std::begin(grid.GetIndices16()), std::end(grid.GetIndices16()));
-	indices.insert(indices.end(), std::begin(sphere.GetIndices16()), std::end(sphere.GetIndices16()));
-	indices.insert(indices.end(), std::begin(cylinder.GetIndices16()), std::end(cylinder.GetIndices16()));
+		VertexQuantizer::EncodePositions(&vertices[vertexOffset].Pos, sizeof(Vertex),
+			&positions[vertexOffset], sizeof(XMFLOAT3), vertexCount, dequantization);
+
+		XMMATRIX dequantize = dequantization.GetMatrix();
+		XMStoreFloat4x4(&mDequantize[name], dequantize);
+
+		// The world matrices start with the dequantization, so keep the bounds in
+		// the same quantized space as the vertices.
+		submesh.Bounds.Transform(submesh.Bounds, MathHelper::Inverse(dequantize, MatrixKind::Affine));
+	};
+
+	quantize("box", boxSubmesh, box.VertexCount);
+	quantize("sphere", sphereSubmesh, sphere.VertexCount);
+	quantize("cylinder", cylinderSubmesh, cylinder.VertexCount);
+
+	UINT k = 0;
+	for (UINT i = 0; i < box.VertexCount; ++i, ++k)
+		vertices[k].Color = XMCOLOR(DirectX::Colors::DarkGreen);
+
+	for (UINT i = 0; i < sphere.VertexCount; ++i, ++k)
+		vertices[k].Color = XMCOLOR(DirectX::Colors::Crimson);
+
+	for (UINT i = 0; i < cylinder.VertexCount; ++i, ++k)
+		vertices[k].Color = XMCOLOR(DirectX::Colors::SteelBlue);
 
 	const UINT vbByteSize = (UINT)vertices.size() * sizeof(Vertex);
 	const UINT ibByteSize = (UINT)indices.size() * sizeof(std::uint16_t);
@@ -653,15 +840,164 @@ void ShapesApp::BuildShapeGeometry()
 	geo->IndexBufferByteSize = ibByteSize;
 
 	geo->DrawArgs["box"] = boxSubmesh;
-	geo->DrawArgs["grid"] = gridSubmesh;
 	geo->DrawArgs["sphere"] = sphereSubmesh;
 	geo->DrawArgs["cylinder"] = cylinderSubmesh;
 
+	MeshFile::Save(L"ShapeGeometry.bin", gGeometryVersion, *geo, &mDequantize);
+
+	mGeometries[geo->Name] = std::move(geo);
+	return true;
+}
+
+void ShapesApp::BuildTerrain()
+{
+	PROFILE_SCOPE("BuildTerrain");
+
+	// The ground is a 400x400 chunked terrain.  It is flat where the shapes stand
+	// and rises into rolling hills further out.  Chunks near the camera get more
+	// triangles than the ones far away.
+	Terrain::Desc desc;
+	desc.Width = 400.0f;
+	desc.Depth = 400.0f;
+	desc.ChunkCells = 16;
+	desc.MaxLevel = 5;
+	desc.MinHeight = 0.0f;
+	desc.MaxHeight = 7.0f;
+	desc.SkirtDepth = 2.0f;
+	desc.LodDistance = 1.5f;
+	desc.MaxCachedChunks = gTerrainCachedChunks;
+
+	mTerrain = std::make_unique<Terrain>(desc, [](float x, float z)
+	{
+		float t = MathHelper::Clamp((sqrtf(x*x + z*z) - 20.0f) / 30.0f, 0.0f, 1.0f);
+		float blend = t*t*(3.0f - 2.0f*t);
+		return blend*(4.0f + 3.0f*sinf(0.08f*x)*cosf(0.06f*z));
+	});
+
+	// Chunk buffers are released with the cached meshes.
+	mTerrain->SetEvictFunction([this](const Terrain::ChunkId& id)
+	{
+		mEvictedTerrainChunks.push_back(Terrain::MakeKey(id));
+	});
+}
+
+std::unique_ptr<TerrainChunkGeometry> ShapesApp::BuildTerrainChunk(const GeometryGenerator::MeshData& mesh)
+{
+	PROFILE_SCOPE("BuildTerrainChunk");
+
+	const XMFLOAT3* positions = &mesh.Vertices[0].Position;
+	UINT vertexCount = (UINT)mesh.Vertices.size();
+	UINT indexCount = (UINT)mesh.Indices32.size();
+
+	assert(vertexCount <= 65536);
+
+	// Quantize every chunk against its own bounds, like the shapes.  The chunks
+	// are generated in world space, so the dequantization is the whole world
+	// matrix.
+	VertexQuantizer::Dequantization dequantization = VertexQuantizer::ComputeDequantization(
+		positions, sizeof(GeometryGenerator::Vertex), vertexCount);
+
+	std::vector<Vertex> vertices(vertexCount);
+	VertexQuantizer::EncodePositions(&vertices[0].Pos, sizeof(Vertex),
+		positions, sizeof(GeometryGenerator::Vertex), vertexCount, dequantization);
+
+	for (Vertex& v : vertices)
+		v.Color = XMCOLOR(DirectX::Colors::ForestGreen);
+
+	std::vector<std::uint16_t> indices = mesh.GetIndices16();
+
+	const UINT vbByteSize = vertexCount * sizeof(Vertex);
+	const UINT ibByteSize = indexCount * sizeof(std::uint16_t);
+
+	auto chunk = std::make_unique<TerrainChunkGeometry>();
+	MeshGeometry& geo = chunk->Geo;
+	geo.Name = "terrainChunk";
+
+	// The system memory copies are kept until UploadTerrainChunks copies them.
+	ThrowIfFailed(D3DCreateBlob(vbByteSize, &geo.VertexBufferCPU));
+	CopyMemory(geo.VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+	ThrowIfFailed(D3DCreateBlob(ibByteSize, &geo.IndexBufferCPU));
+	CopyMemory(geo.IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+
+	geo.VertexByteStride = sizeof(Vertex);
+	geo.VertexBufferByteSize = vbByteSize;
+	geo.IndexFormat = DXGI_FORMAT_R16_UINT;
+	geo.IndexBufferByteSize = ibByteSize;
+
+	chunk->IndexCount = indexCount;
+	XMStoreFloat4x4(&chunk->Constants.World, XMMatrixTranspose(dequantization.GetMatrix()));
+
+	return chunk;
+}
+
+void ShapesApp::UploadTerrainChunks(ID3D12GraphicsCommandList* cmdList)
+{
+	PROFILE_SCOPE("UploadTerrainChunks");
+
+	// The copies run ahead of this frame's draws, so the uploaders are needed
+	// until the frame's fence point and the system memory copies not at all.
+	UINT64 frameFence = mCurrentFence + 1;
+	for (TerrainChunkGeometry* chunk : mPendingTerrainUploads)
+	{
+		MeshGeometry& geo = chunk->Geo;
+
+		geo.VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(), cmdList,
+			geo.VertexBufferCPU->GetBufferPointer(), geo.VertexBufferByteSize, geo.VertexBufferUploader);
+
+		geo.IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(), cmdList,
+			geo.IndexBufferCPU->GetBufferPointer(), geo.IndexBufferByteSize, geo.IndexBufferUploader);
+
+		mRetiredTerrainBuffers.push_back({ frameFence, geo.VertexBufferUploader });
+		mRetiredTerrainBuffers.push_back({ frameFence, geo.IndexBufferUploader });
+		geo.DisposeUploaders();
+
+		geo.VertexBufferCPU = nullptr;
+		geo.IndexBufferCPU = nullptr;
+	}
+	mPendingTerrainUploads.clear();
+}
+
+void ShapesApp::ReleaseEvictedTerrainChunks()
+{
+	// An evicted chunk may still have been drawn by the frame just submitted, so
+	// its buffers are kept until that frame's fence point.
+	for (Terrain::Key key : mEvictedTerrainChunks)
+	{
+		auto it = mTerrainGeometry.find(key);
+		if (it == mTerrainGeometry.end())
+			continue;
+
+		MeshGeometry& geo = it->second->Geo;
+		mRetiredTerrainBuffers.push_back({ mCurrentFence, geo.VertexBufferGPU });
+		mRetiredTerrainBuffers.push_back({ mCurrentFence, geo.IndexBufferGPU });
+		mTerrainGeometry.erase(it);
+	}
+	mEvictedTerrainChunks.clear();
+}
+
+bool ShapesApp::LoadGeometry(const std::wstring& filename)
+{
+	auto geo = std::make_unique<MeshGeometry>();
+	if (!MeshFile::Load(filename, gGeometryVersion, *geo, &mDequantize))
+		return false;
+
+	// The CPU buffers point into the mapped file, so the upload reads the file
+	// directly.
+	geo->VertexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(),
+		geo->VertexBufferCPU->GetBufferPointer(), geo->VertexBufferByteSize, geo->VertexBufferUploader);
+
+	geo->IndexBufferGPU = d3dUtil::CreateDefaultBuffer(md3dDevice.Get(), mCommandList.Get(),
+		geo->IndexBufferCPU->GetBufferPointer(), geo->IndexBufferByteSize, geo->IndexBufferUploader);
+
 	mGeometries[geo->Name] = std::move(geo);
+	return true;
 }
 
 void ShapesApp::BuildPSOs()
 {
+	PROFILE_SCOPE("BuildPSOs");
+
 	D3D12_GRAPHICS_PIPELINE_STATE_DESC opaquePsoDesc;
 
 	//
@@ -705,35 +1041,57 @@ void ShapesApp::BuildPSOs()
 
 void ShapesApp::BuildFrameResources()
 {
+	PROFILE_SCOPE("BuildFrameResources");
+
 	for (int i = 0; i < gNumFrameResources; i++)
 	{
-		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get(), 1, (UINT)mAllRitems.size()));
+		mFrameResources.push_back(std::make_unique<FrameResource>(md3dDevice.Get()));
 	}
+
+	// Start with room for every frame in flight to draw every item and as many
+	// terrain chunks as the terrain caches.  The chunks keep their geometry in
+	// their own buffers, so only their object constants use the ring.  The ring
+	// grows if a frame needs more.
+	UINT64 objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+
+	UploadRing::Desc ringDesc;
+	ringDesc.Capacity = gNumFrameResources*((mAllRitems.size() + gTerrainCachedChunks)*objCBByteSize +
+		d3dUtil::CalcConstantBufferByteSize(sizeof(PassConstants)));
+	mUploadRing = std::make_unique<UploadRing>(md3dDevice.Get(), ringDesc);
 }
 
 void ShapesApp::BuildRenderItems()
 {
+	PROFILE_SCOPE("BuildRenderItems");
+
+	// The vertices are quantized, so every world matrix starts with the
+	// submesh's dequantization.
+	XMMATRIX boxDequantize = XMLoadFloat4x4(&mDequantize["box"]);
+	XMMATRIX sphereDequantize = XMLoadFloat4x4(&mDequantize["sphere"]);
+	XMMATRIX cylinderDequantize = XMLoadFloat4x4(&mDequantize["cylinder"]);
+
+	// The box hangs off a root node, and each row of cylinders and
+	// spheres off a node at the center of the row.  A node's slot is the item's
+	// ObjCBIndex.
+	auto root = mTransforms.AddNode(TransformHierarchy::None, XMMatrixIdentity());
+
+	XMStoreFloat4x4(&mBoxLocal, boxDequantize*XMMatrixScaling(2.0f, 2.0f, 2.0f));
+
 	auto boxRitem = std::make_unique<RenderItem>();
-	XMStoreFloat4x4(&boxRitem->World, XMMatrixScaling(2.0f, 2.0f, 2.0f)*XMMatrixTranslation(0.0f, 0.5f, 0.0f));
 	boxRitem->ObjCBIndex = 0;
+	boxRitem->Node = mTransforms.AddNode(root,
+		XMLoadFloat4x4(&mBoxLocal)*XMMatrixTranslation(0.0f, 0.5f, 0.0f), boxRitem->ObjCBIndex);
+	mBoxNode = boxRitem->Node;
 	boxRitem->Geo = mGeometries["shapeGeo"].get();
 	boxRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 	boxRitem->IndexCount = boxRitem->Geo->DrawArgs["box"].IndexCount;
 	boxRitem->StartIndexLocation = boxRitem->Geo->DrawArgs["box"].StartIndexLocation;
 	boxRitem->BaseVertexLocation = boxRitem->Geo->DrawArgs["box"].BaseVertexLocation;
+	boxRitem->Bounds = boxRitem->Geo->DrawArgs["box"].Bounds;
+	boxRitem->IsOccluder = true;
 	mAllRitems.push_back(std::move(boxRitem));
 
-	auto gridRitem = std::make_unique<RenderItem>();
-	gridRitem->World = MathHelper::Identity4x4();
-	gridRitem->ObjCBIndex = 1;
-	gridRitem->Geo = mGeometries["shapeGeo"].get();
-	gridRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
-	gridRitem->IndexCount = gridRitem->Geo->DrawArgs["grid"].IndexCount;
-	gridRitem->StartIndexLocation = gridRitem->Geo->DrawArgs["grid"].StartIndexLocation;
-	gridRitem->BaseVertexLocation = gridRitem->Geo->DrawArgs["grid"].BaseVertexLocation;
-	mAllRitems.push_back(std::move(gridRitem));
-
-	UINT objCBIndex = 2;
+	UINT objCBIndex = 1;
 	for (int i = 0; i < 5; ++i)
 	{
 		auto leftCylRitem = std::make_unique<RenderItem>();
@@ -741,43 +1099,51 @@ void ShapesApp::BuildRenderItems()
 		auto leftSphereRitem = std::make_unique<RenderItem>();
 		auto rightSphereRitem = std::make_unique<RenderItem>();
 
-		XMMATRIX leftCylWorld = XMMatrixTranslation(-5.0f, 1.5f, -10.0f + i * 5.0f);
-		XMMATRIX rightCylWorld = XMMatrixTranslation(+5.0f, 1.5f, -10.0f + i * 5.0f);
+		auto row = mTransforms.AddNode(root, XMMatrixTranslation(0.0f, 0.0f, -10.0f + i * 5.0f));
 
-		XMMATRIX leftSphereWorld = XMMatrixTranslation(-5.0f, 3.5f, -10.0f + i * 5.0f);
-		XMMATRIX rightSphereWorld = XMMatrixTranslation(+5.0f, 3.5f, -10.0f + i * 5.0f);
+		XMMATRIX leftCylLocal = XMMatrixTranslation(-5.0f, 1.5f, 0.0f);
+		XMMATRIX rightCylLocal = XMMatrixTranslation(+5.0f, 1.5f, 0.0f);
+
+		XMMATRIX leftSphereLocal = XMMatrixTranslation(-5.0f, 3.5f, 0.0f);
+		XMMATRIX rightSphereLocal = XMMatrixTranslation(+5.0f, 3.5f, 0.0f);
 
-		XMStoreFloat4x4(&leftCylRitem->World, rightCylWorld);
 		leftCylRitem->ObjCBIndex = objCBIndex++;
+		leftCylRitem->Node = mTransforms.AddNode(row, cylinderDequantize*rightCylLocal, leftCylRitem->ObjCBIndex);
 		leftCylRitem->Geo = mGeometries["shapeGeo"].get();
 		leftCylRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 		leftCylRitem->IndexCount = leftCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		leftCylRitem->StartIndexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		leftCylRitem->BaseVertexLocation = leftCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+		leftCylRitem->Bounds = leftCylRitem->Geo->DrawArgs["cylinder"].Bounds;
+		leftCylRitem->IsOccluder = true;
 
-		XMStoreFloat4x4(&rightCylRitem->World, leftCylWorld);
 		rightCylRitem->ObjCBIndex = objCBIndex++;
+		rightCylRitem->Node = mTransforms.AddNode(row, cylinderDequantize*leftCylLocal, rightCylRitem->ObjCBIndex);
 		rightCylRitem->Geo = mGeometries["shapeGeo"].get();
 		rightCylRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 		rightCylRitem->IndexCount = rightCylRitem->Geo->DrawArgs["cylinder"].IndexCount;
 		rightCylRitem->StartIndexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].StartIndexLocation;
 		rightCylRitem->BaseVertexLocation = rightCylRitem->Geo->DrawArgs["cylinder"].BaseVertexLocation;
+		rightCylRitem->Bounds = rightCylRitem->Geo->DrawArgs["cylinder"].Bounds;
+		rightCylRitem->IsOccluder = true;
 
-		XMStoreFloat4x4(&leftSphereRitem->World, leftSphereWorld);
 		leftSphereRitem->ObjCBIndex = objCBIndex++;
+		leftSphereRitem->Node = mTransforms.AddNode(row, sphereDequantize*leftSphereLocal, leftSphereRitem->ObjCBIndex);
 		leftSphereRitem->Geo = mGeometries["shapeGeo"].get();
 		leftSphereRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 		leftSphereRitem->IndexCount = leftSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		leftSphereRitem->StartIndexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		leftSphereRitem->BaseVertexLocation = leftSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		leftSphereRitem->Bounds = leftSphereRitem->Geo->DrawArgs["sphere"].Bounds;
 
-		XMStoreFloat4x4(&rightSphereRitem->World, rightSphereWorld);
 		rightSphereRitem->ObjCBIndex = objCBIndex++;
+		rightSphereRitem->Node = mTransforms.AddNode(row, sphereDequantize*rightSphereLocal, rightSphereRitem->ObjCBIndex);
 		rightSphereRitem->Geo = mGeometries["shapeGeo"].get();
 		rightSphereRitem->PrimitiveType = D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
 		rightSphereRitem->IndexCount = rightSphereRitem->Geo->DrawArgs["sphere"].IndexCount;
 		rightSphereRitem->StartIndexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].StartIndexLocation;
 		rightSphereRitem->BaseVertexLocation = rightSphereRitem->Geo->DrawArgs["sphere"].BaseVertexLocation;
+		rightSphereRitem->Bounds = rightSphereRitem->Geo->DrawArgs["sphere"].Bounds;
 
 		mAllRitems.push_back(std::move(leftCylRitem));
 		mAllRitems.push_back(std::move(rightCylRitem));
@@ -788,13 +1154,20 @@ void ShapesApp::BuildRenderItems()
 	// All the render items are opaque.
 	for (auto& e : mAllRitems)
 		mOpaqueRitems.push_back(e.get());
+
+	// The world bounds are filled in by UpdateTransforms, which sees every slot
+	// as changed on the first frame.
+	mCuller.Reserve(mOpaqueRitems.size());
+	for (size_t i = 0; i < mOpaqueRitems.size(); ++i)
+		mCuller.Add(BoundingBox());
+	mWorldBounds.resize(mOpaqueRitems.size());
 }
 
 void ShapesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::vector<RenderItem*>& ritems)
 {
-	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+	PROFILE_SCOPE("DrawRenderItems");
 
-	auto objectCB = mCurrFrameResource->ObjectCB->Resource();
+	UINT objCBByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
 
 	// For each render item...
 	for (size_t i = 0; i < ritems.size(); ++i)
@@ -805,13 +1178,28 @@ void ShapesApp::DrawRenderItems(ID3D12GraphicsCommandList* cmdList, const std::v
 		cmdList->IASetIndexBuffer(&ri->Geo->IndexBufferView());
 		cmdList->IASetPrimitiveTopology(ri->PrimitiveType);
 
-		// Offset to the CBV in the descriptor heap for this object and for this frame resource.
-		UINT cbvIndex = mCurrFrameResourceIndex * (UINT)mOpaqueRitems.size() + ri->ObjCBIndex;
-		auto cbvHandle = CD3DX12_GPU_DESCRIPTOR_HANDLE(mCbvHeap->GetGPUDescriptorHandleForHeapStart());
-		cbvHandle.Offset(cbvIndex, mCbvSrvUavDescriptorSize);
-
-		cmdList->SetGraphicsRootDescriptorTable(0, cbvHandle);
+		// UpdateObjectCBs wrote the items' constants in this order, one after another.
+		cmdList->SetGraphicsRootConstantBufferView(0, mObjectCBAddress + i*objCBByteSize);
 
 		cmdList->DrawIndexedInstanced(ri->IndexCount, 1, ri->StartIndexLocation, ri->BaseVertexLocation, 0);
 	}
 }
+
+void ShapesApp::DrawTerrain(ID3D12GraphicsCommandList* cmdList)
+{
+	PROFILE_SCOPE("DrawTerrain");
+
+	cmdList->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+
+	// Every chunk has its own vertex and index buffers, and UpdateTerrain wrote
+	// its constants.
+	for (const TerrainDraw& draw : mTerrainDraws)
+	{
+		const MeshGeometry& geo = draw.Chunk->Geo;
+		cmdList->IASetVertexBuffers(0, 1, &geo.VertexBufferView());
+		cmdList->IASetIndexBuffer(&geo.IndexBufferView());
+		cmdList->SetGraphicsRootConstantBufferView(0, draw.ObjectCBAddress);
+
+		cmdList->DrawIndexedInstanced(draw.Chunk->IndexCount, 1, 0, 0, 0);
+	}
+}
@@ -0,0 +1,58 @@
+//***************************************************************************************
+// FixedTimestep.cpp
+//***************************************************************************************
+
+#include "FixedTimestep.h"
+#include <algorithm>
+
+FixedTimestep::FixedTimestep(std::int64_t stepNs, uint32 maxStepsPerFrame)
+{
+	SetStep(stepNs, maxStepsPerFrame);
+}
+
+void FixedTimestep::SetStep(std::int64_t stepNs, uint32 maxStepsPerFrame)
+{
+	mStepNs = std::max((std::int64_t)1, stepNs);
+	mMaxStepsPerFrame = std::max(1u, maxStepsPerFrame);
+	mAccumulatorNs = 0;
+}
+
+std::int64_t FixedTimestep::GetStepNs()const
+{
+	return mStepNs;
+}
+
+FixedTimestep::uint32 FixedTimestep::GetMaxStepsPerFrame()const
+{
+	return mMaxStepsPerFrame;
+}
+
+FixedTimestep::uint32 FixedTimestep::Advance(std::int64_t frameNs)
+{
+	mAccumulatorNs += std::max((std::int64_t)0, frameNs);
+
+	std::int64_t due = mAccumulatorNs / mStepNs;
+	uint32 steps = (uint32)std::min(due, (std::int64_t)mMaxStepsPerFrame);
+
+	// Whether or not every due step runs, what is left is the fraction of a step:
+	// catching up on more than mMaxStepsPerFrame would make the next frame longer
+	// still, so that backlog is dropped.
+	mAccumulatorNs %= mStepNs;
+
+	return steps;
+}
+
+float FixedTimestep::GetAlpha()const
+{
+	return (float)((double)mAccumulatorNs / (double)mStepNs);
+}
+
+std::int64_t FixedTimestep::GetAccumulatedNs()const
+{
+	return mAccumulatorNs;
+}
+
+void FixedTimestep::Reset()
+{
+	mAccumulatorNs = 0;
+}
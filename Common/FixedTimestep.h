@@ -0,0 +1,55 @@
+//***************************************************************************************
+// FixedTimestep.h
+//
+// Splits variable frame times into fixed simulation steps.  Each frame adds its
+// duration to an accumulator and runs as many whole steps as it holds; the fraction
+// of a step left over is the interpolation factor for drawing between the last two
+// simulated states.
+//
+// After a long frame at most MaxStepsPerFrame steps run, and the rest of the
+// backlog is dropped rather than making the next frame longer still.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+
+class FixedTimestep
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	FixedTimestep() = default;
+	FixedTimestep(std::int64_t stepNs, uint32 maxStepsPerFrame);
+
+	///<summary>
+	/// stepNs is clamped to at least 1 ns and maxStepsPerFrame to at least 1.
+	/// Forgets the accumulated time.
+	///</summary>
+	void SetStep(std::int64_t stepNs, uint32 maxStepsPerFrame);
+
+	std::int64_t GetStepNs()const;
+	uint32 GetMaxStepsPerFrame()const;
+
+	///<summary>
+	/// Adds a frame of frameNs and returns the number of steps to simulate for it.
+	///</summary>
+	uint32 Advance(std::int64_t frameNs);
+
+	///<summary>
+	/// How far the time has moved past the last step, as a fraction of a step in
+	/// [0, 1).
+	///</summary>
+	float GetAlpha()const;
+
+	std::int64_t GetAccumulatedNs()const;
+
+	void Reset();
+
+private:
+
+	std::int64_t mStepNs = 1000000000 / 60;
+	uint32 mMaxStepsPerFrame = 5;
+	std::int64_t mAccumulatorNs = 0;
+};
@@ -0,0 +1,272 @@
+//***************************************************************************************
+// FramePacer.cpp
+//***************************************************************************************
+
+#include "FramePacer.h"
+#include "GameTimer.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FRAMEPACER_X86 1
+#include <emmintrin.h>
+#else
+#include <thread>
+#endif
+
+namespace
+{
+	// Weight of each new sample in the running overshoot estimate.
+	const double OvershootRate = 1.0 / 16.0;
+
+	// Deviations of overshoot to allow for before the deadline.
+	const double OvershootDeviations = 4.0;
+
+	class SystemClock : public FramePacer::Clock
+	{
+	public:
+		SystemClock()
+		{
+#if defined(_WIN32)
+			// High-resolution timers wake within a fraction of a millisecond rather than
+			// on the next scheduler tick.  Windows versions without them fail the call
+			// and Sleep is used instead.
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+			mTimer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+#endif
+		}
+
+		~SystemClock()
+		{
+#if defined(_WIN32)
+			if(mTimer != nullptr)
+				CloseHandle(mTimer);
+#endif
+		}
+
+		std::int64_t NowNs()override
+		{
+			return GameTimer::CurrentTimeNs();
+		}
+
+		void SleepNs(std::int64_t durationNs)override
+		{
+#if defined(_WIN32)
+			if(mTimer != nullptr)
+			{
+				// Negative due times are relative, in 100 ns units.
+				LARGE_INTEGER due;
+				due.QuadPart = -(LONGLONG)(durationNs / 100);
+				if(SetWaitableTimer(mTimer, &due, 0, nullptr, nullptr, FALSE))
+				{
+					WaitForSingleObject(mTimer, INFINITE);
+					return;
+				}
+			}
+
+			Sleep((DWORD)(durationNs / 1000000));
+#else
+			timespec duration;
+			duration.tv_sec = (time_t)(durationNs / 1000000000);
+			duration.tv_nsec = (long)(durationNs % 1000000000);
+			nanosleep(&duration, nullptr);
+#endif
+		}
+
+		void Spin()override
+		{
+#if defined(FRAMEPACER_X86)
+			_mm_pause();
+#else
+			std::this_thread::yield();
+#endif
+		}
+
+	private:
+#if defined(_WIN32)
+		HANDLE mTimer = nullptr;
+#endif
+	};
+}
+
+std::unique_ptr<FramePacer::Clock> FramePacer::CreateSystemClock()
+{
+	return std::make_unique<SystemClock>();
+}
+
+FramePacer::FramePacer(const Desc& desc, Clock* clock)
+	: mDesc(desc), mClock(clock)
+{
+	if(mClock == nullptr)
+	{
+		mSystemClock = CreateSystemClock();
+		mClock = mSystemClock.get();
+	}
+
+	mFrames.resize(std::max(1u, mDesc.StatsWindow));
+}
+
+void FramePacer::SetTargetFrameTime(std::int64_t targetFrameNs)
+{
+	mDesc.TargetFrameNs = std::max((std::int64_t)0, targetFrameNs);
+	Reset();
+}
+
+std::int64_t FramePacer::GetTargetFrameTime()const
+{
+	return mDesc.TargetFrameNs;
+}
+
+void FramePacer::Reset()
+{
+	mStarted = false;
+}
+
+std::int64_t FramePacer::GetSleepOvershoot()const
+{
+	return (std::int64_t)mOvershootMean;
+}
+
+void FramePacer::Sleep(std::int64_t durationNs)
+{
+	std::int64_t before = mClock->NowNs();
+	mClock->SleepNs(durationNs);
+	std::int64_t overshoot = mClock->NowNs() - before - durationNs;
+
+	if(!mOvershootMeasured)
+	{
+		mOvershootMean = (double)overshoot;
+		mOvershootDeviation = 0.5*std::fabs((double)overshoot);
+		mOvershootMeasured = true;
+		return;
+	}
+
+	mOvershootDeviation += (std::fabs(overshoot - mOvershootMean) - mOvershootDeviation)*OvershootRate;
+	mOvershootMean += (overshoot - mOvershootMean)*OvershootRate;
+}
+
+void FramePacer::Wait()
+{
+	const std::int64_t target = mDesc.TargetFrameNs;
+	std::int64_t now = mClock->NowNs();
+
+	// The first frame of a schedule has nothing to wait for.
+	if(!mStarted)
+	{
+		mStarted = true;
+		mLastWake = now;
+		mDeadline = now + target;
+		return;
+	}
+
+	Frame frame = {};
+	frame.Missed = target > 0 && now > mDeadline;
+
+	if(target > 0)
+	{
+		const std::int64_t start = now;
+
+		// Sleep until the deadline is closer than a sleep might overshoot.
+		std::int64_t spin = mDesc.InitialSpinNs;
+		if(mOvershootMeasured)
+			spin = (std::int64_t)(mOvershootMean + OvershootDeviations*mOvershootDeviation);
+		spin = std::max(spin, mDesc.MinSpinNs);
+
+		while(mDeadline - now > spin)
+		{
+			Sleep(mDeadline - now - spin);
+
+			std::int64_t woke = mClock->NowNs();
+			frame.Slept += woke - now;
+			now = woke;
+		}
+
+		while(now < mDeadline)
+		{
+			mClock->Spin();
+			now = mClock->NowNs();
+		}
+
+		frame.Waited = now - start;
+		frame.Lateness = now - mDeadline;
+	}
+
+	frame.Interval = now - mLastWake;
+	mLastWake = now;
+	Record(frame);
+
+	// Keep to the absolute schedule, so that waking late shortens the next wait.
+	// Far behind, start over rather than rush several frames to catch up.
+	std::int64_t maxLag = mDesc.MaxLagNs > 0 ? mDesc.MaxLagNs : target;
+	if(now - mDeadline > maxLag)
+		mDeadline = now + target;
+	else
+		mDeadline += target;
+}
+
+void FramePacer::Record(const Frame& frame)
+{
+	mFrames[mFrameNext] = frame;
+	mFrameNext = (mFrameNext + 1) % (uint32)mFrames.size();
+	mFrameCount = std::min(mFrameCount + 1, (uint32)mFrames.size());
+}
+
+FramePacer::Stats FramePacer::GetStats()const
+{
+	Stats stats;
+	stats.FrameCount = mFrameCount;
+	if(mFrameCount == 0)
+		return stats;
+
+	// Until the ring wraps, the recorded frames are its first entries.
+	double intervalSum = 0.0;
+	double latenessSum = 0.0;
+	double slept = 0.0;
+	double waited = 0.0;
+	uint32 onTime = 0;
+
+	for(uint32 i = 0; i < mFrameCount; ++i)
+	{
+		const Frame& f = mFrames[i];
+		intervalSum += (double)f.Interval;
+		slept += (double)f.Slept;
+		waited += (double)f.Waited;
+
+		if(f.Missed)
+		{
+			stats.MissedFrames++;
+			continue;
+		}
+
+		latenessSum += (double)f.Lateness;
+		stats.MaxLatenessMs = std::max(stats.MaxLatenessMs, f.Lateness*1e-6);
+		onTime++;
+	}
+
+	double meanInterval = intervalSum / mFrameCount;
+
+	double variance = 0.0;
+	for(uint32 i = 0; i < mFrameCount; ++i)
+	{
+		double d = (double)mFrames[i].Interval - meanInterval;
+		variance += d*d;
+	}
+	variance /= mFrameCount;
+
+	stats.MeanIntervalMs = meanInterval*1e-6;
+	stats.JitterMs = std::sqrt(variance)*1e-6;
+	stats.MeanLatenessMs = onTime > 0 ? latenessSum / onTime*1e-6 : 0.0;
+	stats.SleepFraction = waited > 0.0 ? slept / waited : 0.0;
+	return stats;
+}
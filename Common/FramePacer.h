@@ -0,0 +1,149 @@
+//***************************************************************************************
+// FramePacer.h
+//
+// Frame-rate limiter.  Wait, called once per frame, blocks until the frame's
+// deadline: it sleeps while the deadline is far off, which frees the core, and
+// spins through the last stretch, which sleeping cannot hit precisely.
+//
+// Deadlines are kept on an absolute schedule, one target frame time apart, so the
+// error of one wait is corrected by the next instead of accumulating.  A frame that
+// runs more than MaxLag past its deadline restarts the schedule rather than
+// rushing the frames after it.
+//
+// How far before the deadline to stop sleeping is learned from how much the sleeps
+// overshoot.  Time and sleeping go through a Clock, so the pacing can be run
+// against a simulated clock.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class FramePacer
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	class Clock
+	{
+	public:
+		virtual ~Clock() = default;
+
+		// Monotonic time in nanoseconds.
+		virtual std::int64_t NowNs() = 0;
+
+		// Blocks for about durationNs.  The scheduler may wake the thread late.
+		virtual void SleepNs(std::int64_t durationNs) = 0;
+
+		// Called on every iteration of the final spin.
+		virtual void Spin() = 0;
+	};
+
+	///<summary>
+	/// GameTimer::CurrentTimeNs with the operating system's finest sleep.
+	///</summary>
+	static std::unique_ptr<Clock> CreateSystemClock();
+
+	struct Desc
+	{
+		// 0 does not limit the frame rate; Wait then only records statistics.
+		std::int64_t TargetFrameNs = 0;
+
+		// Time left at which sleeping stops, until overshoot has been measured.
+		// The learned value never goes below MinSpinNs.
+		std::int64_t InitialSpinNs = 2000000;
+		std::int64_t MinSpinNs = 200000;
+
+		// Lateness beyond which the schedule restarts from the current frame; 0 uses
+		// one target frame time.
+		std::int64_t MaxLagNs = 0;
+
+		// Frames the statistics cover.
+		uint32 StatsWindow = 240;
+	};
+
+	struct Stats
+	{
+		uint32 FrameCount = 0;
+
+		// Time from one Wait returning to the next, and its standard deviation.
+		double MeanIntervalMs = 0.0;
+		double JitterMs = 0.0;
+
+		// How late Wait returned relative to the deadline, over the frames that
+		// were not missed.
+		double MeanLatenessMs = 0.0;
+		double MaxLatenessMs = 0.0;
+
+		// Frames that were already past the deadline when Wait was called.
+		uint32 MissedFrames = 0;
+
+		// Share of the waiting spent asleep rather than spinning.
+		double SleepFraction = 0.0;
+	};
+
+	FramePacer() : FramePacer(Desc()) {}
+
+	///<summary>
+	/// clock is not owned; null uses a system clock.
+	///</summary>
+	explicit FramePacer(const Desc& desc, Clock* clock = nullptr);
+
+	FramePacer(const FramePacer& rhs) = delete;
+	FramePacer& operator=(const FramePacer& rhs) = delete;
+
+	void SetTargetFrameTime(std::int64_t targetFrameNs);
+	std::int64_t GetTargetFrameTime()const;
+
+	///<summary>
+	/// Blocks until the current frame's deadline, then starts the next frame.
+	/// Call once per frame, after Present.
+	///</summary>
+	void Wait();
+
+	///<summary>
+	/// Starts a new schedule at the next Wait, for example after the application
+	/// was paused.  The statistics are kept.
+	///</summary>
+	void Reset();
+
+	Stats GetStats()const;
+
+	// Current estimate of how late a sleep wakes up.
+	std::int64_t GetSleepOvershoot()const;
+
+private:
+
+	struct Frame
+	{
+		std::int64_t Interval;
+		std::int64_t Lateness;
+		std::int64_t Slept;
+		std::int64_t Waited;
+		bool Missed;
+	};
+
+	void Sleep(std::int64_t durationNs);
+	void Record(const Frame& frame);
+
+	Desc mDesc;
+
+	std::unique_ptr<Clock> mSystemClock;
+	Clock* mClock = nullptr;
+
+	bool mStarted = false;
+	std::int64_t mDeadline = 0;
+	std::int64_t mLastWake = 0;
+
+	// Running mean and mean absolute deviation of sleep overshoot.
+	double mOvershootMean = 0.0;
+	double mOvershootDeviation = 0.0;
+	bool mOvershootMeasured = false;
+
+	std::vector<Frame> mFrames;
+	uint32 mFrameNext = 0;
+	uint32 mFrameCount = 0;
+};
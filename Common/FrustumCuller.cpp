@@ -0,0 +1,274 @@
+//***************************************************************************************
+// FrustumCuller.cpp
+//***************************************************************************************
+
+#include "FrustumCuller.h"
+#include "MathBatch.h"
+
+#if !defined(_XM_NO_INTRINSICS_) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define FRUSTUMCULLER_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(FRUSTUMCULLER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define FRUSTUMCULLER_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define FRUSTUMCULLER_AVX2
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = FrustumCuller::uint32;
+
+	const size_t Padding = 8;
+
+	// The planes with their normals' absolute values, which turn a box's extents
+	// into its projected radius along the normal.
+	struct Planes
+	{
+		XMFLOAT4 Plane[6];
+		XMFLOAT3 AbsNormal[6];
+	};
+
+	struct Boxes
+	{
+		const float* CenterX;
+		const float* CenterY;
+		const float* CenterZ;
+		const float* ExtentX;
+		const float* ExtentY;
+		const float* ExtentZ;
+		size_t Count;
+	};
+
+	// Appends first + k for every set bit k of mask.  Writing every lane and only
+	// advancing past the visible ones keeps the loop free of branches; visible must
+	// have room for all lanes.  The callers skip blocks with nothing visible, which
+	// are most of them in a large scene.
+	inline size_t Compact(uint32* visible, size_t n, uint32 first, int mask, int lanes)
+	{
+		for(int k = 0; k < lanes; ++k)
+		{
+			visible[n] = first + k;
+			n += (mask >> k) & 1;
+		}
+
+		return n;
+	}
+
+	// Bit k set for the lanes of the block at first that hold real boxes.
+	inline int ValidMask(size_t first, size_t count, int lanes)
+	{
+		size_t valid = count - first;
+		return valid >= (size_t)lanes ? (1 << lanes) - 1 : (1 << valid) - 1;
+	}
+
+	size_t CullScalar(const Planes& planes, const Boxes& boxes, uint32* visible)
+	{
+		size_t n = 0;
+		for(size_t i = 0; i < boxes.Count; ++i)
+		{
+			bool outside = false;
+			for(int p = 0; p < 6; ++p)
+			{
+				const XMFLOAT4& plane = planes.Plane[p];
+				const XMFLOAT3& a = planes.AbsNormal[p];
+
+				float d = plane.x*boxes.CenterX[i] + plane.y*boxes.CenterY[i] + plane.z*boxes.CenterZ[i] + plane.w;
+				float r = a.x*boxes.ExtentX[i] + a.y*boxes.ExtentY[i] + a.z*boxes.ExtentZ[i];
+
+				outside |= d + r < 0.0f;
+			}
+
+			visible[n] = (uint32)i;
+			n += outside ? 0 : 1;
+		}
+
+		return n;
+	}
+
+#if defined(FRUSTUMCULLER_X86)
+
+	size_t CullSSE2(const Planes& planes, const Boxes& boxes, uint32* visible)
+	{
+		__m128 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+		for(int p = 0; p < 6; ++p)
+		{
+			nx[p] = _mm_set1_ps(planes.Plane[p].x);
+			ny[p] = _mm_set1_ps(planes.Plane[p].y);
+			nz[p] = _mm_set1_ps(planes.Plane[p].z);
+			nw[p] = _mm_set1_ps(planes.Plane[p].w);
+			ax[p] = _mm_set1_ps(planes.AbsNormal[p].x);
+			ay[p] = _mm_set1_ps(planes.AbsNormal[p].y);
+			az[p] = _mm_set1_ps(planes.AbsNormal[p].z);
+		}
+
+		const __m128 zero = _mm_setzero_ps();
+
+		size_t n = 0;
+		for(size_t i = 0; i < boxes.Count; i += 4)
+		{
+			__m128 cx = _mm_loadu_ps(boxes.CenterX + i);
+			__m128 cy = _mm_loadu_ps(boxes.CenterY + i);
+			__m128 cz = _mm_loadu_ps(boxes.CenterZ + i);
+			__m128 ex = _mm_loadu_ps(boxes.ExtentX + i);
+			__m128 ey = _mm_loadu_ps(boxes.ExtentY + i);
+			__m128 ez = _mm_loadu_ps(boxes.ExtentZ + i);
+
+			__m128 outside = zero;
+			for(int p = 0; p < 6; ++p)
+			{
+				__m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], cx), _mm_mul_ps(ny[p], cy)),
+					_mm_add_ps(_mm_mul_ps(nz[p], cz), nw[p]));
+				__m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax[p], ex), _mm_mul_ps(ay[p], ey)),
+					_mm_mul_ps(az[p], ez));
+
+				outside = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(d, r), zero));
+			}
+
+			int mask = ~_mm_movemask_ps(outside) & ValidMask(i, boxes.Count, 4);
+			if(mask != 0)
+				n = Compact(visible, n, (uint32)i, mask, 4);
+		}
+
+		return n;
+	}
+
+	FRUSTUMCULLER_AVX2 size_t CullAVX2(const Planes& planes, const Boxes& boxes, uint32* visible)
+	{
+		__m256 nx[6], ny[6], nz[6], nw[6], ax[6], ay[6], az[6];
+		for(int p = 0; p < 6; ++p)
+		{
+			nx[p] = _mm256_set1_ps(planes.Plane[p].x);
+			ny[p] = _mm256_set1_ps(planes.Plane[p].y);
+			nz[p] = _mm256_set1_ps(planes.Plane[p].z);
+			nw[p] = _mm256_set1_ps(planes.Plane[p].w);
+			ax[p] = _mm256_set1_ps(planes.AbsNormal[p].x);
+			ay[p] = _mm256_set1_ps(planes.AbsNormal[p].y);
+			az[p] = _mm256_set1_ps(planes.AbsNormal[p].z);
+		}
+
+		const __m256 zero = _mm256_setzero_ps();
+
+		size_t n = 0;
+		for(size_t i = 0; i < boxes.Count; i += 8)
+		{
+			__m256 cx = _mm256_loadu_ps(boxes.CenterX + i);
+			__m256 cy = _mm256_loadu_ps(boxes.CenterY + i);
+			__m256 cz = _mm256_loadu_ps(boxes.CenterZ + i);
+			__m256 ex = _mm256_loadu_ps(boxes.ExtentX + i);
+			__m256 ey = _mm256_loadu_ps(boxes.ExtentY + i);
+			__m256 ez = _mm256_loadu_ps(boxes.ExtentZ + i);
+
+			__m256 outside = zero;
+			for(int p = 0; p < 6; ++p)
+			{
+				// d + r = n.c + w + |n|.e
+				__m256 s = _mm256_fmadd_ps(nx[p], cx, nw[p]);
+				s = _mm256_fmadd_ps(ny[p], cy, s);
+				s = _mm256_fmadd_ps(nz[p], cz, s);
+				s = _mm256_fmadd_ps(ax[p], ex, s);
+				s = _mm256_fmadd_ps(ay[p], ey, s);
+				s = _mm256_fmadd_ps(az[p], ez, s);
+
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(s, zero, _CMP_LT_OQ));
+			}
+
+			int mask = ~_mm256_movemask_ps(outside) & ValidMask(i, boxes.Count, 8);
+			if(mask != 0)
+				n = Compact(visible, n, (uint32)i, mask, 8);
+		}
+
+		return n;
+	}
+
+#endif
+
+	// Rounds count up so the padded arrays hold whole SIMD blocks.
+	size_t PaddedCount(size_t count)
+	{
+		return (count + Padding - 1) / Padding * Padding;
+	}
+}
+
+FrustumCuller::uint32 FrustumCuller::Add(const BoundingBox& box)
+{
+	uint32 index = (uint32)mCount;
+	Resize(mCount + 1);
+	Set(index, box);
+
+	return index;
+}
+
+void FrustumCuller::Set(uint32 index, const BoundingBox& box)
+{
+	mCenterX[index] = box.Center.x;
+	mCenterY[index] = box.Center.y;
+	mCenterZ[index] = box.Center.z;
+	mExtentX[index] = box.Extents.x;
+	mExtentY[index] = box.Extents.y;
+	mExtentZ[index] = box.Extents.z;
+}
+
+void FrustumCuller::Clear()
+{
+	Resize(0);
+}
+
+void FrustumCuller::Reserve(size_t count)
+{
+	size_t padded = PaddedCount(count);
+	for(auto* v : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ })
+		v->reserve(padded);
+}
+
+size_t FrustumCuller::GetCount()const
+{
+	return mCount;
+}
+
+void FrustumCuller::Resize(size_t count)
+{
+	size_t padded = PaddedCount(count);
+	for(auto* v : { &mCenterX, &mCenterY, &mCenterZ, &mExtentX, &mExtentY, &mExtentZ })
+		v->resize(padded, 0.0f);
+
+	mCount = count;
+}
+
+void FrustumCuller::Cull(CXMMATRIX viewProj, std::vector<uint32>& visible)const
+{
+	Planes planes;
+	MathHelper::ExtractFrustumPlanes(viewProj, planes.Plane);
+	for(int p = 0; p < 6; ++p)
+	{
+		XMVECTOR normal = XMLoadFloat4(&planes.Plane[p]);
+		XMStoreFloat3(&planes.AbsNormal[p], XMVectorAbs(normal));
+	}
+
+	Boxes boxes = { mCenterX.data(), mCenterY.data(), mCenterZ.data(),
+		mExtentX.data(), mExtentY.data(), mExtentZ.data(), mCount };
+
+	// Compact writes whole blocks, so leave room for the padding.
+	visible.resize(PaddedCount(mCount));
+
+	size_t n = 0;
+	switch(MathBatch::GetPath())
+	{
+#if defined(FRUSTUMCULLER_X86)
+	case MathBatch::Path::AVX2:
+		n = CullAVX2(planes, boxes, visible.data());
+		break;
+	case MathBatch::Path::SSE2:
+		n = CullSSE2(planes, boxes, visible.data());
+		break;
+#endif
+	default:
+		n = CullScalar(planes, boxes, visible.data());
+		break;
+	}
+
+	visible.resize(n);
+}
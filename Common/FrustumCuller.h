@@ -0,0 +1,59 @@
+//***************************************************************************************
+// FrustumCuller.h
+//
+// Tests many world-space boxes against a view frustum at once.  The boxes are kept
+// in structure-of-arrays form, one array per center and extent component, so a
+// plane test is a handful of multiply-adds over four (SSE2) or eight (AVX2) boxes
+// instead of one box per call.  The instruction set follows MathBatch::GetPath().
+//
+// The test is conservative: a box is only culled when it lies entirely behind one
+// of the six planes, so boxes near a frustum corner may be reported visible.
+//***************************************************************************************
+
+#pragma once
+
+#include "MathHelper.h"
+#include <vector>
+
+class FrustumCuller
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	///<summary>
+	/// Adds a world-space box and returns its index, which Cull reports when it is
+	/// visible.  Indices are handed out in order starting at zero.
+	///</summary>
+	uint32 Add(const DirectX::BoundingBox& box);
+
+	// Replaces the box of an item that moved.
+	void Set(uint32 index, const DirectX::BoundingBox& box);
+
+	void Clear();
+	void Reserve(size_t count);
+
+	size_t GetCount()const;
+
+	///<summary>
+	/// Replaces visible with the indices, in increasing order, of the boxes inside
+	/// or intersecting the frustum of viewProj (row vectors, as in PassConstants
+	/// before transposing).
+	///</summary>
+	void Cull(DirectX::CXMMATRIX viewProj, std::vector<uint32>& visible)const;
+
+private:
+
+	// Each array is padded to a multiple of eight so the SIMD loops never need a
+	// scalar tail; the padding is masked out of the results.
+	void Resize(size_t count);
+
+	size_t mCount = 0;
+
+	std::vector<float> mCenterX;
+	std::vector<float> mCenterY;
+	std::vector<float> mCenterZ;
+	std::vector<float> mExtentX;
+	std::vector<float> mExtentY;
+	std::vector<float> mExtentZ;
+};
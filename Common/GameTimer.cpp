@@ -2,16 +2,64 @@
 // GameTimer.cpp by Frank Luna (C) 2011 All Rights Reserved.
 //***************************************************************************************
 
-#include <windows.h>
 #include "GameTimer.h"
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <time.h>
+#endif
 
-GameTimer::GameTimer()
-: mSecondsPerCount(0.0), mDeltaTime(-1.0), mBaseTime(0), 
-  mPausedTime(0), mPrevTime(0), mCurrTime(0), mStopped(false)
+namespace
 {
-	__int64 countsPerSec;
-	QueryPerformanceFrequency((LARGE_INTEGER*)&countsPerSec);
-	mSecondsPerCount = 1.0 / (double)countsPerSec;
+	const double SecondsPerNs = 1e-9;
+	const double MsPerNs = 1e-6;
+
+	// Value at fraction p of the sorted frame times, interpolating between the two
+	// nearest.
+	double Percentile(const std::vector<std::int64_t>& sorted, double p)
+	{
+		double rank = p*(double)(sorted.size() - 1);
+		size_t lower = (size_t)rank;
+		size_t upper = std::min(lower + 1, sorted.size() - 1);
+		double t = rank - (double)lower;
+
+		return ((1.0 - t)*(double)sorted[lower] + t*(double)sorted[upper])*MsPerNs;
+	}
+}
+
+GameTimer::GameTimer(TimeSource now)
+: mNow(now), mDeltaTime(-1), mBaseTime(0), mPausedTime(0), mStopTime(0),
+  mPrevTime(0), mCurrTime(0), mStopped(false)
+{
+	SetStatsWindow(1000);
+}
+
+std::int64_t GameTimer::CurrentTimeNs()
+{
+#if defined(_WIN32)
+	static const std::int64_t countsPerSec = []()
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		return (std::int64_t)frequency.QuadPart;
+	}();
+
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+
+	// Whole seconds and the remainder separately, so counts*1e9 cannot overflow.
+	std::int64_t counts = counter.QuadPart;
+	return (counts / countsPerSec)*1000000000 + (counts % countsPerSec)*1000000000 / countsPerSec;
+#else
+	timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (std::int64_t)now.tv_sec*1000000000 + now.tv_nsec;
+#endif
 }
 
 // Returns the total time elapsed since Reset() was called, NOT counting any
@@ -29,7 +77,7 @@ float GameTimer::TotalTime()const
 
 	if( mStopped )
 	{
-		return (float)(((mStopTime - mPausedTime)-mBaseTime)*mSecondsPerCount);
+		return (float)(((mStopTime - mPausedTime)-mBaseTime)*SecondsPerNs);
 	}
 
 	// The distance mCurrTime - mBaseTime includes paused time,
@@ -44,31 +92,46 @@ float GameTimer::TotalTime()const
 	
 	else
 	{
-		return (float)(((mCurrTime-mPausedTime)-mBaseTime)*mSecondsPerCount);
+		return (float)(((mCurrTime-mPausedTime)-mBaseTime)*SecondsPerNs);
 	}
 }
 
 float GameTimer::DeltaTime()const
 {
-	return (float)mDeltaTime;
+	return (float)(mDeltaTime*SecondsPerNs);
+}
+
+std::int64_t GameTimer::TotalTimeNs()const
+{
+	if( mStopped )
+		return (mStopTime - mPausedTime) - mBaseTime;
+
+	return (mCurrTime - mPausedTime) - mBaseTime;
+}
+
+std::int64_t GameTimer::DeltaTimeNs()const
+{
+	return mDeltaTime;
 }
 
 void GameTimer::Reset()
 {
-	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
+	std::int64_t currTime = mNow();
 
 	mBaseTime = currTime;
 	mPrevTime = currTime;
+	mCurrTime = currTime;
+	mPausedTime = 0;
 	mStopTime = 0;
 	mStopped  = false;
+
+	mFrameTimeNext = 0;
+	mFrameTimeCount = 0;
 }
 
 void GameTimer::Start()
 {
-	__int64 startTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&startTime);
-
+	std::int64_t startTime = mNow();
 
 	// Accumulate the time elapsed between stop and start pairs.
 	//
@@ -90,10 +153,7 @@ void GameTimer::Stop()
 {
 	if( !mStopped )
 	{
-		__int64 currTime;
-		QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
-
-		mStopTime = currTime;
+		mStopTime = mNow();
 		mStopped  = true;
 	}
 }
@@ -102,16 +162,14 @@ void GameTimer::Tick()
 {
 	if( mStopped )
 	{
-		mDeltaTime = 0.0;
+		mDeltaTime = 0;
 		return;
 	}
 
-	__int64 currTime;
-	QueryPerformanceCounter((LARGE_INTEGER*)&currTime);
-	mCurrTime = currTime;
+	mCurrTime = mNow();
 
 	// Time difference between this frame and the previous.
-	mDeltaTime = (mCurrTime - mPrevTime)*mSecondsPerCount;
+	mDeltaTime = mCurrTime - mPrevTime;
 
 	// Prepare for next frame.
 	mPrevTime = mCurrTime;
@@ -119,9 +177,58 @@ void GameTimer::Tick()
 	// Force nonnegative.  The DXSDK's CDXUTTimer mentions that if the 
 	// processor goes into a power save mode or we get shuffled to another
 	// processor, then mDeltaTime can be negative.
-	if(mDeltaTime < 0.0)
+	if(mDeltaTime < 0)
 	{
-		mDeltaTime = 0.0;
+		mDeltaTime = 0;
 	}
+
+	mFrameTimes[mFrameTimeNext] = mDeltaTime;
+	mFrameTimeNext = (mFrameTimeNext + 1) % (std::uint32_t)mFrameTimes.size();
+	mFrameTimeCount = std::min(mFrameTimeCount + 1, (std::uint32_t)mFrameTimes.size());
+}
+
+void GameTimer::Advance(std::int64_t deltaNs)
+{
+	mDeltaTime = deltaNs;
+	mCurrTime += deltaNs;
+	mPrevTime = mCurrTime;
+}
+
+GameTimer::FrameTimeStats GameTimer::GetFrameTimeStats()const
+{
+	FrameTimeStats stats;
+	if(mFrameTimeCount == 0)
+		return stats;
+
+	// Until the ring wraps, the recorded times are its first entries.
+	std::vector<std::int64_t> sorted(mFrameTimes.begin(), mFrameTimes.begin() + mFrameTimeCount);
+	std::sort(sorted.begin(), sorted.end());
+
+	// The sum stays an integer, so the average does not drift however long the
+	// window has been running.
+	std::int64_t sum = 0;
+	for(std::int64_t t : sorted)
+		sum += t;
+
+	stats.FrameCount = mFrameTimeCount;
+	stats.MinMs = sorted.front()*MsPerNs;
+	stats.AvgMs = (double)sum / mFrameTimeCount*MsPerNs;
+	stats.P50Ms = Percentile(sorted, 0.50);
+	stats.P95Ms = Percentile(sorted, 0.95);
+	stats.P99Ms = Percentile(sorted, 0.99);
+	stats.MaxMs = sorted.back()*MsPerNs;
+	return stats;
+}
+
+void GameTimer::SetStatsWindow(std::uint32_t frameCount)
+{
+	mFrameTimes.assign(std::max(1u, frameCount), 0);
+	mFrameTimeNext = 0;
+	mFrameTimeCount = 0;
+}
+
+std::uint32_t GameTimer::GetStatsWindow()const
+{
+	return (std::uint32_t)mFrameTimes.size();
 }
 
@@ -1,34 +1,94 @@
 //***************************************************************************************
 // GameTimer.h by Frank Luna (C) 2011 All Rights Reserved.
+//
+// Times are kept as 64-bit integer nanoseconds from a monotonic clock, so they keep
+// full precision however long the application runs; the float accessors convert on
+// the way out.  The timer also keeps a window of recent frame times for pacing
+// statistics.
 //***************************************************************************************
 
 #ifndef GAMETIMER_H
 #define GAMETIMER_H
 
+#include <cstdint>
+#include <vector>
+
 class GameTimer
 {
 public:
-	GameTimer();
+	// Frame times over the last GetStatsWindow() ticks, in milliseconds.
+	struct FrameTimeStats
+	{
+		std::uint32_t FrameCount = 0;
+		double MinMs = 0.0;
+		double AvgMs = 0.0;
+		double P50Ms = 0.0;
+		double P95Ms = 0.0;
+		double P99Ms = 0.0;
+		double MaxMs = 0.0;
+	};
+
+	// Reads the current time in nanoseconds, like CurrentTimeNs.
+	using TimeSource = std::int64_t(*)();
+
+	///<summary>
+	/// now is the clock the timer reads.  Passing a simulated clock feeds the timer
+	/// known frame times.
+	///</summary>
+	explicit GameTimer(TimeSource now = CurrentTimeNs);
 
 	float TotalTime()const; // in seconds
 	float DeltaTime()const; // in seconds
 
+	std::int64_t TotalTimeNs()const;
+	std::int64_t DeltaTimeNs()const;
+
 	void Reset(); // Call before message loop.
 	void Start(); // Call when unpaused.
 	void Stop();  // Call when paused.
 	void Tick();  // Call every frame.
 
+	///<summary>
+	/// Moves the timer forward by exactly deltaNs instead of reading the clock, for
+	/// a timer that counts simulated time in fixed steps.  Not recorded in the
+	/// frame-time statistics.
+	///</summary>
+	void Advance(std::int64_t deltaNs);
+
+	///<summary>
+	/// Statistics of the frame times recorded by the last ticks.  Paused time is not
+	/// counted.
+	///</summary>
+	FrameTimeStats GetFrameTimeStats()const;
+
+	// Number of frames the statistics cover; changing it forgets the recorded ones.
+	void SetStatsWindow(std::uint32_t frameCount);
+	std::uint32_t GetStatsWindow()const;
+
+	///<summary>
+	/// Current value of the monotonic clock in nanoseconds: QueryPerformanceCounter
+	/// on Windows and clock_gettime(CLOCK_MONOTONIC) elsewhere.  Only differences
+	/// between values are meaningful.
+	///</summary>
+	static std::int64_t CurrentTimeNs();
+
 private:
-	double mSecondsPerCount;
-	double mDeltaTime;
+	TimeSource mNow;
 
-	__int64 mBaseTime;
-	__int64 mPausedTime;
-	__int64 mStopTime;
-	__int64 mPrevTime;
-	__int64 mCurrTime;
+	std::int64_t mDeltaTime;
+
+	std::int64_t mBaseTime;
+	std::int64_t mPausedTime;
+	std::int64_t mStopTime;
+	std::int64_t mPrevTime;
+	std::int64_t mCurrTime;
 
 	bool mStopped;
+
+	// Ring of the last frame times, in nanoseconds.
+	std::vector<std::int64_t> mFrameTimes;
+	std::uint32_t mFrameTimeNext = 0;
+	std::uint32_t mFrameTimeCount = 0;
 };
 
-#endif // GAMETIMER_H
\ No newline at end of file
+#endif // GAMETIMER_H
@@ -3,11 +3,54 @@
 //***************************************************************************************
 
 #include "GeometryGenerator.h"
+#include "MeshOptimizer.h"
+#include "MathHelper.h"
 #include <algorithm>
+#include <unordered_map>
+#include <cassert>
+#include <cstring>
+#include "ParallelFor.h"
 
 using namespace DirectX;
 
+namespace
+{
+	template<typename T>
+	void StoreAttribute(const GeometryGenerator::VertexStream& stream, GeometryGenerator::uint32 i, const T& value)
+	{
+		if(stream.Data != nullptr)
+			std::memcpy(static_cast<char*>(stream.Data) + (size_t)i*stream.Stride, &value, sizeof(T));
+	}
+}
+
+void GeometryGenerator::SetCooked(bool cooked)
+{
+	mCooked = cooked;
+}
+
+bool GeometryGenerator::IsCooked()const
+{
+	return mCooked;
+}
+
+void GeometryGenerator::Cook(MeshData& meshData)const
+{
+	if(mCooked)
+	{
+		MeshOptimizer::WeldVertices(meshData);
+		MeshOptimizer::Optimize(meshData);
+	}
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions)
+{
+	MeshData meshData = BuildBox(width, height, depth, numSubdivisions);
+	Cook(meshData);
+
+	return meshData;
+}
+
+GeometryGenerator::MeshData GeometryGenerator::BuildBox(float width, float height, float depth, uint32 numSubdivisions)
 {
     MeshData meshData;
 
@@ -94,16 +137,90 @@ GeometryGenerator::MeshData GeometryGenerator::CreateBox(float width, float heig
     // Put a cap on the number of subdivisions.
     numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
 
+	meshData.Vertices.reserve(BoxSize(numSubdivisions).VertexCount);
+
     for(uint32 i = 0; i < numSubdivisions; ++i)
         Subdivide(meshData);
 
+    ComputeBounds(meshData);
+
     return meshData;
 }
 
+bool GeometryGenerator::CreateBox(float width, float height, float depth, uint32 numSubdivisions, const MeshStreams& out)
+{
+	if(!CanWriteIndices(out, BoxSize(numSubdivisions).VertexCount))
+		return false;
+
+	// Subdivision reads back every attribute of the generated vertices, so build
+	// the full mesh first and then write out the requested attributes.  Like the
+	// other stream overloads it is not cooked, so it matches BoxSize.
+	return WriteVertices(BuildBox(width, height, depth, numSubdivisions), out);
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::BoxSize(uint32 numSubdivisions)
+{
+	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+
+	// Each face starts as a quad split into two triangles.  Subdividing it n times
+	// yields a regular (2^n+1)x(2^n+1) grid of vertices with 2*4^n triangles.
+	// Faces do not share vertices because their normals differ.
+	uint32 edgeVertices = (1u << numSubdivisions) + 1;
+	uint32 faceTriangles = 2u << (2*numSubdivisions);
+
+	MeshSize size;
+	size.VertexCount = 6*edgeVertices*edgeVertices;
+	size.IndexCount  = 6*faceTriangles*3;
+
+	return size;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GeosphereSize(uint32 numSubdivisions)
+{
+	numSubdivisions = std::min<uint32>(numSubdivisions, 6u);
+
+	// An icosahedron has V = 12, E = 30, F = 20.  Each subdivision adds one vertex
+	// per edge and splits every triangle in four, which gives V = 10*4^n + 2.
+	uint32 pow4 = 1u << (2*numSubdivisions);
+
+	MeshSize size;
+	size.VertexCount = 10*pow4 + 2;
+	size.IndexCount  = 60*pow4;
+
+	return size;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::SphereSize(uint32 sliceCount, uint32 stackCount)
+{
+	// Two poles plus stackCount-1 rings of sliceCount+1 vertices.  Each of the
+	// sliceCount columns has two pole triangles and 2*(stackCount-2) inner ones.
+	MeshSize size;
+	size.VertexCount = (stackCount-1)*(sliceCount+1) + 2;
+	size.IndexCount  = 6*sliceCount*(stackCount-1);
+
+	return size;
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
 
+	MeshSize size = SphereSize(sliceCount, stackCount);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices32.resize(size.IndexCount);
+
+	CreateSphere(radius, sliceCount, stackCount, GetStreams(meshData));
+
+    Cook(meshData);
+
+    return meshData;
+}
+
+bool GeometryGenerator::CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, const MeshStreams& out)
+{
+	if(!CanWriteIndices(out, SphereSize(sliceCount, stackCount).VertexCount))
+		return false;
+
 	//
 	// Compute the vertices stating at the top pole and moving down the stacks.
 	//
@@ -114,7 +231,10 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	Vertex topVertex(0.0f, +radius, 0.0f, 0.0f, +1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
 	Vertex bottomVertex(0.0f, -radius, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
 
-	meshData.Vertices.push_back( topVertex );
+	BoundsBuilder bounds;
+
+	uint32 vertexCount = 0;
+	WriteVertex(out, vertexCount++, topVertex, bounds);
 
 	float phiStep   = XM_PI/stackCount;
 	float thetaStep = 2.0f*XM_PI/sliceCount;
@@ -150,22 +270,23 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 			v.TexC.x = theta / XM_2PI;
 			v.TexC.y = phi / XM_PI;
 
-			meshData.Vertices.push_back( v );
+			WriteVertex(out, vertexCount++, v, bounds);
 		}
 	}
 
-	meshData.Vertices.push_back( bottomVertex );
+	WriteVertex(out, vertexCount++, bottomVertex, bounds);
 
 	//
 	// Compute indices for top stack.  The top stack was written first to the vertex buffer
 	// and connects the top pole to the first ring.
 	//
 
+	uint32 k = 0;
     for(uint32 i = 1; i <= sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(0);
-		meshData.Indices32.push_back(i+1);
-		meshData.Indices32.push_back(i);
+		WriteIndex(out, k++, 0);
+		WriteIndex(out, k++, i+1);
+		WriteIndex(out, k++, i);
 	}
 	
 	//
@@ -180,13 +301,13 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	{
 		for(uint32 j = 0; j < sliceCount; ++j)
 		{
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
+			WriteIndex(out, k++, baseIndex + i*ringVertexCount + j);
+			WriteIndex(out, k++, baseIndex + i*ringVertexCount + j+1);
+			WriteIndex(out, k++, baseIndex + (i+1)*ringVertexCount + j);
 
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back(baseIndex + i*ringVertexCount + j+1);
-			meshData.Indices32.push_back(baseIndex + (i+1)*ringVertexCount + j+1);
+			WriteIndex(out, k++, baseIndex + (i+1)*ringVertexCount + j);
+			WriteIndex(out, k++, baseIndex + i*ringVertexCount + j+1);
+			WriteIndex(out, k++, baseIndex + (i+1)*ringVertexCount + j+1);
 		}
 	}
 
@@ -196,29 +317,62 @@ GeometryGenerator::MeshData GeometryGenerator::CreateSphere(float radius, uint32
 	//
 
 	// South pole vertex was added last.
-	uint32 southPoleIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 southPoleIndex = vertexCount-1;
 
 	// Offset the indices to the index of the first vertex in the last ring.
 	baseIndex = southPoleIndex - ringVertexCount;
 	
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(southPoleIndex);
-		meshData.Indices32.push_back(baseIndex+i);
-		meshData.Indices32.push_back(baseIndex+i+1);
+		WriteIndex(out, k++, southPoleIndex);
+		WriteIndex(out, k++, baseIndex+i);
+		WriteIndex(out, k++, baseIndex+i+1);
 	}
 
-    return meshData;
+	bounds.Write(out);
+
+	return true;
 }
  
 void GeometryGenerator::Subdivide(MeshData& meshData)
 {
-	// Save a copy of the input geometry.
-	MeshData inputCopy = meshData;
+	// The input vertices are kept in place and the new edge midpoints are appended
+	// after them, so only the index list needs to be saved.
+	std::vector<uint32> inputIndices;
+	inputIndices.swap(meshData.Indices32);
 
+	uint32 numTris = (uint32)inputIndices.size()/3;
 
-	meshData.Vertices.resize(0);
-	meshData.Indices32.resize(0);
+	// Every edge of a closed mesh is shared by two triangles, so there are
+	// 3*numTris/2 unique midpoints.  Open meshes will just grow the containers.
+	uint32 numEdges = numTris*3/2;
+	meshData.Vertices.reserve(meshData.Vertices.size() + numEdges);
+	meshData.Indices32.resize(numTris*12);
+
+	// Maps an edge (i0, i1) with i0 < i1 to the index of its midpoint vertex so that
+	// the triangles sharing an edge also share the midpoint.
+	std::unordered_map<std::uint64_t, uint32> midpointCache;
+	midpointCache.reserve(numEdges);
+
+	auto midPointIndex = [&](uint32 i0, uint32 i1)
+	{
+		std::uint64_t key = i0 < i1 ? 
+			((std::uint64_t)i0 << 32) | i1 : 
+			((std::uint64_t)i1 << 32) | i0;
+
+		auto it = midpointCache.find(key);
+		if(it != midpointCache.end())
+			return it->second;
+
+		// Compute before push_back since it can reallocate the vertex storage.
+		Vertex m = MidPoint(meshData.Vertices[i0], meshData.Vertices[i1]);
+
+		uint32 index = (uint32)meshData.Vertices.size();
+		meshData.Vertices.push_back(m);
+		midpointCache.emplace(key, index);
+
+		return index;
+	};
 
 	//       v1
 	//       *
@@ -230,47 +384,30 @@ void GeometryGenerator::Subdivide(MeshData& meshData)
 	// *-----*-----*
 	// v0    m2     v2
 
-	uint32 numTris = (uint32)inputCopy.Indices32.size()/3;
 	for(uint32 i = 0; i < numTris; ++i)
 	{
-		Vertex v0 = inputCopy.Vertices[ inputCopy.Indices32[i*3+0] ];
-		Vertex v1 = inputCopy.Vertices[ inputCopy.Indices32[i*3+1] ];
-		Vertex v2 = inputCopy.Vertices[ inputCopy.Indices32[i*3+2] ];
+		uint32 v0 = inputIndices[i*3+0];
+		uint32 v1 = inputIndices[i*3+1];
+		uint32 v2 = inputIndices[i*3+2];
 
 		//
 		// Generate the midpoints.
 		//
 
-        Vertex m0 = MidPoint(v0, v1);
-        Vertex m1 = MidPoint(v1, v2);
-        Vertex m2 = MidPoint(v0, v2);
+		uint32 m0 = midPointIndex(v0, v1);
+		uint32 m1 = midPointIndex(v1, v2);
+		uint32 m2 = midPointIndex(v0, v2);
 
 		//
 		// Add new geometry.
 		//
 
-		meshData.Vertices.push_back(v0); // 0
-		meshData.Vertices.push_back(v1); // 1
-		meshData.Vertices.push_back(v2); // 2
-		meshData.Vertices.push_back(m0); // 3
-		meshData.Vertices.push_back(m1); // 4
-		meshData.Vertices.push_back(m2); // 5
- 
-		meshData.Indices32.push_back(i*6+0);
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+5);
-
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+5);
-
-		meshData.Indices32.push_back(i*6+5);
-		meshData.Indices32.push_back(i*6+4);
-		meshData.Indices32.push_back(i*6+2);
+		uint32* k = &meshData.Indices32[i*12];
 
-		meshData.Indices32.push_back(i*6+3);
-		meshData.Indices32.push_back(i*6+1);
-		meshData.Indices32.push_back(i*6+4);
+		k[0]  = v0; k[1]  = m0; k[2]  = m2;
+		k[3]  = m0; k[4]  = m1; k[5]  = m2;
+		k[6]  = m2; k[7]  = m1; k[8]  = v2;
+		k[9]  = m0; k[10] = v1; k[11] = m1;
 	}
 }
 
@@ -305,6 +442,14 @@ GeometryGenerator::Vertex GeometryGenerator::MidPoint(const Vertex& v0, const Ve
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions)
+{
+	MeshData meshData = BuildGeosphere(radius, numSubdivisions);
+	Cook(meshData);
+
+	return meshData;
+}
+
+GeometryGenerator::MeshData GeometryGenerator::BuildGeosphere(float radius, uint32 numSubdivisions)
 {
     MeshData meshData;
 
@@ -340,6 +485,8 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 	for(uint32 i = 0; i < 12; ++i)
 		meshData.Vertices[i].Position = pos[i];
 
+	meshData.Vertices.reserve(GeosphereSize(numSubdivisions).VertexCount);
+
 	for(uint32 i = 0; i < numSubdivisions; ++i)
 		Subdivide(meshData);
 
@@ -376,13 +523,52 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGeosphere(float radius, uin
 		XMStoreFloat3(&meshData.Vertices[i].TangentU, XMVector3Normalize(T));
 	}
 
+    ComputeBounds(meshData);
+
     return meshData;
 }
 
+bool GeometryGenerator::CreateGeosphere(float radius, uint32 numSubdivisions, const MeshStreams& out)
+{
+	if(!CanWriteIndices(out, GeosphereSize(numSubdivisions).VertexCount))
+		return false;
+
+	// See CreateBox; subdivision needs the full vertex.
+	return WriteVertices(BuildGeosphere(radius, numSubdivisions), out);
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::CylinderSize(uint32 sliceCount, uint32 stackCount)
+{
+	// stackCount+1 rings of sliceCount+1 vertices, plus two caps that each have
+	// their own ring and a center vertex.
+	MeshSize size;
+	size.VertexCount = (stackCount+1)*(sliceCount+1) + 2*(sliceCount+2);
+	size.IndexCount  = 6*sliceCount*stackCount + 2*3*sliceCount;
+
+	return size;
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount)
 {
     MeshData meshData;
 
+	MeshSize size = CylinderSize(sliceCount, stackCount);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices32.resize(size.IndexCount);
+
+	CreateCylinder(bottomRadius, topRadius, height, sliceCount, stackCount, GetStreams(meshData));
+
+    Cook(meshData);
+
+    return meshData;
+}
+
+bool GeometryGenerator::CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount,
+									   const MeshStreams& out)
+{
+	if(!CanWriteIndices(out, CylinderSize(sliceCount, stackCount).VertexCount))
+		return false;
+
 	//
 	// Build Stacks.
 	// 
@@ -394,7 +580,10 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 
 	uint32 ringCount = stackCount+1;
 
+	BoundsBuilder bounds;
+
 	// Compute vertices for each stack ring starting at the bottom and moving up.
+	uint32 vertexCount = 0;
 	for(uint32 i = 0; i < ringCount; ++i)
 	{
 		float y = -0.5f*height + i*stackHeight;
@@ -444,7 +633,7 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 			XMVECTOR N = XMVector3Normalize(XMVector3Cross(T, B));
 			XMStoreFloat3(&vertex.Normal, N);
 
-			meshData.Vertices.push_back(vertex);
+			WriteVertex(out, vertexCount++, vertex, bounds);
 		}
 	}
 
@@ -453,30 +642,34 @@ GeometryGenerator::MeshData GeometryGenerator::CreateCylinder(float bottomRadius
 	uint32 ringVertexCount = sliceCount+1;
 
 	// Compute indices for each stack.
+	uint32 k = 0;
 	for(uint32 i = 0; i < stackCount; ++i)
 	{
 		for(uint32 j = 0; j < sliceCount; ++j)
 		{
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
+			WriteIndex(out, k++, i*ringVertexCount + j);
+			WriteIndex(out, k++, (i+1)*ringVertexCount + j);
+			WriteIndex(out, k++, (i+1)*ringVertexCount + j+1);
 
-			meshData.Indices32.push_back(i*ringVertexCount + j);
-			meshData.Indices32.push_back((i+1)*ringVertexCount + j+1);
-			meshData.Indices32.push_back(i*ringVertexCount + j+1);
+			WriteIndex(out, k++, i*ringVertexCount + j);
+			WriteIndex(out, k++, (i+1)*ringVertexCount + j+1);
+			WriteIndex(out, k++, i*ringVertexCount + j+1);
 		}
 	}
 
-	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
-	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, meshData);
+	BuildCylinderTopCap(bottomRadius, topRadius, height, sliceCount, stackCount, out, vertexCount, k, bounds);
+	BuildCylinderBottomCap(bottomRadius, topRadius, height, sliceCount, stackCount, out, vertexCount, k, bounds);
 
-    return meshData;
+	bounds.Write(out);
+
+	return true;
 }
 
 void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius, float height,
-											uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+											uint32 sliceCount, uint32 stackCount, const MeshStreams& out,
+											uint32& vertexCount, uint32& indexCount, BoundsBuilder& bounds)
 {
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
+	uint32 baseIndex = vertexCount;
 
 	float y = 0.5f*height;
 	float dTheta = 2.0f*XM_PI/sliceCount;
@@ -492,31 +685,32 @@ void GeometryGenerator::BuildCylinderTopCap(float bottomRadius, float topRadius,
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		WriteVertex(out, vertexCount++, Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v), bounds);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
+	WriteVertex(out, vertexCount++, Vertex(0.0f, y, 0.0f, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f), bounds);
 
 	// Index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 centerIndex = vertexCount-1;
 
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i+1);
-		meshData.Indices32.push_back(baseIndex + i);
+		WriteIndex(out, indexCount++, centerIndex);
+		WriteIndex(out, indexCount++, baseIndex + i+1);
+		WriteIndex(out, indexCount++, baseIndex + i);
 	}
 }
 
 void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadius, float height,
-											   uint32 sliceCount, uint32 stackCount, MeshData& meshData)
+											   uint32 sliceCount, uint32 stackCount, const MeshStreams& out,
+											   uint32& vertexCount, uint32& indexCount, BoundsBuilder& bounds)
 {
 	// 
 	// Build bottom cap.
 	//
 
-	uint32 baseIndex = (uint32)meshData.Vertices.size();
+	uint32 baseIndex = vertexCount;
 	float y = -0.5f*height;
 
 	// vertices of ring
@@ -531,30 +725,138 @@ void GeometryGenerator::BuildCylinderBottomCap(float bottomRadius, float topRadi
 		float u = x/height + 0.5f;
 		float v = z/height + 0.5f;
 
-		meshData.Vertices.push_back( Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v) );
+		WriteVertex(out, vertexCount++, Vertex(x, y, z, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, u, v), bounds);
 	}
 
 	// Cap center vertex.
-	meshData.Vertices.push_back( Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f) );
+	WriteVertex(out, vertexCount++, Vertex(0.0f, y, 0.0f, 0.0f, -1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.5f, 0.5f), bounds);
 
 	// Cache the index of center vertex.
-	uint32 centerIndex = (uint32)meshData.Vertices.size()-1;
+	uint32 centerIndex = vertexCount-1;
 
 	for(uint32 i = 0; i < sliceCount; ++i)
 	{
-		meshData.Indices32.push_back(centerIndex);
-		meshData.Indices32.push_back(baseIndex + i);
-		meshData.Indices32.push_back(baseIndex + i+1);
+		WriteIndex(out, indexCount++, centerIndex);
+		WriteIndex(out, indexCount++, baseIndex + i);
+		WriteIndex(out, indexCount++, baseIndex + i+1);
 	}
 }
 
+GeometryGenerator::MeshSize GeometryGenerator::GridSize(uint32 m, uint32 n)
+{
+	MeshSize size;
+	if(IsEmptyGrid(m, n))
+		return size;
+
+	size.VertexCount = m*n;
+	size.IndexCount  = (m-1)*(n-1)*2*3;
+
+	return size;
+}
+
 GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n)
 {
     MeshData meshData;
+	if(IsEmptyGrid(m, n))
+		return meshData;
+
+	MeshSize size = GridSize(m, n);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices32.resize(size.IndexCount);
+
+	CreateGrid(width, depth, m, n, GetStreams(meshData));
+
+    Cook(meshData);
+
+    return meshData;
+}
+
+bool GeometryGenerator::CreateGrid(float width, float depth, uint32 m, uint32 n, const MeshStreams& out)
+{
+	if(!CanWriteIndices(out, m*n))
+		return false;
+
+	// There is nothing to write, and the spacing below would divide by zero.
+	if(IsEmptyGrid(m, n))
+	{
+		BoundsBuilder().Write(out);
+		return true;
+	}
+
+	BoundsBuilder bounds;
+	CreateGridRows(width, depth, m, n, 0, m, out, bounds);
+
+	bounds.Write(out);
+
+	return true;
+}
+
+GeometryGenerator::MeshData GeometryGenerator::CreateGridParallel(float width, float depth, uint32 m, uint32 n, uint32 threadCount)
+{
+    MeshData meshData;
+	if(IsEmptyGrid(m, n))
+		return meshData;
+
+	MeshSize size = GridSize(m, n);
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices32.resize(size.IndexCount);
+
+	CreateGridParallel(width, depth, m, n, GetStreams(meshData), threadCount);
+
+    Cook(meshData);
+
+    return meshData;
+}
+
+bool GeometryGenerator::CreateGridParallel(float width, float depth, uint32 m, uint32 n, const MeshStreams& out, uint32 threadCount)
+{
+	if(!CanWriteIndices(out, m*n))
+		return false;
+
+	// There is nothing to write, and the spacing below would divide by zero.
+	if(IsEmptyGrid(m, n))
+	{
+		BoundsBuilder().Write(out);
+		return true;
+	}
+
+	if(threadCount == 0)
+		threadCount = DefaultThreadCount();
 
-	uint32 vertexCount = m*n;
-	uint32 faceCount   = (m-1)*(n-1)*2;
+	// Use a few bands per thread so that a slow thread does not hold up the rest.
+	uint32 bandCount = std::min(m, threadCount*4);
+	uint32 rowsPerBand = (m + bandCount - 1) / bandCount;
+	bandCount = (m + rowsPerBand - 1) / rowsPerBand;
 
+	// Each band gathers the bounds of its own rows; merging them gives the same
+	// result as the serial grid.
+	std::vector<BoundsBuilder> bandBounds(bandCount);
+
+	ParallelFor(bandCount, threadCount, [&](uint32 band)
+	{
+		uint32 rowBegin = band*rowsPerBand;
+		uint32 rowEnd = std::min(rowBegin + rowsPerBand, m);
+
+		CreateGridRows(width, depth, m, n, rowBegin, rowEnd, out, bandBounds[band]);
+	});
+
+	BoundsBuilder bounds;
+	for(const BoundsBuilder& b : bandBounds)
+		bounds.Merge(b);
+
+	bounds.Write(out);
+
+	return true;
+}
+
+bool GeometryGenerator::IsEmptyGrid(uint32 m, uint32 n)
+{
+	return m < 2 || n < 2;
+}
+
+void GeometryGenerator::CreateGridRows(float width, float depth, uint32 m, uint32 n, 
+									   uint32 rowBegin, uint32 rowEnd, const MeshStreams& out, BoundsBuilder& bounds)
+{
 	//
 	// Create the vertices.
 	//
@@ -568,21 +870,23 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	float du = 1.0f / (n-1);
 	float dv = 1.0f / (m-1);
 
-	meshData.Vertices.resize(vertexCount);
-	for(uint32 i = 0; i < m; ++i)
+	for(uint32 i = rowBegin; i < rowEnd; ++i)
 	{
 		float z = halfDepth - i*dz;
 		for(uint32 j = 0; j < n; ++j)
 		{
 			float x = -halfWidth + j*dx;
 
-			meshData.Vertices[i*n+j].Position = XMFLOAT3(x, 0.0f, z);
-			meshData.Vertices[i*n+j].Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
-			meshData.Vertices[i*n+j].TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
+			Vertex v;
+			v.Position = XMFLOAT3(x, 0.0f, z);
+			v.Normal   = XMFLOAT3(0.0f, 1.0f, 0.0f);
+			v.TangentU = XMFLOAT3(1.0f, 0.0f, 0.0f);
 
 			// Stretch texture over grid.
-			meshData.Vertices[i*n+j].TexC.x = j*du;
-			meshData.Vertices[i*n+j].TexC.y = i*dv;
+			v.TexC.x = j*du;
+			v.TexC.y = i*dv;
+
+			WriteVertex(out, i*n+j, v, bounds);
 		}
 	}
  
@@ -590,27 +894,25 @@ GeometryGenerator::MeshData GeometryGenerator::CreateGrid(float width, float dep
 	// Create the indices.
 	//
 
-	meshData.Indices32.resize(faceCount*3); // 3 indices per face
-
-	// Iterate over each quad and compute indices.
-	uint32 k = 0;
-	for(uint32 i = 0; i < m-1; ++i)
+	// Iterate over each quad and compute indices.  Quad row i connects
+	// vertex rows i and i+1, and every row has (n-1) quads of 6 indices.
+	uint32 quadRowEnd = std::min(rowEnd, m-1);
+	uint32 k = rowBegin*(n-1)*6;
+	for(uint32 i = rowBegin; i < quadRowEnd; ++i)
 	{
 		for(uint32 j = 0; j < n-1; ++j)
 		{
-			meshData.Indices32[k]   = i*n+j;
-			meshData.Indices32[k+1] = i*n+j+1;
-			meshData.Indices32[k+2] = (i+1)*n+j;
+			WriteIndex(out, k,   i*n+j);
+			WriteIndex(out, k+1, i*n+j+1);
+			WriteIndex(out, k+2, (i+1)*n+j);
 
-			meshData.Indices32[k+3] = (i+1)*n+j;
-			meshData.Indices32[k+4] = i*n+j+1;
-			meshData.Indices32[k+5] = (i+1)*n+j+1;
+			WriteIndex(out, k+3, (i+1)*n+j);
+			WriteIndex(out, k+4, i*n+j+1);
+			WriteIndex(out, k+5, (i+1)*n+j+1);
 
 			k += 6; // next quad
 		}
 	}
-
-    return meshData;
 }
 
 GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, float w, float h, float depth)
@@ -653,5 +955,388 @@ GeometryGenerator::MeshData GeometryGenerator::CreateQuad(float x, float y, floa
 	meshData.Indices32[4] = 2;
 	meshData.Indices32[5] = 3;
 
+    ComputeBounds(meshData);
+
     return meshData;
 }
+
+
+GeometryGenerator::MeshStreams GeometryGenerator::GetStreams(MeshData& meshData)
+{
+	MeshStreams out;
+
+	// An empty mesh has no vertices to point at, so its streams stay null.
+	Vertex* vertices = meshData.Vertices.data();
+	if(vertices != nullptr)
+	{
+		out.Position = { &vertices->Position, sizeof(Vertex) };
+		out.Normal   = { &vertices->Normal,   sizeof(Vertex) };
+		out.TangentU = { &vertices->TangentU, sizeof(Vertex) };
+		out.TexC     = { &vertices->TexC,     sizeof(Vertex) };
+	}
+
+	out.Indices32 = meshData.Indices32.data();
+	out.Bounds = &meshData.Bounds;
+	out.SphereBounds = &meshData.SphereBounds;
+
+	return out;
+}
+
+bool GeometryGenerator::WriteVertices(const MeshData& meshData, const MeshStreams& out)
+{
+	if(!CanWriteIndices(out, (uint32)meshData.Vertices.size()))
+		return false;
+
+	for(size_t i = 0; i < meshData.Vertices.size(); ++i)
+		WriteVertex(out, (uint32)i, meshData.Vertices[i]);
+
+	for(size_t i = 0; i < meshData.Indices32.size(); ++i)
+		WriteIndex(out, (uint32)i, meshData.Indices32[i]);
+
+	// The mesh already has its bounds, so the output is never read back.
+	if(out.Position.Data != nullptr)
+	{
+		if(out.Bounds != nullptr)
+			*out.Bounds = meshData.Bounds;
+
+		if(out.SphereBounds != nullptr)
+			*out.SphereBounds = meshData.SphereBounds;
+	}
+
+	return true;
+}
+
+void GeometryGenerator::ComputeBounds(MeshData& meshData)
+{
+	if(meshData.Vertices.empty())
+	{
+		MathHelper::ComputeBounds(nullptr, 0, 0, meshData.Bounds, meshData.SphereBounds);
+		return;
+	}
+
+	MathHelper::ComputeBounds(&meshData.Vertices[0].Position, sizeof(Vertex), meshData.Vertices.size(),
+		meshData.Bounds, meshData.SphereBounds);
+}
+
+GeometryGenerator::SplitMeshData GeometryGenerator::SplitIndices16(const MeshData& meshData, uint32 maxVertices)
+{
+	assert(maxVertices >= 3 && maxVertices <= 65536);
+
+	SplitMeshData split;
+
+	uint32 vertexCount = (uint32)meshData.Vertices.size();
+
+	// Both paths keep whole triangles only.
+	uint32 indexCount = (uint32)meshData.Indices32.size() / 3 * 3;
+	split.Indices16.resize(indexCount);
+
+	if(vertexCount <= maxVertices)
+	{
+		split.Vertices = meshData.Vertices;
+		for(uint32 i = 0; i < indexCount; ++i)
+			split.Indices16[i] = (uint16)meshData.Indices32[i];
+
+		IndexRange part;
+		part.IndexCount = indexCount;
+		if(part.IndexCount > 0)
+			split.Parts.push_back(part);
+
+		return split;
+	}
+
+	split.Vertices.reserve(vertexCount);
+
+	// Index of each vertex within the current part.  An entry is only valid when
+	// vertexPart matches the current part, so nothing is cleared between parts.
+	std::vector<uint32> localIndex(vertexCount);
+	std::vector<uint32> vertexPart(vertexCount, 0xffffffff);
+
+	IndexRange part;
+	uint32 partIndex = 0;
+	uint32 partVertexCount = 0;
+
+	for(uint32 i = 0; i < indexCount; i += 3)
+	{
+		const uint32* tri = &meshData.Indices32[i];
+
+		uint32 newVertices = 0;
+		for(uint32 k = 0; k < 3; ++k)
+		{
+			if(vertexPart[tri[k]] != partIndex &&
+			   (k < 1 || tri[k] != tri[0]) &&
+			   (k < 2 || tri[k] != tri[1]))
+				++newVertices;
+		}
+
+		// Start a new part when the triangle's vertices no longer fit.
+		if(partVertexCount + newVertices > maxVertices)
+		{
+			split.Parts.push_back(part);
+
+			part = IndexRange();
+			part.StartIndexLocation = i;
+			part.BaseVertexLocation = (int)split.Vertices.size();
+
+			++partIndex;
+			partVertexCount = 0;
+		}
+
+		for(uint32 k = 0; k < 3; ++k)
+		{
+			uint32 v = tri[k];
+			if(vertexPart[v] != partIndex)
+			{
+				vertexPart[v] = partIndex;
+				localIndex[v] = partVertexCount++;
+				split.Vertices.push_back(meshData.Vertices[v]);
+			}
+
+			split.Indices16[i + k] = (uint16)localIndex[v];
+		}
+
+		part.IndexCount += 3;
+	}
+
+	if(part.IndexCount > 0)
+		split.Parts.push_back(part);
+
+	return split;
+}
+
+void GeometryGenerator::WriteVertex(const MeshStreams& out, uint32 i, const Vertex& v)
+{
+	StoreAttribute(out.Position, i, v.Position);
+	StoreAttribute(out.Normal,   i, v.Normal);
+	StoreAttribute(out.TangentU, i, v.TangentU);
+	StoreAttribute(out.TexC,     i, v.TexC);
+}
+
+bool GeometryGenerator::CanWriteIndices(const MeshStreams& out, uint32 vertexCount)
+{
+	// 16-bit indices cannot address more than 65536 vertices.  Refuse such a mesh
+	// up front rather than write truncated indices; split it with SplitIndices16.
+	return out.Indices32 != nullptr || out.Indices16 == nullptr || vertexCount <= 65536;
+}
+
+void GeometryGenerator::WriteIndex(const MeshStreams& out, uint32 i, uint32 index)
+{
+	if(out.Indices32 != nullptr)
+	{
+		out.Indices32[i] = index;
+	}
+	else if(out.Indices16 != nullptr)
+	{
+		// CanWriteIndices has already refused meshes that do not fit.
+		assert(index <= 0xffff);
+		out.Indices16[i] = static_cast<uint16>(index);
+	}
+}
+
+void GeometryGenerator::WriteVertex(const MeshStreams& out, uint32 i, const Vertex& v, BoundsBuilder& bounds)
+{
+	WriteVertex(out, i, v);
+	bounds.Add(v.Position);
+}
+
+void GeometryGenerator::BoundsBuilder::Add(const XMFLOAT3& p)
+{
+	Min.x = p.x < Min.x ? p.x : Min.x;
+	Min.y = p.y < Min.y ? p.y : Min.y;
+	Min.z = p.z < Min.z ? p.z : Min.z;
+
+	Max.x = p.x > Max.x ? p.x : Max.x;
+	Max.y = p.y > Max.y ? p.y : Max.y;
+	Max.z = p.z > Max.z ? p.z : Max.z;
+
+	float lengthSq = p.x*p.x + p.y*p.y + p.z*p.z;
+	MaxLengthSq = lengthSq > MaxLengthSq ? lengthSq : MaxLengthSq;
+}
+
+void GeometryGenerator::BoundsBuilder::Merge(const BoundsBuilder& other)
+{
+	Min.x = other.Min.x < Min.x ? other.Min.x : Min.x;
+	Min.y = other.Min.y < Min.y ? other.Min.y : Min.y;
+	Min.z = other.Min.z < Min.z ? other.Min.z : Min.z;
+
+	Max.x = other.Max.x > Max.x ? other.Max.x : Max.x;
+	Max.y = other.Max.y > Max.y ? other.Max.y : Max.y;
+	Max.z = other.Max.z > Max.z ? other.Max.z : Max.z;
+
+	MaxLengthSq = other.MaxLengthSq > MaxLengthSq ? other.MaxLengthSq : MaxLengthSq;
+}
+
+void GeometryGenerator::BoundsBuilder::Write(const MeshStreams& out)const
+{
+	if(out.Position.Data == nullptr)
+		return;
+
+	BoundingBox box;
+	BoundingSphere sphere;
+
+	if(Min.x > Max.x)
+	{
+		box.Center = box.Extents = sphere.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		sphere.Radius = 0.0f;
+	}
+	else
+	{
+		XMVECTOR vMin = XMLoadFloat3(&Min);
+		XMVECTOR vMax = XMLoadFloat3(&Max);
+		XMVECTOR center = 0.5f*(vMin + vMax);
+
+		XMStoreFloat3(&box.Center, center);
+		XMStoreFloat3(&box.Extents, 0.5f*(vMax - vMin));
+
+		// Every point is within sqrt(MaxLengthSq) of the origin, so within that plus
+		// |center| of the center.  The generated shapes are centered on the origin,
+		// so |center| is zero or, for odd tessellations, a small fraction of the size.
+		sphere.Center = box.Center;
+		sphere.Radius = sqrtf(MaxLengthSq) + XMVectorGetX(XMVector3Length(center));
+	}
+
+	if(out.Bounds != nullptr)
+		*out.Bounds = box;
+
+	if(out.SphereBounds != nullptr)
+		*out.SphereBounds = sphere;
+}
+
+GeometryGenerator::ShapeDesc GeometryGenerator::ShapeDesc::Box(float width, float height, float depth, uint32 numSubdivisions)
+{
+	ShapeDesc desc;
+	desc.Type = ShapeType::Box;
+	desc.Width = width;
+	desc.Height = height;
+	desc.Depth = depth;
+	desc.NumSubdivisions = numSubdivisions;
+
+	return desc;
+}
+
+GeometryGenerator::ShapeDesc GeometryGenerator::ShapeDesc::Sphere(float radius, uint32 sliceCount, uint32 stackCount)
+{
+	ShapeDesc desc;
+	desc.Type = ShapeType::Sphere;
+	desc.Radius = radius;
+	desc.SliceCount = sliceCount;
+	desc.StackCount = stackCount;
+
+	return desc;
+}
+
+GeometryGenerator::ShapeDesc GeometryGenerator::ShapeDesc::Geosphere(float radius, uint32 numSubdivisions)
+{
+	ShapeDesc desc;
+	desc.Type = ShapeType::Geosphere;
+	desc.Radius = radius;
+	desc.NumSubdivisions = numSubdivisions;
+
+	return desc;
+}
+
+GeometryGenerator::ShapeDesc GeometryGenerator::ShapeDesc::Cylinder(float bottomRadius, float topRadius, float height, 
+																	uint32 sliceCount, uint32 stackCount)
+{
+	ShapeDesc desc;
+	desc.Type = ShapeType::Cylinder;
+	desc.BottomRadius = bottomRadius;
+	desc.TopRadius = topRadius;
+	desc.Height = height;
+	desc.SliceCount = sliceCount;
+	desc.StackCount = stackCount;
+
+	return desc;
+}
+
+GeometryGenerator::ShapeDesc GeometryGenerator::ShapeDesc::Grid(float width, float depth, uint32 m, uint32 n)
+{
+	ShapeDesc desc;
+	desc.Type = ShapeType::Grid;
+	desc.Width = width;
+	desc.Depth = depth;
+	desc.Rows = m;
+	desc.Columns = n;
+
+	return desc;
+}
+
+GeometryGenerator::MeshData GeometryGenerator::Create(const ShapeDesc& desc)
+{
+	switch(desc.Type)
+	{
+	case ShapeType::Box:
+		return CreateBox(desc.Width, desc.Height, desc.Depth, desc.NumSubdivisions);
+	case ShapeType::Sphere:
+		return CreateSphere(desc.Radius, desc.SliceCount, desc.StackCount);
+	case ShapeType::Geosphere:
+		return CreateGeosphere(desc.Radius, desc.NumSubdivisions);
+	case ShapeType::Cylinder:
+		return CreateCylinder(desc.BottomRadius, desc.TopRadius, desc.Height, desc.SliceCount, desc.StackCount);
+	case ShapeType::Grid:
+		return CreateGrid(desc.Width, desc.Depth, desc.Rows, desc.Columns);
+	}
+
+	return MeshData();
+}
+
+bool GeometryGenerator::Create(const ShapeDesc& desc, const MeshStreams& out)
+{
+	switch(desc.Type)
+	{
+	case ShapeType::Box:
+		return CreateBox(desc.Width, desc.Height, desc.Depth, desc.NumSubdivisions, out);
+	case ShapeType::Sphere:
+		return CreateSphere(desc.Radius, desc.SliceCount, desc.StackCount, out);
+	case ShapeType::Geosphere:
+		return CreateGeosphere(desc.Radius, desc.NumSubdivisions, out);
+	case ShapeType::Cylinder:
+		return CreateCylinder(desc.BottomRadius, desc.TopRadius, desc.Height, desc.SliceCount, desc.StackCount, out);
+	case ShapeType::Grid:
+		return CreateGrid(desc.Width, desc.Depth, desc.Rows, desc.Columns, out);
+	}
+
+	return false;
+}
+
+GeometryGenerator::MeshSize GeometryGenerator::GetSize(const ShapeDesc& desc)
+{
+	switch(desc.Type)
+	{
+	case ShapeType::Box:       return BoxSize(desc.NumSubdivisions);
+	case ShapeType::Sphere:    return SphereSize(desc.SliceCount, desc.StackCount);
+	case ShapeType::Geosphere: return GeosphereSize(desc.NumSubdivisions);
+	case ShapeType::Cylinder:  return CylinderSize(desc.SliceCount, desc.StackCount);
+	case ShapeType::Grid:      return GridSize(desc.Rows, desc.Columns);
+	}
+
+	return MeshSize();
+}
+
+std::vector<GeometryGenerator::MeshData> GeometryGenerator::CreateBatch(const std::vector<ShapeDesc>& shapes, uint32 threadCount)
+{
+	std::vector<MeshData> meshes(shapes.size());
+
+	ParallelFor((uint32)shapes.size(), threadCount, [&](uint32 i)
+	{
+		meshes[i] = Create(shapes[i]);
+	});
+
+	return meshes;
+}
+
+bool GeometryGenerator::CreateBatch(const ShapeDesc* shapes, const MeshStreams* outputs, uint32 shapeCount, uint32 threadCount)
+{
+	// Check every shape before writing any of them.
+	for(uint32 i = 0; i < shapeCount; ++i)
+	{
+		if(!CanWriteIndices(outputs[i], GetSize(shapes[i]).VertexCount))
+			return false;
+	}
+
+	ParallelFor(shapeCount, threadCount, [&](uint32 i)
+	{
+		Create(shapes[i], outputs[i]);
+	});
+
+	return true;
+}
@@ -14,8 +14,11 @@
 
 #pragma once
 
+#include <cassert>
+#include <cfloat>
 #include <cstdint>
 #include <DirectXMath.h>
+#include <DirectXCollision.h>
 #include <vector>
 
 class GeometryGenerator
@@ -63,39 +66,168 @@ public:
 		std::vector<Vertex> Vertices;
         std::vector<uint32> Indices32;
 
-        std::vector<uint16>& GetIndices16()
+		// Bounds of the vertex positions, filled in by the generators.  Call 
+		// ComputeBounds after changing the vertices.
+		DirectX::BoundingBox Bounds;
+		DirectX::BoundingSphere SphereBounds;
+
+		///<summary>
+		/// Returns a 16-bit copy of Indices32.  The mesh must have at most 65536
+		/// vertices; split larger meshes with SplitIndices16.
+		///</summary>
+        std::vector<uint16> GetIndices16()const
         {
-			if(mIndices16.empty())
-			{
-				mIndices16.resize(Indices32.size());
-				for(size_t i = 0; i < Indices32.size(); ++i)
-					mIndices16[i] = static_cast<uint16>(Indices32[i]);
-			}
-
-			return mIndices16;
+			assert(Vertices.size() <= 65536);
+
+			std::vector<uint16> indices16(Indices32.size());
+			for(size_t i = 0; i < Indices32.size(); ++i)
+				indices16[i] = static_cast<uint16>(Indices32[i]);
+
+			return indices16;
         }
+	};
+
+	// Vertex and index counts of a generated mesh.  Useful for sizing
+	// buffers before the geometry is generated.
+	struct MeshSize
+	{
+		uint32 VertexCount = 0;
+		uint32 IndexCount = 0;
+	};
+
+	// Destination of one vertex attribute.  Data points at the attribute of the 
+	// first vertex and Stride is the number of bytes between consecutive vertices.
+	// Attributes with a null Data pointer are not written.
+	struct VertexStream
+	{
+		void* Data = nullptr;
+		uint32 Stride = 0;
+	};
+
+	// Caller-provided memory the generators write into.  Point the streams into
+	// one buffer with a shared stride for interleaved vertices, or into separate
+	// arrays for SoA.  Only one of the index pointers should be set; Indices16
+	// can only be used when the mesh has at most 65536 vertices.  The buffers
+	// must be large enough for the counts returned by the *Size functions.
+	//
+	// The functions that write to MeshStreams return false, and write nothing,
+	// when Indices16 is set and the mesh has more vertices than 16-bit indices
+	// can address.
+	struct MeshStreams
+	{
+		VertexStream Position;
+		VertexStream Normal;
+		VertexStream TangentU;
+		VertexStream TexC;
+
+		uint32* Indices32 = nullptr;
+		uint16* Indices16 = nullptr;
+
+		// Optional outputs: the bounds of the generated positions.  Only computed
+		// when the Position stream is set.  They are gathered while the vertices
+		// are generated, so the streams are never read back.
+		DirectX::BoundingBox* Bounds = nullptr;
+		DirectX::BoundingSphere* SphereBounds = nullptr;
+	};
+
+	// One part of a split mesh.  The fields match SubmeshGeometry, so each part
+	// is drawn with DrawIndexedInstanced(IndexCount, 1, StartIndexLocation, 
+	// BaseVertexLocation, 0).
+	struct IndexRange
+	{
+		uint32 IndexCount = 0;
+		uint32 StartIndexLocation = 0;
+		int BaseVertexLocation = 0;
+	};
+
+	// A mesh split into parts that each reference at most 65536 vertices, so the
+	// whole mesh can use DXGI_FORMAT_R16_UINT indices.
+	struct SplitMeshData
+	{
+		std::vector<Vertex> Vertices;
+		std::vector<uint16> Indices16;
+		std::vector<IndexRange> Parts;
+	};
+
+	enum class ShapeType
+	{
+		Box,
+		Sphere,
+		Geosphere,
+		Cylinder,
+		Grid
+	};
+
+	// Parameters of one shape for the batch and cache interfaces.  Only the fields
+	// used by Type are read, and they mean the same as the arguments of the matching
+	// Create function.  Use the static helpers to fill one in.
+	struct ShapeDesc
+	{
+		ShapeType Type = ShapeType::Box;
 
-	private:
-		std::vector<uint16> mIndices16;
+		float Width = 0.0f;        // Box, Grid
+		float Height = 0.0f;       // Box, Cylinder
+		float Depth = 0.0f;        // Box, Grid
+		float Radius = 0.0f;       // Sphere, Geosphere
+		float BottomRadius = 0.0f; // Cylinder
+		float TopRadius = 0.0f;    // Cylinder
+		uint32 SliceCount = 0;     // Sphere, Cylinder
+		uint32 StackCount = 0;     // Sphere, Cylinder
+		uint32 NumSubdivisions = 0;// Box, Geosphere
+		uint32 Rows = 0;           // Grid (m)
+		uint32 Columns = 0;        // Grid (n)
+
+		static ShapeDesc Box(float width, float height, float depth, uint32 numSubdivisions);
+		static ShapeDesc Sphere(float radius, uint32 sliceCount, uint32 stackCount);
+		static ShapeDesc Geosphere(float radius, uint32 numSubdivisions);
+		static ShapeDesc Cylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount);
+		static ShapeDesc Grid(float width, float depth, uint32 m, uint32 n);
 	};
 
+	///<summary>
+	/// In cooked mode every function that returns a MeshData also runs 
+	/// MeshOptimizer::WeldVertices and MeshOptimizer::Optimize on it, so duplicate
+	/// vertices are merged, the triangles come out in vertex cache order and the
+	/// vertices in first-use order.  The MeshStreams overloads 
+	/// write straight to the caller's memory and are never cooked, so their
+	/// counts always match the *Size functions.
+	///</summary>
+	void SetCooked(bool cooked);
+	bool IsCooked()const;
+
 	///<summary>
 	/// Creates a box centered at the origin with the given dimensions, where each
     /// face has m rows and n columns of vertices.
 	///</summary>
     MeshData CreateBox(float width, float height, float depth, uint32 numSubdivisions);
+    bool CreateBox(float width, float height, float depth, uint32 numSubdivisions, const MeshStreams& out);
+
+	///<summary>
+	/// Returns the vertex and index counts CreateBox produces for the given number
+	/// of subdivisions: 6*(2^n+1)^2 vertices and 36*4^n indices.
+	///</summary>
+    static MeshSize BoxSize(uint32 numSubdivisions);
 
 	///<summary>
 	/// Creates a sphere centered at the origin with the given radius.  The
 	/// slices and stacks parameters control the degree of tessellation.
 	///</summary>
     MeshData CreateSphere(float radius, uint32 sliceCount, uint32 stackCount);
+    bool CreateSphere(float radius, uint32 sliceCount, uint32 stackCount, const MeshStreams& out);
+    static MeshSize SphereSize(uint32 sliceCount, uint32 stackCount);
 
 	///<summary>
 	/// Creates a geosphere centered at the origin with the given radius.  The
 	/// depth controls the level of tessellation.
 	///</summary>
     MeshData CreateGeosphere(float radius, uint32 numSubdivisions);
+    bool CreateGeosphere(float radius, uint32 numSubdivisions, const MeshStreams& out);
+
+	///<summary>
+	/// Returns the vertex and index counts CreateGeosphere produces for the given
+	/// number of subdivisions: 10*4^n+2 vertices and 60*4^n indices.
+	///</summary>
+    static MeshSize GeosphereSize(uint32 numSubdivisions);
 
 	///<summary>
 	/// Creates a cylinder parallel to the y-axis, and centered about the origin.  
@@ -103,30 +235,133 @@ public:
 	// cylinders.  The slices and stacks parameters control the degree of tessellation.
 	///</summary>
     MeshData CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount);
+    bool CreateCylinder(float bottomRadius, float topRadius, float height, uint32 sliceCount, uint32 stackCount, const MeshStreams& out);
+    static MeshSize CylinderSize(uint32 sliceCount, uint32 stackCount);
 
 	///<summary>
 	/// Creates an mxn grid in the xz-plane with m rows and n columns, centered
-	/// at the origin with the specified width and depth.
+	/// at the origin with the specified width and depth.  A grid needs at least
+	/// two rows and two columns of vertices; smaller grids are empty.
 	///</summary>
     MeshData CreateGrid(float width, float depth, uint32 m, uint32 n);
+    bool CreateGrid(float width, float depth, uint32 m, uint32 n, const MeshStreams& out);
+    static MeshSize GridSize(uint32 m, uint32 n);
 
 	///<summary>
 	/// Creates a quad aligned with the screen.  This is useful for postprocessing and screen effects.
 	///</summary>
     MeshData CreateQuad(float x, float y, float w, float h, float depth);
 
+	///<summary>
+	/// Creates the shape described by desc by calling the matching Create function.
+	///</summary>
+    MeshData Create(const ShapeDesc& desc);
+    bool Create(const ShapeDesc& desc, const MeshStreams& out);
+    static MeshSize GetSize(const ShapeDesc& desc);
+
+	///<summary>
+	/// Generates many shapes at once, one shape per worker thread at a time.  Every
+	/// shape is built by the same code as the serial Create functions, so the output
+	/// does not depend on the thread count.  threadCount = 0 uses one thread per core.
+	/// The MeshStreams overload checks every output first and writes nothing if any
+	/// of them cannot hold its shape.
+	///</summary>
+    std::vector<MeshData> CreateBatch(const std::vector<ShapeDesc>& shapes, uint32 threadCount = 0);
+    bool CreateBatch(const ShapeDesc* shapes, const MeshStreams* outputs, uint32 shapeCount, uint32 threadCount = 0);
+
+	///<summary>
+	/// Same as CreateGrid, but splits the grid into bands of rows that worker threads
+	/// write directly into the output.  The result is byte-identical to CreateGrid.
+	///</summary>
+    MeshData CreateGridParallel(float width, float depth, uint32 m, uint32 n, uint32 threadCount = 0);
+    bool CreateGridParallel(float width, float depth, uint32 m, uint32 n, const MeshStreams& out, uint32 threadCount = 0);
+
+	///<summary>
+	/// Returns streams that write every attribute into meshData, which must already 
+	/// be sized to hold the generated geometry.
+	///</summary>
+    static MeshStreams GetStreams(MeshData& meshData);
+
+	///<summary>
+	/// Writes the requested attributes and the indices of meshData into out.
+	///</summary>
+    static bool WriteVertices(const MeshData& meshData, const MeshStreams& out);
+
+	///<summary>
+	/// Recomputes meshData.Bounds and meshData.SphereBounds from the vertices.
+	///</summary>
+    static void ComputeBounds(MeshData& meshData);
+
+	///<summary>
+	/// Splits meshData into parts of at most maxVertices vertices each, so that it 
+	/// can be drawn with 16-bit indices no matter how large it is.  Triangles keep
+	/// their order, and each part gets its own copy of the vertices it uses, relative
+	/// to its BaseVertexLocation.  A mesh that already fits is one part with the
+	/// vertices unchanged.  Indices past the last whole triangle are dropped, and a
+	/// mesh without triangles has no parts.
+	///</summary>
+    static SplitMeshData SplitIndices16(const MeshData& meshData, uint32 maxVertices = 65536);
+
 private:
+	// Bounds of the positions a generator has written so far.  Gathering them as
+	// the vertices are written means the output, which may be a mapped upload
+	// buffer where reads are uncached, is never read back.
+	struct BoundsBuilder
+	{
+		DirectX::XMFLOAT3 Min = { FLT_MAX, FLT_MAX, FLT_MAX };
+		DirectX::XMFLOAT3 Max = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+		float MaxLengthSq = 0.0f;
+
+		void Add(const DirectX::XMFLOAT3& p);
+		void Merge(const BoundsBuilder& other);
+
+		// Writes the box and a sphere centered on it to out.Bounds and
+		// out.SphereBounds.
+		void Write(const MeshStreams& out)const;
+	};
+
+	///<summary>
+	/// Splits every triangle into four.  Midpoints of shared edges are shared
+	/// by the adjacent triangles, so a closed mesh gains one vertex per edge.
+	///</summary>
 	void Subdivide(MeshData& meshData);
+
+	///<summary>
+	/// The uncooked box and geosphere.  Both are built as a MeshData first because
+	/// Subdivide needs it; the MeshStreams overloads copy from these.
+	///</summary>
+	MeshData BuildBox(float width, float height, float depth, uint32 numSubdivisions);
+	MeshData BuildGeosphere(float radius, uint32 numSubdivisions);
     Vertex MidPoint(const Vertex& v0, const Vertex& v1);
     void BuildCylinderTopCap
 	(
 		float bottomRadius, float topRadius, float height, 
-		uint32 sliceCount, uint32 stackCount, MeshData& meshData
+		uint32 sliceCount, uint32 stackCount, const MeshStreams& out,
+		uint32& vertexCount, uint32& indexCount, BoundsBuilder& bounds
 	);
     void BuildCylinderBottomCap
 	(
 		float bottomRadius, float topRadius, float height, 
-		uint32 sliceCount, uint32 stackCount, MeshData& meshData
+		uint32 sliceCount, uint32 stackCount, const MeshStreams& out,
+		uint32& vertexCount, uint32& indexCount, BoundsBuilder& bounds
 	);
+
+	// True when an mxn grid has no quads, so there is nothing to generate.
+	static bool IsEmptyGrid(uint32 m, uint32 n);
+
+	///<summary>
+	/// Writes vertex rows [rowBegin, rowEnd) of an mxn grid and the quads whose top
+	/// edge lies on those rows.
+	///</summary>
+	void CreateGridRows(float width, float depth, uint32 m, uint32 n, uint32 rowBegin, uint32 rowEnd, const MeshStreams& out, BoundsBuilder& bounds);
+
+	void Cook(MeshData& meshData)const;
+
+	static bool CanWriteIndices(const MeshStreams& out, uint32 vertexCount);
+	static void WriteVertex(const MeshStreams& out, uint32 i, const Vertex& v);
+	static void WriteVertex(const MeshStreams& out, uint32 i, const Vertex& v, BoundsBuilder& bounds);
+	static void WriteIndex(const MeshStreams& out, uint32 i, uint32 index);
+
+	bool mCooked = false;
 };
 
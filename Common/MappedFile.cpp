@@ -0,0 +1,176 @@
+//***************************************************************************************
+// MappedFile.cpp
+//***************************************************************************************
+
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if !defined(_WIN32)
+namespace
+{
+	std::string NarrowPath(const std::wstring& filename)
+	{
+		size_t length = std::wcstombs(nullptr, filename.c_str(), 0);
+		if(length == static_cast<size_t>(-1))
+			return std::string();
+
+		std::string path(length, '\0');
+		std::wcstombs(&path[0], filename.c_str(), length + 1);
+		return path;
+	}
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::wstring& filename)
+{
+	Close();
+
+#if defined(_WIN32)
+	HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+		OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if(!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(file);
+	if(mapping == nullptr)
+		return false;
+
+	// The view keeps the mapping (and the file) alive, so neither handle is needed
+	// after this.
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(mapping);
+	if(view == nullptr)
+		return false;
+
+	mData = static_cast<const std::uint8_t*>(view);
+	mSize = static_cast<size_t>(size.QuadPart);
+#else
+	int file = open(NarrowPath(filename).c_str(), O_RDONLY);
+	if(file < 0)
+		return false;
+
+	struct stat info;
+	if(fstat(file, &info) != 0 || info.st_size == 0)
+	{
+		close(file);
+		return false;
+	}
+
+	// The mapping stays valid after the descriptor is closed.
+	void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+	if(view == MAP_FAILED)
+		return false;
+
+	mData = static_cast<const std::uint8_t*>(view);
+	mSize = static_cast<size_t>(info.st_size);
+#endif
+
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if(mData == nullptr)
+		return;
+
+#if defined(_WIN32)
+	UnmapViewOfFile(mData);
+#else
+	munmap(const_cast<std::uint8_t*>(mData), mSize);
+#endif
+
+	mData = nullptr;
+	mSize = 0;
+}
+
+bool MappedFile::IsOpen()const
+{
+	return mData != nullptr;
+}
+
+const std::uint8_t* MappedFile::GetData()const
+{
+	return mData;
+}
+
+size_t MappedFile::GetSize()const
+{
+	return mSize;
+}
+
+bool MappedFile::Write(const std::wstring& filename, const void* data, size_t size)
+{
+	const std::uint8_t* bytes = static_cast<const std::uint8_t*>(data);
+
+#if defined(_WIN32)
+	std::wstring tempName = filename + L".tmp";
+
+	HANDLE file = CreateFileW(tempName.c_str(), GENERIC_WRITE, 0, nullptr,
+		CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+
+	bool ok = true;
+	while(ok && size > 0)
+	{
+		DWORD chunk = size > 0x40000000 ? 0x40000000 : static_cast<DWORD>(size);
+		DWORD written = 0;
+		ok = WriteFile(file, bytes, chunk, &written, nullptr) && written == chunk;
+
+		bytes += chunk;
+		size -= chunk;
+	}
+
+	CloseHandle(file);
+
+	if(ok)
+		ok = MoveFileExW(tempName.c_str(), filename.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+
+	if(!ok)
+		DeleteFileW(tempName.c_str());
+
+	return ok;
+#else
+	std::string path = NarrowPath(filename);
+	std::string tempPath = path + ".tmp";
+
+	FILE* file = std::fopen(tempPath.c_str(), "wb");
+	if(file == nullptr)
+		return false;
+
+	bool ok = std::fwrite(bytes, 1, size, file) == size;
+	ok = std::fclose(file) == 0 && ok;
+
+	if(ok)
+		ok = std::rename(tempPath.c_str(), path.c_str()) == 0;
+
+	if(!ok)
+		std::remove(tempPath.c_str());
+
+	return ok;
+#endif
+}
@@ -0,0 +1,43 @@
+//***************************************************************************************
+// MappedFile.h
+//
+// Read-only memory mapping of a whole file, for Win32 and POSIX.  The pages are
+// loaded on first touch, so opening a large file is cheap and only the parts that
+// are read cost any I/O.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile& rhs) = delete;
+	MappedFile& operator=(const MappedFile& rhs) = delete;
+	~MappedFile();
+
+	///<summary>
+	/// Maps filename for reading, closing any file mapped before.  Returns false if
+	/// the file does not exist, is empty, or cannot be mapped.
+	///</summary>
+	bool Open(const std::wstring& filename);
+	void Close();
+
+	bool IsOpen()const;
+	const std::uint8_t* GetData()const;
+	size_t GetSize()const;
+
+	///<summary>
+	/// Writes size bytes to filename through a temporary file, so readers never see
+	/// a partial file.  The file must not be mapped while it is replaced.
+	///</summary>
+	static bool Write(const std::wstring& filename, const void* data, size_t size);
+
+private:
+	const std::uint8_t* mData = nullptr;
+	size_t mSize = 0;
+};
@@ -0,0 +1,682 @@
+//***************************************************************************************
+// MathBatch.cpp
+//***************************************************************************************
+
+#include "MathBatch.h"
+#include "MathHelper.h"
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+
+#if !defined(_XM_NO_INTRINSICS_) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define MATHBATCH_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2/FMA instructions in functions that ask for them;
+// MSVC allows the intrinsics anywhere.
+#if defined(MATHBATCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#define MATHBATCH_AVX2 __attribute__((target("avx2,fma")))
+#else
+#define MATHBATCH_AVX2
+#endif
+
+using namespace DirectX;
+
+namespace
+{
+	using uint8 = std::uint8_t;
+
+	std::atomic<int> gPath(-1);
+
+	MathBatch::Path DetectPath()
+	{
+#if defined(MATHBATCH_X86)
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if(info[0] < 7)
+			return MathBatch::Path::SSE2;
+
+		__cpuid(info, 1);
+		bool fma = (info[2] & (1 << 12)) != 0;
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+
+		// The OS must save the upper halves of the ymm registers.
+		bool ymmState = osxsave && (_xgetbv(0) & 0x6) == 0x6;
+
+		__cpuidex(info, 7, 0);
+		bool avx2 = (info[1] & (1 << 5)) != 0;
+
+		return avx2 && fma && ymmState ? MathBatch::Path::AVX2 : MathBatch::Path::SSE2;
+#else
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ?
+			MathBatch::Path::AVX2 : MathBatch::Path::SSE2;
+#endif
+#else
+		return MathBatch::Path::Scalar;
+#endif
+	}
+
+	// Matrix sources for StoreTransposed.
+	struct StridedMatrices
+	{
+		const uint8* Data;
+		size_t Stride;
+
+		const XMFLOAT4X4* operator()(size_t i)const
+		{
+			return reinterpret_cast<const XMFLOAT4X4*>(Data + i*Stride);
+		}
+	};
+
+	struct IndirectMatrices
+	{
+		const XMFLOAT4X4* const* Data;
+
+		const XMFLOAT4X4* operator()(size_t i)const
+		{
+			return Data[i];
+		}
+	};
+
+	//
+	// Scalar.  Also the reference the SIMD paths are checked against.
+	//
+
+	void TransformPositionsScalar(const XMFLOAT4X4& m, uint8* out, size_t outStride,
+		const uint8* in, size_t inStride, size_t count)
+	{
+		for(size_t i = 0; i < count; ++i, in += inStride, out += outStride)
+		{
+			XMFLOAT3 p = *reinterpret_cast<const XMFLOAT3*>(in);
+
+			XMFLOAT3& r = *reinterpret_cast<XMFLOAT3*>(out);
+			r.x = p.x*m._11 + p.y*m._21 + p.z*m._31 + m._41;
+			r.y = p.x*m._12 + p.y*m._22 + p.z*m._32 + m._42;
+			r.z = p.x*m._13 + p.y*m._23 + p.z*m._33 + m._43;
+		}
+	}
+
+	void TransformNormalsScalar(const XMFLOAT4X4& m, uint8* out, size_t outStride,
+		const uint8* in, size_t inStride, size_t count)
+	{
+		for(size_t i = 0; i < count; ++i, in += inStride, out += outStride)
+		{
+			XMFLOAT3 n = *reinterpret_cast<const XMFLOAT3*>(in);
+
+			float x = n.x*m._11 + n.y*m._21 + n.z*m._31;
+			float y = n.x*m._12 + n.y*m._22 + n.z*m._32;
+			float z = n.x*m._13 + n.y*m._23 + n.z*m._33;
+
+			float length = std::sqrt(x*x + y*y + z*z);
+			float invLength = length > 0.0f ? 1.0f / length : 0.0f;
+
+			XMFLOAT3& r = *reinterpret_cast<XMFLOAT3*>(out);
+			r.x = x*invLength;
+			r.y = y*invLength;
+			r.z = z*invLength;
+		}
+	}
+
+	void AffineInverseTransposeScalar(uint8* out, size_t outStride,
+		const uint8* in, size_t inStride, size_t count)
+	{
+		for(size_t i = 0; i < count; ++i, in += inStride, out += outStride)
+		{
+			XMMATRIX M = XMLoadFloat4x4(reinterpret_cast<const XMFLOAT4X4*>(in));
+			XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(out), MathHelper::InverseTranspose(M, MatrixKind::Affine));
+		}
+	}
+
+	template<typename Source>
+	void StoreTransposedScalar(uint8* out, size_t outStride, Source source, size_t count)
+	{
+		for(size_t i = 0; i < count; ++i, out += outStride)
+		{
+			XMFLOAT4X4 m = *source(i);
+
+			XMFLOAT4X4& r = *reinterpret_cast<XMFLOAT4X4*>(out);
+			for(int row = 0; row < 4; ++row)
+			{
+				for(int col = 0; col < 4; ++col)
+					r.m[row][col] = m.m[col][row];
+			}
+		}
+	}
+
+#if defined(MATHBATCH_X86)
+
+	//
+	// SSE2.
+	//
+
+	inline __m128 LoadFloat3(const uint8* p)
+	{
+		__m128 xy = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p)));
+		__m128 z = _mm_load_ss(reinterpret_cast<const float*>(p) + 2);
+		return _mm_movelh_ps(xy, z);
+	}
+
+	inline void StoreFloat3(uint8* p, __m128 v)
+	{
+		_mm_store_sd(reinterpret_cast<double*>(p), _mm_castps_pd(v));
+		_mm_store_ss(reinterpret_cast<float*>(p) + 2, _mm_movehl_ps(v, v));
+	}
+
+	// Returns v/|v| over xyz, or zero for a zero vector.
+	inline __m128 Normalize3(__m128 v)
+	{
+		__m128 sq = _mm_mul_ps(v, v);
+		__m128 lengthSq = _mm_add_ps(_mm_add_ps(
+			_mm_shuffle_ps(sq, sq, _MM_SHUFFLE(0, 0, 0, 0)),
+			_mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 1, 1, 1))),
+			_mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 2, 2, 2)));
+
+		__m128 nonZero = _mm_cmpgt_ps(lengthSq, _mm_setzero_ps());
+		return _mm_and_ps(_mm_div_ps(v, _mm_sqrt_ps(lengthSq)), nonZero);
+	}
+
+	void TransformPositionsSSE2(const XMFLOAT4X4& m, uint8* out, size_t outStride,
+		const uint8* in, size_t inStride, size_t count)
+	{
+		__m128 r0 = _mm_loadu_ps(&m._11);
+		__m128 r1 = _mm_loadu_ps(&m._21);
+		__m128 r2 = _mm_loadu_ps(&m._31);
+		__m128 r3 = _mm_loadu_ps(&m._41);
+
+		for(size_t i = 0; i < count; ++i, in += inStride, out += outStride)
+		{
+			__m128 p = LoadFloat3(in);
+
+			__m128 r = _mm_add_ps(r3, _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0)), r0));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)), r1));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2)), r2));
+
+			StoreFloat3(out, r);
+		}
+	}
+
+	void TransformNormalsSSE2(const XMFLOAT4X4& m, uint8* out, size_t outStride,
+		const uint8* in, size_t inStride, size_t count)
+	{
+		__m128 r0 = _mm_loadu_ps(&m._11);
+		__m128 r1 = _mm_loadu_ps(&m._21);
+		__m128 r2 = _mm_loadu_ps(&m._31);
+
+		for(size_t i = 0; i < count; ++i, in += inStride, out += outStride)
+		{
+			__m128 n = LoadFloat3(in);
+
+			__m128 r = _mm_mul_ps(_mm_shuffle_ps(n, n, _MM_SHUFFLE(0, 0, 0, 0)), r0);
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(n, n, _MM_SHUFFLE(1, 1, 1, 1)), r1));
+			r = _mm_add_ps(r, _mm_mul_ps(_mm_shuffle_ps(n, n, _MM_SHUFFLE(2, 2, 2, 2)), r2));
+
+			StoreFloat3(out, Normalize3(r));
+		}
+	}
+
+	// Streaming stores bypass the cache, for write-combined destinations; they need
+	// 16-byte alignment.
+	template<bool Stream>
+	inline void StoreRow(float* r, __m128 v)
+	{
+		if(Stream)
+			_mm_stream_ps(r, v);
+		else
+			_mm_storeu_ps(r, v);
+	}
+
+	template<bool Stream, typename Source>
+	void StoreTransposedSSE2(uint8* out, size_t outStride, Source source, size_t count)
+	{
+		for(size_t i = 0; i < count; ++i, out += outStride)
+		{
+			const float* m = &source(i)->_11;
+
+			__m128 r0 = _mm_loadu_ps(m);
+			__m128 r1 = _mm_loadu_ps(m + 4);
+			__m128 r2 = _mm_loadu_ps(m + 8);
+			__m128 r3 = _mm_loadu_ps(m + 12);
+
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+			float* r = reinterpret_cast<float*>(out);
+			StoreRow<Stream>(r, r0);
+			StoreRow<Stream>(r + 4, r1);
+			StoreRow<Stream>(r + 8, r2);
+			StoreRow<Stream>(r + 12, r3);
+		}
+	}
+
+	// Inverts four affine matrices side by side, one per lane: the 3x3 entries are
+	// transposed into SoA form so each cofactor is a couple of multiplies for all
+	// four matrices, then transposed back into rows.
+	void AffineInverseTransposeSSE2(uint8* out, size_t outStride,
+		const uint8* in, size_t inStride, size_t count)
+	{
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4, in += 4*inStride, out += 4*outStride)
+		{
+			__m128 a[3][3];
+			for(int row = 0; row < 3; ++row)
+			{
+				__m128 m0 = _mm_loadu_ps(reinterpret_cast<const float*>(in) + 4*row);
+				__m128 m1 = _mm_loadu_ps(reinterpret_cast<const float*>(in + inStride) + 4*row);
+				__m128 m2 = _mm_loadu_ps(reinterpret_cast<const float*>(in + 2*inStride) + 4*row);
+				__m128 m3 = _mm_loadu_ps(reinterpret_cast<const float*>(in + 3*inStride) + 4*row);
+
+				_MM_TRANSPOSE4_PS(m0, m1, m2, m3);
+				a[row][0] = m0;
+				a[row][1] = m1;
+				a[row][2] = m2;
+			}
+
+			// Rows of the cofactor matrix: a1 x a2, a2 x a0, a0 x a1.
+			__m128 c[3][3];
+			for(int row = 0; row < 3; ++row)
+			{
+				const __m128* u = a[(row + 1) % 3];
+				const __m128* v = a[(row + 2) % 3];
+				c[row][0] = _mm_sub_ps(_mm_mul_ps(u[1], v[2]), _mm_mul_ps(u[2], v[1]));
+				c[row][1] = _mm_sub_ps(_mm_mul_ps(u[2], v[0]), _mm_mul_ps(u[0], v[2]));
+				c[row][2] = _mm_sub_ps(_mm_mul_ps(u[0], v[1]), _mm_mul_ps(u[1], v[0]));
+			}
+
+			__m128 det = _mm_add_ps(_mm_add_ps(
+				_mm_mul_ps(a[0][0], c[0][0]),
+				_mm_mul_ps(a[0][1], c[0][1])),
+				_mm_mul_ps(a[0][2], c[0][2]));
+			__m128 invDet = _mm_div_ps(_mm_set1_ps(1.0f), det);
+
+			for(int row = 0; row < 3; ++row)
+			{
+				__m128 x = _mm_mul_ps(c[row][0], invDet);
+				__m128 y = _mm_mul_ps(c[row][1], invDet);
+				__m128 z = _mm_mul_ps(c[row][2], invDet);
+				__m128 w = _mm_setzero_ps();
+
+				_MM_TRANSPOSE4_PS(x, y, z, w);
+				_mm_storeu_ps(reinterpret_cast<float*>(out) + 4*row, x);
+				_mm_storeu_ps(reinterpret_cast<float*>(out + outStride) + 4*row, y);
+				_mm_storeu_ps(reinterpret_cast<float*>(out + 2*outStride) + 4*row, z);
+				_mm_storeu_ps(reinterpret_cast<float*>(out + 3*outStride) + 4*row, w);
+			}
+
+			__m128 r3 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+			for(int k = 0; k < 4; ++k)
+				_mm_storeu_ps(reinterpret_cast<float*>(out + k*outStride) + 12, r3);
+		}
+
+		AffineInverseTransposeScalar(out, outStride, in, inStride, count - i);
+	}
+
+	//
+	// AVX2.  The vector kernels put two vertices side by side in the two 128-bit
+	// lanes, so each FMA does the work of two SSE2 multiply-adds.
+	//
+
+	MATHBATCH_AVX2 inline __m256 LoadFloat3x2(const uint8* p0, const uint8* p1)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(LoadFloat3(p0)), LoadFloat3(p1), 1);
+	}
+
+	MATHBATCH_AVX2 inline void StoreFloat3x2(uint8* p0, uint8* p1, __m256 v)
+	{
+		StoreFloat3(p0, _mm256_castps256_ps128(v));
+		StoreFloat3(p1, _mm256_extractf128_ps(v, 1));
+	}
+
+	MATHBATCH_AVX2 void TransformPositionsAVX2(const XMFLOAT4X4& m, uint8* out, size_t outStride,
+		const uint8* in, size_t inStride, size_t count)
+	{
+		__m256 r0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m._11));
+		__m256 r1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m._21));
+		__m256 r2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m._31));
+		__m256 r3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m._41));
+
+		size_t i = 0;
+		for(; i + 2 <= count; i += 2, in += 2*inStride, out += 2*outStride)
+		{
+			__m256 p = LoadFloat3x2(in, in + inStride);
+
+			__m256 r = _mm256_fmadd_ps(_mm256_permute_ps(p, _MM_SHUFFLE(0, 0, 0, 0)), r0, r3);
+			r = _mm256_fmadd_ps(_mm256_permute_ps(p, _MM_SHUFFLE(1, 1, 1, 1)), r1, r);
+			r = _mm256_fmadd_ps(_mm256_permute_ps(p, _MM_SHUFFLE(2, 2, 2, 2)), r2, r);
+
+			StoreFloat3x2(out, out + outStride, r);
+		}
+
+		TransformPositionsSSE2(m, out, outStride, in, inStride, count - i);
+	}
+
+	MATHBATCH_AVX2 void TransformNormalsAVX2(const XMFLOAT4X4& m, uint8* out, size_t outStride,
+		const uint8* in, size_t inStride, size_t count)
+	{
+		__m256 r0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m._11));
+		__m256 r1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m._21));
+		__m256 r2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(&m._31));
+
+		size_t i = 0;
+		for(; i + 2 <= count; i += 2, in += 2*inStride, out += 2*outStride)
+		{
+			__m256 n = LoadFloat3x2(in, in + inStride);
+
+			__m256 r = _mm256_mul_ps(_mm256_permute_ps(n, _MM_SHUFFLE(0, 0, 0, 0)), r0);
+			r = _mm256_fmadd_ps(_mm256_permute_ps(n, _MM_SHUFFLE(1, 1, 1, 1)), r1, r);
+			r = _mm256_fmadd_ps(_mm256_permute_ps(n, _MM_SHUFFLE(2, 2, 2, 2)), r2, r);
+
+			__m256 sq = _mm256_mul_ps(r, r);
+			__m256 lengthSq = _mm256_add_ps(_mm256_add_ps(
+				_mm256_permute_ps(sq, _MM_SHUFFLE(0, 0, 0, 0)),
+				_mm256_permute_ps(sq, _MM_SHUFFLE(1, 1, 1, 1))),
+				_mm256_permute_ps(sq, _MM_SHUFFLE(2, 2, 2, 2)));
+
+			__m256 nonZero = _mm256_cmp_ps(lengthSq, _mm256_setzero_ps(), _CMP_GT_OQ);
+			r = _mm256_and_ps(_mm256_div_ps(r, _mm256_sqrt_ps(lengthSq)), nonZero);
+
+			StoreFloat3x2(out, out + outStride, r);
+		}
+
+		TransformNormalsSSE2(m, out, outStride, in, inStride, count - i);
+	}
+
+	template<bool Stream, typename Source>
+	MATHBATCH_AVX2 void StoreTransposedAVX2(uint8* out, size_t outStride, Source source, size_t count)
+	{
+		for(size_t i = 0; i < count; ++i, out += outStride)
+		{
+			const float* m = &source(i)->_11;
+
+			// a = [r0 | r1], b = [r2 | r3].
+			__m256 a = _mm256_loadu_ps(m);
+			__m256 b = _mm256_loadu_ps(m + 8);
+
+			// [r0x r2x r0y r2y | r1x r3x r1y r3y] and the same for z and w.
+			__m256 xy = _mm256_unpacklo_ps(a, b);
+			__m256 zw = _mm256_unpackhi_ps(a, b);
+
+			// Line the row 0/2 halves up against the row 1/3 halves.
+			__m256 lo = _mm256_permute2f128_ps(xy, zw, 0x20);
+			__m256 hi = _mm256_permute2f128_ps(xy, zw, 0x31);
+
+			// [c0 | c2] and [c1 | c3].
+			__m256 c02 = _mm256_unpacklo_ps(lo, hi);
+			__m256 c13 = _mm256_unpackhi_ps(lo, hi);
+
+			float* r = reinterpret_cast<float*>(out);
+			if(Stream)
+			{
+				// Constant buffer elements are only sure to be 16-byte aligned, too
+				// little for _mm256_stream_ps, so the columns go out 128 bits at a time.
+				_mm_stream_ps(r, _mm256_castps256_ps128(c02));
+				_mm_stream_ps(r + 4, _mm256_castps256_ps128(c13));
+				_mm_stream_ps(r + 8, _mm256_extractf128_ps(c02, 1));
+				_mm_stream_ps(r + 12, _mm256_extractf128_ps(c13, 1));
+			}
+			else
+			{
+				_mm256_storeu_ps(r, _mm256_permute2f128_ps(c02, c13, 0x20));
+				_mm256_storeu_ps(r + 8, _mm256_permute2f128_ps(c02, c13, 0x31));
+			}
+		}
+	}
+
+	// Row row of the matrices at p0 and p1, in the low and high lane.
+	MATHBATCH_AVX2 inline __m256 LoadRowx2(const uint8* p0, const uint8* p1, int row)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(
+			_mm_loadu_ps(reinterpret_cast<const float*>(p0) + 4*row)),
+			_mm_loadu_ps(reinterpret_cast<const float*>(p1) + 4*row), 1);
+	}
+
+	MATHBATCH_AVX2 inline void StoreRowx2(uint8* p0, uint8* p1, int row, __m256 v)
+	{
+		_mm_storeu_ps(reinterpret_cast<float*>(p0) + 4*row, _mm256_castps256_ps128(v));
+		_mm_storeu_ps(reinterpret_cast<float*>(p1) + 4*row, _mm256_extractf128_ps(v, 1));
+	}
+
+	// The SSE2 kernel with matrices i and i+4 in the two 128-bit lanes, which the
+	// in-lane shuffles of _MM_TRANSPOSE4_PS treat independently.
+	MATHBATCH_AVX2 void AffineInverseTransposeAVX2(uint8* out, size_t outStride,
+		const uint8* in, size_t inStride, size_t count)
+	{
+		size_t i = 0;
+		for(; i + 8 <= count; i += 8, in += 8*inStride, out += 8*outStride)
+		{
+			__m256 a[3][3];
+			for(int row = 0; row < 3; ++row)
+			{
+				__m256 m0 = LoadRowx2(in, in + 4*inStride, row);
+				__m256 m1 = LoadRowx2(in + inStride, in + 5*inStride, row);
+				__m256 m2 = LoadRowx2(in + 2*inStride, in + 6*inStride, row);
+				__m256 m3 = LoadRowx2(in + 3*inStride, in + 7*inStride, row);
+
+				__m256 t0 = _mm256_unpacklo_ps(m0, m1);
+				__m256 t1 = _mm256_unpacklo_ps(m2, m3);
+				__m256 t2 = _mm256_unpackhi_ps(m0, m1);
+				__m256 t3 = _mm256_unpackhi_ps(m2, m3);
+
+				a[row][0] = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0));
+				a[row][1] = _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2));
+				a[row][2] = _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0));
+			}
+
+			__m256 c[3][3];
+			for(int row = 0; row < 3; ++row)
+			{
+				const __m256* u = a[(row + 1) % 3];
+				const __m256* v = a[(row + 2) % 3];
+				c[row][0] = _mm256_fmsub_ps(u[1], v[2], _mm256_mul_ps(u[2], v[1]));
+				c[row][1] = _mm256_fmsub_ps(u[2], v[0], _mm256_mul_ps(u[0], v[2]));
+				c[row][2] = _mm256_fmsub_ps(u[0], v[1], _mm256_mul_ps(u[1], v[0]));
+			}
+
+			__m256 det = _mm256_fmadd_ps(a[0][2], c[0][2],
+				_mm256_fmadd_ps(a[0][1], c[0][1], _mm256_mul_ps(a[0][0], c[0][0])));
+			__m256 invDet = _mm256_div_ps(_mm256_set1_ps(1.0f), det);
+
+			for(int row = 0; row < 3; ++row)
+			{
+				__m256 x = _mm256_mul_ps(c[row][0], invDet);
+				__m256 y = _mm256_mul_ps(c[row][1], invDet);
+				__m256 z = _mm256_mul_ps(c[row][2], invDet);
+				__m256 w = _mm256_setzero_ps();
+
+				__m256 t0 = _mm256_unpacklo_ps(x, y);
+				__m256 t1 = _mm256_unpacklo_ps(z, w);
+				__m256 t2 = _mm256_unpackhi_ps(x, y);
+				__m256 t3 = _mm256_unpackhi_ps(z, w);
+
+				StoreRowx2(out, out + 4*outStride, row, _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(1, 0, 1, 0)));
+				StoreRowx2(out + outStride, out + 5*outStride, row, _mm256_shuffle_ps(t0, t1, _MM_SHUFFLE(3, 2, 3, 2)));
+				StoreRowx2(out + 2*outStride, out + 6*outStride, row, _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(1, 0, 1, 0)));
+				StoreRowx2(out + 3*outStride, out + 7*outStride, row, _mm256_shuffle_ps(t2, t3, _MM_SHUFFLE(3, 2, 3, 2)));
+			}
+
+			__m128 r3 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+			for(int k = 0; k < 8; ++k)
+				_mm_storeu_ps(reinterpret_cast<float*>(out + k*outStride) + 12, r3);
+		}
+
+		AffineInverseTransposeSSE2(out, outStride, in, inStride, count - i);
+	}
+
+#endif
+
+	template<typename Source>
+	void StoreTransposedDispatch(uint8* out, size_t outStride, Source source, size_t count, bool stream)
+	{
+		// Streaming needs every matrix 16-byte aligned.
+		assert(!stream || ((reinterpret_cast<std::uintptr_t>(out) | outStride) & 15) == 0);
+
+		switch(MathBatch::GetPath())
+		{
+#if defined(MATHBATCH_X86)
+		case MathBatch::Path::AVX2:
+			if(stream)
+				StoreTransposedAVX2<true>(out, outStride, source, count);
+			else
+				StoreTransposedAVX2<false>(out, outStride, source, count);
+			break;
+		case MathBatch::Path::SSE2:
+			if(stream)
+				StoreTransposedSSE2<true>(out, outStride, source, count);
+			else
+				StoreTransposedSSE2<false>(out, outStride, source, count);
+			break;
+#endif
+		default:
+			StoreTransposedScalar(out, outStride, source, count);
+			break;
+		}
+
+#if defined(MATHBATCH_X86)
+		// Streaming stores are weakly ordered; make them visible before whatever
+		// tells the GPU to read them.
+		if(stream)
+			_mm_sfence();
+#endif
+	}
+}
+
+MathBatch::Path MathBatch::GetBestPath()
+{
+	static const Path best = DetectPath();
+	return best;
+}
+
+MathBatch::Path MathBatch::GetPath()
+{
+	int path = gPath.load(std::memory_order_relaxed);
+	if(path < 0)
+	{
+		path = (int)GetBestPath();
+		gPath.store(path, std::memory_order_relaxed);
+	}
+
+	return (Path)path;
+}
+
+void MathBatch::SetPath(Path path)
+{
+	if((int)path > (int)GetBestPath())
+		path = GetBestPath();
+
+	gPath.store((int)path, std::memory_order_relaxed);
+}
+
+void MathBatch::TransformPositions(XMFLOAT3* out, size_t outStride,
+	const XMFLOAT3* in, size_t inStride, size_t count, CXMMATRIX M)
+{
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, M);
+
+	uint8* dst = reinterpret_cast<uint8*>(out);
+	const uint8* src = reinterpret_cast<const uint8*>(in);
+
+	switch(GetPath())
+	{
+#if defined(MATHBATCH_X86)
+	case Path::AVX2:
+		TransformPositionsAVX2(m, dst, outStride, src, inStride, count);
+		break;
+	case Path::SSE2:
+		TransformPositionsSSE2(m, dst, outStride, src, inStride, count);
+		break;
+#endif
+	default:
+		TransformPositionsScalar(m, dst, outStride, src, inStride, count);
+		break;
+	}
+}
+
+void MathBatch::TransformNormals(XMFLOAT3* out, size_t outStride,
+	const XMFLOAT3* in, size_t inStride, size_t count, CXMMATRIX M)
+{
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, MathHelper::InverseTranspose(M, MatrixKind::Affine));
+
+	uint8* dst = reinterpret_cast<uint8*>(out);
+	const uint8* src = reinterpret_cast<const uint8*>(in);
+
+	switch(GetPath())
+	{
+#if defined(MATHBATCH_X86)
+	case Path::AVX2:
+		TransformNormalsAVX2(m, dst, outStride, src, inStride, count);
+		break;
+	case Path::SSE2:
+		TransformNormalsSSE2(m, dst, outStride, src, inStride, count);
+		break;
+#endif
+	default:
+		TransformNormalsScalar(m, dst, outStride, src, inStride, count);
+		break;
+	}
+}
+
+void MathBatch::StoreTransposed(void* out, size_t outStride,
+	const XMFLOAT4X4* in, size_t inStride, size_t count)
+{
+	StridedMatrices source = { reinterpret_cast<const uint8*>(in), inStride };
+	StoreTransposedDispatch(static_cast<uint8*>(out), outStride, source, count, false);
+}
+
+void MathBatch::StoreTransposed(void* out, size_t outStride,
+	const XMFLOAT4X4* const* in, size_t count)
+{
+	IndirectMatrices source = { in };
+	StoreTransposedDispatch(static_cast<uint8*>(out), outStride, source, count, false);
+}
+
+void MathBatch::StreamTransposed(void* out, size_t outStride,
+	const XMFLOAT4X4* in, size_t inStride, size_t count)
+{
+	StridedMatrices source = { reinterpret_cast<const uint8*>(in), inStride };
+	StoreTransposedDispatch(static_cast<uint8*>(out), outStride, source, count, true);
+}
+
+void MathBatch::StreamTransposed(void* out, size_t outStride,
+	const XMFLOAT4X4* const* in, size_t count)
+{
+	IndirectMatrices source = { in };
+	StoreTransposedDispatch(static_cast<uint8*>(out), outStride, source, count, true);
+}
+
+void MathBatch::InverseTranspose(XMFLOAT4X4* out, size_t outStride,
+	const XMFLOAT4X4* in, size_t inStride, size_t count, MatrixKind kind)
+{
+	uint8* dst = reinterpret_cast<uint8*>(out);
+	const uint8* src = reinterpret_cast<const uint8*>(in);
+
+	if(kind != MatrixKind::Affine)
+	{
+		for(size_t i = 0; i < count; ++i, src += inStride, dst += outStride)
+		{
+			XMMATRIX M = XMLoadFloat4x4(reinterpret_cast<const XMFLOAT4X4*>(src));
+			XMStoreFloat4x4(reinterpret_cast<XMFLOAT4X4*>(dst), MathHelper::InverseTranspose(M, kind));
+		}
+		return;
+	}
+
+	switch(GetPath())
+	{
+#if defined(MATHBATCH_X86)
+	case Path::AVX2:
+		AffineInverseTransposeAVX2(dst, outStride, src, inStride, count);
+		break;
+	case Path::SSE2:
+		AffineInverseTransposeSSE2(dst, outStride, src, inStride, count);
+		break;
+#endif
+	default:
+		AffineInverseTransposeScalar(dst, outStride, src, inStride, count);
+		break;
+	}
+}
@@ -0,0 +1,82 @@
+//***************************************************************************************
+// MathBatch.h
+//
+// Batch kernels for transforming whole streams of vectors and matrices at once,
+// instead of one XMLoad/XMStore round trip per element.  Each kernel has a scalar,
+// an SSE2 and an AVX2 (with FMA) implementation; the fastest one the CPU supports
+// is picked the first time a kernel runs.
+//
+// Streams are strided like GeometryGenerator::VertexStream, so the kernels read
+// and write the members of interleaved vertices in place.  Inputs and outputs may
+// be the same memory, but must not otherwise overlap.
+//***************************************************************************************
+
+#pragma once
+
+#include "MathHelper.h"
+#include <cstddef>
+
+class MathBatch
+{
+public:
+
+	enum class Path
+	{
+		Scalar,
+		SSE2,
+		AVX2
+	};
+
+	///<summary>
+	/// The implementation the kernels use.  SetPath is meant for testing and
+	/// benchmarking; asking for a path the CPU does not support selects the best
+	/// one it does.
+	///</summary>
+	static Path GetPath();
+	static void SetPath(Path path);
+	static Path GetBestPath();
+
+	///<summary>
+	/// out[i] = in[i]*M for points (w = 1).  M must be affine: there is no divide by w.
+	///</summary>
+	static void TransformPositions(DirectX::XMFLOAT3* out, size_t outStride,
+		const DirectX::XMFLOAT3* in, size_t inStride, size_t count, DirectX::CXMMATRIX M);
+
+	///<summary>
+	/// Transforms normals by the inverse-transpose of M's upper 3x3 and renormalizes
+	/// them, so they stay perpendicular to the surface under non-uniform scaling.
+	/// Zero vectors stay zero.
+	///</summary>
+	static void TransformNormals(DirectX::XMFLOAT3* out, size_t outStride,
+		const DirectX::XMFLOAT3* in, size_t inStride, size_t count, DirectX::CXMMATRIX M);
+
+	///<summary>
+	/// Writes the transpose of count matrices to out, outStride bytes apart, e.g. the
+	/// World member of mapped constant buffer elements.  The second overload gathers
+	/// the matrices through pointers, such as the World members of render items.
+	///</summary>
+	static void StoreTransposed(void* out, size_t outStride,
+		const DirectX::XMFLOAT4X4* in, size_t inStride, size_t count);
+	static void StoreTransposed(void* out, size_t outStride,
+		const DirectX::XMFLOAT4X4* const* in, size_t count);
+
+	///<summary>
+	/// StoreTransposed with non-temporal stores, for write-combined memory such as
+	/// mapped upload heaps: out and outStride must be multiples of 16 bytes, and
+	/// should be of 64 so each matrix fills a whole cache line.  Ends with a store
+	/// fence.
+	///</summary>
+	static void StreamTransposed(void* out, size_t outStride,
+		const DirectX::XMFLOAT4X4* in, size_t inStride, size_t count);
+	static void StreamTransposed(void* out, size_t outStride,
+		const DirectX::XMFLOAT4X4* const* in, size_t count);
+
+	///<summary>
+	/// MathHelper::InverseTranspose of count matrices, e.g. the normal matrices of
+	/// all objects at once.  Matrices passed as Affine are inverted four (SSE2) or
+	/// eight (AVX2) at a time; the other kinds go through MathHelper one by one.
+	///</summary>
+	static void InverseTranspose(DirectX::XMFLOAT4X4* out, size_t outStride,
+		const DirectX::XMFLOAT4X4* in, size_t inStride, size_t count,
+		MatrixKind kind = MatrixKind::General);
+};
@@ -4,13 +4,224 @@
 
 #include "MathHelper.h"
 #include <float.h>
+#include <atomic>
 #include <cmath>
 
+#if !defined(_XM_NO_INTRINSICS_) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define MATHHELPER_SSE2 1
+#include <emmintrin.h>
+#endif
+
 using namespace DirectX;
 
 const float MathHelper::Infinity = FLT_MAX;
 const float MathHelper::Pi       = 3.1415926535f;
 
+namespace
+{
+	// Expands a 64-bit seed into well mixed generator state (Steele, Lea and Flood).
+	std::uint64_t SplitMix64(std::uint64_t& x)
+	{
+		std::uint64_t z = (x += 0x9E3779B97F4A7C15ull);
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	// xoshiro128 must not start from all zeros.
+	void SeedState(std::uint64_t& x, std::uint32_t* s, size_t stride)
+	{
+		std::uint64_t a = SplitMix64(x);
+		std::uint64_t b = SplitMix64(x);
+		s[0] = (std::uint32_t)a;
+		s[stride] = (std::uint32_t)(a >> 32);
+		s[2*stride] = (std::uint32_t)b;
+		s[3*stride] = (std::uint32_t)(b >> 32);
+
+		if((a | b) == 0)
+			s[0] = 1;
+	}
+
+	inline std::uint32_t Rotl(std::uint32_t x, int k)
+	{
+		return (x << k) | (x >> (32 - k));
+	}
+
+	// The top 24 bits are the best ones of xoshiro128+ and fill a float mantissa
+	// exactly, so the result is below 1.
+	const float UIntToUnitFloat = 1.0f / 16777216.0f;
+
+	// Builds unit vectors from uniform u and v in [0, 1): z = 1 - 2u is uniform in
+	// (-1, 1], and by Archimedes' hat-box theorem so is the area of the sphere
+	// above it.  The results are in SoA form, one vector per lane.
+	void UnitVectorsFromUniform(FXMVECTOR u, FXMVECTOR v, XMVECTOR& x, XMVECTOR& y, XMVECTOR& z)
+	{
+		const XMVECTOR One = XMVectorReplicate(1.0f);
+
+		z = One - 2.0f*u;
+		XMVECTOR r = XMVectorSqrt(XMVectorMax(One - z*z, XMVectorZero()));
+
+		// Map the angle to [-pi, pi), where XMVectorSinCos is most accurate.
+		XMVECTOR sinPhi, cosPhi;
+		XMVectorSinCos(&sinPhi, &cosPhi, XMVectorReplicate(XM_2PI)*v - XMVectorReplicate(XM_PI));
+		x = r*cosPhi;
+		y = r*sinPhi;
+	}
+
+	// Mirrors the vectors that point away from n through the plane orthogonal to
+	// n.  This maps the lower hemisphere onto the upper one, area for area.
+	void MirrorToHemisphere(FXMVECTOR n, XMVECTOR& x, XMVECTOR& y, XMVECTOR& z)
+	{
+		XMVECTOR nx = XMVectorSplatX(n);
+		XMVECTOR ny = XMVectorSplatY(n);
+		XMVECTOR nz = XMVectorSplatZ(n);
+
+		XMVECTOR d = x*nx + y*ny + z*nz;
+		XMVECTOR s = -2.0f*XMVectorMin(d, XMVectorZero());
+		x += s*nx;
+		y += s*ny;
+		z += s*nz;
+	}
+
+	void StoreSoA(XMFLOAT3* out, size_t count, FXMVECTOR x, FXMVECTOR y, FXMVECTOR z)
+	{
+		XMMATRIX T = XMMatrixTranspose(XMMATRIX(x, y, z, XMVectorZero()));
+		for(size_t i = 0; i < count; ++i)
+			XMStoreFloat3(&out[i], T.r[i]);
+	}
+
+	// Returns the upper 3x3 of M with the fourth column and row cleared, the
+	// fourth row set to (0, 0, 0, 1).
+	XMMATRIX Upper3x3(CXMMATRIX M)
+	{
+		XMVECTOR mask = XMVectorSelectControl(1, 1, 1, 0);
+		return XMMATRIX(
+			XMVectorAndInt(M.r[0], mask),
+			XMVectorAndInt(M.r[1], mask),
+			XMVectorAndInt(M.r[2], mask),
+			XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f));
+	}
+
+	// Inverse-transpose of an affine matrix's upper 3x3: the cofactor rows are the
+	// cross products of the other two rows, and their dot with the first row is
+	// the determinant.
+	XMMATRIX AffineInverseTranspose(CXMMATRIX M)
+	{
+		XMMATRIX A = Upper3x3(M);
+
+		XMVECTOR c0 = XMVector3Cross(A.r[1], A.r[2]);
+		XMVECTOR c1 = XMVector3Cross(A.r[2], A.r[0]);
+		XMVECTOR c2 = XMVector3Cross(A.r[0], A.r[1]);
+		XMVECTOR invDet = XMVectorReciprocal(XMVector3Dot(A.r[0], c0));
+
+		return XMMATRIX(c0*invDet, c1*invDet, c2*invDet, A.r[3]);
+	}
+
+	// Inverse of an affine matrix with the upper 3x3 inverse L: the translation t
+	// becomes -t*L.
+	XMMATRIX AffineInverse(CXMMATRIX L, FXMVECTOR t)
+	{
+		XMVECTOR invT = -(XMVectorSplatX(t)*L.r[0] + XMVectorSplatY(t)*L.r[1] + XMVectorSplatZ(t)*L.r[2]);
+		return XMMATRIX(L.r[0], L.r[1], L.r[2], XMVectorSetW(invT, 1.0f));
+	}
+
+	// A rotation times s has the inverse-transpose rotation/s, which is
+	// (rotation*s)/s^2.
+	XMMATRIX UniformScaleInverseTranspose(CXMMATRIX M)
+	{
+		XMMATRIX A = Upper3x3(M);
+		XMVECTOR invScaleSq = XMVectorReciprocal(XMVector3LengthSq(A.r[0]));
+
+		return XMMATRIX(A.r[0]*invScaleSq, A.r[1]*invScaleSq, A.r[2]*invScaleSq, A.r[3]);
+	}
+
+	// A perspective matrix only has the entries
+	//   [a 0 0 0]
+	//   [0 b 0 0]
+	//   [e f c 1]
+	//   [0 0 d 0]
+	// and solving v*P = (X, Y, Z, W) for v gives the inverse directly.
+	XMMATRIX PerspectiveInverse(CXMMATRIX P)
+	{
+		XMFLOAT4X4 p;
+		XMStoreFloat4x4(&p, P);
+
+		float invA = 1.0f / p._11;
+		float invB = 1.0f / p._22;
+		float invD = 1.0f / p._43;
+
+		return XMMATRIX(
+			invA, 0.0f, 0.0f, 0.0f,
+			0.0f, invB, 0.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, invD,
+			-p._31*invA, -p._32*invB, 1.0f, -p._33*invD);
+	}
+
+	// With WideLoad, positions are read with one unaligned 16-byte load instead of
+	// XMLoadFloat3's three.  The w component then holds whatever follows the
+	// position and is ignored, so it may only be used when the stride leaves room
+	// for it.
+	template<bool WideLoad>
+	XMVECTOR LoadPosition(const std::uint8_t* p)
+	{
+		return WideLoad ? XMLoadFloat4(reinterpret_cast<const XMFLOAT4*>(p)) :
+						  XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(p));
+	}
+
+	// Folds count points into vMin/vMax.  Four accumulators keep the min/max
+	// dependency chains short.
+	template<bool WideLoad>
+	void AccumulateMinMax(const std::uint8_t* p, size_t stride, size_t count, XMVECTOR& vMin, XMVECTOR& vMax)
+	{
+		XMVECTOR min0 = vMin, min1 = vMin, min2 = vMin, min3 = vMin;
+		XMVECTOR max0 = vMax, max1 = vMax, max2 = vMax, max3 = vMax;
+
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4, p += 4*stride)
+		{
+			XMVECTOR p0 = LoadPosition<WideLoad>(p);
+			XMVECTOR p1 = LoadPosition<WideLoad>(p + stride);
+			XMVECTOR p2 = LoadPosition<WideLoad>(p + 2*stride);
+			XMVECTOR p3 = LoadPosition<WideLoad>(p + 3*stride);
+
+			min0 = XMVectorMin(min0, p0); max0 = XMVectorMax(max0, p0);
+			min1 = XMVectorMin(min1, p1); max1 = XMVectorMax(max1, p1);
+			min2 = XMVectorMin(min2, p2); max2 = XMVectorMax(max2, p2);
+			min3 = XMVectorMin(min3, p3); max3 = XMVectorMax(max3, p3);
+		}
+
+		for(; i < count; ++i, p += stride)
+		{
+			XMVECTOR p0 = LoadPosition<WideLoad>(p);
+			min0 = XMVectorMin(min0, p0);
+			max0 = XMVectorMax(max0, p0);
+		}
+
+		vMin = XMVectorMin(XMVectorMin(min0, min1), XMVectorMin(min2, min3));
+		vMax = XMVectorMax(XMVectorMax(max0, max1), XMVectorMax(max2, max3));
+	}
+
+	template<bool WideLoad>
+	void AccumulateMaxDistanceSq(const std::uint8_t* p, size_t stride, size_t count, FXMVECTOR center, XMVECTOR& maxDistSq)
+	{
+		XMVECTOR d0 = maxDistSq, d1 = maxDistSq, d2 = maxDistSq, d3 = maxDistSq;
+
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4, p += 4*stride)
+		{
+			d0 = XMVectorMax(d0, XMVector3LengthSq(LoadPosition<WideLoad>(p) - center));
+			d1 = XMVectorMax(d1, XMVector3LengthSq(LoadPosition<WideLoad>(p + stride) - center));
+			d2 = XMVectorMax(d2, XMVector3LengthSq(LoadPosition<WideLoad>(p + 2*stride) - center));
+			d3 = XMVectorMax(d3, XMVector3LengthSq(LoadPosition<WideLoad>(p + 3*stride) - center));
+		}
+
+		for(; i < count; ++i, p += stride)
+			d0 = XMVectorMax(d0, XMVector3LengthSq(LoadPosition<WideLoad>(p) - center));
+
+		maxDistSq = XMVectorMax(XMVectorMax(d0, d1), XMVectorMax(d2, d3));
+	}
+}
+
 float MathHelper::AngleFromXY(float x, float y)
 {
 	float theta = 0.0f;
@@ -33,50 +244,275 @@ float MathHelper::AngleFromXY(float x, float y)
 	return theta;
 }
 
-XMVECTOR MathHelper::RandUnitVec3()
+XMMATRIX MathHelper::Inverse(CXMMATRIX M, MatrixKind kind)
 {
-	XMVECTOR One  = XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
-	XMVECTOR Zero = XMVectorZero();
+	switch(kind)
+	{
+	case MatrixKind::Rigid:
+		return AffineInverse(XMMatrixTranspose(Upper3x3(M)), M.r[3]);
+	case MatrixKind::UniformScale:
+		return AffineInverse(XMMatrixTranspose(UniformScaleInverseTranspose(M)), M.r[3]);
+	case MatrixKind::Affine:
+		return AffineInverse(XMMatrixTranspose(AffineInverseTranspose(M)), M.r[3]);
+	case MatrixKind::Perspective:
+		return PerspectiveInverse(M);
+	default:
+		XMVECTOR det = XMMatrixDeterminant(M);
+		return XMMatrixInverse(&det, M);
+	}
+}
 
-	// Keep trying until we get a point on/in the hemisphere.
-	while(true)
+XMMATRIX MathHelper::InverseTranspose(CXMMATRIX M, MatrixKind kind)
+{
+	switch(kind)
 	{
-		// Generate random point in the cube [-1,1]^3.
-		XMVECTOR v = XMVectorSet(MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f), 0.0f);
+	case MatrixKind::Rigid:
+		return Upper3x3(M);
+	case MatrixKind::UniformScale:
+		return UniformScaleInverseTranspose(M);
+	case MatrixKind::Affine:
+		return AffineInverseTranspose(M);
+	default:
+		// Inverse-transpose is just applied to normals.  So zero out 
+		// translation row so that it doesn't get into our inverse-transpose
+		// calculation--we don't want the inverse-transpose of the translation.
+		XMMATRIX A = M;
+		A.r[3] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
 
-		// Ignore points outside the unit sphere in order to get an even distribution 
-		// over the unit sphere.  Otherwise points will clump more on the sphere near 
-		// the corners of the cube.
+		XMVECTOR det = XMMatrixDeterminant(A);
+		return XMMatrixTranspose(XMMatrixInverse(&det, A));
+	}
+}
 
-		if( XMVector3Greater( XMVector3LengthSq(v), One) )
-			continue;
+void MathHelper::ExtractFrustumPlanes(CXMMATRIX M, XMFLOAT4 planes[6])
+{
+	// With row vectors, a point p is inside the clip volume when
+	//   -w <= x <= w, -w <= y <= w, 0 <= z <= w
+	// where x = p.col0, y = p.col1, z = p.col2 and w = p.col3.  Each inequality
+	// is a plane whose coefficients are a sum/difference of columns of M.
+	XMMATRIX T = XMMatrixTranspose(M);
+
+	XMVECTOR p[6] =
+	{
+		T.r[3] + T.r[0], // left
+		T.r[3] - T.r[0], // right
+		T.r[3] + T.r[1], // bottom
+		T.r[3] - T.r[1], // top
+		T.r[2],          // near
+		T.r[3] - T.r[2]  // far
+	};
 
-		return XMVector3Normalize(v);
+	for(int i = 0; i < 6; ++i)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(p[i]));
+}
+
+void MathHelper::ComputeBounds(const XMFLOAT3* positions, size_t stride, size_t count,
+	BoundingBox& box, BoundingSphere& sphere)
+{
+	if(count == 0)
+	{
+		box.Center = box.Extents = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		sphere.Center = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		sphere.Radius = 0.0f;
+		return;
 	}
+
+	const std::uint8_t* p = reinterpret_cast<const std::uint8_t*>(positions);
+
+	// All but the last point can use wide loads when the stride has room for a
+	// fourth float; the last one might end the buffer.
+	size_t wideCount = stride >= sizeof(XMFLOAT4) ? count - 1 : 0;
+	const std::uint8_t* last = p + wideCount*stride;
+
+	XMVECTOR vMin = XMLoadFloat3(positions);
+	XMVECTOR vMax = vMin;
+	AccumulateMinMax<true>(p, stride, wideCount, vMin, vMax);
+	AccumulateMinMax<false>(last, stride, count - wideCount, vMin, vMax);
+
+	XMVECTOR center = 0.5f*(vMin + vMax);
+	XMStoreFloat3(&box.Center, center);
+	XMStoreFloat3(&box.Extents, 0.5f*(vMax - vMin));
+
+	XMVECTOR maxDistSq = XMVectorZero();
+	AccumulateMaxDistanceSq<true>(p, stride, wideCount, center, maxDistSq);
+	AccumulateMaxDistanceSq<false>(last, stride, count - wideCount, center, maxDistSq);
+
+	sphere.Center = box.Center;
+	sphere.Radius = XMVectorGetX(XMVectorSqrt(maxDistSq));
+}
+
+XMVECTOR MathHelper::RandUnitVec3()
+{
+	return ThreadRandom().NextUnitVec3();
 }
 
 XMVECTOR MathHelper::RandHemisphereUnitVec3(XMVECTOR n)
 {
-	XMVECTOR One  = XMVectorSet(1.0f, 1.0f, 1.0f, 1.0f);
-	XMVECTOR Zero = XMVectorZero();
+	return ThreadRandom().NextHemisphereUnitVec3(n);
+}
+
+RandomStream::RandomStream(std::uint64_t seed, std::uint64_t stream)
+{
+	Seed(seed, stream);
+}
+
+void RandomStream::Seed(std::uint64_t seed, std::uint64_t stream)
+{
+	std::uint64_t x = seed ^ (stream * 0xD1342543DE82EF95ull);
+
+	SeedState(x, mState, 1);
+	for(int lane = 0; lane < 4; ++lane)
+		SeedState(x, &mLanes[0][lane], 4);
+}
+
+std::uint32_t RandomStream::NextUInt()
+{
+	const std::uint32_t result = mState[0] + mState[3];
+	const std::uint32_t t = mState[1] << 9;
+
+	mState[2] ^= mState[0];
+	mState[3] ^= mState[1];
+	mState[1] ^= mState[2];
+	mState[0] ^= mState[3];
+	mState[2] ^= t;
+	mState[3] = Rotl(mState[3], 11);
+
+	return result;
+}
+
+float RandomStream::NextFloat()
+{
+	return (NextUInt() >> 8) * UIntToUnitFloat;
+}
+
+float RandomStream::NextFloat(float a, float b)
+{
+	return a + NextFloat()*(b - a);
+}
+
+int RandomStream::NextInt(int a, int b)
+{
+	// Scale into the range with a multiply instead of %, which is slow and favors
+	// small values.  The bias left is below range/2^32.
+	std::uint64_t range = (std::uint64_t)((std::int64_t)b - a) + 1;
+	return (int)((std::int64_t)a + (std::int64_t)((NextUInt() * range) >> 32));
+}
+
+XMVECTOR RandomStream::NextUnitVec3()
+{
+	// See UnitVectorsFromUniform.
+	float z = 1.0f - 2.0f*NextFloat();
+	float r = sqrtf(fmaxf(1.0f - z*z, 0.0f));
+	float phi = XM_2PI*NextFloat();
+
+	return XMVectorSet(r*cosf(phi), r*sinf(phi), z, 0.0f);
+}
+
+XMVECTOR RandomStream::NextHemisphereUnitVec3(FXMVECTOR n)
+{
+	XMVECTOR v = NextUnitVec3();
+	XMVECTOR d = XMVectorMin(XMVector3Dot(v, n), XMVectorZero());
+
+	return v - 2.0f*d*n;
+}
+
+void RandomStream::NextLaneFloats(float out[4])
+{
+#if defined(MATHHELPER_SSE2)
+	__m128i s0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mLanes[0]));
+	__m128i s1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mLanes[1]));
+	__m128i s2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mLanes[2]));
+	__m128i s3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(mLanes[3]));
+
+	__m128i result = _mm_add_epi32(s0, s3);
+	__m128i t = _mm_slli_epi32(s1, 9);
+
+	s2 = _mm_xor_si128(s2, s0);
+	s3 = _mm_xor_si128(s3, s1);
+	s1 = _mm_xor_si128(s1, s2);
+	s0 = _mm_xor_si128(s0, s3);
+	s2 = _mm_xor_si128(s2, t);
+	s3 = _mm_or_si128(_mm_slli_epi32(s3, 11), _mm_srli_epi32(s3, 21));
+
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(mLanes[0]), s0);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(mLanes[1]), s1);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(mLanes[2]), s2);
+	_mm_storeu_si128(reinterpret_cast<__m128i*>(mLanes[3]), s3);
+
+	// After the shift the values fit in a signed int, so the signed conversion is exact.
+	__m128 f = _mm_cvtepi32_ps(_mm_srli_epi32(result, 8));
+	_mm_storeu_ps(out, _mm_mul_ps(f, _mm_set1_ps(UIntToUnitFloat)));
+#else
+	for(int lane = 0; lane < 4; ++lane)
+	{
+		std::uint32_t& s0 = mLanes[0][lane];
+		std::uint32_t& s1 = mLanes[1][lane];
+		std::uint32_t& s2 = mLanes[2][lane];
+		std::uint32_t& s3 = mLanes[3][lane];
+
+		const std::uint32_t result = s0 + s3;
+		const std::uint32_t t = s1 << 9;
+
+		s2 ^= s0;
+		s3 ^= s1;
+		s1 ^= s2;
+		s0 ^= s3;
+		s2 ^= t;
+		s3 = Rotl(s3, 11);
+
+		out[lane] = (result >> 8) * UIntToUnitFloat;
+	}
+#endif
+}
+
+void RandomStream::FillFloats(float* out, size_t count, float a, float b)
+{
+	const float scale = b - a;
+
+	float f[4];
+	for(size_t i = 0; i < count; i += 4)
+	{
+		NextLaneFloats(f);
 
-	// Keep trying until we get a point on/in the hemisphere.
-	while(true)
+		size_t n = count - i < 4 ? count - i : 4;
+		for(size_t j = 0; j < n; ++j)
+			out[i + j] = a + f[j]*scale;
+	}
+}
+
+void RandomStream::FillUnitVec3(XMFLOAT3* out, size_t count)
+{
+	XMFLOAT4 u, v;
+	for(size_t i = 0; i < count; i += 4)
 	{
-		// Generate random point in the cube [-1,1]^3.
-		XMVECTOR v = XMVectorSet(MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f), MathHelper::RandF(-1.0f, 1.0f), 0.0f);
+		NextLaneFloats(&u.x);
+		NextLaneFloats(&v.x);
 
-		// Ignore points outside the unit sphere in order to get an even distribution 
-		// over the unit sphere.  Otherwise points will clump more on the sphere near 
-		// the corners of the cube.
-		
-		if( XMVector3Greater( XMVector3LengthSq(v), One) )
-			continue;
+		XMVECTOR x, y, z;
+		UnitVectorsFromUniform(XMLoadFloat4(&u), XMLoadFloat4(&v), x, y, z);
+		StoreSoA(&out[i], count - i < 4 ? count - i : 4, x, y, z);
+	}
+}
 
-		// Ignore points in the bottom hemisphere.
-		if( XMVector3Less( XMVector3Dot(n, v), Zero ) )
-			continue;
+void RandomStream::FillHemisphereUnitVec3(XMFLOAT3* out, size_t count, FXMVECTOR n)
+{
+	XMFLOAT4 u, v;
+	for(size_t i = 0; i < count; i += 4)
+	{
+		NextLaneFloats(&u.x);
+		NextLaneFloats(&v.x);
 
-		return XMVector3Normalize(v);
+		XMVECTOR x, y, z;
+		UnitVectorsFromUniform(XMLoadFloat4(&u), XMLoadFloat4(&v), x, y, z);
+		MirrorToHemisphere(n, x, y, z);
+		StoreSoA(&out[i], count - i < 4 ? count - i : 4, x, y, z);
 	}
-}
\ No newline at end of file
+}
+
+RandomStream& MathHelper::ThreadRandom()
+{
+	static std::atomic<std::uint64_t> nextStream(0);
+
+	thread_local RandomStream random(0, nextStream++);
+	return random;
+}
@@ -6,17 +6,86 @@
 
 #pragma once
 
+// Keep windows.h from defining min and max macros, which break std::min and std::max.
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include <Windows.h>
 #include <DirectXMath.h>
+#include <DirectXCollision.h>
 #include <cstdint>
 
+// xoshiro128+ pseudo-random number generator (Blackman and Vigna).  Each (seed,
+// stream) pair gives its own sequence, so worker threads can each be handed a
+// reproducible stream.  A RandomStream is not thread safe; use one per thread, e.g.
+// MathHelper::ThreadRandom().
+//
+// The Fill functions draw from four interleaved generators kept next to the main
+// one, so four values are made per step in SIMD registers.
+class RandomStream
+{
+public:
+	explicit RandomStream(std::uint64_t seed = 0, std::uint64_t stream = 0);
+
+	void Seed(std::uint64_t seed, std::uint64_t stream = 0);
+
+	std::uint32_t NextUInt();
+
+	// Returns random float in [0, 1).
+	float NextFloat();
+
+	// Returns random float in [a, b).
+	float NextFloat(float a, float b);
+
+	// Returns random int in [a, b].
+	int NextInt(int a, int b);
+
+	// Uniformly distributed unit vectors.  The sphere's area is sampled directly
+	// (uniform height, uniform angle), so no samples are thrown away.
+	DirectX::XMVECTOR NextUnitVec3();
+	DirectX::XMVECTOR NextHemisphereUnitVec3(DirectX::FXMVECTOR n);
+
+	void FillFloats(float* out, size_t count, float a = 0.0f, float b = 1.0f);
+	void FillUnitVec3(DirectX::XMFLOAT3* out, size_t count);
+
+	// Unit vectors on the hemisphere around the unit vector n.  Samples from the
+	// other half are mirrored, which keeps the distribution uniform.
+	void FillHemisphereUnitVec3(DirectX::XMFLOAT3* out, size_t count, DirectX::FXMVECTOR n);
+
+private:
+	// Four floats in [0, 1), one from each lane generator.
+	void NextLaneFloats(float out[4]);
+
+	std::uint32_t mState[4];
+
+	// The lane generators, one per column: mLanes[i][lane] is word i of that lane.
+	std::uint32_t mLanes[4][4];
+};
+
+// What is known about a matrix, so its inverse can skip the general 4x4 path.
+// Affine, UniformScale and Rigid are each a special case of the one before.
+enum class MatrixKind
+{
+	General,      // Any invertible matrix.
+	Affine,       // The fourth column is (0, 0, 0, 1).
+	UniformScale, // Affine, with a rotation and one scale factor in the upper 3x3.
+	Rigid,        // Affine, with only a rotation in the upper 3x3.
+	Perspective   // Of the form made by XMMatrixPerspective[FovLH|OffCenterLH].
+};
+
 class MathHelper
 {
 public:
+	///<summary>
+	/// Generator of the calling thread.  Threads get consecutive streams of the same
+	/// seed in the order they first call this.
+	///</summary>
+	static RandomStream& ThreadRandom();
+
 	// Returns random float in [0, 1).
 	static float RandF()
 	{
-		return (float)(rand()) / (float)RAND_MAX;
+		return ThreadRandom().NextFloat();
 	}
 
 	// Returns random float in [a, b).
@@ -27,7 +96,7 @@ public:
 
     static int Rand(int a, int b)
     {
-        return a + rand() % ((b - a) + 1);
+        return ThreadRandom().NextInt(a, b);
     }
 
 	template<typename T>
@@ -66,17 +135,21 @@ public:
 			1.0f);
 	}
 
-    static DirectX::XMMATRIX InverseTranspose(DirectX::CXMMATRIX M)
-	{
-		// Inverse-transpose is just applied to normals.  So zero out 
-		// translation row so that it doesn't get into our inverse-transpose
-		// calculation--we don't want the inverse-transpose of the translation.
-        DirectX::XMMATRIX A = M;
-        A.r[3] = DirectX::XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
-
-        DirectX::XMVECTOR det = DirectX::XMMatrixDeterminant(A);
-        return DirectX::XMMatrixTranspose(DirectX::XMMatrixInverse(&det, A));
-	}
+	///<summary>
+	/// Inverse of M, using the shortcut for its kind.  The rigid, uniform scale and
+	/// perspective inverses are exact rearrangements of M; only the general one
+	/// needs a 4x4 determinant.
+	///</summary>
+	static DirectX::XMMATRIX Inverse(DirectX::CXMMATRIX M, MatrixKind kind);
+
+	///<summary>
+	/// Inverse-transpose of M with the translation zeroed out, for transforming
+	/// normals.  Without a kind M is inverted as a general matrix; pass Affine for
+	/// world matrices, whose 3x3 inverse is three cross products over the
+	/// determinant.
+	///</summary>
+	static DirectX::XMMATRIX InverseTranspose(DirectX::CXMMATRIX M,
+		MatrixKind kind = MatrixKind::General);
 
     static DirectX::XMFLOAT4X4 Identity4x4()
     {
@@ -89,6 +162,19 @@ public:
         return I;
     }
 
+	// Extracts the six clip planes (left, right, bottom, top, near, far) of the 
+	// frustum described by a view-projection matrix.  The planes are normalized
+	// and point into the frustum.  Passing World*ViewProj gives the planes in the
+	// object's local space.
+	static void ExtractFrustumPlanes(DirectX::CXMMATRIX M, DirectX::XMFLOAT4 planes[6]);
+
+	// Computes the axis-aligned box and a bounding sphere of count points stored 
+	// stride bytes apart, e.g. the Position member of an array of vertices.  The
+	// sphere is centered on the box and reaches the farthest point, which is 
+	// tighter than the sphere around the box.
+	static void ComputeBounds(const DirectX::XMFLOAT3* positions, size_t stride, size_t count,
+		DirectX::BoundingBox& box, DirectX::BoundingSphere& sphere);
+
     static DirectX::XMVECTOR RandUnitVec3();
     static DirectX::XMVECTOR RandHemisphereUnitVec3(DirectX::XMVECTOR n);
 
@@ -98,3 +184,45 @@ public:
 
 };
 
+// A matrix tagged with its kind, so that inverting it takes the fast path without
+// every caller having to remember what the matrix is made of.
+struct TaggedMatrix
+{
+	TaggedMatrix() = default;
+	TaggedMatrix(DirectX::CXMMATRIX M, MatrixKind kind)
+		: Kind(kind)
+	{
+		DirectX::XMStoreFloat4x4(&Matrix, M);
+	}
+
+	DirectX::XMMATRIX Load()const
+	{
+		return DirectX::XMLoadFloat4x4(&Matrix);
+	}
+
+	// The inverse keeps the kind, except that a perspective inverse is general.
+	TaggedMatrix Inverse()const
+	{
+		return TaggedMatrix(MathHelper::Inverse(Load(), Kind),
+			Kind == MatrixKind::Perspective ? MatrixKind::General : Kind);
+	}
+
+	DirectX::XMMATRIX InverseTranspose()const
+	{
+		return MathHelper::InverseTranspose(Load(), Kind);
+	}
+
+	DirectX::XMFLOAT4X4 Matrix = MathHelper::Identity4x4();
+	MatrixKind Kind = MatrixKind::Rigid;
+};
+
+// The product is of the weaker kind of the two, and general once a perspective
+// is involved.
+inline TaggedMatrix operator*(const TaggedMatrix& a, const TaggedMatrix& b)
+{
+	MatrixKind kind = a.Kind < b.Kind ? a.Kind : b.Kind;
+	if(a.Kind == MatrixKind::Perspective || b.Kind == MatrixKind::Perspective)
+		kind = MatrixKind::General;
+
+	return TaggedMatrix(DirectX::XMMatrixMultiply(a.Load(), b.Load()), kind);
+}
@@ -0,0 +1,273 @@
+//***************************************************************************************
+// MeshFile.cpp
+//***************************************************************************************
+
+#include "MeshFile.h"
+#include "MappedFile.h"
+#include <atomic>
+#include <climits>
+#include <cstring>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = std::uint32_t;
+	using uint64 = std::uint64_t;
+
+	// Bump FileVersion whenever the layout below changes.
+	const uint32 FileMagic   = 0x4d4f4547; // "GEOM"
+	const uint32 FileVersion = 1;
+
+	// Buffers start on 16-byte boundaries within the file.
+	const uint64 DataAlignment = 16;
+
+	// File layout: FileHeader, SubmeshCount FileSubmeshes, the names, then the
+	// vertex and index buffers.
+	struct FileHeader
+	{
+		uint32 Magic;
+		uint32 Version;
+		uint32 ContentVersion;
+		uint32 VertexByteStride;
+		uint32 IndexFormat;
+		uint32 SubmeshCount;
+		uint64 VertexOffset;
+		uint64 VertexBufferByteSize;
+		uint64 IndexOffset;
+		uint64 IndexBufferByteSize;
+		uint64 NameOffset;
+		uint32 NameLength; // Of the geometry name, which starts at NameOffset.
+		uint32 Pad;
+	};
+
+	struct FileSubmesh
+	{
+		uint32 IndexCount;
+		uint32 StartIndexLocation;
+		std::int32_t BaseVertexLocation;
+		uint32 NameOffset; // Relative to FileHeader::NameOffset.
+		uint32 NameLength;
+		XMFLOAT3 BoundsCenter;
+		XMFLOAT3 BoundsExtents;
+		XMFLOAT4X4 Transform;
+		uint32 Pad;
+	};
+
+	uint64 AlignUp(uint64 offset)
+	{
+		return (offset + DataAlignment - 1) & ~(DataAlignment - 1);
+	}
+
+	bool InRange(uint64 offset, uint64 size, uint64 fileSize)
+	{
+		return offset <= fileSize && size <= fileSize - offset;
+	}
+
+	// A blob that views part of a mapped file instead of owning a copy.  The
+	// memory is read-only.
+	class MappedBlob : public ID3DBlob
+	{
+	public:
+		MappedBlob(std::shared_ptr<MappedFile> file, uint64 offset, uint64 size)
+			: mFile(std::move(file)), mOffset(offset), mSize(size)
+		{
+		}
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** object)override
+		{
+			if(object == nullptr)
+				return E_POINTER;
+
+			if(riid == __uuidof(IUnknown) || riid == __uuidof(ID3DBlob))
+			{
+				*object = static_cast<ID3DBlob*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*object = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		ULONG STDMETHODCALLTYPE AddRef()override
+		{
+			return ++mRefCount;
+		}
+
+		ULONG STDMETHODCALLTYPE Release()override
+		{
+			ULONG count = --mRefCount;
+			if(count == 0)
+				delete this;
+
+			return count;
+		}
+
+		LPVOID STDMETHODCALLTYPE GetBufferPointer()override
+		{
+			return const_cast<std::uint8_t*>(mFile->GetData() + mOffset);
+		}
+
+		SIZE_T STDMETHODCALLTYPE GetBufferSize()override
+		{
+			return static_cast<SIZE_T>(mSize);
+		}
+
+	private:
+		std::atomic<ULONG> mRefCount{ 1 };
+		std::shared_ptr<MappedFile> mFile;
+		uint64 mOffset = 0;
+		uint64 mSize = 0;
+	};
+}
+
+bool MeshFile::Save(const std::wstring& filename, uint32 contentVersion,
+	const MeshGeometry& geo, const TransformMap* transforms)
+{
+	if(geo.VertexBufferCPU == nullptr || geo.IndexBufferCPU == nullptr)
+		return false;
+
+	std::string names = geo.Name;
+
+	std::vector<FileSubmesh> submeshes;
+	submeshes.reserve(geo.DrawArgs.size());
+	for(auto& e : geo.DrawArgs)
+	{
+		FileSubmesh submesh = {};
+		submesh.IndexCount = e.second.IndexCount;
+		submesh.StartIndexLocation = e.second.StartIndexLocation;
+		submesh.BaseVertexLocation = e.second.BaseVertexLocation;
+		submesh.NameOffset = (uint32)names.size();
+		submesh.NameLength = (uint32)e.first.size();
+		submesh.BoundsCenter = e.second.Bounds.Center;
+		submesh.BoundsExtents = e.second.Bounds.Extents;
+		submesh.Transform = MathHelper::Identity4x4();
+
+		if(transforms != nullptr)
+		{
+			auto it = transforms->find(e.first);
+			if(it != transforms->end())
+				submesh.Transform = it->second;
+		}
+
+		names += e.first;
+		submeshes.push_back(submesh);
+	}
+
+	uint64 vertexBytes = geo.VertexBufferCPU->GetBufferSize();
+	uint64 indexBytes = geo.IndexBufferCPU->GetBufferSize();
+
+	FileHeader header = {};
+	header.Magic = FileMagic;
+	header.Version = FileVersion;
+	header.ContentVersion = contentVersion;
+	header.VertexByteStride = geo.VertexByteStride;
+	header.IndexFormat = (uint32)geo.IndexFormat;
+	header.SubmeshCount = (uint32)submeshes.size();
+	header.NameOffset = sizeof(FileHeader) + submeshes.size()*sizeof(FileSubmesh);
+	header.NameLength = (uint32)geo.Name.size();
+	header.VertexOffset = AlignUp(header.NameOffset + names.size());
+	header.VertexBufferByteSize = vertexBytes;
+	header.IndexOffset = AlignUp(header.VertexOffset + vertexBytes);
+	header.IndexBufferByteSize = indexBytes;
+
+	std::vector<std::uint8_t> file((size_t)(header.IndexOffset + indexBytes), 0);
+	std::memcpy(file.data(), &header, sizeof(header));
+	if(!submeshes.empty())
+		std::memcpy(&file[sizeof(header)], submeshes.data(), submeshes.size()*sizeof(FileSubmesh));
+	std::memcpy(&file[(size_t)header.NameOffset], names.data(), names.size());
+	std::memcpy(&file[(size_t)header.VertexOffset], geo.VertexBufferCPU->GetBufferPointer(), (size_t)vertexBytes);
+	std::memcpy(&file[(size_t)header.IndexOffset], geo.IndexBufferCPU->GetBufferPointer(), (size_t)indexBytes);
+
+	return MappedFile::Write(filename, file.data(), file.size());
+}
+
+bool MeshFile::Load(const std::wstring& filename, uint32 contentVersion,
+	MeshGeometry& geo, TransformMap* transforms)
+{
+	auto file = std::make_shared<MappedFile>();
+	if(!file->Open(filename))
+		return false;
+
+	const std::uint8_t* data = file->GetData();
+	const uint64 size = file->GetSize();
+
+	FileHeader header;
+	if(size < sizeof(header))
+		return false;
+
+	std::memcpy(&header, data, sizeof(header));
+
+	if(header.Magic != FileMagic ||
+	   header.Version != FileVersion ||
+	   header.ContentVersion != contentVersion ||
+	   header.SubmeshCount > (size - sizeof(header)) / sizeof(FileSubmesh))
+		return false;
+
+	// Never trust offsets read from disk.
+	uint64 namesEnd = header.VertexOffset;
+	if(!InRange(header.NameOffset, header.NameLength, size) ||
+	   header.VertexOffset < header.NameOffset ||
+	   !InRange(header.VertexOffset, header.VertexBufferByteSize, size) ||
+	   !InRange(header.IndexOffset, header.IndexBufferByteSize, size) ||
+	   header.VertexBufferByteSize > UINT_MAX || header.IndexBufferByteSize > UINT_MAX)
+		return false;
+
+	// The vertex buffer must hold whole vertices.
+	if(header.VertexByteStride == 0 || header.VertexBufferByteSize % header.VertexByteStride != 0)
+		return false;
+
+	DXGI_FORMAT indexFormat = (DXGI_FORMAT)header.IndexFormat;
+	if(indexFormat != DXGI_FORMAT_R16_UINT && indexFormat != DXGI_FORMAT_R32_UINT)
+		return false;
+
+	uint64 indexSize = indexFormat == DXGI_FORMAT_R16_UINT ? 2 : 4;
+	uint64 indexCount = header.IndexBufferByteSize / indexSize;
+
+	std::unordered_map<std::string, SubmeshGeometry> drawArgs;
+	TransformMap submeshTransforms;
+
+	for(uint32 i = 0; i < header.SubmeshCount; ++i)
+	{
+		FileSubmesh fileSubmesh;
+		std::memcpy(&fileSubmesh, data + sizeof(header) + i*sizeof(FileSubmesh), sizeof(fileSubmesh));
+
+		uint64 nameOffset = header.NameOffset + fileSubmesh.NameOffset;
+		if(nameOffset + fileSubmesh.NameLength > namesEnd ||
+		   (uint64)fileSubmesh.StartIndexLocation + fileSubmesh.IndexCount > indexCount)
+			return false;
+
+		std::string name(reinterpret_cast<const char*>(data + nameOffset), fileSubmesh.NameLength);
+
+		SubmeshGeometry submesh;
+		submesh.IndexCount = fileSubmesh.IndexCount;
+		submesh.StartIndexLocation = fileSubmesh.StartIndexLocation;
+		submesh.BaseVertexLocation = fileSubmesh.BaseVertexLocation;
+		submesh.Bounds.Center = fileSubmesh.BoundsCenter;
+		submesh.Bounds.Extents = fileSubmesh.BoundsExtents;
+
+		drawArgs[name] = submesh;
+		submeshTransforms[name] = fileSubmesh.Transform;
+	}
+
+	geo.Name.assign(reinterpret_cast<const char*>(data + header.NameOffset), header.NameLength);
+
+	// The blobs share the mapping, which is closed when the last one goes away.
+	geo.VertexBufferCPU.Attach(new MappedBlob(file, header.VertexOffset, header.VertexBufferByteSize));
+	geo.IndexBufferCPU.Attach(new MappedBlob(file, header.IndexOffset, header.IndexBufferByteSize));
+
+	geo.VertexByteStride = header.VertexByteStride;
+	geo.VertexBufferByteSize = (UINT)header.VertexBufferByteSize;
+	geo.IndexFormat = indexFormat;
+	geo.IndexBufferByteSize = (UINT)header.IndexBufferByteSize;
+	geo.DrawArgs = std::move(drawArgs);
+
+	if(transforms != nullptr)
+	{
+		for(auto& e : submeshTransforms)
+			(*transforms)[e.first] = e.second;
+	}
+
+	return true;
+}
@@ -0,0 +1,42 @@
+//***************************************************************************************
+// MeshFile.h
+//
+// Binary file holding everything a MeshGeometry needs on the CPU side: the vertex
+// and index buffers, their formats, and the submesh table with bounds.  Loading
+// maps the file and hands out blobs that point into the mapping, so nothing is
+// parsed or copied and the buffers are read straight from the page cache by the
+// GPU upload.  Startup cost is then independent of how complex the meshes are.
+//
+// Each submesh can also carry a transform, for data the app folds into its world
+// matrices such as a dequantization.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class MeshFile
+{
+public:
+
+	using TransformMap = std::unordered_map<std::string, DirectX::XMFLOAT4X4>;
+
+	///<summary>
+	/// Writes the CPU side of geo to filename.  contentVersion is stored as is; bump
+	/// it whenever the vertex format or the generated meshes change so Load rejects
+	/// old files.  Submeshes named in transforms get that transform saved with them.
+	///</summary>
+	static bool Save(const std::wstring& filename, std::uint32_t contentVersion,
+		const MeshGeometry& geo, const TransformMap* transforms = nullptr);
+
+	///<summary>
+	/// Maps filename and fills in the name, CPU buffers, formats and DrawArgs of geo.
+	/// VertexBufferCPU and IndexBufferCPU point into the read-only mapping, which
+	/// stays open while either blob is referenced.  The submesh transforms are added
+	/// to transforms.  Returns false if the file is missing, damaged, or has another
+	/// format or content version; a file whose buffers or submeshes do not fit its
+	/// size, or whose vertex buffer is not a whole number of vertices, is damaged.
+	///</summary>
+	static bool Load(const std::wstring& filename, std::uint32_t contentVersion,
+		MeshGeometry& geo, TransformMap* transforms = nullptr);
+};
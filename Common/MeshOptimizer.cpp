@@ -0,0 +1,426 @@
+//***************************************************************************************
+// MeshOptimizer.cpp
+//***************************************************************************************
+
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = MeshOptimizer::uint32;
+
+	// Tuning values from Forsyth's "Linear-Speed Vertex Cache Optimisation".
+	const uint32 CacheSize         = 32;
+	const float  CacheDecayPower   = 1.5f;
+	const float  LastTriScore      = 0.75f;
+	const float  ValenceBoostScale = 2.0f;
+	const float  ValenceBoostPower = 0.5f;
+
+	const uint32 InvalidTriangle   = 0xffffffff;
+
+	bool WithinTolerance(const XMFLOAT3& a, const XMFLOAT3& b, float tolerance)
+	{
+		return std::fabs(a.x - b.x) <= tolerance &&
+			   std::fabs(a.y - b.y) <= tolerance &&
+			   std::fabs(a.z - b.z) <= tolerance;
+	}
+
+	bool WithinTolerance(const XMFLOAT2& a, const XMFLOAT2& b, float tolerance)
+	{
+		return std::fabs(a.x - b.x) <= tolerance &&
+			   std::fabs(a.y - b.y) <= tolerance;
+	}
+
+	bool CanWeld(const GeometryGenerator::Vertex& a, const GeometryGenerator::Vertex& b,
+				 const MeshOptimizer::WeldTolerance& tolerance)
+	{
+		return WithinTolerance(a.Position, b.Position, tolerance.Position) &&
+			   WithinTolerance(a.Normal, b.Normal, tolerance.Normal) &&
+			   WithinTolerance(a.TangentU, b.TangentU, tolerance.TangentU) &&
+			   WithinTolerance(a.TexC, b.TexC, tolerance.TexC);
+	}
+
+	// Spatial hash from Teschner et al., "Optimized Spatial Hashing for Collision
+	// Detection of Deformable Objects".  Cells that collide just share a bucket.
+	std::uint64_t HashCell(std::int64_t x, std::int64_t y, std::int64_t z)
+	{
+		return ((std::uint64_t)x*73856093u) ^ ((std::uint64_t)y*19349663u) ^ ((std::uint64_t)z*83492791u);
+	}
+
+	float VertexScore(int cachePosition, uint32 remainingValence)
+	{
+		// Vertices with no triangles left are never needed again.
+		if(remainingValence == 0)
+			return -1.0f;
+
+		float score = 0.0f;
+		if(cachePosition >= 0)
+		{
+			// The vertices of the last triangle get a fixed score so that the
+			// next triangle does not simply reuse the same edge every time.
+			if(cachePosition < 3)
+			{
+				score = LastTriScore;
+			}
+			else
+			{
+				float scaler = 1.0f / (CacheSize - 3);
+				score = powf(1.0f - (cachePosition - 3)*scaler, CacheDecayPower);
+			}
+		}
+
+		// Boost vertices with few triangles left so that they get finished off
+		// rather than leaving lone triangles behind.
+		score += ValenceBoostScale * powf((float)remainingValence, -ValenceBoostPower);
+
+		return score;
+	}
+}
+
+MeshOptimizer::VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const uint32* indices, size_t indexCount,
+																  uint32 vertexCount, uint32 cacheSize)
+{
+	VertexCacheStats stats;
+	if(indexCount < 3 || vertexCount == 0)
+		return stats;
+
+	// Timestamp of the miss that put each vertex in the cache.  A vertex is a
+	// hit when it was inserted within the last cacheSize misses.
+	std::vector<uint32> insertedAt(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+
+	uint32 misses = 0;
+	uint32 uniqueVertices = 0;
+	for(size_t i = 0; i < indexCount; ++i)
+	{
+		uint32 v = indices[i];
+
+		if(!referenced[v])
+		{
+			referenced[v] = true;
+			++uniqueVertices;
+		}
+
+		if(insertedAt[v] == 0 || misses + 1 - insertedAt[v] > cacheSize)
+		{
+			++misses;
+			insertedAt[v] = misses;
+		}
+	}
+
+	stats.ACMR = (float)misses / (float)(indexCount / 3);
+	stats.ATVR = (float)misses / (float)uniqueVertices;
+
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(uint32* indices, size_t indexCount, uint32 vertexCount)
+{
+	uint32 triCount = (uint32)(indexCount / 3);
+	if(triCount == 0)
+		return;
+
+	//
+	// Build vertex to triangle adjacency.
+	//
+
+	std::vector<uint32> valence(vertexCount, 0);
+	for(size_t i = 0; i < triCount*3; ++i)
+		valence[indices[i]]++;
+
+	std::vector<uint32> adjacencyOffset(vertexCount + 1, 0);
+	for(uint32 v = 0; v < vertexCount; ++v)
+		adjacencyOffset[v+1] = adjacencyOffset[v] + valence[v];
+
+	std::vector<uint32> adjacency(triCount*3);
+	{
+		std::vector<uint32> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+		for(uint32 t = 0; t < triCount; ++t)
+		{
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				uint32 v = indices[t*3+k];
+				adjacency[fill[v]++] = t;
+			}
+		}
+	}
+
+	//
+	// Initial scores.
+	//
+
+	std::vector<int> cachePosition(vertexCount, -1);
+	std::vector<float> vertexScore(vertexCount);
+	for(uint32 v = 0; v < vertexCount; ++v)
+		vertexScore[v] = VertexScore(-1, valence[v]);
+
+	std::vector<float> triScore(triCount);
+	std::vector<bool> emitted(triCount, false);
+
+	uint32 bestTri = 0;
+	for(uint32 t = 0; t < triCount; ++t)
+	{
+		triScore[t] = vertexScore[indices[t*3+0]] + vertexScore[indices[t*3+1]] + vertexScore[indices[t*3+2]];
+
+		if(triScore[t] > triScore[bestTri])
+			bestTri = t;
+	}
+
+	//
+	// Greedily emit the best scoring triangle, then rescore the triangles that
+	// touch the vertices whose cache position changed.
+	//
+
+	std::vector<uint32> output(triCount*3);
+	std::vector<uint32> cache;
+	std::vector<uint32> newCache;
+	cache.reserve(CacheSize + 3);
+	newCache.reserve(CacheSize + 3);
+
+	uint32 inputCursor = 0;
+	for(uint32 outTri = 0; outTri < triCount; ++outTri)
+	{
+		// When no cached vertex has triangles left, continue with the next
+		// unemitted triangle in input order.
+		if(bestTri == InvalidTriangle)
+		{
+			while(emitted[inputCursor])
+				++inputCursor;
+
+			bestTri = inputCursor;
+		}
+
+		const uint32* tri = &indices[bestTri*3];
+		output[outTri*3+0] = tri[0];
+		output[outTri*3+1] = tri[1];
+		output[outTri*3+2] = tri[2];
+		emitted[bestTri] = true;
+
+		// Remove the triangle from the adjacency of its vertices.
+		for(uint32 k = 0; k < 3; ++k)
+		{
+			uint32 v = tri[k];
+
+			uint32* begin = &adjacency[adjacencyOffset[v]];
+			uint32* end = begin + valence[v];
+			uint32* it = std::find(begin, end, bestTri);
+			*it = *(end - 1);
+			valence[v]--;
+		}
+
+		// Move the triangle's vertices to the front of the LRU cache.
+		newCache.clear();
+		newCache.push_back(tri[0]);
+		newCache.push_back(tri[1]);
+		newCache.push_back(tri[2]);
+		for(uint32 v : cache)
+		{
+			if(v != tri[0] && v != tri[1] && v != tri[2])
+				newCache.push_back(v);
+		}
+
+		// Vertices pushed out of the cache lose their cache score.
+		for(size_t i = CacheSize; i < newCache.size(); ++i)
+		{
+			uint32 v = newCache[i];
+			cachePosition[v] = -1;
+			vertexScore[v] = VertexScore(-1, valence[v]);
+		}
+
+		if(newCache.size() > CacheSize)
+			newCache.resize(CacheSize);
+
+		for(size_t i = 0; i < newCache.size(); ++i)
+		{
+			uint32 v = newCache[i];
+			cachePosition[v] = (int)i;
+			vertexScore[v] = VertexScore((int)i, valence[v]);
+		}
+
+		cache.swap(newCache);
+
+		// Rescore the remaining triangles of the cached vertices and pick the best.
+		bestTri = InvalidTriangle;
+		float bestScore = -1.0f;
+		for(uint32 v : cache)
+		{
+			for(uint32 a = adjacencyOffset[v], e = adjacencyOffset[v] + valence[v]; a < e; ++a)
+			{
+				uint32 t = adjacency[a];
+				triScore[t] = vertexScore[indices[t*3+0]] + vertexScore[indices[t*3+1]] + vertexScore[indices[t*3+2]];
+
+				if(triScore[t] > bestScore)
+				{
+					bestScore = triScore[t];
+					bestTri = t;
+				}
+			}
+		}
+	}
+
+	// The greedy order is not always better than the one it started from, so an
+	// already optimized mesh could get slightly worse on every pass.  Keep
+	// whichever of the two the simulated cache prefers.
+	float before = AnalyzeVertexCache(indices, triCount*3, vertexCount).ACMR;
+	float after = AnalyzeVertexCache(output.data(), triCount*3, vertexCount).ACMR;
+	if(after <= before)
+		std::copy(output.begin(), output.end(), indices);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(GeometryGenerator::MeshData& meshData)
+{
+	const uint32 Unused = 0xffffffff;
+
+	std::vector<uint32> remap(meshData.Vertices.size(), Unused);
+	std::vector<GeometryGenerator::Vertex> vertices;
+	vertices.reserve(meshData.Vertices.size());
+
+	for(auto& index : meshData.Indices32)
+	{
+		if(remap[index] == Unused)
+		{
+			remap[index] = (uint32)vertices.size();
+			vertices.push_back(meshData.Vertices[index]);
+		}
+
+		index = remap[index];
+	}
+
+	meshData.Vertices.swap(vertices);
+}
+
+MeshOptimizer::OptimizeStats MeshOptimizer::Optimize(GeometryGenerator::MeshData& meshData)
+{
+	OptimizeStats stats;
+
+	uint32 vertexCount = (uint32)meshData.Vertices.size();
+	stats.Before = AnalyzeVertexCache(meshData.Indices32.data(), meshData.Indices32.size(), vertexCount);
+
+	OptimizeVertexCache(meshData.Indices32.data(), meshData.Indices32.size(), vertexCount);
+	OptimizeVertexFetch(meshData);
+
+	vertexCount = (uint32)meshData.Vertices.size();
+	stats.After = AnalyzeVertexCache(meshData.Indices32.data(), meshData.Indices32.size(), vertexCount);
+
+	return stats;
+}
+
+MeshOptimizer::uint32 MeshOptimizer::WeldVertices(GeometryGenerator::MeshData& meshData, const WeldTolerance& tolerance)
+{
+	const uint32 None = 0xffffffff;
+
+	const std::vector<GeometryGenerator::Vertex>& vertices = meshData.Vertices;
+	uint32 vertexCount = (uint32)vertices.size();
+
+	// With cells no smaller than the position tolerance, a vertex can only match
+	// vertices in its own cell or the 26 around it.
+	float cellSize = std::max(tolerance.Position, 1e-6f);
+	float invCellSize = 1.0f / cellSize;
+
+	// Each cell heads a list, linked through next, of the vertices kept in it.
+	std::unordered_map<std::uint64_t, uint32> cells;
+	cells.reserve(vertexCount);
+	std::vector<uint32> next(vertexCount, None);
+	std::vector<uint32> remap(vertexCount);
+
+	for(uint32 i = 0; i < vertexCount; ++i)
+	{
+		const GeometryGenerator::Vertex& v = vertices[i];
+
+		std::int64_t cx = (std::int64_t)std::floor(v.Position.x*invCellSize);
+		std::int64_t cy = (std::int64_t)std::floor(v.Position.y*invCellSize);
+		std::int64_t cz = (std::int64_t)std::floor(v.Position.z*invCellSize);
+
+		uint32 match = None;
+		for(int dz = -1; dz <= 1 && match == None; ++dz)
+		{
+			for(int dy = -1; dy <= 1 && match == None; ++dy)
+			{
+				for(int dx = -1; dx <= 1 && match == None; ++dx)
+				{
+					auto it = cells.find(HashCell(cx + dx, cy + dy, cz + dz));
+					if(it == cells.end())
+						continue;
+
+					for(uint32 k = it->second; k != None; k = next[k])
+					{
+						if(CanWeld(vertices[k], v, tolerance))
+						{
+							match = k;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		if(match != None)
+		{
+			remap[i] = match;
+			continue;
+		}
+
+		remap[i] = i;
+
+		auto inserted = cells.emplace(HashCell(cx, cy, cz), i);
+		if(!inserted.second)
+		{
+			next[i] = inserted.first->second;
+			inserted.first->second = i;
+		}
+	}
+
+	// Remap the triangles, dropping the ones that lost an edge.
+	std::vector<uint32> indices;
+	indices.reserve(meshData.Indices32.size());
+	for(size_t t = 0; t + 2 < meshData.Indices32.size(); t += 3)
+	{
+		uint32 i0 = remap[meshData.Indices32[t]];
+		uint32 i1 = remap[meshData.Indices32[t+1]];
+		uint32 i2 = remap[meshData.Indices32[t+2]];
+
+		if(i0 == i1 || i1 == i2 || i0 == i2)
+			continue;
+
+		indices.push_back(i0);
+		indices.push_back(i1);
+		indices.push_back(i2);
+	}
+
+	// Keep the referenced vertices in their original order.
+	std::vector<uint32> newIndex(vertexCount, None);
+	for(uint32 index : indices)
+		newIndex[index] = 0;
+
+	std::vector<GeometryGenerator::Vertex> welded;
+	welded.reserve(vertexCount);
+	for(uint32 i = 0; i < vertexCount; ++i)
+	{
+		if(newIndex[i] != None)
+		{
+			newIndex[i] = (uint32)welded.size();
+			welded.push_back(vertices[i]);
+		}
+	}
+
+	for(auto& index : indices)
+		index = newIndex[index];
+
+	uint32 removed = vertexCount - (uint32)welded.size();
+
+	meshData.Vertices.swap(welded);
+	meshData.Indices32.swap(indices);
+	GeometryGenerator::ComputeBounds(meshData);
+
+	return removed;
+}
+
+MeshOptimizer::uint32 MeshOptimizer::WeldVertices(GeometryGenerator::MeshData& meshData)
+{
+	return WeldVertices(meshData, WeldTolerance());
+}
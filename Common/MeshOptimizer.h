@@ -0,0 +1,83 @@
+//***************************************************************************************
+// MeshOptimizer.h
+//
+// Reorders the triangles and vertices of a MeshData for better use of the GPU's
+// post-transform vertex cache and of the memory caches during vertex fetch, and
+// welds duplicate vertices.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+
+class MeshOptimizer
+{
+public:
+
+	using uint32 = GeometryGenerator::uint32;
+
+	struct VertexCacheStats
+	{
+		// Average cache miss ratio: vertex shader invocations per triangle.
+		// 3.0 is the worst case and about 0.5 the best for large regular meshes.
+		float ACMR = 0.0f;
+
+		// Average transform to vertex ratio: vertex shader invocations per
+		// referenced vertex.  1.0 means every vertex is transformed only once.
+		float ATVR = 0.0f;
+	};
+
+	struct OptimizeStats
+	{
+		VertexCacheStats Before;
+		VertexCacheStats After;
+	};
+
+	// Largest per-component difference at which two vertices are still merged.  Use
+	// FLT_MAX to ignore an attribute other than the position, whose tolerance also
+	// sets the size of the hash grid cells.
+	struct WeldTolerance
+	{
+		float Position = 1e-5f;
+		float Normal = 1e-3f;
+		float TangentU = 1e-3f;
+		float TexC = 1e-5f;
+	};
+
+	///<summary>
+	/// Simulates a FIFO post-transform cache with the given number of entries over
+	/// the index list.  No GPU is needed, so this can be used to measure the effect
+	/// of the optimizations offline.
+	///</summary>
+	static VertexCacheStats AnalyzeVertexCache(const uint32* indices, size_t indexCount, uint32 vertexCount, uint32 cacheSize = 16);
+
+	///<summary>
+	/// Reorders the triangles of a triangle list for vertex cache reuse using Tom
+	/// Forsyth's linear-speed vertex cache optimization.  The vertices are not touched.
+	/// If the new order simulates worse than the given one, the given one is kept,
+	/// so optimizing an optimized mesh never makes it worse.
+	///</summary>
+	static void OptimizeVertexCache(uint32* indices, size_t indexCount, uint32 vertexCount);
+
+	///<summary>
+	/// Reorders the vertices so they appear in the order the index list first uses
+	/// them and remaps the indices.  Unreferenced vertices are removed.  Run this
+	/// after OptimizeVertexCache.
+	///</summary>
+	static void OptimizeVertexFetch(GeometryGenerator::MeshData& meshData);
+
+	///<summary>
+	/// Runs OptimizeVertexCache then OptimizeVertexFetch on meshData and returns the
+	/// simulated cache statistics from before and after.
+	///</summary>
+	static OptimizeStats Optimize(GeometryGenerator::MeshData& meshData);
+
+	///<summary>
+	/// Merges vertices whose attributes all lie within tolerance of an earlier vertex
+	/// and remaps the indices.  Candidates are found through a hash grid over the
+	/// positions, so this runs in expected linear time.  Triangles that collapse are
+	/// removed, as are unreferenced vertices.  Returns the number of vertices removed.
+	///</summary>
+	static uint32 WeldVertices(GeometryGenerator::MeshData& meshData, const WeldTolerance& tolerance);
+	static uint32 WeldVertices(GeometryGenerator::MeshData& meshData);
+};
@@ -0,0 +1,481 @@
+//***************************************************************************************
+// MeshSimplifier.cpp
+//***************************************************************************************
+
+#include "MeshSimplifier.h"
+#include "MeshOptimizer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <queue>
+#include <unordered_map>
+
+using namespace DirectX;
+
+namespace
+{
+	using uint32 = MeshSimplifier::uint32;
+
+	// Sum of the squared distances to a set of planes, stored as the upper half of
+	// the symmetric 4x4 matrix sum(w * p*p^T) together with the total weight, so
+	// that the error can be normalized back to a squared distance.
+	struct Quadric
+	{
+		double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+		double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+		double a22 = 0.0, a23 = 0.0;
+		double a33 = 0.0;
+		double Weight = 0.0;
+
+		void AddPlane(double a, double b, double c, double d, double w)
+		{
+			a00 += w*a*a; a01 += w*a*b; a02 += w*a*c; a03 += w*a*d;
+			a11 += w*b*b; a12 += w*b*c; a13 += w*b*d;
+			a22 += w*c*c; a23 += w*c*d;
+			a33 += w*d*d;
+			Weight += w;
+		}
+
+		void Add(const Quadric& q)
+		{
+			a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+			a11 += q.a11; a12 += q.a12; a13 += q.a13;
+			a22 += q.a22; a23 += q.a23;
+			a33 += q.a33;
+			Weight += q.Weight;
+		}
+
+		// Returns the weighted mean squared distance of p to the planes.
+		double Evaluate(const XMFLOAT3& p)const
+		{
+			double x = p.x, y = p.y, z = p.z;
+
+			double e = a00*x*x + 2.0*a01*x*y + 2.0*a02*x*z + 2.0*a03*x
+					 + a11*y*y + 2.0*a12*y*z + 2.0*a13*y
+					 + a22*z*z + 2.0*a23*z
+					 + a33;
+
+			// Rounding can make the error slightly negative.
+			return Weight > 0.0 ? std::fabs(e) / Weight : 0.0;
+		}
+	};
+
+	// Weight of the squared edge length in the collapse order.  On flat areas every
+	// collapse is free, and without it a few vertices end up with huge fans.
+	const double EdgeLengthBias = 1e-3;
+
+	// Candidate collapse of vertex From onto vertex To.  The versions are used to
+	// detect entries that went stale because either endpoint changed.
+	struct Collapse
+	{
+		double Priority;
+		double Error;
+		uint32 From;
+		uint32 To;
+		uint32 FromVersion;
+		uint32 ToVersion;
+
+		bool operator>(const Collapse& rhs)const
+		{
+			return Priority > rhs.Priority;
+		}
+	};
+
+	std::uint64_t EdgeKey(uint32 a, uint32 b)
+	{
+		return a < b ? ((std::uint64_t)a << 32) | b : ((std::uint64_t)b << 32) | a;
+	}
+
+	struct PositionHash
+	{
+		size_t operator()(const XMFLOAT3& p)const
+		{
+			uint32 bits[3];
+			std::memcpy(bits, &p, sizeof(bits));
+			return bits[0]*73856093u ^ bits[1]*19349663u ^ bits[2]*83492791u;
+		}
+	};
+
+	struct PositionEqual
+	{
+		bool operator()(const XMFLOAT3& a, const XMFLOAT3& b)const
+		{
+			return a.x == b.x && a.y == b.y && a.z == b.z;
+		}
+	};
+
+	XMVECTOR TriangleNormal(const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2)
+	{
+		XMVECTOR v0 = XMLoadFloat3(&p0);
+		return XMVector3Cross(XMLoadFloat3(&p1) - v0, XMLoadFloat3(&p2) - v0);
+	}
+}
+
+std::vector<uint32> MeshSimplifier::Simplify(const GeometryGenerator::MeshData& meshData, uint32 targetIndexCount,
+											 float maxError, float* resultError)
+{
+	const auto& vertices = meshData.Vertices;
+	uint32 vertexCount = (uint32)vertices.size();
+	uint32 triCount = (uint32)meshData.Indices32.size() / 3;
+
+	std::vector<uint32> indices(meshData.Indices32.begin(), meshData.Indices32.begin() + triCount*3);
+
+	if(resultError != nullptr)
+		*resultError = 0.0f;
+
+	if(indices.size() <= targetIndexCount || vertexCount == 0)
+		return indices;
+
+	//
+	// Convert the relative error bound to a squared distance.
+	//
+
+	XMVECTOR vMin = XMLoadFloat3(&vertices[0].Position);
+	XMVECTOR vMax = vMin;
+	for(auto& v : vertices)
+	{
+		XMVECTOR p = XMLoadFloat3(&v.Position);
+		vMin = XMVectorMin(vMin, p);
+		vMax = XMVectorMax(vMax, p);
+	}
+
+	float extent = XMVectorGetX(XMVector3Length(vMax - vMin));
+	if(extent <= 0.0f)
+		return indices;
+
+	double maxCost = (double)maxError*extent * (double)maxError*extent;
+
+	//
+	// Lock vertices on attribute seams (several vertices at one position, e.g.
+	// the texture seam of a sphere or the edges of a box) and on borders (edges
+	// used by only one triangle).  Moving them would open cracks.
+	//
+
+	std::vector<bool> locked(vertexCount, false);
+	{
+		std::unordered_map<XMFLOAT3, uint32, PositionHash, PositionEqual> firstAtPosition;
+		firstAtPosition.reserve(vertexCount);
+		for(uint32 v = 0; v < vertexCount; ++v)
+		{
+			auto inserted = firstAtPosition.emplace(vertices[v].Position, v);
+			if(!inserted.second)
+			{
+				locked[v] = true;
+				locked[inserted.first->second] = true;
+			}
+		}
+
+		std::unordered_map<std::uint64_t, uint32> edgeUseCount;
+		edgeUseCount.reserve(triCount*3);
+		for(uint32 t = 0; t < triCount; ++t)
+		{
+			for(uint32 k = 0; k < 3; ++k)
+				edgeUseCount[EdgeKey(indices[t*3+k], indices[t*3+(k+1)%3])]++;
+		}
+
+		for(auto& e : edgeUseCount)
+		{
+			if(e.second == 1)
+			{
+				locked[(uint32)(e.first >> 32)] = true;
+				locked[(uint32)(e.first & 0xffffffff)] = true;
+			}
+		}
+	}
+
+	//
+	// Vertex quadrics and adjacency.
+	//
+
+	std::vector<Quadric> quadrics(vertexCount);
+	std::vector<std::vector<uint32>> vertexTris(vertexCount);
+	std::vector<bool> triAlive(triCount, false);
+	uint32 aliveCount = 0;
+
+	for(uint32 t = 0; t < triCount; ++t)
+	{
+		uint32 i0 = indices[t*3+0];
+		uint32 i1 = indices[t*3+1];
+		uint32 i2 = indices[t*3+2];
+
+		if(i0 == i1 || i1 == i2 || i0 == i2)
+			continue;
+
+		triAlive[t] = true;
+		++aliveCount;
+
+		vertexTris[i0].push_back(t);
+		vertexTris[i1].push_back(t);
+		vertexTris[i2].push_back(t);
+
+		XMVECTOR n = TriangleNormal(vertices[i0].Position, vertices[i1].Position, vertices[i2].Position);
+		float length = XMVectorGetX(XMVector3Length(n));
+		if(length <= 0.0f)
+			continue;
+
+		// Weight each plane by the triangle area so that small triangles do
+		// not dominate the error.
+		n = n / length;
+		double a = XMVectorGetX(n), b = XMVectorGetY(n), c = XMVectorGetZ(n);
+		double d = -(a*vertices[i0].Position.x + b*vertices[i0].Position.y + c*vertices[i0].Position.z);
+		double area = 0.5*length;
+
+		quadrics[i0].AddPlane(a, b, c, d, area);
+		quadrics[i1].AddPlane(a, b, c, d, area);
+		quadrics[i2].AddPlane(a, b, c, d, area);
+	}
+
+	//
+	// Seed the queue with both directions of every edge.
+	//
+
+	std::vector<uint32> version(vertexCount, 0);
+	std::vector<bool> removed(vertexCount, false);
+	std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> queue;
+
+	auto pushCollapse = [&](uint32 from, uint32 to)
+	{
+		if(locked[from])
+			return;
+
+		Quadric q = quadrics[from];
+		q.Add(quadrics[to]);
+
+		XMVECTOR edge = XMLoadFloat3(&vertices[to].Position) - XMLoadFloat3(&vertices[from].Position);
+
+		Collapse c;
+		c.Error = q.Evaluate(vertices[to].Position);
+		c.Priority = c.Error + EdgeLengthBias*XMVectorGetX(XMVector3LengthSq(edge));
+		c.From = from;
+		c.To = to;
+		c.FromVersion = version[from];
+		c.ToVersion = version[to];
+		queue.push(c);
+	};
+
+	for(uint32 t = 0; t < triCount; ++t)
+	{
+		if(!triAlive[t])
+			continue;
+
+		// Interior edges appear once in each direction, so only take a < b.
+		for(uint32 k = 0; k < 3; ++k)
+		{
+			uint32 a = indices[t*3+k];
+			uint32 b = indices[t*3+(k+1)%3];
+			if(a < b)
+			{
+				pushCollapse(a, b);
+				pushCollapse(b, a);
+			}
+		}
+	}
+
+	//
+	// Collapse edges in order of increasing error.
+	//
+
+	auto compactTris = [&](uint32 v)
+	{
+		auto& tris = vertexTris[v];
+		tris.erase(std::remove_if(tris.begin(), tris.end(), [&](uint32 t) { return !triAlive[t]; }), tris.end());
+	};
+
+	auto collectNeighbors = [&](uint32 v, std::vector<uint32>& neighbors)
+	{
+		neighbors.clear();
+		for(uint32 t : vertexTris[v])
+		{
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				if(indices[t*3+k] != v)
+					neighbors.push_back(indices[t*3+k]);
+			}
+		}
+
+		std::sort(neighbors.begin(), neighbors.end());
+		neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+	};
+
+	auto containsVertex = [&](uint32 t, uint32 v)
+	{
+		return indices[t*3+0] == v || indices[t*3+1] == v || indices[t*3+2] == v;
+	};
+
+	std::vector<uint32> neighborsFrom;
+	std::vector<uint32> neighborsTo;
+	std::vector<uint32> common;
+
+	uint32 targetTriCount = targetIndexCount / 3;
+	double worstCost = 0.0;
+
+	while(aliveCount > targetTriCount && !queue.empty())
+	{
+		Collapse c = queue.top();
+		queue.pop();
+
+		if(removed[c.From] || removed[c.To] ||
+		   version[c.From] != c.FromVersion || version[c.To] != c.ToVersion)
+			continue;
+
+		if(c.Error > maxCost)
+			continue;
+
+		uint32 from = c.From;
+		uint32 to = c.To;
+
+		compactTris(from);
+		compactTris(to);
+
+		// The edge must still exist, and the vertices may only share the
+		// neighbours opposite the shared edge, otherwise the collapse would
+		// create non-manifold geometry.
+		uint32 sharedTris = 0;
+		for(uint32 t : vertexTris[from])
+		{
+			if(containsVertex(t, to))
+				++sharedTris;
+		}
+
+		if(sharedTris == 0)
+			continue;
+
+		collectNeighbors(from, neighborsFrom);
+		collectNeighbors(to, neighborsTo);
+
+		common.clear();
+		std::set_intersection(neighborsFrom.begin(), neighborsFrom.end(),
+							  neighborsTo.begin(), neighborsTo.end(), std::back_inserter(common));
+
+		if(common.size() != sharedTris)
+			continue;
+
+		// Reject collapses that would flip a triangle or turn it by more than
+		// about 75 degrees, which also keeps slivers from building up.
+		bool flips = false;
+		for(uint32 t : vertexTris[from])
+		{
+			if(containsVertex(t, to))
+				continue;
+
+			XMFLOAT3 p[3];
+			XMFLOAT3 q[3];
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				uint32 v = indices[t*3+k];
+				p[k] = vertices[v].Position;
+				q[k] = v == from ? vertices[to].Position : p[k];
+			}
+
+			XMVECTOR before = TriangleNormal(p[0], p[1], p[2]);
+			XMVECTOR after = TriangleNormal(q[0], q[1], q[2]);
+			if(XMVectorGetX(XMVector3Dot(XMVector3Normalize(before), XMVector3Normalize(after))) < 0.25f)
+			{
+				flips = true;
+				break;
+			}
+		}
+
+		if(flips)
+			continue;
+
+		// Perform the collapse.
+		for(uint32 t : vertexTris[from])
+		{
+			if(containsVertex(t, to))
+			{
+				triAlive[t] = false;
+				--aliveCount;
+				continue;
+			}
+
+			for(uint32 k = 0; k < 3; ++k)
+			{
+				if(indices[t*3+k] == from)
+					indices[t*3+k] = to;
+			}
+
+			vertexTris[to].push_back(t);
+		}
+
+		vertexTris[from].clear();
+		removed[from] = true;
+		quadrics[to].Add(quadrics[from]);
+		version[to]++;
+		worstCost = std::max(worstCost, c.Error);
+
+		// The error of every edge around the surviving vertex changed.
+		compactTris(to);
+		collectNeighbors(to, neighborsTo);
+		for(uint32 v : neighborsTo)
+		{
+			pushCollapse(to, v);
+			pushCollapse(v, to);
+		}
+	}
+
+	std::vector<uint32> result;
+	result.reserve(aliveCount*3);
+	for(uint32 t = 0; t < triCount; ++t)
+	{
+		if(triAlive[t])
+			result.insert(result.end(), &indices[t*3], &indices[t*3] + 3);
+	}
+
+	if(resultError != nullptr)
+		*resultError = (float)(std::sqrt(worstCost) / extent);
+
+	return result;
+}
+
+MeshSimplifier::LodChain MeshSimplifier::BuildLodChain(const GeometryGenerator::MeshData& meshData, uint32 levelCount,
+													   float triangleRatio, float maxError)
+{
+	LodChain chain;
+	chain.Mesh.Vertices = meshData.Vertices;
+	chain.Mesh.Bounds = meshData.Bounds;
+	chain.Mesh.SphereBounds = meshData.SphereBounds;
+
+	uint32 vertexCount = (uint32)meshData.Vertices.size();
+
+	auto addLevel = [&](std::vector<uint32>& indices, float error)
+	{
+		MeshOptimizer::OptimizeVertexCache(indices.data(), indices.size(), vertexCount);
+
+		LodLevel level;
+		level.Submesh.IndexCount = (UINT)indices.size();
+		level.Submesh.StartIndexLocation = (UINT)chain.Mesh.Indices32.size();
+		level.Submesh.BaseVertexLocation = 0;
+		level.Submesh.Bounds = meshData.Bounds;
+		level.Error = error;
+		chain.Levels.push_back(level);
+
+		chain.Mesh.Indices32.insert(chain.Mesh.Indices32.end(), indices.begin(), indices.end());
+	};
+
+	std::vector<uint32> indices = meshData.Indices32;
+	addLevel(indices, 0.0f);
+
+	// Every level is simplified from the original mesh so that its error is
+	// measured against the real surface rather than the previous level.
+	uint32 prevIndexCount = (uint32)indices.size();
+	for(uint32 i = 1; i < levelCount; ++i)
+	{
+		uint32 targetIndexCount = (uint32)(prevIndexCount/3 * triangleRatio) * 3;
+
+		float error = 0.0f;
+		indices = Simplify(meshData, targetIndexCount, maxError, &error);
+
+		// Stop once the error bound (or the locked borders) keep us from
+		// getting meaningfully smaller.
+		if(indices.empty() || indices.size() > prevIndexCount - prevIndexCount/10)
+			break;
+
+		addLevel(indices, error);
+		prevIndexCount = (uint32)indices.size();
+	}
+
+	return chain;
+}
@@ -0,0 +1,60 @@
+//***************************************************************************************
+// MeshSimplifier.h
+//
+// Quadric error metric mesh simplification and level-of-detail chains.
+//
+// Edges are collapsed onto one of their endpoints (never onto a new vertex), so
+// every level of detail indexes the original vertex buffer.  A LOD chain is
+// therefore one vertex buffer plus one index range per level, and a render item
+// can switch levels by changing its IndexCount/StartIndexLocation alone.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include "d3dUtil.h"
+
+class MeshSimplifier
+{
+public:
+
+	using uint32 = GeometryGenerator::uint32;
+
+	// One level of a LodChain.
+	struct LodLevel
+	{
+		// Where the level's indices are in LodChain::Mesh, ready to be put in a
+		// MeshGeometry's DrawArgs.  Bounds are those of the whole mesh.
+		SubmeshGeometry Submesh;
+
+		// Approximate geometric deviation from level 0, relative to the size of
+		// the mesh (the diagonal of its bounding box).
+		float Error = 0.0f;
+	};
+
+	struct LodChain
+	{
+		// The original vertices and the indices of every level, back to back.
+		GeometryGenerator::MeshData Mesh;
+		std::vector<LodLevel> Levels;
+	};
+
+	///<summary>
+	/// Collapses edges of meshData in order of increasing quadric error until at most
+	/// targetIndexCount indices remain, or the next collapse would exceed maxError
+	/// (relative to the size of the mesh).  Returns the new index list, which
+	/// references meshData.Vertices.  Borders and attribute seams (vertices that
+	/// share a position) are kept in place so the mesh does not crack.
+	///</summary>
+	static std::vector<uint32> Simplify(const GeometryGenerator::MeshData& meshData, uint32 targetIndexCount,
+										float maxError, float* resultError = nullptr);
+
+	///<summary>
+	/// Builds up to levelCount levels, where level 0 is the input and each level aims for
+	/// triangleRatio times the triangles of the one before.  The chain stops early once
+	/// a level can no longer be reduced within maxError.  Each level is optimized for
+	/// the vertex cache.
+	///</summary>
+	static LodChain BuildLodChain(const GeometryGenerator::MeshData& meshData, uint32 levelCount,
+								  float triangleRatio = 0.5f, float maxError = 0.01f);
+};
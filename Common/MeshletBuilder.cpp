@@ -0,0 +1,223 @@
+//***************************************************************************************
+// MeshletBuilder.cpp
+//***************************************************************************************
+
+#include "MeshletBuilder.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+using namespace DirectX;
+
+MeshletBuilder::MeshletData MeshletBuilder::Build(const GeometryGenerator::MeshData& meshData, uint32 maxVertices, uint32 maxPrimitives)
+{
+	assert(maxVertices >= 3 && maxVertices <= 256);
+	assert(maxPrimitives >= 1);
+
+	MeshletData result;
+
+	uint32 triCount = (uint32)meshData.Indices32.size() / 3;
+	result.Indices.reserve(triCount*3);
+	result.PrimitiveIndices.reserve(triCount*3);
+
+	// Local index of each mesh vertex in the meshlet being built, or -1.
+	std::vector<int> localIndex(meshData.Vertices.size(), -1);
+
+	Meshlet current;
+
+	auto finishMeshlet = [&]()
+	{
+		if(current.PrimitiveCount == 0)
+			return;
+
+		ComputeBounds(meshData, result, current);
+
+		for(uint32 i = 0; i < current.VertexCount; ++i)
+			localIndex[result.UniqueVertexIndices[current.VertexOffset + i]] = -1;
+
+		result.Meshlets.push_back(current);
+
+		current = Meshlet();
+		current.StartIndexLocation = (uint32)result.Indices.size();
+		current.VertexOffset = (uint32)result.UniqueVertexIndices.size();
+		current.PrimitiveOffset = (uint32)result.PrimitiveIndices.size() / 3;
+	};
+
+	for(uint32 t = 0; t < triCount; ++t)
+	{
+		const uint32* tri = &meshData.Indices32[t*3];
+
+		uint32 newVertices = 0;
+		for(uint32 k = 0; k < 3; ++k)
+		{
+			if(localIndex[tri[k]] < 0 &&
+			   (k < 1 || tri[k] != tri[0]) &&
+			   (k < 2 || tri[k] != tri[1]))
+				++newVertices;
+		}
+
+		if(current.VertexCount + newVertices > maxVertices || current.PrimitiveCount + 1 > maxPrimitives)
+			finishMeshlet();
+
+		for(uint32 k = 0; k < 3; ++k)
+		{
+			uint32 v = tri[k];
+			if(localIndex[v] < 0)
+			{
+				localIndex[v] = (int)current.VertexCount++;
+				result.UniqueVertexIndices.push_back(v);
+			}
+
+			result.PrimitiveIndices.push_back((uint8)localIndex[v]);
+			result.Indices.push_back(v);
+		}
+
+		current.PrimitiveCount++;
+		current.IndexCount += 3;
+	}
+
+	finishMeshlet();
+
+	return result;
+}
+
+void MeshletBuilder::ComputeBounds(const GeometryGenerator::MeshData& meshData, MeshletData& meshlets, Meshlet& m)
+{
+	//
+	// Bounding sphere: centered on the box of the vertices, radius to the
+	// farthest vertex.
+	//
+
+	const uint32* vertexIndices = &meshlets.UniqueVertexIndices[m.VertexOffset];
+
+	XMVECTOR vMin = XMLoadFloat3(&meshData.Vertices[vertexIndices[0]].Position);
+	XMVECTOR vMax = vMin;
+	for(uint32 i = 1; i < m.VertexCount; ++i)
+	{
+		XMVECTOR p = XMLoadFloat3(&meshData.Vertices[vertexIndices[i]].Position);
+		vMin = XMVectorMin(vMin, p);
+		vMax = XMVectorMax(vMax, p);
+	}
+
+	XMVECTOR center = 0.5f*(vMin + vMax);
+
+	XMVECTOR maxDistSq = XMVectorZero();
+	for(uint32 i = 0; i < m.VertexCount; ++i)
+	{
+		XMVECTOR p = XMLoadFloat3(&meshData.Vertices[vertexIndices[i]].Position);
+		maxDistSq = XMVectorMax(maxDistSq, XMVector3LengthSq(p - center));
+	}
+
+	XMStoreFloat3(&m.Center, center);
+	m.Radius = sqrtf(XMVectorGetX(maxDistSq));
+
+	//
+	// Normal cone: the axis is the average face normal and the cutoff is the sine
+	// of the widest angle between the axis and any face normal.
+	//
+
+	const uint32* indices = &meshlets.Indices[m.StartIndexLocation];
+	uint32 triCount = m.IndexCount / 3;
+
+	std::vector<XMFLOAT3> normals;
+	normals.reserve(triCount);
+
+	XMVECTOR axis = XMVectorZero();
+	for(uint32 t = 0; t < triCount; ++t)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&meshData.Vertices[indices[t*3+0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&meshData.Vertices[indices[t*3+1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&meshData.Vertices[indices[t*3+2]].Position);
+
+		// Clockwise winding is front facing, so this points outward for the
+		// left-handed coordinate system.
+		XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+
+		// Skip degenerate triangles.
+		if(XMVectorGetX(XMVector3LengthSq(n)) < 1e-12f)
+			continue;
+
+		n = XMVector3Normalize(n);
+		axis += n;
+
+		XMFLOAT3 normal;
+		XMStoreFloat3(&normal, n);
+		normals.push_back(normal);
+	}
+
+	m.ConeAxis = XMFLOAT3(0.0f, 0.0f, 1.0f);
+	m.ConeCutoff = 1.0f;
+
+	if(normals.empty() || XMVectorGetX(XMVector3LengthSq(axis)) < 1e-12f)
+		return;
+
+	axis = XMVector3Normalize(axis);
+
+	float minDot = 1.0f;
+	for(auto& normal : normals)
+		minDot = std::min(minDot, XMVectorGetX(XMVector3Dot(XMLoadFloat3(&normal), axis)));
+
+	XMStoreFloat3(&m.ConeAxis, axis);
+
+	// A cone this wide (more than ~84 degrees) would almost never be culled,
+	// so treat it as unbounded.
+	if(minDot > 0.1f)
+		m.ConeCutoff = sqrtf(1.0f - minDot*minDot);
+}
+
+MeshletBuilder::uint32 MeshletBuilder::Cull(const MeshletData& meshlets, const XMFLOAT4 frustumPlanes[6],
+											const XMFLOAT3& eyePosL, std::vector<DrawRange>& visibleRanges)
+{
+	XMVECTOR planes[6];
+	for(int i = 0; i < 6; ++i)
+		planes[i] = XMLoadFloat4(&frustumPlanes[i]);
+
+	XMVECTOR eye = XMLoadFloat3(&eyePosL);
+
+	uint32 visibleCount = 0;
+	for(const Meshlet& m : meshlets.Meshlets)
+	{
+		XMVECTOR center = XMLoadFloat3(&m.Center);
+		XMVECTOR negRadius = XMVectorReplicate(-m.Radius);
+
+		// Frustum test: reject when the sphere is completely behind any plane.
+		bool outside = false;
+		for(int i = 0; i < 6 && !outside; ++i)
+			outside = XMVector4Less(XMPlaneDotCoord(planes[i], center), negRadius);
+
+		if(outside)
+			continue;
+
+		// Cone test: every triangle faces away when the eye lies inside the
+		// back-facing cone, which holds for the whole sphere when
+		//   dot(c - eye, axis) >= cutoff*|c - eye| + r
+		if(m.ConeCutoff < 1.0f)
+		{
+			XMVECTOR toCenter = center - eye;
+			float d = XMVectorGetX(XMVector3Dot(toCenter, XMLoadFloat3(&m.ConeAxis)));
+			float dist = XMVectorGetX(XMVector3Length(toCenter));
+
+			if(d >= m.ConeCutoff*dist + m.Radius)
+				continue;
+		}
+
+		++visibleCount;
+
+		// Neighbouring meshlets are contiguous in the index buffer, so extend the
+		// previous range instead of starting a new draw.
+		if(!visibleRanges.empty() &&
+		   visibleRanges.back().StartIndexLocation + visibleRanges.back().IndexCount == m.StartIndexLocation)
+		{
+			visibleRanges.back().IndexCount += m.IndexCount;
+		}
+		else
+		{
+			DrawRange range;
+			range.StartIndexLocation = m.StartIndexLocation;
+			range.IndexCount = m.IndexCount;
+			visibleRanges.push_back(range);
+		}
+	}
+
+	return visibleCount;
+}
@@ -0,0 +1,87 @@
+//***************************************************************************************
+// MeshletBuilder.h
+//
+// Splits a MeshData into small clusters of triangles (meshlets) with culling data,
+// and culls them on the CPU so that only the index ranges of potentially visible
+// clusters are drawn.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+
+class MeshletBuilder
+{
+public:
+
+	using uint8  = std::uint8_t;
+	using uint32 = GeometryGenerator::uint32;
+
+	struct Meshlet
+	{
+		// Range of the meshlet's triangles in MeshletData::Indices.  These can be
+		// used directly as DrawIndexedInstanced arguments.
+		uint32 StartIndexLocation = 0;
+		uint32 IndexCount = 0;
+
+		// Range of the meshlet's vertices in MeshletData::UniqueVertexIndices.
+		uint32 VertexOffset = 0;
+		uint32 VertexCount = 0;
+
+		// Range of the meshlet's triangles in MeshletData::PrimitiveIndices, where
+		// each triangle is three bytes indexing the meshlet's vertex range.
+		uint32 PrimitiveOffset = 0;
+		uint32 PrimitiveCount = 0;
+
+		// Bounding sphere of the meshlet's vertices.
+		DirectX::XMFLOAT3 Center = { 0.0f, 0.0f, 0.0f };
+		float Radius = 0.0f;
+
+		// Normal cone: every triangle normal n satisfies dot(n, ConeAxis) >= cos(a),
+		// and ConeCutoff = sin(a).  A cutoff of 1 means the cone is too wide to cull.
+		DirectX::XMFLOAT3 ConeAxis = { 0.0f, 0.0f, 1.0f };
+		float ConeCutoff = 1.0f;
+	};
+
+	struct MeshletData
+	{
+		std::vector<Meshlet> Meshlets;
+
+		// Meshlet-local vertex lists.  Each entry indexes MeshData::Vertices.
+		std::vector<uint32> UniqueVertexIndices;
+
+		// Meshlet-local triangle lists, three bytes per triangle.
+		std::vector<uint8> PrimitiveIndices;
+
+		// The input index list reordered so that each meshlet is one contiguous
+		// range.  Upload this in place of MeshData::Indices32.
+		std::vector<uint32> Indices;
+	};
+
+	// Contiguous run of surviving triangles in MeshletData::Indices.
+	struct DrawRange
+	{
+		uint32 StartIndexLocation = 0;
+		uint32 IndexCount = 0;
+	};
+
+	///<summary>
+	/// Splits the triangles of meshData into meshlets of at most maxVertices unique
+	/// vertices and maxPrimitives triangles.  Triangles are taken in index order, so
+	/// run MeshOptimizer::OptimizeVertexCache first for tighter clusters.
+	/// maxVertices must not be more than 256 since local indices are bytes.
+	///</summary>
+	static MeshletData Build(const GeometryGenerator::MeshData& meshData, uint32 maxVertices = 64, uint32 maxPrimitives = 126);
+
+	///<summary>
+	/// Rejects meshlets that are outside the frustum or face away from the eye and
+	/// appends the index ranges of the rest to visibleRanges, merging neighbours.
+	/// The planes (see MathHelper::ExtractFrustumPlanes) and eye position must be in
+	/// the mesh's local space.  Returns the number of meshlets that survived.
+	///</summary>
+	static uint32 Cull(const MeshletData& meshlets, const DirectX::XMFLOAT4 frustumPlanes[6],
+					   const DirectX::XMFLOAT3& eyePosL, std::vector<DrawRange>& visibleRanges);
+
+private:
+	static void ComputeBounds(const GeometryGenerator::MeshData& meshData, MeshletData& meshlets, Meshlet& m);
+};
@@ -0,0 +1,466 @@
+//***************************************************************************************
+// OcclusionCuller.cpp
+//***************************************************************************************
+
+#include "OcclusionCuller.h"
+#include "MathBatch.h"
+#include "ParallelFor.h"
+#include "Profiler.h"
+#include <DirectXPackedVector.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#if !defined(_XM_NO_INTRINSICS_) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define OCCLUSIONCULLER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	using uint32 = OcclusionCuller::uint32;
+
+	// Rounding in the depth planes can put an occluder a few ulps in front of its
+	// own bounding box; the bias keeps it from hiding itself.
+	const float DepthBias = 1e-6f;
+
+	XMVECTOR LoadPosition(const std::uint8_t* vertex, DXGI_FORMAT format)
+	{
+		if(format == DXGI_FORMAT_R16G16B16A16_UNORM)
+			return XMVectorSetW(XMLoadUShortN4(reinterpret_cast<const XMUSHORTN4*>(vertex)), 1.0f);
+
+		return XMVectorSetW(XMLoadFloat3(reinterpret_cast<const XMFLOAT3*>(vertex)), 1.0f);
+	}
+
+	uint32 LoadIndex(const void* indices, DXGI_FORMAT format, size_t i)
+	{
+		if(format == DXGI_FORMAT_R16_UINT)
+			return static_cast<const std::uint16_t*>(indices)[i];
+
+		return static_cast<const std::uint32_t*>(indices)[i];
+	}
+}
+
+OcclusionCuller::OcclusionCuller(const Desc& desc)
+	: mDesc(desc)
+{
+	mDesc.Width = std::max(1u, mDesc.Width);
+	mDesc.Height = std::max(1u, mDesc.Height);
+	mDesc.BandHeight = std::max(1u, mDesc.BandHeight);
+
+	mBandCount = (mDesc.Height + mDesc.BandHeight - 1) / mDesc.BandHeight;
+	mBands.resize(mBandCount);
+
+	mPitch = (mDesc.Width + 3) & ~3u;
+	mDepth.assign((size_t)mPitch*mDesc.Height, 1.0f);
+
+	uint32 width = mDesc.Width;
+	uint32 height = mDesc.Height;
+	while(true)
+	{
+		Level level;
+		level.Width = width;
+		level.Height = height;
+		level.Depth.assign((size_t)width*height, 1.0f);
+		mLevels.push_back(std::move(level));
+
+		if(width == 1 && height == 1)
+			break;
+
+		width = (width + 1) / 2;
+		height = (height + 1) / 2;
+	}
+
+	mViewProj = MathHelper::Identity4x4();
+}
+
+void OcclusionCuller::Begin(CXMMATRIX viewProj)
+{
+	XMStoreFloat4x4(&mViewProj, viewProj);
+	mOccluders.clear();
+}
+
+bool OcclusionCuller::AddOccluder(const MeshGeometry& geo, const SubmeshGeometry& submesh,
+	DXGI_FORMAT positionFormat, CXMMATRIX world)
+{
+	if(positionFormat != DXGI_FORMAT_R32G32B32_FLOAT && positionFormat != DXGI_FORMAT_R16G16B16A16_UNORM)
+		return false;
+
+	if(geo.VertexBufferCPU == nullptr || geo.IndexBufferCPU == nullptr)
+		return false;
+
+	Occluder occluder;
+	occluder.Vertices = static_cast<const std::uint8_t*>(geo.VertexBufferCPU->GetBufferPointer());
+	occluder.VertexStride = geo.VertexByteStride;
+	occluder.PositionFormat = positionFormat;
+	occluder.Indices = geo.IndexBufferCPU->GetBufferPointer();
+	occluder.IndexFormat = geo.IndexFormat;
+	occluder.Submesh = submesh;
+	XMStoreFloat4x4(&occluder.WorldViewProj, XMMatrixMultiply(world, XMLoadFloat4x4(&mViewProj)));
+
+	mOccluders.push_back(occluder);
+	return true;
+}
+
+void OcclusionCuller::SetupTriangles(const Occluder& occluder, std::vector<DirectX::XMFLOAT4>& vertices,
+	std::vector<Triangle>& triangles)const
+{
+	triangles.clear();
+
+	const SubmeshGeometry& submesh = occluder.Submesh;
+	if(submesh.IndexCount < 3)
+		return;
+
+	// Each vertex is shared by about six triangles, so project the range of
+	// vertices the submesh uses once instead of every triangle corner.
+	uint32 first = UINT_MAX;
+	uint32 last = 0;
+	for(UINT i = 0; i < submesh.IndexCount; ++i)
+	{
+		uint32 index = LoadIndex(occluder.Indices, occluder.IndexFormat, submesh.StartIndexLocation + i);
+		first = std::min(first, index);
+		last = std::max(last, index);
+	}
+
+	XMMATRIX wvp = XMLoadFloat4x4(&occluder.WorldViewProj);
+	const float width = (float)mDesc.Width;
+	const float height = (float)mDesc.Height;
+
+	// Screen x and y, depth, and the clip-space z whose sign tells which side of
+	// the near plane the vertex is on.
+	vertices.resize(last - first + 1);
+	for(uint32 i = first; i <= last; ++i)
+	{
+		size_t index = (size_t)((INT)i + submesh.BaseVertexLocation);
+
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector4Transform(
+			LoadPosition(occluder.Vertices + index*occluder.VertexStride, occluder.PositionFormat), wvp));
+
+		float invW = 1.0f / clip.w;
+		vertices[i - first] = XMFLOAT4(
+			(0.5f + 0.5f*clip.x*invW)*width,
+			(0.5f - 0.5f*clip.y*invW)*height,
+			clip.z*invW,
+			clip.z);
+	}
+
+	for(UINT i = 0; i + 3 <= submesh.IndexCount; i += 3)
+	{
+		float x[3], y[3], z[3];
+		bool nearClipped = false;
+
+		for(int v = 0; v < 3; ++v)
+		{
+			const XMFLOAT4& vertex = vertices[LoadIndex(occluder.Indices, occluder.IndexFormat,
+				submesh.StartIndexLocation + i + v) - first];
+
+			x[v] = vertex.x;
+			y[v] = vertex.y;
+			z[v] = vertex.z;
+
+			// Clipping against the near plane would add vertices; dropping the
+			// triangle only makes the buffer less occluding.
+			nearClipped |= vertex.w < 0.0f;
+		}
+
+		if(nearClipped)
+			continue;
+
+		// Front faces are clockwise on screen, which with y pointing down gives a
+		// positive area.  Back faces are hidden by the front ones anyway.
+		float area = (x[1] - x[0])*(y[2] - y[0]) - (y[1] - y[0])*(x[2] - x[0]);
+		if(!(area > 0.0f))
+			continue;
+
+		// Pixel (px, py) is covered when its center lies inside the triangle.
+		float minX = std::min(x[0], std::min(x[1], x[2]));
+		float maxX = std::max(x[0], std::max(x[1], x[2]));
+		float minY = std::min(y[0], std::min(y[1], y[2]));
+		float maxY = std::max(y[0], std::max(y[1], y[2]));
+
+		Triangle t;
+		t.MinX = std::max(0, (int)std::ceil(minX - 0.5f));
+		t.MaxX = std::min((int)mDesc.Width - 1, (int)std::floor(maxX - 0.5f));
+		t.MinY = std::max(0, (int)std::ceil(minY - 0.5f));
+		t.MaxY = std::min((int)mDesc.Height - 1, (int)std::floor(maxY - 0.5f));
+
+		if(t.MinX > t.MaxX || t.MinY > t.MaxY)
+			continue;
+
+		// Edge e is opposite vertex e and positive on the inside; divided by the
+		// area, the three edge functions are the barycentric weights.
+		float invArea = 1.0f / area;
+		t.DepthA = t.DepthB = t.DepthC = 0.0f;
+		for(int e = 0; e < 3; ++e)
+		{
+			int v0 = (e + 1) % 3;
+			int v1 = (e + 2) % 3;
+
+			t.EdgeA[e] = y[v0] - y[v1];
+			t.EdgeB[e] = x[v1] - x[v0];
+			t.EdgeC[e] = -(t.EdgeA[e]*x[v0] + t.EdgeB[e]*y[v0]);
+
+			t.DepthA += t.EdgeA[e]*z[e]*invArea;
+			t.DepthB += t.EdgeB[e]*z[e]*invArea;
+			t.DepthC += t.EdgeC[e]*z[e]*invArea;
+		}
+
+		triangles.push_back(t);
+	}
+}
+
+void OcclusionCuller::Rasterize()
+{
+	size_t inputTriangleCount = 0;
+	for(const Occluder& occluder : mOccluders)
+		inputTriangleCount += occluder.Submesh.IndexCount / 3;
+
+	mTriangles.resize(mOccluders.size());
+	mVertices.resize(mOccluders.size());
+	ParallelFor((uint32)mOccluders.size(), GetThreadCount(inputTriangleCount), [&](uint32 i)
+	{
+		SetupTriangles(mOccluders[i], mVertices[i], mTriangles[i]);
+	});
+
+	// Bin in submission order, so every band draws its triangles in the same
+	// order however the work is scheduled.
+	for(auto& band : mBands)
+		band.clear();
+
+	size_t triangleCount = 0;
+	for(auto& triangles : mTriangles)
+	{
+		triangleCount += triangles.size();
+		for(auto& t : triangles)
+		{
+			for(int band = t.MinY / (int)mDesc.BandHeight; band <= t.MaxY / (int)mDesc.BandHeight; ++band)
+				mBands[band].push_back(&t);
+		}
+	}
+
+	ParallelFor(mBandCount, GetThreadCount(triangleCount), [this](uint32 band)
+	{
+		RasterizeBand(band);
+	});
+
+	BuildPyramid();
+}
+
+OcclusionCuller::uint32 OcclusionCuller::GetThreadCount(size_t triangleCount)const
+{
+	uint32 threadCount = mDesc.ThreadCount != 0 ? mDesc.ThreadCount : DefaultThreadCount();
+	size_t useful = triangleCount / std::max(1u, mDesc.MinTrianglesPerThread);
+
+	return (uint32)std::max<size_t>(1, std::min<size_t>(threadCount, useful));
+}
+
+void OcclusionCuller::RasterizeBand(uint32 band)
+{
+	PROFILE_SCOPE("RasterizeBand");
+
+	int bandMinY = (int)(band*mDesc.BandHeight);
+	int bandMaxY = std::min((int)mDesc.Height, bandMinY + (int)mDesc.BandHeight) - 1;
+
+	std::fill(mDepth.begin() + (size_t)bandMinY*mPitch, mDepth.begin() + (size_t)(bandMaxY + 1)*mPitch, 1.0f);
+
+	const bool simd = MathBatch::GetPath() != MathBatch::Path::Scalar;
+
+	for(const Triangle* t : mBands[band])
+	{
+		int minY = std::max(t->MinY, bandMinY);
+		int maxY = std::min(t->MaxY, bandMaxY);
+
+		// Whole groups of four pixels; the rows are padded to allow it.
+		int minX = t->MinX & ~3;
+
+		for(int py = minY; py <= maxY; ++py)
+		{
+			float* row = &mDepth[(size_t)py*mPitch];
+			float y = (float)py + 0.5f;
+
+			float edge0 = t->EdgeB[0]*y + t->EdgeC[0];
+			float edge1 = t->EdgeB[1]*y + t->EdgeC[1];
+			float edge2 = t->EdgeB[2]*y + t->EdgeC[2];
+			float depth = t->DepthB*y + t->DepthC;
+
+#if defined(OCCLUSIONCULLER_SSE2)
+			if(simd)
+			{
+				const __m128 a0 = _mm_set1_ps(t->EdgeA[0]);
+				const __m128 a1 = _mm_set1_ps(t->EdgeA[1]);
+				const __m128 a2 = _mm_set1_ps(t->EdgeA[2]);
+				const __m128 ad = _mm_set1_ps(t->DepthA);
+				const __m128 e0 = _mm_set1_ps(edge0);
+				const __m128 e1 = _mm_set1_ps(edge1);
+				const __m128 e2 = _mm_set1_ps(edge2);
+				const __m128 d = _mm_set1_ps(depth);
+				const __m128 zero = _mm_setzero_ps();
+
+				__m128 x = _mm_add_ps(_mm_set1_ps((float)minX), _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f));
+				const __m128 four = _mm_set1_ps(4.0f);
+
+				for(int px = minX; px <= t->MaxX; px += 4, x = _mm_add_ps(x, four))
+				{
+					__m128 inside = _mm_and_ps(
+						_mm_and_ps(
+							_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a0, x), e0), zero),
+							_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a1, x), e1), zero)),
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(a2, x), e2), zero));
+
+					if(_mm_movemask_ps(inside) == 0)
+						continue;
+
+					__m128 current = _mm_loadu_ps(row + px);
+					__m128 nearer = _mm_min_ps(current, _mm_add_ps(_mm_mul_ps(ad, x), d));
+					_mm_storeu_ps(row + px, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, current)));
+				}
+
+				continue;
+			}
+#endif
+
+			for(int px = minX; px <= t->MaxX; ++px)
+			{
+				float x = (float)px + 0.5f;
+				if(t->EdgeA[0]*x + edge0 >= 0.0f &&
+				   t->EdgeA[1]*x + edge1 >= 0.0f &&
+				   t->EdgeA[2]*x + edge2 >= 0.0f)
+				{
+					row[px] = std::min(row[px], t->DepthA*x + depth);
+				}
+			}
+		}
+	}
+}
+
+void OcclusionCuller::BuildPyramid()
+{
+	Level& base = mLevels[0];
+	for(uint32 y = 0; y < mDesc.Height; ++y)
+		std::copy_n(&mDepth[(size_t)y*mPitch], mDesc.Width, &base.Depth[(size_t)y*mDesc.Width]);
+
+	for(size_t i = 1; i < mLevels.size(); ++i)
+	{
+		const Level& src = mLevels[i - 1];
+		Level& dst = mLevels[i];
+
+		for(uint32 y = 0; y < dst.Height; ++y)
+		{
+			// Odd sizes repeat the last row or column.
+			uint32 y0 = 2*y;
+			uint32 y1 = std::min(y0 + 1, src.Height - 1);
+
+			for(uint32 x = 0; x < dst.Width; ++x)
+			{
+				uint32 x0 = 2*x;
+				uint32 x1 = std::min(x0 + 1, src.Width - 1);
+
+				dst.Depth[(size_t)y*dst.Width + x] = std::max(
+					std::max(src.Depth[(size_t)y0*src.Width + x0], src.Depth[(size_t)y0*src.Width + x1]),
+					std::max(src.Depth[(size_t)y1*src.Width + x0], src.Depth[(size_t)y1*src.Width + x1]));
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const BoundingBox& box)const
+{
+	XMFLOAT3 corners[BoundingBox::CORNER_COUNT];
+	box.GetCorners(corners);
+
+	XMMATRIX viewProj = XMLoadFloat4x4(&mViewProj);
+	const float width = (float)mDesc.Width;
+	const float height = (float)mDesc.Height;
+
+	float minX = MathHelper::Infinity, maxX = -MathHelper::Infinity;
+	float minY = MathHelper::Infinity, maxY = -MathHelper::Infinity;
+	float minDepth = MathHelper::Infinity;
+
+	for(auto& corner : corners)
+	{
+		XMFLOAT4 clip;
+		XMStoreFloat4(&clip, XMVector3Transform(XMLoadFloat3(&corner), viewProj));
+
+		// The box reaches the eye; nothing can be in front of all of it.
+		if(clip.z < 0.0f)
+			return true;
+
+		float invW = 1.0f / clip.w;
+		float x = (0.5f + 0.5f*clip.x*invW)*width;
+		float y = (0.5f - 0.5f*clip.y*invW)*height;
+
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		minDepth = std::min(minDepth, clip.z*invW);
+	}
+
+	if(maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+		return false;
+
+	// Every pixel the rectangle touches.
+	int x0 = std::max(0, (int)std::floor(minX));
+	int x1 = std::min((int)mDesc.Width - 1, (int)std::floor(maxX));
+	int y0 = std::max(0, (int)std::floor(minY));
+	int y1 = std::min((int)mDesc.Height - 1, (int)std::floor(maxY));
+
+	// The first level where the rectangle spans at most 4x4 texels.
+	size_t level = 0;
+	while(level + 1 < mLevels.size() && ((x1 >> level) - (x0 >> level) > 3 || (y1 >> level) - (y0 >> level) > 3))
+		++level;
+
+	const Level& l = mLevels[level];
+	minDepth -= DepthBias;
+
+	for(int ty = y0 >> level; ty <= (y1 >> level); ++ty)
+	{
+		for(int tx = x0 >> level; tx <= (x1 >> level); ++tx)
+		{
+			if(l.Depth[(size_t)ty*l.Width + tx] >= minDepth)
+				return true;
+		}
+	}
+
+	return false;
+}
+
+void OcclusionCuller::Cull(const std::vector<BoundingBox>& boxes, std::vector<uint32>& indices)const
+{
+	size_t n = 0;
+	for(uint32 index : indices)
+	{
+		if(IsVisible(boxes[index]))
+			indices[n++] = index;
+	}
+
+	indices.resize(n);
+}
+
+OcclusionCuller::uint32 OcclusionCuller::GetWidth()const
+{
+	return mDesc.Width;
+}
+
+OcclusionCuller::uint32 OcclusionCuller::GetHeight()const
+{
+	return mDesc.Height;
+}
+
+float OcclusionCuller::GetDepth(uint32 x, uint32 y)const
+{
+	return mDepth[(size_t)y*mPitch + x];
+}
+
+size_t OcclusionCuller::GetTriangleCount()const
+{
+	size_t count = 0;
+	for(auto& triangles : mTriangles)
+		count += triangles.size();
+
+	return count;
+}
@@ -0,0 +1,158 @@
+//***************************************************************************************
+// OcclusionCuller.h
+//
+// Software occlusion culling.  A few large occluder meshes are rasterized on the
+// CPU into a small depth buffer, from which a max-depth pyramid (hierarchical Z) is
+// built.  A box is occluded when every pyramid texel its screen rectangle touches
+// is nearer than the box's nearest point, which takes a handful of reads at the
+// pyramid level where the rectangle covers a few texels.
+//
+// The buffer is split into horizontal bands that are rasterized on worker threads
+// when there are enough triangles to be worth it.  Each band is owned by one thread
+// and draws its triangles in submission order, so the result does not depend on the
+// number of threads or on scheduling.
+//
+// All tests are conservative: triangles crossing the near plane are left out of
+// the depth buffer, and boxes crossing it are always visible.
+//
+// Unlike masked occlusion culling, which keeps a coverage mask and a couple of
+// depths per 8x4 tile, this stores one float per pixel.  At 256x144 the whole
+// buffer is 144KB, the per-pixel depth is exact rather than a merged estimate,
+// and the rasterizer can be checked pixel for pixel; the pyramid gives the cheap
+// coarse reads that the tile depths would.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+
+class OcclusionCuller
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	struct Desc
+	{
+		// Size of the depth buffer.  Occlusion only needs a coarse image, so this is
+		// far below the size of the back buffer; keep the same aspect ratio.
+		uint32 Width = 256;
+		uint32 Height = 144;
+
+		// Rows per band of work.
+		uint32 BandHeight = 16;
+
+		// 0 uses one thread per hardware thread.
+		uint32 ThreadCount = 0;
+
+		// Occluder triangles each thread must have before another one is used, so
+		// light frames run on the calling thread alone.  ParallelFor creates its
+		// threads on every call, which costs more than drawing a few thousand
+		// small triangles.
+		uint32 MinTrianglesPerThread = 8192;
+	};
+
+	OcclusionCuller() : OcclusionCuller(Desc()) {}
+	explicit OcclusionCuller(const Desc& desc);
+
+	OcclusionCuller(const OcclusionCuller& rhs) = delete;
+	OcclusionCuller& operator=(const OcclusionCuller& rhs) = delete;
+
+	///<summary>
+	/// Starts a frame seen through viewProj (row vectors, as in PassConstants before
+	/// transposing) and forgets the previous frame's occluders.
+	///</summary>
+	void Begin(DirectX::CXMMATRIX viewProj);
+
+	///<summary>
+	/// Queues a submesh of geo's CPU buffers to be drawn as an occluder.  The
+	/// position must be the first member of each vertex, as R32G32B32_FLOAT or
+	/// R16G16B16A16_UNORM; world maps it to world space, including any
+	/// dequantization.  Returns false for other position formats.  The buffers
+	/// must stay alive until Rasterize returns.
+	///</summary>
+	bool AddOccluder(const MeshGeometry& geo, const SubmeshGeometry& submesh,
+		DXGI_FORMAT positionFormat, DirectX::CXMMATRIX world);
+
+	///<summary>
+	/// Draws the queued occluders and builds the depth pyramid.
+	///</summary>
+	void Rasterize();
+
+	///<summary>
+	/// False if the world-space box is hidden behind the occluders or off screen.
+	///</summary>
+	bool IsVisible(const DirectX::BoundingBox& box)const;
+
+	///<summary>
+	/// Removes from indices, keeping the order, the items whose boxes[index] is not
+	/// visible.  Meant to run on the output of FrustumCuller::Cull.
+	///</summary>
+	void Cull(const std::vector<DirectX::BoundingBox>& boxes, std::vector<uint32>& indices)const;
+
+	uint32 GetWidth()const;
+	uint32 GetHeight()const;
+
+	// Nearest occluder depth (z/w in [0, 1], 1 where nothing was drawn) at pixel
+	// (x, y) of the last Rasterize.
+	float GetDepth(uint32 x, uint32 y)const;
+
+	size_t GetTriangleCount()const;
+
+private:
+
+	struct Occluder
+	{
+		const std::uint8_t* Vertices;
+		size_t VertexStride;
+		DXGI_FORMAT PositionFormat;
+		const void* Indices;
+		DXGI_FORMAT IndexFormat;
+		SubmeshGeometry Submesh;
+		DirectX::XMFLOAT4X4 WorldViewProj;
+	};
+
+	// A screen-space triangle ready to rasterize: three edge functions and the
+	// depth plane, each as a*x + b*y + c, and the pixel rectangle it covers.
+	struct Triangle
+	{
+		float EdgeA[3];
+		float EdgeB[3];
+		float EdgeC[3];
+		float DepthA, DepthB, DepthC;
+		int MinX, MaxX, MinY, MaxY;
+	};
+
+	struct Level
+	{
+		uint32 Width = 0;
+		uint32 Height = 0;
+		std::vector<float> Depth;
+	};
+
+	void SetupTriangles(const Occluder& occluder, std::vector<DirectX::XMFLOAT4>& vertices,
+		std::vector<Triangle>& triangles)const;
+	void RasterizeBand(uint32 band);
+	uint32 GetThreadCount(size_t triangleCount)const;
+	void BuildPyramid();
+
+	Desc mDesc;
+	uint32 mBandCount = 0;
+
+	// Rows of the depth buffer are padded to a multiple of four pixels so the SIMD
+	// rasterizer can always write whole groups.
+	uint32 mPitch = 0;
+	std::vector<float> mDepth;
+
+	// Level 0 is the unpadded depth buffer; each further level holds the farthest
+	// depth of 2x2 texels of the one before.
+	std::vector<Level> mLevels;
+
+	DirectX::XMFLOAT4X4 mViewProj;
+	std::vector<Occluder> mOccluders;
+
+	// Per occluder: its projected vertices and its triangles.
+	std::vector<std::vector<DirectX::XMFLOAT4>> mVertices;
+	std::vector<std::vector<Triangle>> mTriangles;
+	std::vector<std::vector<const Triangle*>> mBands;
+};
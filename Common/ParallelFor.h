@@ -0,0 +1,60 @@
+//***************************************************************************************
+// ParallelFor.h
+//
+// Minimal fork/join helper for splitting CPU work across threads.
+//***************************************************************************************
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// Returns the number of threads to use when the caller passes 0.
+inline std::uint32_t DefaultThreadCount()
+{
+	return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls func(i) for every i in [0, count) on up to threadCount threads (0 uses one 
+// per hardware thread).  The calling thread takes part in the work and the call
+// returns once every index has been processed.  Indices are handed out one at a
+// time, so the order they run in is unspecified and func must only write data
+// that belongs to index i.
+//
+// Threads are created per call, so this is meant for coarse jobs (whole meshes,
+// bands of rows, tiles) rather than fine-grained per-item work.
+template<typename Func>
+void ParallelFor(std::uint32_t count, std::uint32_t threadCount, Func func)
+{
+	if(threadCount == 0)
+		threadCount = DefaultThreadCount();
+
+	threadCount = std::min(threadCount, count);
+
+	if(threadCount <= 1)
+	{
+		for(std::uint32_t i = 0; i < count; ++i)
+			func(i);
+		return;
+	}
+
+	std::atomic<std::uint32_t> next(0);
+	auto worker = [&]()
+	{
+		for(std::uint32_t i = next++; i < count; i = next++)
+			func(i);
+	};
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount-1);
+	for(std::uint32_t t = 1; t < threadCount; ++t)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for(auto& t : threads)
+		t.join();
+}
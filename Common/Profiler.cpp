@@ -0,0 +1,327 @@
+//***************************************************************************************
+// Profiler.cpp
+//***************************************************************************************
+
+#include "Profiler.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace
+{
+	using uint32 = Profiler::uint32;
+	using uint64 = std::uint64_t;
+
+	struct Event
+	{
+		const char* Name;
+		std::int64_t Start;
+		std::int64_t End;
+		uint32 Thread;
+	};
+
+	// An Event in a ring.  Readers copy slots while the owner may be overwriting
+	// them, so every field is atomic; the copy can still mix two events, which
+	// ReadEvents detects and drops.
+	struct EventSlot
+	{
+		std::atomic<const char*> Name{nullptr};
+		std::atomic<std::int64_t> Start{0};
+		std::atomic<std::int64_t> End{0};
+		std::atomic<uint32> Thread{0};
+	};
+
+	// One thread's ring.  Only the owning thread writes it.  Head counts the events
+	// written so far and is published after each one, so readers know which entries
+	// are complete.
+	struct ThreadBuffer
+	{
+		std::unique_ptr<EventSlot[]> Events{new EventSlot[Profiler::EventsPerThread]};
+		std::atomic<uint64> Head{0};
+		std::atomic<bool> InUse{false};
+
+		// Trace id of the thread that owns the buffer now.  Each event keeps the id
+		// of the thread that recorded it, so events left by an earlier owner stay on
+		// that thread's track.
+		uint32 Thread = 0;
+	};
+
+	std::atomic<bool> gEnabled(true);
+
+	std::mutex gBuffersMutex;
+	std::vector<std::unique_ptr<ThreadBuffer>> gBuffers;
+	uint32 gNextThread = 0;
+
+	// Names given with SetThreadName, by trace id.
+	std::unordered_map<uint32, std::string> gThreadNames;
+
+	// Threads come and go (ParallelFor starts new ones on every call), so a buffer
+	// goes back to the pool when its thread exits and the next new thread takes it,
+	// under a new trace id.  The previous owner's events stay in the ring until they
+	// are overwritten, so the frame they were recorded in still counts them.
+	struct BufferOwner
+	{
+		ThreadBuffer* Buffer = nullptr;
+
+		~BufferOwner()
+		{
+			if(Buffer)
+				Buffer->InUse.store(false, std::memory_order_release);
+		}
+	};
+
+	thread_local BufferOwner tOwner;
+
+	ThreadBuffer& GetThreadBuffer()
+	{
+		if(tOwner.Buffer)
+			return *tOwner.Buffer;
+
+		std::lock_guard<std::mutex> lock(gBuffersMutex);
+		for(auto& buffer : gBuffers)
+		{
+			bool inUse = false;
+			if(buffer->InUse.compare_exchange_strong(inUse, true, std::memory_order_acquire))
+			{
+				buffer->Thread = gNextThread++;
+				tOwner.Buffer = buffer.get();
+				return *tOwner.Buffer;
+			}
+		}
+
+		auto buffer = std::make_unique<ThreadBuffer>();
+		buffer->Thread = gNextThread++;
+		buffer->InUse.store(true, std::memory_order_relaxed);
+
+		tOwner.Buffer = buffer.get();
+		gBuffers.push_back(std::move(buffer));
+		return *tOwner.Buffer;
+	}
+
+	// Appends the events of buffer that ended after sinceNs, oldest first.  The
+	// owner keeps writing meanwhile, so entries it may have overwritten during the
+	// copy are dropped afterwards.  This is a sequence lock with Head as the
+	// sequence: Record fences between reading Head and writing a slot, so a copy
+	// that saw any new field also sees the Head that marks the slot as reused.
+	void ReadEvents(const ThreadBuffer& buffer, std::int64_t sinceNs, std::vector<Event>& out)
+	{
+		const uint64 capacity = Profiler::EventsPerThread;
+		const uint64 head = buffer.Head.load(std::memory_order_acquire);
+		const uint64 oldest = head > capacity ? head - capacity : 0;
+
+		// Events are written in the order they end, so walk back from the newest.
+		uint64 first = head;
+		while(first > oldest && buffer.Events[(first - 1) % capacity].End.load(std::memory_order_relaxed) > sinceNs)
+			--first;
+
+		size_t start = out.size();
+		for(uint64 i = first; i < head; ++i)
+		{
+			const EventSlot& slot = buffer.Events[i % capacity];
+
+			Event e;
+			e.Name = slot.Name.load(std::memory_order_relaxed);
+			e.Start = slot.Start.load(std::memory_order_relaxed);
+			e.End = slot.End.load(std::memory_order_relaxed);
+			e.Thread = slot.Thread.load(std::memory_order_relaxed);
+			out.push_back(e);
+		}
+
+		// The entry being written when Head was read again may be torn as well.
+		std::atomic_thread_fence(std::memory_order_acquire);
+		const uint64 newHead = buffer.Head.load(std::memory_order_relaxed);
+		const uint64 valid = newHead + 1 > capacity ? newHead + 1 - capacity : 0;
+
+		if(valid > first)
+		{
+			size_t overwritten = (size_t)(std::min(valid, head) - first);
+			out.erase(out.begin() + start, out.begin() + start + overwritten);
+		}
+	}
+
+	void AppendJsonString(std::string& json, const char* s)
+	{
+		json += '"';
+		for(; *s; ++s)
+		{
+			unsigned char c = (unsigned char)*s;
+
+			if(c == '"' || c == '\\')
+			{
+				json += '\\';
+				json += *s;
+			}
+			else if(c == '\n')
+				json += "\\n";
+			else if(c == '\r')
+				json += "\\r";
+			else if(c == '\t')
+				json += "\\t";
+			else if(c < 0x20)
+			{
+				char escape[8];
+				std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+				json += escape;
+			}
+			else
+				json += *s;
+		}
+		json += '"';
+	}
+
+	std::int64_t gFrameStart = LLONG_MIN;
+	std::vector<Event> gFrameEvents;
+	std::vector<Profiler::ScopeStats> gFrameStats;
+}
+
+const Profiler::uint32 Profiler::EventsPerThread;
+
+void Profiler::SetEnabled(bool enabled)
+{
+	gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool Profiler::IsEnabled()
+{
+	return gEnabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::SetThreadName(const char* name)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	std::lock_guard<std::mutex> lock(gBuffersMutex);
+	gThreadNames[buffer.Thread] = name;
+}
+
+void Profiler::Record(const char* name, std::int64_t startNs, std::int64_t endNs)
+{
+	ThreadBuffer& buffer = GetThreadBuffer();
+
+	uint64 head = buffer.Head.load(std::memory_order_relaxed);
+	EventSlot& slot = buffer.Events[head % EventsPerThread];
+
+	// Orders the stores below after the one that published head; see ReadEvents.
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.Name.store(name, std::memory_order_relaxed);
+	slot.Start.store(startNs, std::memory_order_relaxed);
+	slot.End.store(endNs, std::memory_order_relaxed);
+	slot.Thread.store(buffer.Thread, std::memory_order_relaxed);
+	buffer.Head.store(head + 1, std::memory_order_release);
+}
+
+void Profiler::EndFrame()
+{
+	std::int64_t frameEnd = GameTimer::CurrentTimeNs();
+
+	gFrameEvents.clear();
+	{
+		std::lock_guard<std::mutex> lock(gBuffersMutex);
+		for(auto& buffer : gBuffers)
+			ReadEvents(*buffer, gFrameStart, gFrameEvents);
+	}
+
+	// A few dozen names per frame, so a linear search is fine.  The same literal can
+	// have different addresses in different translation units, hence the strcmp.
+	gFrameStats.clear();
+	for(const Event& e : gFrameEvents)
+	{
+		if(e.End > frameEnd)
+			continue;
+
+		auto it = std::find_if(gFrameStats.begin(), gFrameStats.end(), [&](const ScopeStats& s)
+		{
+			return s.Name == e.Name || std::strcmp(s.Name, e.Name) == 0;
+		});
+
+		if(it == gFrameStats.end())
+		{
+			ScopeStats stats;
+			stats.Name = e.Name;
+			gFrameStats.push_back(stats);
+			it = gFrameStats.end() - 1;
+		}
+
+		it->Count++;
+		it->TotalMs += (e.End - e.Start)*1e-6;
+	}
+
+	std::sort(gFrameStats.begin(), gFrameStats.end(), [](const ScopeStats& a, const ScopeStats& b)
+	{
+		return a.TotalMs > b.TotalMs;
+	});
+
+	gFrameStart = frameEnd;
+}
+
+const std::vector<Profiler::ScopeStats>& Profiler::GetFrameStats()
+{
+	return gFrameStats;
+}
+
+bool Profiler::WriteChromeTrace(const std::wstring& filename)
+{
+	// One track per thread that recorded events, which a pooled buffer can hold
+	// several of.
+	std::map<uint32, std::vector<Event>> tracks;
+	std::unordered_map<uint32, std::string> names;
+	{
+		std::lock_guard<std::mutex> lock(gBuffersMutex);
+
+		std::vector<Event> events;
+		for(auto& buffer : gBuffers)
+			ReadEvents(*buffer, LLONG_MIN, events);
+
+		for(const Event& e : events)
+			tracks[e.Thread].push_back(e);
+
+		names = gThreadNames;
+	}
+
+	// Timestamps are in microseconds from the oldest event.
+	std::int64_t epoch = LLONG_MAX;
+	for(auto& track : tracks)
+	{
+		for(auto& e : track.second)
+			epoch = std::min(epoch, e.Start);
+	}
+
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	bool first = true;
+	char number[128];
+
+	for(auto& track : tracks)
+	{
+		uint32 id = track.first;
+		auto named = names.find(id);
+		std::string name = named != names.end() ? named->second : "Worker " + std::to_string(id);
+
+		std::snprintf(number, sizeof(number), "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+			first ? "" : ",", id);
+		json += number;
+		AppendJsonString(json, name.c_str());
+		json += "}}";
+		first = false;
+
+		for(auto& e : track.second)
+		{
+			json += ",{\"name\":";
+			AppendJsonString(json, e.Name);
+			std::snprintf(number, sizeof(number), ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				id, (e.Start - epoch)*1e-3, (e.End - e.Start)*1e-3);
+			json += number;
+		}
+	}
+
+	json += "]}\n";
+
+	return MappedFile::Write(filename, json.data(), json.size());
+}
@@ -0,0 +1,100 @@
+//***************************************************************************************
+// Profiler.h
+//
+// Scoped CPU timing markers.  PROFILE_SCOPE("name") times the rest of the enclosing
+// block on whatever thread runs it.  Every thread records into its own ring of the
+// most recent events, so recording takes no locks and never allocates; the rings
+// are read when a frame is summarized or a trace is written.
+//
+// EndFrame sums the events of the frame that just ended by name, and
+// WriteChromeTrace saves the recorded events as Chrome trace JSON, which
+// chrome://tracing and Perfetto open.
+//***************************************************************************************
+
+#pragma once
+
+#include "GameTimer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+class Profiler
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	struct ScopeStats
+	{
+		const char* Name = nullptr;
+		uint32 Count = 0;
+		double TotalMs = 0.0;
+	};
+
+	// Events each thread keeps; older ones are overwritten.
+	static const uint32 EventsPerThread = 1 << 16;
+
+	///<summary>
+	/// Recording is on by default; turning it off makes a scope cost one load.
+	///</summary>
+	static void SetEnabled(bool enabled);
+	static bool IsEnabled();
+
+	///<summary>
+	/// Names the calling thread in traces.  Threads that do not set a name are
+	/// listed as workers.
+	///</summary>
+	static void SetThreadName(const char* name);
+
+	///<summary>
+	/// Adds a finished scope to the calling thread's ring.  name must be a string
+	/// literal or otherwise outlive the profiler.
+	///</summary>
+	static void Record(const char* name, std::int64_t startNs, std::int64_t endNs);
+
+	///<summary>
+	/// Marks the end of a frame and sums, over every thread, the scopes that ended
+	/// since the previous call.  Call once per frame from one thread.
+	///</summary>
+	static void EndFrame();
+
+	///<summary>
+	/// The sums made by the last EndFrame, largest total first.
+	///</summary>
+	static const std::vector<ScopeStats>& GetFrameStats();
+
+	///<summary>
+	/// Writes every event still in the rings as Chrome trace JSON.  Returns false if
+	/// the file cannot be written.
+	///</summary>
+	static bool WriteChromeTrace(const std::wstring& filename);
+};
+
+class ProfileScope
+{
+public:
+	explicit ProfileScope(const char* name)
+		: mName(Profiler::IsEnabled() ? name : nullptr)
+	{
+		if(mName)
+			mStart = GameTimer::CurrentTimeNs();
+	}
+
+	ProfileScope(const ProfileScope& rhs) = delete;
+	ProfileScope& operator=(const ProfileScope& rhs) = delete;
+
+	~ProfileScope()
+	{
+		if(mName)
+			Profiler::Record(mName, mStart, GameTimer::CurrentTimeNs());
+	}
+
+private:
+	const char* mName;
+	std::int64_t mStart = 0;
+};
+
+#define PROFILER_CONCAT_INNER(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_INNER(a, b)
+
+#define PROFILE_SCOPE(name) ProfileScope PROFILER_CONCAT(profileScope, __LINE__)(name)
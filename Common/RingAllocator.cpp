@@ -0,0 +1,119 @@
+//***************************************************************************************
+// RingAllocator.cpp
+//***************************************************************************************
+
+#include "RingAllocator.h"
+#include <algorithm>
+
+namespace
+{
+	using uint64 = RingAllocator::uint64;
+
+	uint64 AlignUp(uint64 value, uint64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+RingAllocator::RingAllocator(uint64 capacity)
+{
+	Reset(capacity);
+}
+
+bool RingAllocator::TryAllocate(uint64 size, uint64 alignment, uint64& offset)
+{
+	alignment = std::max<uint64>(alignment, 1);
+
+	uint64 used = mAllocated - mRetired;
+	if(used == 0)
+		mHead = mTail = 0;
+
+	uint64 start = AlignUp(mHead, alignment);
+
+	if(mHead >= mTail && !(used > 0 && mHead == mTail))
+	{
+		// Free space is [mHead, capacity) and then [0, mTail).
+		if(start + size <= mCapacity)
+		{
+			mAllocated += start + size - mHead;
+			mHead = start + size;
+		}
+		// Wrap, giving up the end of the buffer until this frame retires.
+		else if(size <= mTail)
+		{
+			start = 0;
+			mAllocated += (mCapacity - mHead) + size;
+			mHead = size;
+		}
+		else
+			return false;
+	}
+	else
+	{
+		// Wrapped: free space is [mHead, mTail).
+		if(start + size > mTail)
+			return false;
+
+		mAllocated += start + size - mHead;
+		mHead = start + size;
+	}
+
+	offset = start;
+	mHighWaterMark = std::max(mHighWaterMark, mAllocated - mRetired);
+	return true;
+}
+
+void RingAllocator::EndFrame(uint64 fence)
+{
+	mFrames.push_back({ fence, mHead, mAllocated });
+}
+
+void RingAllocator::Retire(uint64 completedFence)
+{
+	while(!mFrames.empty() && mFrames.front().Fence <= completedFence)
+	{
+		mTail = mFrames.front().Head;
+		mRetired = mFrames.front().Allocated;
+		mFrames.pop_front();
+	}
+}
+
+void RingAllocator::Reset(uint64 capacity)
+{
+	mCapacity = capacity;
+	mHead = 0;
+	mTail = 0;
+	mAllocated = 0;
+	mRetired = 0;
+	mFrames.clear();
+}
+
+uint64 RingAllocator::GetGrowCapacity(uint64 size, uint64 alignment)const
+{
+	return AlignUp(std::max(2*mCapacity, size + std::max<uint64>(alignment, 1)), 256);
+}
+
+uint64 RingAllocator::GetCapacity()const
+{
+	return mCapacity;
+}
+
+uint64 RingAllocator::GetUsed()const
+{
+	return mAllocated - mRetired;
+}
+
+uint64 RingAllocator::GetHighWaterMark()const
+{
+	return mHighWaterMark;
+}
+
+void RingAllocator::ResetHighWaterMark()
+{
+	mHighWaterMark = mAllocated - mRetired;
+}
+
+size_t RingAllocator::GetFramesInFlight()const
+{
+	return mFrames.size();
+}
@@ -0,0 +1,92 @@
+//***************************************************************************************
+// RingAllocator.h
+//
+// The offset and fence bookkeeping of UploadRing, without the buffer.  Ranges of a
+// buffer of Capacity bytes are handed out in order, wrapping at the end.  EndFrame
+// tags everything allocated since the previous call with the frame's fence value,
+// and Retire frees the frames whose fence has completed.
+//
+// TryAllocate fails when the free space cannot hold the request; the owner then
+// either waits for frames to retire or moves to a larger buffer with Reset.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+class RingAllocator
+{
+public:
+
+	using uint64 = std::uint64_t;
+
+	explicit RingAllocator(uint64 capacity);
+
+	///<summary>
+	/// Finds size bytes aligned to alignment, a power of two, and returns their
+	/// offset.  Returns false, changing nothing, if they do not fit.
+	///</summary>
+	bool TryAllocate(uint64 size, uint64 alignment, uint64& offset);
+
+	///<summary>
+	/// Ends the frame: everything allocated since the last call stays in use until
+	/// fence completes.
+	///</summary>
+	void EndFrame(uint64 fence);
+
+	///<summary>
+	/// Frees the frames whose fence is at most completedFence.
+	///</summary>
+	void Retire(uint64 completedFence);
+
+	///<summary>
+	/// Starts over on an empty buffer of capacity bytes, forgetting the frames in
+	/// flight.  The high-water mark is kept.
+	///</summary>
+	void Reset(uint64 capacity);
+
+	///<summary>
+	/// Capacity of the buffer to move to when TryAllocate(size, alignment) fails:
+	/// twice the current one, or enough for the request, in multiples of 256 bytes.
+	///</summary>
+	uint64 GetGrowCapacity(uint64 size, uint64 alignment)const;
+
+	uint64 GetCapacity()const;
+
+	// Bytes in use, counting alignment padding and the unused end of the buffer
+	// skipped when wrapping.
+	uint64 GetUsed()const;
+
+	// Most bytes ever in use at once, over every Reset.
+	uint64 GetHighWaterMark()const;
+	void ResetHighWaterMark();
+
+	// Frames ended and not yet retired.
+	size_t GetFramesInFlight()const;
+
+private:
+
+	struct FrameMark
+	{
+		uint64 Fence;
+		uint64 Head;
+		uint64 Allocated;
+	};
+
+	uint64 mCapacity = 0;
+
+	// Allocation starts at mHead; mTail is the start of the oldest frame in use.
+	uint64 mHead = 0;
+	uint64 mTail = 0;
+
+	// Bytes handed out and bytes retired since the last Reset; their difference is
+	// the amount in use.
+	uint64 mAllocated = 0;
+	uint64 mRetired = 0;
+
+	std::deque<FrameMark> mFrames;
+
+	uint64 mHighWaterMark = 0;
+};
@@ -0,0 +1,127 @@
+//***************************************************************************************
+// StreamingCopy.cpp
+//***************************************************************************************
+
+#include "StreamingCopy.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define STREAMINGCOPY_X86 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+	using uint8 = std::uint8_t;
+
+#if defined(STREAMINGCOPY_X86)
+	const size_t LineSize = 64;
+
+	bool IsLineAligned(const void* p)
+	{
+		return (reinterpret_cast<std::uintptr_t>(p) & (LineSize - 1)) == 0;
+	}
+
+	// Streams one cache line to a line-aligned dst.
+	void StreamLine(uint8* dst, const uint8* src)
+	{
+		__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+		__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+		__m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+		__m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+		_mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+	}
+
+	void CopyUnfenced(uint8* d, const uint8* s, size_t byteSize)
+	{
+		// Only whole cache lines are streamed.  A streaming store that leaves part
+		// of a line unwritten is flushed as a partial burst, which is far slower
+		// than the ordinary stores used for the lines at either end.
+		size_t head = (LineSize - (reinterpret_cast<std::uintptr_t>(d) & (LineSize - 1))) & (LineSize - 1);
+		if(head > byteSize)
+			head = byteSize;
+
+		memcpy(d, s, head);
+		d += head;
+		s += head;
+		byteSize -= head;
+
+		size_t i = 0;
+		for(; i + LineSize <= byteSize; i += LineSize)
+			StreamLine(d + i, s + i);
+
+		memcpy(d + i, s + i, byteSize - i);
+	}
+#endif
+}
+
+void StreamingCopy::Copy(void* dst, const void* src, size_t byteSize)
+{
+#if defined(STREAMINGCOPY_X86)
+	CopyUnfenced(static_cast<uint8*>(dst), static_cast<const uint8*>(src), byteSize);
+	_mm_sfence();
+#else
+	memcpy(dst, src, byteSize);
+#endif
+}
+
+void StreamingCopy::CopyStrided(void* dst, size_t dstStride, const void* src, size_t srcStride,
+	size_t elementSize, size_t count)
+{
+	CopyStridedUnfenced(dst, dstStride, src, srcStride, elementSize, count);
+	Fence();
+}
+
+void StreamingCopy::CopyStridedUnfenced(void* dst, size_t dstStride, const void* src, size_t srcStride,
+	size_t elementSize, size_t count)
+{
+	uint8* d = static_cast<uint8*>(dst);
+	const uint8* s = static_cast<const uint8*>(src);
+
+#if defined(STREAMINGCOPY_X86)
+	size_t paddedSize = (elementSize + LineSize - 1) & ~(LineSize - 1);
+
+	if(IsLineAligned(d) && dstStride % LineSize == 0 && dstStride >= paddedSize)
+	{
+		for(size_t i = 0; i < count; ++i, d += dstStride, s += srcStride)
+		{
+			size_t j = 0;
+			for(; j + LineSize <= elementSize; j += LineSize)
+				StreamLine(d + j, s + j);
+
+			// Pad the last partial line with zeros, so it is streamed whole too.
+			if(j < elementSize)
+			{
+				alignas(16) uint8 tail[LineSize] = {};
+				memcpy(tail, s + j, elementSize - j);
+				StreamLine(d + j, tail);
+			}
+		}
+		return;
+	}
+
+	// Contiguous elements are one copy.
+	if(dstStride == elementSize && srcStride == elementSize)
+	{
+		CopyUnfenced(d, s, elementSize*count);
+		return;
+	}
+
+	for(size_t i = 0; i < count; ++i, d += dstStride, s += srcStride)
+		CopyUnfenced(d, s, elementSize);
+#else
+	for(size_t i = 0; i < count; ++i, d += dstStride, s += srcStride)
+		memcpy(d, s, elementSize);
+#endif
+}
+
+void StreamingCopy::Fence()
+{
+#if defined(STREAMINGCOPY_X86)
+	_mm_sfence();
+#endif
+}
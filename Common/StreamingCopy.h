@@ -0,0 +1,53 @@
+//***************************************************************************************
+// StreamingCopy.h
+//
+// Copies into write-combined memory, such as mapped upload heaps, with
+// non-temporal SIMD stores.  The stores bypass the cache and fill whole 64-byte
+// write-combining buffers, so the data goes to memory in full bursts and does not
+// evict anything the CPU still needs.  Writing the same memory with memcpy works,
+// but it is prone to partial bursts, and any read of the destination, however
+// small, is uncached and very slow.
+//
+// Streaming stores are weakly ordered, so the copies end with a store fence that
+// makes the data visible before the command list that uses it is submitted.
+// Without SSE2 they fall back to memcpy.
+//***************************************************************************************
+
+#pragma once
+
+#include <cstddef>
+
+class StreamingCopy
+{
+public:
+
+	///<summary>
+	/// Copies byteSize bytes.  The whole 64-byte cache lines of dst are streamed;
+	/// partial lines at either end are written with ordinary stores, since a
+	/// partially streamed line is flushed as a slow partial burst.
+	///</summary>
+	static void Copy(void* dst, const void* src, size_t byteSize);
+
+	///<summary>
+	/// Copies count elements of elementSize bytes, srcStride bytes apart, to dst,
+	/// dstStride bytes apart.  When dst and dstStride are multiples of 64 and the
+	/// stride leaves room, each element is streamed in whole cache lines, its last
+	/// line padded with zeros, as for constant buffer elements with their 256-byte
+	/// stride.  Otherwise each element goes through Copy.
+	///</summary>
+	static void CopyStrided(void* dst, size_t dstStride, const void* src, size_t srcStride,
+		size_t elementSize, size_t count);
+
+	///<summary>
+	/// CopyStrided without the store fence, for callers that write many small
+	/// batches and call Fence once after the last.
+	///</summary>
+	static void CopyStridedUnfenced(void* dst, size_t dstStride, const void* src, size_t srcStride,
+		size_t elementSize, size_t count);
+
+	///<summary>
+	/// Makes earlier streaming stores visible before any later store.  Copy and
+	/// CopyStrided end with it.
+	///</summary>
+	static void Fence();
+};
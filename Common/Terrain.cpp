@@ -0,0 +1,292 @@
+//***************************************************************************************
+// Terrain.cpp
+//***************************************************************************************
+
+#include "Terrain.h"
+#include "ParallelFor.h"
+#include <algorithm>
+#include <cassert>
+
+using namespace DirectX;
+
+Terrain::Terrain(const Desc& desc, HeightFunction heightFunction)
+	: mDesc(desc), mHeightFunction(std::move(heightFunction))
+{
+	// MakeKey packs X and Z into 28 bits each.
+	assert(mDesc.MaxLevel <= 28);
+	assert(mDesc.ChunkCells > 0);
+}
+
+Terrain::Key Terrain::MakeKey(const ChunkId& id)
+{
+	return ((Key)id.Level << 56) | ((Key)id.X << 28) | (Key)id.Z;
+}
+
+Terrain::ChunkId Terrain::MakeId(Key key)
+{
+	const Key mask = ((Key)1 << 28) - 1;
+
+	ChunkId id;
+	id.Level = (uint32)(key >> 56);
+	id.X = (uint32)((key >> 28) & mask);
+	id.Z = (uint32)(key & mask);
+	return id;
+}
+
+void Terrain::SetEvictFunction(EvictFunction evict)
+{
+	mEvictFunction = std::move(evict);
+}
+
+void Terrain::GetArea(const ChunkId& id, float& width, float& depth, float& centerX, float& centerZ)const
+{
+	float scale = 1.0f / (float)(1u << id.Level);
+
+	width = mDesc.Width*scale;
+	depth = mDesc.Depth*scale;
+	centerX = -0.5f*mDesc.Width + (id.X + 0.5f)*width;
+	centerZ = 0.5f*mDesc.Depth - (id.Z + 0.5f)*depth;
+}
+
+float Terrain::GetHeight(float x, float z)const
+{
+	return mHeightFunction(x, z);
+}
+
+BoundingBox Terrain::GetBounds(const ChunkId& id)const
+{
+	auto it = mCache.find(MakeKey(id));
+	if(it != mCache.end())
+		return it->second.Mesh->Bounds;
+
+	float width, depth, centerX, centerZ;
+	GetArea(id, width, depth, centerX, centerZ);
+
+	// The skirts hang below the lowest height.
+	float minHeight = mDesc.MinHeight - mDesc.SkirtDepth;
+	float maxHeight = mDesc.MaxHeight;
+
+	return BoundingBox(
+		XMFLOAT3(centerX, 0.5f*(minHeight + maxHeight), centerZ),
+		XMFLOAT3(0.5f*width, 0.5f*(maxHeight - minHeight), 0.5f*depth));
+}
+
+void Terrain::Select(const XMFLOAT3& eyePos, const BoundingFrustum* frustum, std::vector<Chunk>& chunks)
+{
+	chunks.clear();
+
+	SelectNode(ChunkId(), eyePos, frustum, chunks);
+	GenerateMissing(chunks);
+	Trim();
+}
+
+void Terrain::SelectNode(const ChunkId& id, const XMFLOAT3& eyePos, const BoundingFrustum* frustum,
+						 std::vector<Chunk>& chunks)
+{
+	BoundingBox bounds = GetBounds(id);
+	if(frustum != nullptr && frustum->Contains(bounds) == DISJOINT)
+		return;
+
+	if(id.Level < mDesc.MaxLevel)
+	{
+		// Distance from the eye to the closest point of the node.
+		XMVECTOR center = XMLoadFloat3(&bounds.Center);
+		XMVECTOR extents = XMLoadFloat3(&bounds.Extents);
+		XMVECTOR offset = XMVectorAbs(XMVectorSubtract(XMLoadFloat3(&eyePos), center));
+		offset = XMVectorMax(XMVectorSubtract(offset, extents), XMVectorZero());
+		float distance = XMVectorGetX(XMVector3Length(offset));
+
+		float size = 2.0f*std::max(bounds.Extents.x, bounds.Extents.z);
+		if(distance < mDesc.LodDistance*size)
+		{
+			for(uint32 i = 0; i < 4; ++i)
+			{
+				ChunkId child;
+				child.Level = id.Level + 1;
+				child.X = 2*id.X + (i & 1);
+				child.Z = 2*id.Z + (i >> 1);
+
+				SelectNode(child, eyePos, frustum, chunks);
+			}
+			return;
+		}
+	}
+
+	Chunk chunk;
+	chunk.Id = id;
+
+	auto it = mCache.find(MakeKey(id));
+	if(it != mCache.end())
+	{
+		chunk.Mesh = it->second.Mesh;
+		Touch(it->second);
+		mStats.Hits++;
+	}
+
+	chunks.push_back(chunk);
+}
+
+void Terrain::GenerateMissing(std::vector<Chunk>& chunks)
+{
+	std::vector<uint32> missing;
+	for(uint32 i = 0; i < (uint32)chunks.size(); ++i)
+	{
+		if(chunks[i].Mesh == nullptr)
+			missing.push_back(i);
+	}
+
+	ParallelFor((uint32)missing.size(), mDesc.ThreadCount, [&](uint32 i)
+	{
+		Chunk& chunk = chunks[missing[i]];
+		chunk.Mesh = std::make_shared<const GeometryGenerator::MeshData>(CreateChunk(chunk.Id));
+	});
+
+	for(uint32 i : missing)
+		Insert(MakeKey(chunks[i].Id), chunks[i].Mesh);
+
+	mStats.Generated += (uint32)missing.size();
+}
+
+Terrain::MeshPtr Terrain::GetChunk(const ChunkId& id)
+{
+	Key key = MakeKey(id);
+
+	auto it = mCache.find(key);
+	if(it != mCache.end())
+	{
+		Touch(it->second);
+		mStats.Hits++;
+		return it->second.Mesh;
+	}
+
+	MeshPtr mesh = std::make_shared<const GeometryGenerator::MeshData>(CreateChunk(id));
+	Insert(key, mesh);
+	mStats.Generated++;
+	Trim();
+
+	return mesh;
+}
+
+GeometryGenerator::MeshData Terrain::CreateChunk(const ChunkId& id)const
+{
+	using Vertex = GeometryGenerator::Vertex;
+
+	float width, depth, centerX, centerZ;
+	GetArea(id, width, depth, centerX, centerZ);
+
+	uint32 cells = mDesc.ChunkCells;
+	uint32 n = cells + 1;
+
+	// Start from a flat grid of the node's size, then move it into place and
+	// displace it by the heightfield.
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData meshData = geoGen.CreateGrid(width, depth, n, n);
+
+	float dx = width / cells;
+	float dz = depth / cells;
+
+	for(Vertex& v : meshData.Vertices)
+	{
+		float x = v.Position.x + centerX;
+		float z = v.Position.z + centerZ;
+
+		// Central differences.  Sampling the heightfield rather than the chunk's
+		// own vertices keeps the normals continuous across chunk borders.
+		float dhdx = (GetHeight(x + dx, z) - GetHeight(x - dx, z)) / (2.0f*dx);
+		float dhdz = (GetHeight(x, z + dz) - GetHeight(x, z - dz)) / (2.0f*dz);
+
+		v.Position = XMFLOAT3(x, GetHeight(x, z), z);
+		XMStoreFloat3(&v.Normal, XMVector3Normalize(XMVectorSet(-dhdx, 1.0f, -dhdz, 0.0f)));
+		XMStoreFloat3(&v.TangentU, XMVector3Normalize(XMVectorSet(1.0f, dhdx, 0.0f, 0.0f)));
+
+		// Texture coordinates over the whole world, so they line up between chunks.
+		v.TexC.x = (x + 0.5f*mDesc.Width) / mDesc.Width;
+		v.TexC.y = (0.5f*mDesc.Depth - z) / mDesc.Depth;
+	}
+
+	//
+	// Skirts.  Walk the border clockwise seen from above (along the +z row, down the
+	// +x column, back along the -z row and up the -x column) and hang a copy of each
+	// border vertex SkirtDepth below it.
+	//
+
+	std::vector<uint32> border;
+	border.reserve(4*cells);
+	for(uint32 j = 0; j < cells; ++j)
+		border.push_back(j);
+	for(uint32 i = 0; i < cells; ++i)
+		border.push_back(i*n + cells);
+	for(uint32 j = cells; j > 0; --j)
+		border.push_back(cells*n + j);
+	for(uint32 i = cells; i > 0; --i)
+		border.push_back(i*n);
+
+	uint32 skirtBase = (uint32)meshData.Vertices.size();
+	for(uint32 b : border)
+	{
+		Vertex v = meshData.Vertices[b];
+		v.Position.y -= mDesc.SkirtDepth;
+		meshData.Vertices.push_back(v);
+	}
+
+	uint32 borderCount = (uint32)border.size();
+	for(uint32 k = 0; k < borderCount; ++k)
+	{
+		uint32 next = (k + 1) % borderCount;
+
+		uint32 a = border[k];
+		uint32 b = border[next];
+		uint32 aSkirt = skirtBase + k;
+		uint32 bSkirt = skirtBase + next;
+
+		meshData.Indices32.push_back(a);
+		meshData.Indices32.push_back(aSkirt);
+		meshData.Indices32.push_back(b);
+
+		meshData.Indices32.push_back(b);
+		meshData.Indices32.push_back(aSkirt);
+		meshData.Indices32.push_back(bSkirt);
+	}
+
+	GeometryGenerator::ComputeBounds(meshData);
+
+	return meshData;
+}
+
+void Terrain::Touch(CacheEntry& entry)
+{
+	mLru.splice(mLru.begin(), mLru, entry.LruPosition);
+}
+
+void Terrain::Insert(Key key, const MeshPtr& mesh)
+{
+	mLru.push_front(key);
+
+	CacheEntry& entry = mCache[key];
+	entry.Mesh = mesh;
+	entry.LruPosition = mLru.begin();
+}
+
+void Terrain::Trim()
+{
+	while(mCache.size() > mDesc.MaxCachedChunks)
+	{
+		Key key = mLru.back();
+		mCache.erase(key);
+		mLru.pop_back();
+		mStats.Evicted++;
+
+		if(mEvictFunction)
+			mEvictFunction(MakeId(key));
+	}
+}
+
+Terrain::uint32 Terrain::GetCachedChunkCount()const
+{
+	return (uint32)mCache.size();
+}
+
+Terrain::Stats Terrain::GetStats()const
+{
+	return mStats;
+}
@@ -0,0 +1,162 @@
+//***************************************************************************************
+// Terrain.h
+//
+// Chunked heightfield terrain.  The world is the root of a quadtree whose nodes all
+// carry a grid of the same number of cells, so a node one level deeper covers a
+// quarter of the area at twice the detail.  Each frame Select walks the tree from
+// the eye, splitting nodes that are close compared to their size and dropping nodes
+// outside the frustum, and returns the chunks to draw.
+//
+// Neighbouring chunks of different levels do not share their edge vertices, so each
+// chunk hangs a skirt down from its border to hide the cracks.  Chunk meshes are
+// generated on demand and kept in a least recently used cache of bounded size, so
+// the memory used does not depend on the size of the world.  Data kept per chunk
+// elsewhere, such as GPU buffers, can follow the cache through an evict function.
+//
+// A Terrain must only be used from one thread at a time; Select generates the
+// missing chunks of a frame on worker threads.
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <functional>
+#include <list>
+#include <memory>
+#include <unordered_map>
+
+class Terrain
+{
+public:
+
+	using uint32 = GeometryGenerator::uint32;
+	using MeshPtr = std::shared_ptr<const GeometryGenerator::MeshData>;
+
+	// Height of the terrain at world position (x, z).  Called from worker threads.
+	using HeightFunction = std::function<float(float x, float z)>;
+
+	struct Desc
+	{
+		// Size of the world in the xz-plane, centered at the origin.
+		float Width = 0.0f;
+		float Depth = 0.0f;
+
+		// Quads along each side of every chunk, and the number of levels below the
+		// root.  The finest chunks are Width/2^MaxLevel wide.
+		uint32 ChunkCells = 32;
+		uint32 MaxLevel = 4;
+
+		// Range of the height function.  Used for the bounds of chunks that have not
+		// been generated yet, so it must contain every height.
+		float MinHeight = 0.0f;
+		float MaxHeight = 0.0f;
+
+		// How far the skirts reach below the chunk border.  It has to cover the
+		// largest height difference between two levels along a shared edge.
+		float SkirtDepth = 1.0f;
+
+		// A node is split while the eye is closer than LodDistance times its size.
+		float LodDistance = 2.0f;
+
+		// Chunks kept in the cache.  Chunks selected in one frame may exceed it;
+		// the least recently used chunks are dropped after every Select.
+		uint32 MaxCachedChunks = 256;
+
+		uint32 ThreadCount = 0;
+	};
+
+	// Node of the quadtree.  Level 0 is the root, and X and Z count the nodes of a
+	// level from the -x, +z corner of the world, like the rows and columns of
+	// CreateGrid.
+	struct ChunkId
+	{
+		uint32 Level = 0;
+		uint32 X = 0;
+		uint32 Z = 0;
+	};
+
+	struct Chunk
+	{
+		ChunkId Id;
+		MeshPtr Mesh;
+	};
+
+	// Called with every chunk the cache drops.
+	using EvictFunction = std::function<void(const ChunkId& id)>;
+
+	// Unique among the nodes of one terrain, for keying data kept per chunk.
+	using Key = std::uint64_t;
+	static Key MakeKey(const ChunkId& id);
+
+	struct Stats
+	{
+		uint32 Hits = 0;
+		uint32 Generated = 0;
+		uint32 Evicted = 0;
+	};
+
+	Terrain(const Desc& desc, HeightFunction heightFunction);
+	Terrain(const Terrain& rhs) = delete;
+	Terrain& operator=(const Terrain& rhs) = delete;
+
+	///<summary>
+	/// Fills chunks with the chunks to draw from eyePos.  Nodes outside frustum (in
+	/// world space) are skipped; pass nullptr to keep every node.  The returned meshes
+	/// are in world space and stay valid while they are referenced, even after the
+	/// cache drops them.
+	///</summary>
+	void Select(const DirectX::XMFLOAT3& eyePos, const DirectX::BoundingFrustum* frustum, std::vector<Chunk>& chunks);
+
+	///<summary>
+	/// Returns the mesh of one chunk, generating it if it is not cached.
+	///</summary>
+	MeshPtr GetChunk(const ChunkId& id);
+
+	///<summary>
+	/// evict is called, on the calling thread, with each chunk Select or GetChunk
+	/// drops from the cache.  A chunk selected in the same call may be among them.
+	///</summary>
+	void SetEvictFunction(EvictFunction evict);
+
+	///<summary>
+	/// Bounds of a node: the exact bounds of its mesh when it is cached, otherwise
+	/// its area with the height range of the Desc.
+	///</summary>
+	DirectX::BoundingBox GetBounds(const ChunkId& id)const;
+
+	float GetHeight(float x, float z)const;
+
+	uint32 GetCachedChunkCount()const;
+	Stats GetStats()const;
+
+private:
+	struct CacheEntry
+	{
+		MeshPtr Mesh;
+		std::list<Key>::iterator LruPosition;
+	};
+
+	static ChunkId MakeId(Key key);
+
+	void SelectNode(const ChunkId& id, const DirectX::XMFLOAT3& eyePos, const DirectX::BoundingFrustum* frustum,
+					std::vector<Chunk>& chunks);
+
+	void GenerateMissing(std::vector<Chunk>& chunks);
+	GeometryGenerator::MeshData CreateChunk(const ChunkId& id)const;
+
+	// Size and center of a node in the xz-plane.
+	void GetArea(const ChunkId& id, float& width, float& depth, float& centerX, float& centerZ)const;
+
+	// Moves entry to the front of the LRU list.
+	void Touch(CacheEntry& entry);
+	void Insert(Key key, const MeshPtr& mesh);
+	void Trim();
+
+	Desc mDesc;
+	HeightFunction mHeightFunction;
+	EvictFunction mEvictFunction;
+
+	std::unordered_map<Key, CacheEntry> mCache;
+	std::list<Key> mLru; // Most recently used first.
+	Stats mStats;
+};
@@ -0,0 +1,271 @@
+//***************************************************************************************
+// TransformHierarchy.cpp
+//***************************************************************************************
+
+#include "TransformHierarchy.h"
+#include "ParallelFor.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	// Levels with fewer dirty nodes than this are not worth waking threads for.
+	const std::uint32_t ParallelThreshold = 4096;
+
+	// Nodes per job of a parallel level.
+	const std::uint32_t JobSize = 1024;
+}
+
+const TransformHierarchy::uint32 TransformHierarchy::None;
+
+TransformHierarchy::TransformHierarchy(uint32 threadCount)
+	: mThreadCount(threadCount)
+{
+}
+
+TransformHierarchy::uint32 TransformHierarchy::AddNode(uint32 parent, CXMMATRIX local, uint32 slot)
+{
+	uint32 node = (uint32)mParentNode.size();
+	uint32 depth = parent == None ? 0 : mDepth[parent] + 1;
+
+	mParentNode.push_back(parent);
+	mDepth.push_back(depth);
+	mPosition.push_back(node);
+
+	// Appended for now; Rebuild moves it into its level.
+	XMFLOAT4X4 m;
+	XMStoreFloat4x4(&m, local);
+	mLocal.push_back(m);
+	mWorld.push_back(m);
+	mParent.push_back(None);
+	mFirstChild.push_back(0);
+	mChildCount.push_back(0);
+	mSlot.push_back(slot);
+	mNode.push_back(node);
+
+	mQueued.push_back(0);
+
+	if(depth >= mQueues.size())
+		mQueues.resize(depth + 1);
+
+	mLayoutChanged = true;
+	return node;
+}
+
+void TransformHierarchy::SetLocal(uint32 node, CXMMATRIX local)
+{
+	uint32 position = mPosition[node];
+	XMStoreFloat4x4(&mLocal[position], local);
+
+	// The whole tree is recomputed after a rebuild anyway.
+	if(!mLayoutChanged)
+		Queue(position);
+}
+
+const XMFLOAT4X4& TransformHierarchy::GetLocal(uint32 node)const
+{
+	return mLocal[mPosition[node]];
+}
+
+const XMFLOAT4X4& TransformHierarchy::GetWorld(uint32 node)const
+{
+	return mWorld[mPosition[node]];
+}
+
+TransformHierarchy::uint32 TransformHierarchy::GetParent(uint32 node)const
+{
+	return mParentNode[node];
+}
+
+TransformHierarchy::uint32 TransformHierarchy::GetSlot(uint32 node)const
+{
+	return mSlot[mPosition[node]];
+}
+
+size_t TransformHierarchy::GetNodeCount()const
+{
+	return mParentNode.size();
+}
+
+void TransformHierarchy::Queue(uint32 position)
+{
+	if(mQueued[position])
+		return;
+
+	mQueued[position] = 1;
+	mQueues[mDepth[mNode[position]]].push_back(position);
+}
+
+void TransformHierarchy::Rebuild()
+{
+	const uint32 count = (uint32)mParentNode.size();
+
+	// Children of each node, in handle order, as ranges of one array.
+	std::vector<uint32> childStart(count + 1, 0);
+	for(uint32 node = 0; node < count; ++node)
+	{
+		if(mParentNode[node] != None)
+			++childStart[mParentNode[node] + 1];
+	}
+
+	for(uint32 node = 0; node < count; ++node)
+		childStart[node + 1] += childStart[node];
+
+	std::vector<uint32> children(childStart[count]);
+	std::vector<uint32> fill(childStart.begin(), childStart.end() - 1);
+	for(uint32 node = 0; node < count; ++node)
+	{
+		if(mParentNode[node] != None)
+			children[fill[mParentNode[node]]++] = node;
+	}
+
+	// Breadth-first order: the roots, then the children of each node in turn.
+	std::vector<uint32> order;
+	order.reserve(count);
+	for(uint32 node = 0; node < count; ++node)
+	{
+		if(mParentNode[node] == None)
+			order.push_back(node);
+	}
+
+	for(size_t i = 0; i < order.size(); ++i)
+		order.insert(order.end(), children.begin() + childStart[order[i]], children.begin() + childStart[order[i] + 1]);
+
+	std::vector<XMFLOAT4X4> local(count);
+	std::vector<uint32> slot(count);
+	for(uint32 position = 0; position < count; ++position)
+	{
+		uint32 node = order[position];
+		local[position] = mLocal[mPosition[node]];
+		slot[position] = mSlot[mPosition[node]];
+	}
+
+	for(uint32 position = 0; position < count; ++position)
+	{
+		mNode[position] = order[position];
+		mPosition[order[position]] = position;
+	}
+
+	// The depth never decreases along the order, so each level is a range.
+	mLevelStart.assign(mQueues.size() + 1, 0);
+	for(uint32 node = 0; node < count; ++node)
+		++mLevelStart[mDepth[node] + 1];
+
+	for(size_t level = 0; level < mQueues.size(); ++level)
+		mLevelStart[level + 1] += mLevelStart[level];
+
+	for(uint32 position = 0; position < count; ++position)
+	{
+		uint32 node = order[position];
+		uint32 parent = mParentNode[node];
+		uint32 childCount = childStart[node + 1] - childStart[node];
+
+		mParent[position] = parent == None ? None : mPosition[parent];
+		mChildCount[position] = childCount;
+		mFirstChild[position] = childCount > 0 ? mPosition[children[childStart[node]]] : 0;
+	}
+
+	mLocal = std::move(local);
+	mSlot = std::move(slot);
+
+	for(auto& queue : mQueues)
+		queue.clear();
+
+	std::fill(mQueued.begin(), mQueued.end(), 0);
+
+	mLayoutChanged = false;
+}
+
+void TransformHierarchy::UpdateWorlds(const uint32* positions, uint32 first, uint32 count)
+{
+	for(uint32 i = 0; i < count; ++i)
+	{
+		uint32 p = positions ? positions[i] : first + i;
+		XMMATRIX local = XMLoadFloat4x4(&mLocal[p]);
+
+		if(mParent[p] == None)
+			XMStoreFloat4x4(&mWorld[p], local);
+		else
+			XMStoreFloat4x4(&mWorld[p], XMMatrixMultiply(local, XMLoadFloat4x4(&mWorld[mParent[p]])));
+	}
+}
+
+void TransformHierarchy::Recompute(const uint32* positions, uint32 first, uint32 count)
+{
+	if(count < ParallelThreshold || mThreadCount == 1)
+	{
+		UpdateWorlds(positions, first, count);
+		return;
+	}
+
+	uint32 jobCount = (count + JobSize - 1) / JobSize;
+	ParallelFor(jobCount, mThreadCount, [&](uint32 job)
+	{
+		uint32 begin = job*JobSize;
+		uint32 size = std::min(JobSize, count - begin);
+
+		if(positions)
+			UpdateWorlds(positions + begin, 0, size);
+		else
+			UpdateWorlds(nullptr, first + begin, size);
+	});
+}
+
+void TransformHierarchy::Update(std::vector<uint32>& changedSlots)
+{
+	changedSlots.clear();
+
+	// A new layout recomputes everything.
+	bool wholeLevel = mLayoutChanged;
+	if(mLayoutChanged)
+		Rebuild();
+
+	for(size_t level = 0; level < mQueues.size(); ++level)
+	{
+		std::vector<uint32>& queue = mQueues[level];
+		uint32 first = mLevelStart[level];
+		uint32 count = mLevelStart[level + 1] - first;
+
+		// Once a whole level is dirty, so is every level below it, and the levels
+		// are walked as ranges with no queues.
+		wholeLevel = wholeLevel || queue.size() == count;
+		if(wholeLevel)
+		{
+			for(uint32 p : queue)
+				mQueued[p] = 0;
+			queue.clear();
+
+			Recompute(nullptr, first, count);
+
+			for(uint32 p = first; p < first + count; ++p)
+			{
+				if(mSlot[p] != None)
+					changedSlots.push_back(mSlot[p]);
+			}
+
+			continue;
+		}
+
+		if(queue.empty())
+			continue;
+
+		// Walk the level's arrays front to back.
+		std::sort(queue.begin(), queue.end());
+		Recompute(queue.data(), 0, (uint32)queue.size());
+
+		// The children of everything that changed change as well.
+		for(uint32 p : queue)
+		{
+			if(mSlot[p] != None)
+				changedSlots.push_back(mSlot[p]);
+
+			for(uint32 c = mFirstChild[p]; c < mFirstChild[p] + mChildCount[p]; ++c)
+				Queue(c);
+
+			mQueued[p] = 0;
+		}
+
+		queue.clear();
+	}
+}
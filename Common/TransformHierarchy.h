@@ -0,0 +1,101 @@
+//***************************************************************************************
+// TransformHierarchy.h
+//
+// Parent/child transforms.  Each node has a local matrix relative to its parent,
+// and Update derives the world matrices from them.
+//
+// The nodes are stored as parallel arrays in breadth-first order: every level of
+// the tree is one contiguous range, and the children of a node are contiguous in
+// the next level.  Update only visits nodes whose local matrix was set since the
+// last update and their descendants.  It goes one level at a time, since all the
+// parents of a level are final once the level above it is done; large levels are
+// split across threads.  The cost is therefore proportional to what moved rather
+// than to the size of the tree.
+//
+// Nodes can carry a slot, such as an object constant buffer index, and Update
+// reports the slots whose world matrix changed, in the order it recomputed them.
+//***************************************************************************************
+
+#pragma once
+
+#include "MathHelper.h"
+#include <vector>
+
+class TransformHierarchy
+{
+public:
+
+	using uint32 = std::uint32_t;
+
+	// No parent, or no slot.
+	static const uint32 None = 0xffffffff;
+
+	///<summary>
+	/// threadCount limits the threads Update uses for large levels; 0 uses one
+	/// per hardware thread.
+	///</summary>
+	explicit TransformHierarchy(uint32 threadCount = 0);
+
+	///<summary>
+	/// Adds a node under parent (None for a root) and returns its handle.  The
+	/// parent must already exist.  Handles are handed out in order starting at
+	/// zero and stay valid.  The arrays are reordered on the next Update, which
+	/// then recomputes every node.
+	///</summary>
+	uint32 AddNode(uint32 parent, DirectX::CXMMATRIX local, uint32 slot = None);
+
+	void SetLocal(uint32 node, DirectX::CXMMATRIX local);
+
+	const DirectX::XMFLOAT4X4& GetLocal(uint32 node)const;
+
+	// World matrix as of the last Update.
+	const DirectX::XMFLOAT4X4& GetWorld(uint32 node)const;
+
+	uint32 GetParent(uint32 node)const;
+	uint32 GetSlot(uint32 node)const;
+	size_t GetNodeCount()const;
+
+	///<summary>
+	/// Brings the world matrices of changed nodes and their descendants up to date
+	/// and replaces changedSlots with the slots of those nodes, in breadth-first
+	/// order: level by level from the roots, and within a level in the order of
+	/// the arrays, so parents come before their children.
+	///</summary>
+	void Update(std::vector<uint32>& changedSlots);
+
+private:
+
+	// Sorts the nodes into breadth-first order.
+	void Rebuild();
+
+	void Queue(uint32 position);
+
+	// Recomputes count nodes of one level: positions[0, count), or the range
+	// starting at first when positions is null.
+	void Recompute(const uint32* positions, uint32 first, uint32 count);
+	void UpdateWorlds(const uint32* positions, uint32 first, uint32 count);
+
+	uint32 mThreadCount = 0;
+	bool mLayoutChanged = false;
+
+	// By handle.
+	std::vector<uint32> mParentNode;
+	std::vector<uint32> mDepth;
+	std::vector<uint32> mPosition;
+
+	// By position in breadth-first order.
+	std::vector<DirectX::XMFLOAT4X4> mLocal;
+	std::vector<DirectX::XMFLOAT4X4> mWorld;
+	std::vector<uint32> mParent;
+	std::vector<uint32> mFirstChild;
+	std::vector<uint32> mChildCount;
+	std::vector<uint32> mSlot;
+	std::vector<uint32> mNode;
+	std::vector<std::uint8_t> mQueued;
+
+	// First position of each level, plus the node count.
+	std::vector<uint32> mLevelStart;
+
+	// Positions to recompute, by level.
+	std::vector<std::vector<uint32>> mQueues;
+};
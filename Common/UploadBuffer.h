@@ -1,6 +1,9 @@
 #pragma once
 
 #include "d3dUtil.h"
+#include "StreamingCopy.h"
+#include <new>
+#include <type_traits>
 
 template<typename T>
 class UploadBuffer
@@ -55,6 +58,51 @@ public:
         memcpy(&mMappedData[elementIndex*mElementByteSize], &data, sizeof(T));
     }
 
+    // Writes count contiguous elements starting at firstIndex in one call, with
+    // streaming stores.  Constant buffer elements are written whole, padding
+    // included, so each one goes out in full 64-byte bursts.
+    void CopyData(int firstIndex, const T* data, UINT count)
+    {
+        StreamingCopy::CopyStrided(&mMappedData[firstIndex*mElementByteSize], mElementByteSize,
+            data, sizeof(T), sizeof(T), count);
+    }
+
+    // Builds count elements starting at firstIndex: each is default-constructed,
+    // filled in by build(i, element) and streamed out.  The elements are built in a
+    // staging copy on the stack, because the mapped memory is write-combined and a
+    // build that read back a member it had written would read it uncached.  The
+    // store fence comes once at the end, so build a batch per call.
+    template<typename Build>
+    void EmplaceData(int firstIndex, UINT count, Build&& build)
+    {
+        static_assert(std::is_trivially_destructible<T>::value,
+            "EmplaceData copies the staged elements without destroying them.");
+
+        alignas(16) alignas(T) BYTE staging[sizeof(T)];
+        for(UINT i = 0; i < count; ++i)
+        {
+            T* element = new(staging) T();
+            build(i, *element);
+
+            StreamingCopy::CopyStridedUnfenced(&mMappedData[(firstIndex + i)*mElementByteSize],
+                mElementByteSize, element, sizeof(T), sizeof(T), 1);
+        }
+
+        StreamingCopy::Fence();
+    }
+
+    // Mapped memory of an element, for writing many elements at once.  Elements
+    // are ElementByteSize() bytes apart.
+    BYTE* MappedData(int elementIndex)
+    {
+        return &mMappedData[elementIndex*mElementByteSize];
+    }
+
+    UINT ElementByteSize()const
+    {
+        return mElementByteSize;
+    }
+
 private:
     Microsoft::WRL::ComPtr<ID3D12Resource> mUploadBuffer;
     BYTE* mMappedData = nullptr;
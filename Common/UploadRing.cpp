@@ -0,0 +1,131 @@
+//***************************************************************************************
+// UploadRing.cpp
+//***************************************************************************************
+
+#include "UploadRing.h"
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	UINT64 AlignUp(UINT64 value, UINT64 alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+}
+
+UploadRing::UploadRing(ID3D12Device* device, const Desc& desc)
+	: mDevice(device), mRing(0)
+{
+	CreateBuffer(AlignUp(std::max<UINT64>(desc.Capacity, 256), 256));
+}
+
+UploadRing::~UploadRing()
+{
+	if(mBuffer != nullptr)
+		mBuffer->Unmap(0, nullptr);
+}
+
+void UploadRing::CreateBuffer(UINT64 capacity)
+{
+	ComPtr<ID3D12Resource> buffer;
+	ThrowIfFailed(mDevice->CreateCommittedResource(
+		&CD3DX12_HEAP_PROPERTIES(D3D12_HEAP_TYPE_UPLOAD),
+		D3D12_HEAP_FLAG_NONE,
+		&CD3DX12_RESOURCE_DESC::Buffer(capacity),
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(&buffer)));
+
+	BYTE* mappedData = nullptr;
+	ThrowIfFailed(buffer->Map(0, nullptr, reinterpret_cast<void**>(&mappedData)));
+
+	// Frames still in flight may use the old buffer; it is released once the fence
+	// of the current frame, the last one that can use it, completes.
+	if(mBuffer != nullptr)
+	{
+		mBuffer->Unmap(0, nullptr);
+		mRetiredBuffers.push_back({ mBuffer, 0, false });
+	}
+
+	mBuffer = buffer;
+	mMappedData = mappedData;
+	mGpuAddress = mBuffer->GetGPUVirtualAddress();
+	mRing.Reset(capacity);
+}
+
+UploadRing::Allocation UploadRing::Allocate(UINT64 size, UINT64 alignment)
+{
+	UINT64 offset = 0;
+	if(!mRing.TryAllocate(size, alignment, offset))
+	{
+		CreateBuffer(mRing.GetGrowCapacity(size, alignment));
+		mGrowCount++;
+
+		bool allocated = mRing.TryAllocate(size, alignment, offset);
+		assert(allocated);
+	}
+
+	Allocation allocation;
+	allocation.CpuAddress = mMappedData + offset;
+	allocation.GpuAddress = mGpuAddress + offset;
+	allocation.Resource = mBuffer.Get();
+	allocation.Offset = offset;
+	allocation.Size = size;
+	return allocation;
+}
+
+UploadRing::Allocation UploadRing::AllocateConstants(UINT64 size)
+{
+	return Allocate(d3dUtil::CalcConstantBufferByteSize((UINT)size), D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+}
+
+void UploadRing::EndFrame(UINT64 fence)
+{
+	mRing.EndFrame(fence);
+
+	for(auto& retired : mRetiredBuffers)
+	{
+		if(!retired.FenceKnown)
+		{
+			retired.Fence = fence;
+			retired.FenceKnown = true;
+		}
+	}
+}
+
+void UploadRing::Retire(UINT64 completedFence)
+{
+	mRing.Retire(completedFence);
+
+	mRetiredBuffers.erase(std::remove_if(mRetiredBuffers.begin(), mRetiredBuffers.end(),
+		[&](const RetiredBuffer& retired)
+		{
+			return retired.FenceKnown && retired.Fence <= completedFence;
+		}), mRetiredBuffers.end());
+}
+
+UINT64 UploadRing::GetCapacity()const
+{
+	return mRing.GetCapacity();
+}
+
+UINT64 UploadRing::GetUsed()const
+{
+	return mRing.GetUsed();
+}
+
+UINT64 UploadRing::GetHighWaterMark()const
+{
+	return mRing.GetHighWaterMark();
+}
+
+void UploadRing::ResetHighWaterMark()
+{
+	mRing.ResetHighWaterMark();
+}
+
+UINT UploadRing::GetGrowCount()const
+{
+	return mGrowCount;
+}
@@ -0,0 +1,127 @@
+//***************************************************************************************
+// UploadRing.h
+//
+// Linear allocator for data the CPU writes every frame: constants, dynamic vertices
+// and indices.  Chunks are handed out in order from one persistently mapped upload
+// buffer used as a ring.  EndFrame tags everything allocated since the previous call
+// with the frame's fence value, and Retire frees the frames whose fence the GPU has
+// completed, so memory is reused as soon as the GPU is done with it.
+//
+// Nothing is sized per type or per object: when the ring is full it is replaced by
+// one twice the size, and the old buffer is released once the frames that used it
+// have retired.  GetHighWaterMark shows how large the ring needs to be.
+//
+// The offsets and fences are kept by a RingAllocator; this class adds the buffer.
+//***************************************************************************************
+
+#pragma once
+
+#include "d3dUtil.h"
+#include "RingAllocator.h"
+#include "StreamingCopy.h"
+
+class UploadRing
+{
+public:
+
+	struct Desc
+	{
+		// Initial size in bytes.
+		UINT64 Capacity = 256*1024;
+	};
+
+	struct Allocation
+	{
+		BYTE* CpuAddress = nullptr;
+		D3D12_GPU_VIRTUAL_ADDRESS GpuAddress = 0;
+		ID3D12Resource* Resource = nullptr;
+		UINT64 Offset = 0;
+		UINT64 Size = 0;
+	};
+
+	explicit UploadRing(ID3D12Device* device) : UploadRing(device, Desc()) {}
+	UploadRing(ID3D12Device* device, const Desc& desc);
+
+	UploadRing(const UploadRing& rhs) = delete;
+	UploadRing& operator=(const UploadRing& rhs) = delete;
+	~UploadRing();
+
+	///<summary>
+	/// Returns size bytes aligned to alignment, a power of two.  The memory is
+	/// valid until the fence of the frame it belongs to completes.
+	///</summary>
+	Allocation Allocate(UINT64 size, UINT64 alignment);
+
+	///<summary>
+	/// Memory for a constant buffer: the size is rounded up to a multiple of 256
+	/// bytes and the address is 256-byte aligned, as CBVs and root CBVs require.
+	///</summary>
+	Allocation AllocateConstants(UINT64 size);
+
+	///<summary>
+	/// Streams data into new constant buffer memory and returns its GPU address.
+	///</summary>
+	template<typename T>
+	D3D12_GPU_VIRTUAL_ADDRESS UploadConstants(const T& data)
+	{
+		return UploadConstants(&data, 1);
+	}
+
+	///<summary>
+	/// Streams count constant buffers into one block, each in its own 256-byte
+	/// aligned element, and returns the GPU address of the first.  Element i is at
+	/// i*d3dUtil::CalcConstantBufferByteSize(sizeof(T)) past it.
+	///</summary>
+	template<typename T>
+	D3D12_GPU_VIRTUAL_ADDRESS UploadConstants(const T* data, UINT count)
+	{
+		UINT elementByteSize = d3dUtil::CalcConstantBufferByteSize(sizeof(T));
+		Allocation allocation = Allocate((UINT64)elementByteSize*count, D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT);
+		StreamingCopy::CopyStrided(allocation.CpuAddress, elementByteSize, data, sizeof(T), sizeof(T), count);
+		return allocation.GpuAddress;
+	}
+
+	///<summary>
+	/// Ends the frame: everything allocated since the last call stays in use until
+	/// fence completes.
+	///</summary>
+	void EndFrame(UINT64 fence);
+
+	///<summary>
+	/// Frees the frames whose fence is at most completedFence.
+	///</summary>
+	void Retire(UINT64 completedFence);
+
+	UINT64 GetCapacity()const;
+
+	// Bytes in use, counting alignment padding and the unused end of the buffer
+	// skipped when wrapping.
+	UINT64 GetUsed()const;
+
+	// Most bytes ever in use at once, over every buffer the ring has had.
+	UINT64 GetHighWaterMark()const;
+	void ResetHighWaterMark();
+
+	UINT GetGrowCount()const;
+
+private:
+
+	struct RetiredBuffer
+	{
+		Microsoft::WRL::ComPtr<ID3D12Resource> Buffer;
+		UINT64 Fence;
+		bool FenceKnown;
+	};
+
+	void CreateBuffer(UINT64 capacity);
+
+	Microsoft::WRL::ComPtr<ID3D12Device> mDevice;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> mBuffer;
+	BYTE* mMappedData = nullptr;
+	D3D12_GPU_VIRTUAL_ADDRESS mGpuAddress = 0;
+	RingAllocator mRing;
+	std::vector<RetiredBuffer> mRetiredBuffers;
+
+	UINT mGrowCount = 0;
+};
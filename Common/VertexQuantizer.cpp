@@ -0,0 +1,394 @@
+//***************************************************************************************
+// VertexQuantizer.cpp
+//***************************************************************************************
+
+#include "VertexQuantizer.h"
+#include <cstring>
+
+#if !defined(_XM_NO_INTRINSICS_) && (defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__))
+#define VERTEXQUANTIZER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	const UINT PositionSize  = sizeof(XMUSHORTN4);
+	const UINT DirectionSize = sizeof(XMSHORTN2);
+	const UINT TexCoordSize  = sizeof(XMHALF2);
+
+	template<typename T>
+	T* Advance(T* p, size_t stride)
+	{
+		return reinterpret_cast<T*>(reinterpret_cast<std::uint8_t*>(p) + stride);
+	}
+
+	template<typename T>
+	const T* Advance(const T* p, size_t stride)
+	{
+		return reinterpret_cast<const T*>(reinterpret_cast<const std::uint8_t*>(p) + stride);
+	}
+
+#if defined(VERTEXQUANTIZER_SSE2)
+	using uint8 = std::uint8_t;
+
+	// Runs kernel(out, outStride, in, inStride), which converts four vertices, over
+	// the whole stream.  The last partial group is converted from zero-padded
+	// copies, so every vertex goes through the same arithmetic.
+	template<size_t InSize, size_t OutSize, typename Kernel>
+	void EncodeGroups(void* dst, size_t outStride, const void* src, size_t inStride, size_t count, Kernel kernel)
+	{
+		uint8* out = static_cast<uint8*>(dst);
+		const uint8* in = static_cast<const uint8*>(src);
+
+		size_t i = 0;
+		for(; i + 4 <= count; i += 4, in += 4*inStride, out += 4*outStride)
+			kernel(out, outStride, in, inStride);
+
+		size_t rest = count - i;
+		if(rest > 0)
+		{
+			uint8 inTail[4*InSize] = {};
+			uint8 outTail[4*OutSize];
+
+			for(size_t k = 0; k < rest; ++k)
+				std::memcpy(inTail + k*InSize, in + k*inStride, InSize);
+
+			kernel(outTail, OutSize, inTail, InSize);
+
+			for(size_t k = 0; k < rest; ++k)
+				std::memcpy(out + k*outStride, outTail + k*OutSize, OutSize);
+		}
+	}
+
+	inline __m128 LoadFloat3(const uint8* p)
+	{
+		__m128 xy = _mm_castpd_ps(_mm_load_sd(reinterpret_cast<const double*>(p)));
+		__m128 z = _mm_load_ss(reinterpret_cast<const float*>(p) + 2);
+		return _mm_movelh_ps(xy, z);
+	}
+
+	// Loads the float3 of four vertices into SoA form, one vertex per lane.
+	inline void LoadFloat3x4(const uint8* in, size_t stride, __m128& x, __m128& y, __m128& z)
+	{
+		__m128 v0 = LoadFloat3(in);
+		__m128 v1 = LoadFloat3(in + stride);
+		__m128 v2 = LoadFloat3(in + 2*stride);
+		__m128 v3 = LoadFloat3(in + 3*stride);
+
+		_MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+		x = v0;
+		y = v1;
+		z = v2;
+	}
+
+	inline __m128 Abs(__m128 v)
+	{
+		return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+	}
+
+	inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+	{
+		return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+	}
+
+	// Saturates to [lo, 1], scales by max and rounds to the nearest integer, as the
+	// DirectXMath UNORM and SNORM stores do.
+	inline __m128i ToNorm(__m128 v, __m128 lo, float max)
+	{
+		v = _mm_min_ps(_mm_max_ps(v, lo), _mm_set1_ps(1.0f));
+		return _mm_cvtps_epi32(_mm_mul_ps(v, _mm_set1_ps(max)));
+	}
+
+	// Stores the low 32 bits of lane k of v to out + k*stride.
+	inline void Store32x4(uint8* out, size_t stride, __m128i v)
+	{
+		for(int k = 0; k < 4; ++k, out += stride)
+		{
+			int value = _mm_cvtsi128_si32(v);
+			std::memcpy(out, &value, sizeof(value));
+			v = _mm_srli_si128(v, 4);
+		}
+	}
+#endif
+}
+
+XMMATRIX VertexQuantizer::Dequantization::GetMatrix()const
+{
+	return XMMatrixScaling(Scale, Scale, Scale) * XMMatrixTranslation(Bias.x, Bias.y, Bias.z);
+}
+
+VertexQuantizer::uint32 VertexQuantizer::GetStride(uint32 attributes)
+{
+	uint32 stride = 0;
+
+	if(attributes & AttributePosition)
+		stride += PositionSize;
+
+	if(attributes & AttributeNormal)
+		stride += DirectionSize;
+
+	if(attributes & AttributeTangentU)
+		stride += DirectionSize;
+
+	if(attributes & AttributeTexC)
+		stride += TexCoordSize;
+
+	return stride;
+}
+
+std::vector<D3D12_INPUT_ELEMENT_DESC> VertexQuantizer::GetInputLayout(uint32 attributes, UINT inputSlot)
+{
+	std::vector<D3D12_INPUT_ELEMENT_DESC> layout;
+	UINT offset = 0;
+
+	auto addElement = [&](const char* semantic, DXGI_FORMAT format, UINT size)
+	{
+		layout.push_back({ semantic, 0, format, inputSlot, offset, D3D12_INPUT_CLASSIFICATION_PER_VERTEX_DATA, 0 });
+		offset += size;
+	};
+
+	if(attributes & AttributePosition)
+		addElement("POSITION", DXGI_FORMAT_R16G16B16A16_UNORM, PositionSize);
+
+	if(attributes & AttributeNormal)
+		addElement("NORMAL", DXGI_FORMAT_R16G16_SNORM, DirectionSize);
+
+	if(attributes & AttributeTangentU)
+		addElement("TANGENT", DXGI_FORMAT_R16G16_SNORM, DirectionSize);
+
+	if(attributes & AttributeTexC)
+		addElement("TEXCOORD", DXGI_FORMAT_R16G16_FLOAT, TexCoordSize);
+
+	return layout;
+}
+
+VertexQuantizer::Dequantization VertexQuantizer::Encode(const GeometryGenerator::MeshData& meshData, uint32 attributes, void* dst)
+{
+	Dequantization dequantization;
+
+	size_t count = meshData.Vertices.size();
+	if(count == 0)
+		return dequantization;
+
+	const GeometryGenerator::Vertex* v = meshData.Vertices.data();
+	const size_t inStride = sizeof(GeometryGenerator::Vertex);
+	const size_t outStride = GetStride(attributes);
+
+	std::uint8_t* out = static_cast<std::uint8_t*>(dst);
+
+	if(attributes & AttributePosition)
+	{
+		dequantization = ComputeDequantization(&v->Position, inStride, count);
+		EncodePositions(reinterpret_cast<XMUSHORTN4*>(out), outStride, &v->Position, inStride, count, dequantization);
+		out += PositionSize;
+	}
+
+	if(attributes & AttributeNormal)
+	{
+		EncodeDirections(reinterpret_cast<XMSHORTN2*>(out), outStride, &v->Normal, inStride, count);
+		out += DirectionSize;
+	}
+
+	if(attributes & AttributeTangentU)
+	{
+		EncodeDirections(reinterpret_cast<XMSHORTN2*>(out), outStride, &v->TangentU, inStride, count);
+		out += DirectionSize;
+	}
+
+	if(attributes & AttributeTexC)
+	{
+		EncodeTexCoords(reinterpret_cast<XMHALF2*>(out), outStride, &v->TexC, inStride, count);
+		out += TexCoordSize;
+	}
+
+	return dequantization;
+}
+
+VertexQuantizer::Dequantization VertexQuantizer::ComputeDequantization(const XMFLOAT3* positions, size_t stride, size_t count)
+{
+	Dequantization dequantization;
+	if(count == 0)
+		return dequantization;
+
+	XMVECTOR vMin = XMLoadFloat3(positions);
+	XMVECTOR vMax = vMin;
+	for(size_t i = 1; i < count; ++i)
+	{
+		positions = Advance(positions, stride);
+
+		XMVECTOR p = XMLoadFloat3(positions);
+		vMin = XMVectorMin(vMin, p);
+		vMax = XMVectorMax(vMax, p);
+	}
+
+	XMVECTOR extent = vMax - vMin;
+	float scale = XMVectorGetX(XMVectorMax(XMVectorMax(XMVectorSplatX(extent), XMVectorSplatY(extent)), XMVectorSplatZ(extent)));
+
+	// A single point still needs an invertible scale.
+	XMStoreFloat3(&dequantization.Bias, vMin);
+	dequantization.Scale = scale > 0.0f ? scale : 1.0f;
+
+	return dequantization;
+}
+
+void VertexQuantizer::EncodePositions(XMUSHORTN4* out, size_t outStride,
+									  const XMFLOAT3* in, size_t inStride, size_t count, const Dequantization& dequantization)
+{
+#if defined(VERTEXQUANTIZER_SSE2)
+	const __m128 biasX = _mm_set1_ps(dequantization.Bias.x);
+	const __m128 biasY = _mm_set1_ps(dequantization.Bias.y);
+	const __m128 biasZ = _mm_set1_ps(dequantization.Bias.z);
+	const __m128 invScale = _mm_set1_ps(1.0f / dequantization.Scale);
+	const __m128 zero = _mm_setzero_ps();
+
+	// w = 1 so the data also reads correctly as a float4 position.
+	const __m128i wOne = _mm_set1_epi32((int)0xffff0000u);
+
+	EncodeGroups<sizeof(XMFLOAT3), PositionSize>(out, outStride, in, inStride, count,
+		[&](uint8* o, size_t os, const uint8* i, size_t is)
+	{
+		__m128 x, y, z;
+		LoadFloat3x4(i, is, x, y, z);
+
+		__m128i qx = ToNorm(_mm_mul_ps(_mm_sub_ps(x, biasX), invScale), zero, 65535.0f);
+		__m128i qy = ToNorm(_mm_mul_ps(_mm_sub_ps(y, biasY), invScale), zero, 65535.0f);
+		__m128i qz = ToNorm(_mm_mul_ps(_mm_sub_ps(z, biasZ), invScale), zero, 65535.0f);
+
+		// Each lane holds 16-bit x|y and z|w; interleave them into whole vertices.
+		__m128i xy = _mm_or_si128(qx, _mm_slli_epi32(qy, 16));
+		__m128i zw = _mm_or_si128(qz, wOne);
+
+		__m128i v01 = _mm_unpacklo_epi32(xy, zw);
+		__m128i v23 = _mm_unpackhi_epi32(xy, zw);
+
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(o), v01);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(o + os), _mm_unpackhi_epi64(v01, v01));
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(o + 2*os), v23);
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(o + 3*os), _mm_unpackhi_epi64(v23, v23));
+	});
+#else
+	XMVECTOR bias = XMLoadFloat3(&dequantization.Bias);
+	XMVECTOR invScale = XMVectorReplicate(1.0f / dequantization.Scale);
+
+	// w = 1 so the data also reads correctly as a float4 position.
+	XMVECTOR wOne = XMVectorSelect(XMVectorZero(), XMVectorSplatOne(), g_XMSelect0001);
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		XMVECTOR p = XMLoadFloat3(in);
+		XMVECTOR q = XMVectorMultiplyAdd(p - bias, invScale, wOne);
+
+		// XMStoreUShortN4 saturates and rounds to nearest.
+		XMStoreUShortN4(out, q);
+
+		in = Advance(in, inStride);
+		out = Advance(out, outStride);
+	}
+#endif
+}
+
+void VertexQuantizer::EncodeDirections(XMSHORTN2* out, size_t outStride,
+									   const XMFLOAT3* in, size_t inStride, size_t count)
+{
+#if defined(VERTEXQUANTIZER_SSE2)
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 negOne = _mm_set1_ps(-1.0f);
+
+	EncodeGroups<sizeof(XMFLOAT3), DirectionSize>(out, outStride, in, inStride, count,
+		[&](uint8* o, size_t os, const uint8* i, size_t is)
+	{
+		__m128 x, y, z;
+		LoadFloat3x4(i, is, x, y, z);
+
+		// Project onto the octahedron |x| + |y| + |z| = 1.
+		__m128 l1 = _mm_add_ps(_mm_add_ps(Abs(x), Abs(y)), Abs(z));
+		__m128 nonZero = _mm_cmpneq_ps(l1, zero);
+		__m128 px = _mm_and_ps(_mm_div_ps(x, l1), nonZero);
+		__m128 py = _mm_and_ps(_mm_div_ps(y, l1), nonZero);
+		__m128 pz = _mm_and_ps(_mm_div_ps(z, l1), nonZero);
+
+		// Fold the lower hemisphere over the diagonals.
+		__m128 signX = Select(_mm_cmpge_ps(px, zero), one, negOne);
+		__m128 signY = Select(_mm_cmpge_ps(py, zero), one, negOne);
+		__m128 foldedX = _mm_mul_ps(_mm_sub_ps(one, Abs(py)), signX);
+		__m128 foldedY = _mm_mul_ps(_mm_sub_ps(one, Abs(px)), signY);
+
+		__m128 lower = _mm_cmplt_ps(pz, zero);
+		px = Select(lower, foldedX, px);
+		py = Select(lower, foldedY, py);
+
+		__m128i ex = ToNorm(px, negOne, 32767.0f);
+		__m128i ey = ToNorm(py, negOne, 32767.0f);
+
+		Store32x4(o, os, _mm_or_si128(_mm_and_si128(ex, _mm_set1_epi32(0xffff)), _mm_slli_epi32(ey, 16)));
+	});
+#else
+	const XMVECTOR zero = XMVectorZero();
+	const XMVECTOR one = XMVectorSplatOne();
+	const XMVECTOR negOne = XMVectorNegate(one);
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		XMVECTOR n = XMLoadFloat3(in);
+
+		// Project onto the octahedron |x| + |y| + |z| = 1.
+		XMVECTOR l1 = XMVector3Dot(XMVectorAbs(n), one);
+		XMVECTOR p = XMVectorSelect(XMVectorDivide(n, l1), zero, XMVectorEqual(l1, zero));
+
+		// Fold the lower hemisphere over the diagonals.
+		XMVECTOR signs = XMVectorSelect(negOne, one, XMVectorGreaterOrEqual(p, zero));
+		XMVECTOR folded = (one - XMVectorAbs(XMVectorSwizzle<XM_SWIZZLE_Y, XM_SWIZZLE_X, XM_SWIZZLE_Z, XM_SWIZZLE_W>(p))) * signs;
+
+		p = XMVectorSelect(p, folded, XMVectorLess(XMVectorSplatZ(p), zero));
+
+		XMStoreShortN2(out, p);
+
+		in = Advance(in, inStride);
+		out = Advance(out, outStride);
+	}
+#endif
+}
+
+void VertexQuantizer::EncodeTexCoords(XMHALF2* out, size_t outStride,
+									  const XMFLOAT2* in, size_t inStride, size_t count)
+{
+	// The stream conversion uses F16C when it is available.
+	XMConvertFloatToHalfStream(&out->x, outStride, &in->x, inStride, count);
+	XMConvertFloatToHalfStream(&out->y, outStride, &in->y, inStride, count);
+}
+
+void VertexQuantizer::EncodeColors(XMCOLOR* out, size_t outStride,
+								   const XMFLOAT4* in, size_t inStride, size_t count)
+{
+#if defined(VERTEXQUANTIZER_SSE2)
+	const __m128 zero = _mm_setzero_ps();
+
+	EncodeGroups<sizeof(XMFLOAT4), sizeof(XMCOLOR)>(out, outStride, in, inStride, count,
+		[&](uint8* o, size_t os, const uint8* i, size_t is)
+	{
+		// XMCOLOR is BGRA in memory, so swap red and blue before packing.
+		__m128i c[4];
+		for(int k = 0; k < 4; ++k)
+		{
+			__m128 v = _mm_loadu_ps(reinterpret_cast<const float*>(i + k*is));
+			c[k] = ToNorm(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 0, 1, 2)), zero, 255.0f);
+		}
+
+		// Every value is in [0, 255], so the saturating packs only narrow them.
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(c[0], c[1]), _mm_packs_epi32(c[2], c[3]));
+		Store32x4(o, os, packed);
+	});
+#else
+	for(size_t i = 0; i < count; ++i)
+	{
+		XMStoreColor(out, XMLoadFloat4(in));
+
+		in = Advance(in, inStride);
+		out = Advance(out, outStride);
+	}
+#endif
+}
@@ -0,0 +1,104 @@
+//***************************************************************************************
+// VertexQuantizer.h
+//
+// Packs generated geometry into compact vertex formats:
+//
+//   Position  R16G16B16A16_UNORM   8 bytes  (dequantized by a per-mesh scale/bias)
+//   Normal    R16G16_SNORM         4 bytes  (octahedral encoding)
+//   TangentU  R16G16_SNORM         4 bytes  (octahedral encoding)
+//   TexC      R16G16_FLOAT         4 bytes
+//   Color     B8G8R8A8_UNORM       4 bytes  (XMCOLOR)
+//
+// A full GeometryGenerator::Vertex shrinks from 44 to 20 bytes.
+//
+// Positions decode for free: the vertex shader reads values in [0,1], and the
+// Dequantization matrix is folded into the world matrix.  Octahedral normals are
+// decoded in the vertex shader with
+//
+//   float3 OctDecode(float2 e)
+//   {
+//       float3 n = float3(e.xy, 1.0f - abs(e.x) - abs(e.y));
+//       float t = saturate(-n.z);
+//       n.xy += n.xy >= 0.0f ? -t : t;
+//       return normalize(n);
+//   }
+//***************************************************************************************
+
+#pragma once
+
+#include "GeometryGenerator.h"
+#include <d3d12.h>
+#include <DirectXPackedVector.h>
+
+class VertexQuantizer
+{
+public:
+
+	using uint32 = GeometryGenerator::uint32;
+
+	// Attributes of GeometryGenerator::Vertex to store in a compact vertex.
+	enum Attribute : uint32
+	{
+		AttributePosition = 0x1,
+		AttributeNormal   = 0x2,
+		AttributeTangentU = 0x4,
+		AttributeTexC     = 0x8,
+		AttributeAll      = 0xf
+	};
+
+	// Maps a quantized position q in [0,1]^3 back to local space, p = Bias + Scale*q.
+	// The scale is uniform so that folding the matrix into a world matrix does not
+	// skew normals.
+	struct Dequantization
+	{
+		DirectX::XMFLOAT3 Bias = { 0.0f, 0.0f, 0.0f };
+		float Scale = 1.0f;
+
+		DirectX::XMMATRIX GetMatrix()const;
+	};
+
+	///<summary>
+	/// Size in bytes of a compact vertex holding the given attributes.
+	///</summary>
+	static uint32 GetStride(uint32 attributes);
+
+	///<summary>
+	/// Input layout matching the vertices written by Encode.  Elements are in the
+	/// order of the Attribute bits and use the POSITION, NORMAL, TANGENT and
+	/// TEXCOORD semantics.
+	///</summary>
+	static std::vector<D3D12_INPUT_ELEMENT_DESC> GetInputLayout(uint32 attributes, UINT inputSlot = 0);
+
+	///<summary>
+	/// Writes meshData.Vertices to dst as compact vertices of GetStride(attributes)
+	/// bytes.  Returns the dequantization of the positions.
+	///</summary>
+	static Dequantization Encode(const GeometryGenerator::MeshData& meshData, uint32 attributes, void* dst);
+
+	//
+	// Batch conversion kernels.  Like the DirectXMath stream functions, these take
+	// the output first and a byte stride for every stream, so they can read and
+	// write interleaved vertices in place.  On x86 they convert four vertices per
+	// step with SSE2; texture coordinates use XMConvertFloatToHalfStream.
+	//
+
+	///<summary>
+	/// Smallest cube containing the positions.
+	///</summary>
+	static Dequantization ComputeDequantization(const DirectX::XMFLOAT3* positions, size_t stride, size_t count);
+
+	static void EncodePositions(DirectX::PackedVector::XMUSHORTN4* out, size_t outStride,
+								const DirectX::XMFLOAT3* in, size_t inStride, size_t count, const Dequantization& dequantization);
+
+	///<summary>
+	/// Octahedral encoding of unit vectors.
+	///</summary>
+	static void EncodeDirections(DirectX::PackedVector::XMSHORTN2* out, size_t outStride,
+								 const DirectX::XMFLOAT3* in, size_t inStride, size_t count);
+
+	static void EncodeTexCoords(DirectX::PackedVector::XMHALF2* out, size_t outStride,
+								const DirectX::XMFLOAT2* in, size_t inStride, size_t count);
+
+	static void EncodeColors(DirectX::PackedVector::XMCOLOR* out, size_t outStride,
+							 const DirectX::XMFLOAT4* in, size_t inStride, size_t count);
+};
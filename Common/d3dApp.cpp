@@ -69,11 +69,34 @@ void D3DApp::Set4xMsaaState(bool value)
     }
 }
 
+bool D3DApp::GetFixedTimestep()const
+{
+	return mFixedTimestep;
+}
+
+void D3DApp::SetFixedTimestep(bool value, double ticksPerSecond, UINT maxStepsPerFrame)
+{
+	mFixedTimestep = value;
+	mFixedStep.SetStep((std::int64_t)(1e9 / ticksPerSecond + 0.5), maxStepsPerFrame);
+}
+
+double D3DApp::GetFrameRateLimit()const
+{
+	std::int64_t target = mFramePacer.GetTargetFrameTime();
+	return target > 0 ? 1e9 / (double)target : 0.0;
+}
+
+void D3DApp::SetFrameRateLimit(double framesPerSecond)
+{
+	mFramePacer.SetTargetFrameTime(framesPerSecond > 0.0 ? (std::int64_t)(1e9 / framesPerSecond + 0.5) : 0);
+}
+
 int D3DApp::Run()
 {
 	MSG msg = {0};
  
 	mTimer.Reset();
+	mStepTimer.Reset();
 
 	while(msg.message != WM_QUIT)
 	{
@@ -90,12 +113,48 @@ int D3DApp::Run()
 
 			if( !mAppPaused )
 			{
-				CalculateFrameStats();
-				Update(mTimer);	
-                Draw(mTimer);
+				{
+					PROFILE_SCOPE("Frame");
+
+					CalculateFrameStats();
+
+					float alpha = 1.0f;
+					if(mFixedTimestep)
+					{
+						PROFILE_SCOPE("FixedUpdate");
+
+						UINT steps = mFixedStep.Advance(mTimer.DeltaTimeNs());
+						for(UINT i = 0; i < steps; ++i)
+						{
+							mStepTimer.Advance(mFixedStep.GetStepNs());
+							FixedUpdate(mStepTimer);
+						}
+
+						alpha = mFixedStep.GetAlpha();
+					}
+
+					{
+						PROFILE_SCOPE("Update");
+						Update(mTimer);
+					}
+
+					{
+						PROFILE_SCOPE("Draw");
+						DrawInterpolated(mTimer, alpha);
+					}
+				}
+
+				{
+					PROFILE_SCOPE("FramePacing");
+					mFramePacer.Wait();
+				}
+
+				Profiler::EndFrame();
 			}
 			else
 			{
+				// Start a new schedule on resume rather than rush to catch up.
+				mFramePacer.Reset();
 				Sleep(100);
 			}
         }
@@ -106,6 +165,8 @@ int D3DApp::Run()
 
 bool D3DApp::Initialize()
 {
+	Profiler::SetThreadName("Main");
+
 	if(!InitMainWindow())
 		return false;
 
@@ -365,6 +426,8 @@ LRESULT D3DApp::MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam)
         }
         else if((int)wParam == VK_F2)
             Set4xMsaaState(!m4xMsaaState);
+        else if((int)wParam == VK_F3)
+            Profiler::WriteChromeTrace(L"profile.json");
 
         return 0;
 	}
@@ -580,28 +643,45 @@ void D3DApp::CalculateFrameStats()
 	// are appended to the window caption bar.
     
 	static int frameCnt = 0;
-	static float timeElapsed = 0.0f;
+	static std::int64_t timeElapsed = 0;
 
 	frameCnt++;
 
-	// Compute averages over one second period.
-	if( (mTimer.TotalTime() - timeElapsed) >= 1.0f )
+	// Compute averages over one second period.  Integer nanoseconds keep the
+	// period exact however long the app has been running.
+	if( (mTimer.TotalTimeNs() - timeElapsed) >= 1000000000 )
 	{
 		float fps = (float)frameCnt; // fps = frameCnt / 1
 		float mspf = 1000.0f / fps;
 
+		// The tail of the recent frame times shows hitches the average hides.
+		GameTimer::FrameTimeStats stats = mTimer.GetFrameTimeStats();
+
         wstring fpsStr = to_wstring(fps);
         wstring mspfStr = to_wstring(mspf);
+        wstring p99Str = to_wstring(stats.P99Ms);
+        wstring maxStr = to_wstring(stats.MaxMs);
 
         wstring windowText = mMainWndCaption +
             L"    fps: " + fpsStr +
-            L"   mspf: " + mspfStr;
+            L"   mspf: " + mspfStr +
+            L"   p99: " + p99Str +
+            L"   max: " + maxStr;
+
+		// Where the last frame's time went: the profile scopes that took longest.
+		const std::vector<Profiler::ScopeStats>& scopes = Profiler::GetFrameStats();
+		for(size_t i = 0; i < scopes.size() && i < 3; ++i)
+		{
+			wchar_t scopeText[128];
+			swprintf_s(scopeText, L"   %hs: %.2f ms", scopes[i].Name, scopes[i].TotalMs);
+			windowText += scopeText;
+		}
 
         SetWindowText(mhMainWnd, windowText.c_str());
 		
 		// Reset for next average.
 		frameCnt = 0;
-		timeElapsed += 1.0f;
+		timeElapsed += 1000000000;
 	}
 }
 
@@ -10,7 +10,10 @@
 #endif
 
 #include "d3dUtil.h"
+#include "FixedTimestep.h"
+#include "FramePacer.h"
 #include "GameTimer.h"
+#include "Profiler.h"
 
 // Link necessary d3d12 libraries.
 #pragma comment(lib,"d3dcompiler.lib")
@@ -37,6 +40,18 @@ public:
     bool Get4xMsaaState()const;
     void Set4xMsaaState(bool value);
 
+	// In fixed-timestep mode Run calls FixedUpdate ticksPerSecond times per second of
+	// game time, however fast frames are drawn.  After a long frame it runs at most
+	// maxStepsPerFrame steps and drops the rest of the time rather than fall
+	// further behind.
+	bool GetFixedTimestep()const;
+	void SetFixedTimestep(bool value, double ticksPerSecond = 60.0, UINT maxStepsPerFrame = 5);
+
+	// Caps the frame rate by waiting after each Present; 0 draws as fast as
+	// possible, which is the default.
+	double GetFrameRateLimit()const;
+	void SetFrameRateLimit(double framesPerSecond);
+
 	int Run();
  
     virtual bool Initialize();
@@ -48,6 +63,16 @@ protected:
 	virtual void Update(const GameTimer& gt)=0;
     virtual void Draw(const GameTimer& gt)=0;
 
+	// Fixed-timestep mode only.  gt advances by exactly one step per call, and
+	// FixedUpdate runs before the frame's Update.
+	virtual void FixedUpdate(const GameTimer& gt) { }
+
+	// Called instead of Draw.  alpha in [0, 1) is how far the game time has moved
+	// past the last fixed step, as a fraction of a step, for interpolating between
+	// the last two simulated states.  It is 1 outside fixed-timestep mode.  Named
+	// apart from Draw so that overriding one does not hide the other.
+	virtual void DrawInterpolated(const GameTimer& gt, float alpha) { Draw(gt); }
+
 	// Convenience overrides for handling mouse input.
 	virtual void OnMouseDown(WPARAM btnState, int x, int y){ }
 	virtual void OnMouseUp(WPARAM btnState, int x, int y)  { }
@@ -90,6 +115,15 @@ protected:
 
 	// Used to keep track of the delta-time and game time (4.4).
 	GameTimer mTimer;
+
+	// Fixed-timestep mode.  mStepTimer is advanced one step at a time, and
+	// mFixedStep holds the game time not yet simulated.
+	bool mFixedTimestep = false;
+	FixedTimestep mFixedStep;
+	GameTimer mStepTimer;
+
+	// Holds each frame to the frame rate limit.
+	FramePacer mFramePacer;
 	
     Microsoft::WRL::ComPtr<IDXGIFactory4> mdxgiFactory;
     Microsoft::WRL::ComPtr<IDXGISwapChain> mSwapChain;
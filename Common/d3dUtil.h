@@ -6,6 +6,10 @@
 
 #pragma once
 
+// Keep windows.h from defining min and max macros, which break std::min and std::max.
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
 #include <windows.h>
 #include <wrl.h>
 #include <dxgi1_4.h>
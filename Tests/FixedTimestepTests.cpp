@@ -0,0 +1,142 @@
+//***************************************************************************************
+// FixedTimestepTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/FixedTimestep.h"
+#include "../Common/GameTimer.h"
+#include <cmath>
+#include <cstdint>
+
+using uint32 = FixedTimestep::uint32;
+
+namespace
+{
+	const std::int64_t NsPerMs = 1000000;
+
+	// The simulated clock the frame timer reads.
+	std::int64_t gNow = 0;
+
+	std::int64_t FakeNow()
+	{
+		return gNow;
+	}
+
+	// Runs one frame of durationNs the way D3DApp::Run does, and returns the number
+	// of steps simulated.
+	uint32 Frame(GameTimer& frameTimer, GameTimer& stepTimer, FixedTimestep& fixedStep, std::int64_t durationNs)
+	{
+		gNow += durationNs;
+		frameTimer.Tick();
+
+		uint32 steps = fixedStep.Advance(frameTimer.DeltaTimeNs());
+		for(uint32 i = 0; i < steps; ++i)
+			stepTimer.Advance(fixedStep.GetStepNs());
+
+		return steps;
+	}
+
+	bool Near(float a, float b)
+	{
+		return std::fabs(a - b) < 1e-6f;
+	}
+}
+
+TEST(FixedTimestepStepsAndInterpolates)
+{
+	gNow = 777*NsPerMs;
+
+	GameTimer frameTimer(FakeNow);
+	GameTimer stepTimer(FakeNow);
+	frameTimer.Reset();
+	stepTimer.Reset();
+
+	// 10 ms steps.
+	const std::int64_t Step = 10*NsPerMs;
+	FixedTimestep fixedStep(Step, 5);
+	CHECK(fixedStep.GetAlpha() == 0.0f);
+
+	// Frames shorter than a step run no step until a whole one has built up.
+	CHECK(Frame(frameTimer, stepTimer, fixedStep, 4*NsPerMs) == 0);
+	CHECK(Near(fixedStep.GetAlpha(), 0.4f));
+	CHECK(Frame(frameTimer, stepTimer, fixedStep, 4*NsPerMs) == 0);
+	CHECK(Near(fixedStep.GetAlpha(), 0.8f));
+	CHECK(Frame(frameTimer, stepTimer, fixedStep, 4*NsPerMs) == 1);
+	CHECK(Near(fixedStep.GetAlpha(), 0.2f));
+
+	// A frame of exactly two steps runs two and leaves the fraction unchanged.
+	CHECK(Frame(frameTimer, stepTimer, fixedStep, 20*NsPerMs) == 2);
+	CHECK(Near(fixedStep.GetAlpha(), 0.2f));
+
+	// The simulated time trails the frame time by the fraction of a step.
+	CHECK(stepTimer.TotalTimeNs() == 3*Step);
+	CHECK(frameTimer.TotalTimeNs() == 32*NsPerMs);
+	CHECK(frameTimer.TotalTimeNs() - stepTimer.TotalTimeNs() == fixedStep.GetAccumulatedNs());
+
+	// Alpha stays below 1 right up to the next step.
+	CHECK(Frame(frameTimer, stepTimer, fixedStep, 8*NsPerMs - 1) == 0);
+	CHECK(fixedStep.GetAlpha() < 1.0f);
+	CHECK(Frame(frameTimer, stepTimer, fixedStep, 1) == 1);
+	CHECK(fixedStep.GetAlpha() == 0.0f);
+
+	// Steps that do not divide a second still add up exactly over many frames.
+	fixedStep.SetStep(1000000000 / 60, 5);
+	stepTimer.Reset();
+	std::int64_t steps = 0;
+	for(int i = 0; i < 1000; ++i)
+		steps += Frame(frameTimer, stepTimer, fixedStep, 7*NsPerMs + i % 5);
+
+	std::int64_t elapsed = 0;
+	for(int i = 0; i < 1000; ++i)
+		elapsed += 7*NsPerMs + i % 5;
+
+	CHECK(steps == elapsed / fixedStep.GetStepNs());
+	CHECK(fixedStep.GetAccumulatedNs() == elapsed % fixedStep.GetStepNs());
+	CHECK(stepTimer.TotalTimeNs() == steps*fixedStep.GetStepNs());
+}
+
+TEST(FixedTimestepClampsCatchUp)
+{
+	gNow = 0;
+
+	GameTimer frameTimer(FakeNow);
+	GameTimer stepTimer(FakeNow);
+	frameTimer.Reset();
+	stepTimer.Reset();
+
+	const std::int64_t Step = 10*NsPerMs;
+	FixedTimestep fixedStep(Step, 4);
+
+	CHECK(Frame(frameTimer, stepTimer, fixedStep, 3*NsPerMs) == 0);
+
+	// A 1 s hitch runs only the maximum number of steps, drops the rest of the
+	// backlog and keeps the fraction of a step for the interpolation.
+	CHECK(Frame(frameTimer, stepTimer, fixedStep, 1000*NsPerMs + 4*NsPerMs) == 4);
+	CHECK(fixedStep.GetAccumulatedNs() == 7*NsPerMs);
+	CHECK(Near(fixedStep.GetAlpha(), 0.7f));
+	CHECK(stepTimer.TotalTimeNs() == 4*Step);
+
+	// The next frame does not try to catch up on what was dropped.
+	CHECK(Frame(frameTimer, stepTimer, fixedStep, 10*NsPerMs) == 1);
+	CHECK(Near(fixedStep.GetAlpha(), 0.7f));
+
+	// Exactly the maximum is not clamped.
+	fixedStep.Reset();
+	CHECK(Frame(frameTimer, stepTimer, fixedStep, 4*Step) == 4);
+	CHECK(fixedStep.GetAccumulatedNs() == 0);
+
+	// Nor is a paused frame, which does not move the clock.
+	frameTimer.Stop();
+	gNow += 500*NsPerMs;
+	frameTimer.Tick();
+	CHECK(fixedStep.Advance(frameTimer.DeltaTimeNs()) == 0);
+	CHECK(fixedStep.GetAccumulatedNs() == 0);
+	frameTimer.Start();
+
+	// Degenerate settings are clamped rather than stalling or dividing by zero.
+	fixedStep.SetStep(0, 0);
+	CHECK(fixedStep.GetStepNs() == 1);
+	CHECK(fixedStep.GetMaxStepsPerFrame() == 1);
+	CHECK(fixedStep.Advance(5) == 1);
+	CHECK(fixedStep.GetAccumulatedNs() == 0);
+}
@@ -0,0 +1,286 @@
+//***************************************************************************************
+// FramePacerTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/FramePacer.h"
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+	const std::int64_t NsPerUs = 1000;
+	const std::int64_t NsPerMs = 1000000;
+
+	// A simulated clock.  Sleeps wake Overshoot late, and each spin takes SpinStep.
+	class FakeClock : public FramePacer::Clock
+	{
+	public:
+		std::int64_t Now = 0;
+		std::int64_t Overshoot = 0;
+		std::int64_t SpinStep = NsPerUs;
+
+		std::int64_t SleepCount = 0;
+		std::int64_t SpinCount = 0;
+
+		std::int64_t NowNs()override
+		{
+			return Now;
+		}
+
+		void SleepNs(std::int64_t durationNs)override
+		{
+			Now += durationNs + Overshoot;
+			SleepCount++;
+		}
+
+		void Spin()override
+		{
+			Now += SpinStep;
+			SpinCount++;
+		}
+	};
+
+	FramePacer::Desc PacerDesc(std::int64_t targetFrameNs)
+	{
+		FramePacer::Desc desc;
+		desc.TargetFrameNs = targetFrameNs;
+		desc.InitialSpinNs = 2*NsPerMs;
+		desc.MinSpinNs = 200*NsPerUs;
+		return desc;
+	}
+
+	bool Near(double a, double b)
+	{
+		return std::fabs(a - b) < 1e-9;
+	}
+}
+
+TEST(FramePacerKeepsTheScheduleAtTheTargetRate)
+{
+	const std::int64_t Target = 10*NsPerMs;
+
+	FakeClock clock;
+	clock.Now = 1000*NsPerMs;
+	clock.Overshoot = 100*NsPerUs;
+
+	FramePacer pacer(PacerDesc(Target), &clock);
+
+	// The first frame starts the schedule without waiting.
+	const std::int64_t start = clock.Now;
+	pacer.Wait();
+	CHECK(clock.Now == start);
+
+	// Whatever the frames take, Wait returns on the deadlines, which stay a target
+	// frame apart: returning a spin step late does not push back the next one.
+	const std::int64_t work[] = { 3*NsPerMs, 9*NsPerMs, 1*NsPerMs, 6*NsPerMs + 333, 0, 8*NsPerMs };
+	std::int64_t deadline = start;
+	for(std::int64_t frameWork : work)
+	{
+		clock.Now += frameWork;
+		pacer.Wait();
+
+		deadline += Target;
+		CHECK(clock.Now >= deadline && clock.Now < deadline + clock.SpinStep);
+	}
+
+	CHECK(clock.SleepCount > 0);
+	CHECK(pacer.GetStats().MissedFrames == 0);
+
+	// A limit of 0 never waits.
+	pacer.SetTargetFrameTime(0);
+	clock.SleepCount = 0;
+	clock.SpinCount = 0;
+	for(int i = 0; i < 10; ++i)
+	{
+		clock.Now += 1*NsPerMs;
+		pacer.Wait();
+	}
+
+	CHECK(clock.SleepCount == 0 && clock.SpinCount == 0);
+	CHECK(pacer.GetTargetFrameTime() == 0);
+}
+
+TEST(FramePacerRestartsTheScheduleWhenFarBehind)
+{
+	const std::int64_t Target = 10*NsPerMs;
+
+	FakeClock clock;
+	FramePacer pacer(PacerDesc(Target), &clock);
+
+	pacer.Wait();
+	const std::int64_t start = clock.Now;
+
+	// A frame 5 ms late, within MaxLag (one target frame by default), is not
+	// waited for, and the next frame is shortened to get back on schedule.
+	clock.Now += Target + 5*NsPerMs;
+	pacer.Wait();
+	CHECK(clock.Now == start + Target + 5*NsPerMs);
+
+	clock.Now += 1*NsPerMs;
+	pacer.Wait();
+	CHECK(clock.Now >= start + 2*Target && clock.Now < start + 2*Target + clock.SpinStep);
+
+	// A frame more than MaxLag late starts a new schedule from where it ends,
+	// rather than rushing the frames after it.
+	const std::int64_t hitchEnd = clock.Now + 45*NsPerMs;
+	clock.Now = hitchEnd;
+	pacer.Wait();
+	CHECK(clock.Now == hitchEnd);
+
+	clock.Now += 1*NsPerMs;
+	pacer.Wait();
+	CHECK(clock.Now >= hitchEnd + Target && clock.Now < hitchEnd + Target + clock.SpinStep);
+
+	FramePacer::Stats stats = pacer.GetStats();
+	CHECK(stats.FrameCount == 4);
+	CHECK(stats.MissedFrames == 2);
+
+	// MaxLag can be set.  With 50 ms, the same hitch keeps to the old schedule, and
+	// the frames after it run back to back until they have caught up.
+	FramePacer::Desc desc = PacerDesc(Target);
+	desc.MaxLagNs = 50*NsPerMs;
+	FramePacer patient(desc, &clock);
+
+	patient.Wait();
+	const std::int64_t patientStart = clock.Now;
+	clock.Now += Target + 45*NsPerMs;
+	patient.Wait();
+
+	// Frames of 2 ms, from 55 ms in: 57, 59, 61, 63 and 65 are past the deadlines
+	// at 20 to 60 ms, and the next waits for the one at 70.
+	int rushed = 0;
+	for(int i = 0; i < 100; ++i)
+	{
+		clock.Now += 2*NsPerMs;
+		std::int64_t before = clock.Now;
+		patient.Wait();
+		if(clock.Now != before)
+			break;
+
+		rushed++;
+	}
+
+	CHECK(rushed == 5);
+	CHECK(clock.Now >= patientStart + 7*Target && clock.Now < patientStart + 7*Target + clock.SpinStep);
+
+	// Reset starts over on the next Wait, which does not wait.
+	pacer.Reset();
+	clock.Now += 1*NsPerMs;
+	const std::int64_t resumed = clock.Now;
+	pacer.Wait();
+	CHECK(clock.Now == resumed);
+	clock.Now += 1*NsPerMs;
+	pacer.Wait();
+	CHECK(clock.Now >= resumed + Target && clock.Now < resumed + Target + clock.SpinStep);
+}
+
+TEST(FramePacerLearnsHowLateSleepsWake)
+{
+	// Sleeps wake 3 ms late, more than the initial 2 ms allowed for.
+	const std::int64_t Target = 20*NsPerMs;
+
+	FakeClock clock;
+	clock.Overshoot = 3*NsPerMs;
+
+	FramePacer::Desc desc = PacerDesc(Target);
+	desc.StatsWindow = 1000;
+	FramePacer pacer(desc, &clock);
+
+	pacer.Wait();
+	const std::int64_t start = clock.Now;
+
+	// So the first wait oversleeps the deadline by 1 ms.
+	clock.Now += 2*NsPerMs;
+	pacer.Wait();
+	CHECK(clock.Now == start + Target + 1*NsPerMs);
+	CHECK(pacer.GetSleepOvershoot() == 3*NsPerMs);
+
+	// After that the pacer stops sleeping early enough, and the frames after the
+	// late one are on time.
+	for(int i = 2; i <= 200; ++i)
+	{
+		clock.Now += 2*NsPerMs;
+		pacer.Wait();
+
+		std::int64_t deadline = start + i*Target;
+		CHECK(clock.Now >= deadline && clock.Now < deadline + clock.SpinStep);
+	}
+
+	CHECK(pacer.GetSleepOvershoot() == 3*NsPerMs);
+
+	// As the overshoot proves steady, the margin shrinks towards it, so the
+	// spinning at the end of a frame shrinks towards 0.
+	std::int64_t spins = clock.SpinCount;
+	clock.Now += 2*NsPerMs;
+	pacer.Wait();
+	CHECK(clock.SpinCount - spins < 10);
+
+	FramePacer::Stats stats = pacer.GetStats();
+	CHECK(Near(stats.MaxLatenessMs, 1.0));
+	CHECK(stats.SleepFraction > 0.9);
+}
+
+TEST(FramePacerStatsOfKnownFrames)
+{
+	const std::int64_t Target = 10*NsPerMs;
+
+	// Without overshoot, and with deadlines a whole number of spin steps after
+	// each sleep, every wait returns exactly on its deadline.
+	FakeClock clock;
+	FramePacer::Desc desc = PacerDesc(Target);
+	desc.StatsWindow = 4;
+	FramePacer pacer(desc, &clock);
+
+	CHECK(pacer.GetStats().FrameCount == 0);
+
+	pacer.Wait();
+
+	// Two frames on time, after 3 and 5 ms of work.
+	clock.Now += 3*NsPerMs;
+	pacer.Wait();
+	clock.Now += 5*NsPerMs;
+	pacer.Wait();
+
+	FramePacer::Stats stats = pacer.GetStats();
+	CHECK(stats.FrameCount == 2);
+	CHECK(Near(stats.MeanIntervalMs, 10.0));
+	CHECK(Near(stats.JitterMs, 0.0));
+	CHECK(Near(stats.MeanLatenessMs, 0.0));
+	CHECK(Near(stats.MaxLatenessMs, 0.0));
+	CHECK(stats.MissedFrames == 0);
+
+	// 12 ms of waiting.  The first wait spins the initial 2 ms; once a sleep has
+	// measured no overshoot, the second spins only MinSpinNs.
+	CHECK(Near(stats.SleepFraction, (5.0 + 4.8) / 12.0));
+
+	// A frame 4 ms late is missed, and the one after it shortened to 6 ms.
+	clock.Now += 14*NsPerMs;
+	pacer.Wait();
+	clock.Now += 1*NsPerMs;
+	pacer.Wait();
+
+	stats = pacer.GetStats();
+	CHECK(stats.FrameCount == 4);
+	CHECK(stats.MissedFrames == 1);
+	CHECK(Near(stats.MeanIntervalMs, (10.0 + 10.0 + 14.0 + 6.0) / 4));
+
+	// Intervals of 10, 10, 14 and 6 ms are 0, 0, 4 and 4 ms off their mean.
+	CHECK(Near(stats.JitterMs, std::sqrt(8.0)));
+
+	// The missed frame does not count towards the lateness.
+	CHECK(Near(stats.MaxLatenessMs, 0.0));
+
+	// The window holds the last four frames, so four more on time replace them.
+	for(int i = 0; i < 4; ++i)
+	{
+		clock.Now += 2*NsPerMs;
+		pacer.Wait();
+	}
+
+	stats = pacer.GetStats();
+	CHECK(stats.FrameCount == 4);
+	CHECK(stats.MissedFrames == 0);
+	CHECK(Near(stats.MeanIntervalMs, 10.0));
+	CHECK(Near(stats.JitterMs, 0.0));
+}
@@ -0,0 +1,132 @@
+//***************************************************************************************
+// FrustumCullerTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/FrustumCuller.h"
+#include "../Common/MathBatch.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const MathBatch::Path Paths[] = { MathBatch::Path::Scalar, MathBatch::Path::SSE2, MathBatch::Path::AVX2 };
+	const char* PathNames[] = { "Scalar", "SSE2", "AVX2" };
+
+	XMMATRIX TestViewProj()
+	{
+		XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 20.0f, -150.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*XM_PI, 16.0f/9.0f, 1.0f, 1000.0f);
+		return view*proj;
+	}
+
+	// Boxes scattered around the camera, about a third of them in view.
+	void AddRandomBoxes(FrustumCuller& culler, std::vector<BoundingBox>& boxes, size_t count)
+	{
+		std::mt19937 rng(17);
+		std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+		std::uniform_real_distribution<float> extent(0.1f, 5.0f);
+
+		boxes.resize(count);
+		culler.Clear();
+		culler.Reserve(count);
+
+		for(BoundingBox& box : boxes)
+		{
+			box.Center = XMFLOAT3(position(rng), 0.1f*position(rng), position(rng));
+			box.Extents = XMFLOAT3(extent(rng), extent(rng), extent(rng));
+			culler.Add(box);
+		}
+	}
+
+	// One box at a time against the same planes.
+	bool IsVisible(const BoundingBox& box, const XMFLOAT4 planes[6])
+	{
+		for(int i = 0; i < 6; ++i)
+		{
+			const XMFLOAT4& p = planes[i];
+			float distance = p.x*box.Center.x + p.y*box.Center.y + p.z*box.Center.z + p.w;
+			float radius = std::abs(p.x)*box.Extents.x + std::abs(p.y)*box.Extents.y + std::abs(p.z)*box.Extents.z;
+
+			if(distance + radius < 0.0f)
+				return false;
+		}
+
+		return true;
+	}
+
+	struct PathScope
+	{
+		MathBatch::Path Saved = MathBatch::GetPath();
+		~PathScope() { MathBatch::SetPath(Saved); }
+	};
+}
+
+TEST(FrustumCullerMatchesPerBoxTest)
+{
+	PathScope scope;
+
+	XMMATRIX viewProj = TestViewProj();
+	XMFLOAT4 planes[6];
+	MathHelper::ExtractFrustumPlanes(viewProj, planes);
+
+	// Counts around the 8-wide padding.
+	const size_t counts[] = { 0, 1, 7, 8, 9, 5000 };
+
+	for(size_t count : counts)
+	{
+		FrustumCuller culler;
+		std::vector<BoundingBox> boxes;
+		AddRandomBoxes(culler, boxes, count);
+
+		std::vector<FrustumCuller::uint32> expected;
+		for(size_t i = 0; i < count; ++i)
+		{
+			if(IsVisible(boxes[i], planes))
+				expected.push_back((FrustumCuller::uint32)i);
+		}
+
+		for(MathBatch::Path path : Paths)
+		{
+			MathBatch::SetPath(path);
+			if(MathBatch::GetPath() != path)
+				continue;
+
+			std::vector<FrustumCuller::uint32> visible;
+			culler.Cull(viewProj, visible);
+
+			CHECK(visible == expected);
+		}
+	}
+}
+
+BENCHMARK(FrustumCullerItems)
+{
+	PathScope scope;
+
+	XMMATRIX viewProj = TestViewProj();
+	const size_t counts[] = { 100000, 250000, 1000000 };
+
+	for(size_t count : counts)
+	{
+		FrustumCuller culler;
+		std::vector<BoundingBox> boxes;
+		AddRandomBoxes(culler, boxes, count);
+
+		std::vector<FrustumCuller::uint32> visible;
+		visible.reserve(count);
+
+		for(int p = 0; p < 3; ++p)
+		{
+			MathBatch::SetPath(Paths[p]);
+			if(MathBatch::GetPath() != Paths[p])
+				continue;
+
+			double ms = Tests::Time([&] { culler.Cull(viewProj, visible); }, 20);
+			std::printf("  %7zu items, %-6s: %.3f ms, %zu visible\n", count, PathNames[p], ms, visible.size());
+		}
+	}
+}
@@ -0,0 +1,149 @@
+//***************************************************************************************
+// GameTimerTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/GameTimer.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+namespace
+{
+	const std::int64_t NsPerMs = 1000000;
+
+	// The simulated clock the timers below read.
+	std::int64_t gNow = 0;
+
+	std::int64_t FakeNow()
+	{
+		return gNow;
+	}
+
+	// Runs one frame of durationNs.
+	void Frame(GameTimer& timer, std::int64_t durationNs)
+	{
+		gNow += durationNs;
+		timer.Tick();
+	}
+
+	bool Near(double a, double b)
+	{
+		return std::fabs(a - b) < 1e-9;
+	}
+}
+
+TEST(GameTimerStatsOfKnownFrameTimes)
+{
+	gNow = 5000*NsPerMs;
+
+	GameTimer timer(FakeNow);
+	timer.SetStatsWindow(100);
+	timer.Reset();
+
+	CHECK(timer.GetFrameTimeStats().FrameCount == 0);
+
+	// 1 to 100 ms, out of order.
+	auto frameMs = [](std::int64_t i) { return 1 + (i*37) % 100; };
+	for(std::int64_t i = 0; i < 100; ++i)
+		Frame(timer, frameMs(i)*NsPerMs);
+
+	CHECK(timer.TotalTimeNs() == 5050*NsPerMs);
+
+	GameTimer::FrameTimeStats stats = timer.GetFrameTimeStats();
+	CHECK(stats.FrameCount == 100);
+	CHECK(Near(stats.MinMs, 1.0));
+	CHECK(Near(stats.MaxMs, 100.0));
+	CHECK(Near(stats.AvgMs, 50.5));
+
+	// The percentiles interpolate between the two nearest frames: the median of
+	// 1..100 is halfway between 50 and 51, and p99 is at rank 98.01.
+	CHECK(Near(stats.P50Ms, 50.5));
+	CHECK(Near(stats.P95Ms, 95.05));
+	CHECK(Near(stats.P99Ms, 99.01));
+
+	// Once the window is full the oldest frames drop out: fifty frames of 200 ms
+	// replace the first fifty.
+	for(int i = 0; i < 50; ++i)
+		Frame(timer, 200*NsPerMs);
+
+	std::int64_t keptSum = 0;
+	std::int64_t keptMin = 100;
+	std::int64_t keptMax = 0;
+	for(std::int64_t i = 50; i < 100; ++i)
+	{
+		keptSum += frameMs(i);
+		keptMin = std::min(keptMin, frameMs(i));
+		keptMax = std::max(keptMax, frameMs(i));
+	}
+
+	stats = timer.GetFrameTimeStats();
+	CHECK(stats.FrameCount == 100);
+	CHECK(Near(stats.MinMs, (double)keptMin));
+	CHECK(Near(stats.MaxMs, 200.0));
+	CHECK(Near(stats.AvgMs, (keptSum + 50*200.0) / 100));
+
+	// The median falls between the slowest kept frame and the 200 ms ones.
+	CHECK(Near(stats.P50Ms, 0.5*(keptMax + 200.0)));
+
+	// A changed window or a reset forgets the recorded frames.
+	timer.SetStatsWindow(10);
+	CHECK(timer.GetFrameTimeStats().FrameCount == 0);
+
+	Frame(timer, 20*NsPerMs);
+	CHECK(timer.GetFrameTimeStats().FrameCount == 1);
+	CHECK(Near(timer.GetFrameTimeStats().P99Ms, 20.0));
+
+	timer.Reset();
+	CHECK(timer.GetFrameTimeStats().FrameCount == 0);
+	CHECK(timer.TotalTimeNs() == 0);
+}
+
+TEST(GameTimerSkipsPausedTime)
+{
+	gNow = 0;
+
+	GameTimer timer(FakeNow);
+	timer.Reset();
+
+	Frame(timer, 10*NsPerMs);
+
+	// A second spent stopped counts neither as time nor as a frame.
+	timer.Stop();
+	gNow += 1000*NsPerMs;
+	timer.Tick();
+	CHECK(timer.DeltaTimeNs() == 0);
+	CHECK(timer.TotalTimeNs() == 10*NsPerMs);
+	timer.Start();
+
+	Frame(timer, 16*NsPerMs);
+	CHECK(timer.DeltaTimeNs() == 16*NsPerMs);
+	CHECK(timer.TotalTimeNs() == 26*NsPerMs);
+
+	GameTimer::FrameTimeStats stats = timer.GetFrameTimeStats();
+	CHECK(stats.FrameCount == 2);
+	CHECK(Near(stats.MaxMs, 16.0));
+}
+
+TEST(GameTimerAdvanceAccumulates)
+{
+	gNow = 123*NsPerMs;
+
+	GameTimer timer(FakeNow);
+	timer.Reset();
+
+	// Fixed steps add up exactly, with no rounding, however many there are.
+	const std::int64_t step = 1000000000 / 60;
+	for(int i = 0; i < 6000; ++i)
+	{
+		timer.Advance(step);
+		CHECK(timer.DeltaTimeNs() == step);
+	}
+
+	CHECK(timer.TotalTimeNs() == 6000*step);
+	CHECK(std::fabs(timer.TotalTime() - 6000*step*1e-9) < 1e-4);
+
+	// The clock did not move, and the steps are not frames.
+	CHECK(timer.GetFrameTimeStats().FrameCount == 0);
+	CHECK(gNow == 123*NsPerMs);
+}
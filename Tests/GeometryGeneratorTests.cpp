@@ -0,0 +1,288 @@
+//***************************************************************************************
+// GeometryGeneratorTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/GeometryGenerator.h"
+#include "../Common/MathHelper.h"
+#include "../Common/ParallelFor.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace DirectX;
+
+using uint16 = std::uint16_t;
+using uint32 = std::uint32_t;
+
+namespace
+{
+	bool SameMesh(const GeometryGenerator::MeshData& a, const GeometryGenerator::MeshData& b)
+	{
+		return a.Vertices.size() == b.Vertices.size() &&
+			a.Indices32.size() == b.Indices32.size() &&
+			std::memcmp(a.Vertices.data(), b.Vertices.data(), a.Vertices.size()*sizeof(GeometryGenerator::Vertex)) == 0 &&
+			std::memcmp(a.Indices32.data(), b.Indices32.data(), a.Indices32.size()*sizeof(uint32)) == 0;
+	}
+
+	// Checks that every part of split fits 16-bit indices and that, part by part,
+	// the split indices name the same vertices as the whole mesh's, triangle for
+	// triangle.
+	void CheckSplit(const GeometryGenerator::MeshData& meshData, const GeometryGenerator::SplitMeshData& split, uint32 maxVertices)
+	{
+		uint32 indexCount = (uint32)meshData.Indices32.size() / 3 * 3;
+		CHECK(split.Indices16.size() == indexCount);
+
+		uint32 nextIndex = 0;
+		for(const GeometryGenerator::IndexRange& part : split.Parts)
+		{
+			CHECK(part.StartIndexLocation == nextIndex);
+			CHECK(part.IndexCount > 0 && part.IndexCount % 3 == 0);
+
+			uint32 partVertexCount = 0;
+			for(uint32 i = part.StartIndexLocation; i < part.StartIndexLocation + part.IndexCount; ++i)
+			{
+				uint32 local = split.Indices16[i];
+				partVertexCount = std::max(partVertexCount, local + 1);
+
+				size_t v = part.BaseVertexLocation + local;
+				CHECK(v < split.Vertices.size());
+				if(v < split.Vertices.size())
+				{
+					CHECK(std::memcmp(&split.Vertices[v], &meshData.Vertices[meshData.Indices32[i]],
+						sizeof(GeometryGenerator::Vertex)) == 0);
+				}
+			}
+
+			CHECK(partVertexCount <= maxVertices);
+			nextIndex += part.IndexCount;
+		}
+
+		CHECK(nextIndex == indexCount);
+	}
+}
+
+TEST(GridParallelMatchesSerial)
+{
+	GeometryGenerator geoGen;
+
+	// Sizes that do not split evenly into bands, including fewer rows than threads.
+	const uint32 sizes[][2] = { { 2, 2 }, { 3, 7 }, { 257, 131 }, { 1000, 33 } };
+	const uint32 threadCounts[] = { 1, 2, 3, 8, 64 };
+
+	for(const auto& size : sizes)
+	{
+		GeometryGenerator::MeshData serial = geoGen.CreateGrid(20.0f, 30.0f, size[0], size[1]);
+
+		for(uint32 threadCount : threadCounts)
+		{
+			GeometryGenerator::MeshData parallel = geoGen.CreateGridParallel(20.0f, 30.0f, size[0], size[1], threadCount);
+
+			CHECK(SameMesh(serial, parallel));
+			CHECK(std::memcmp(&serial.Bounds, &parallel.Bounds, sizeof(serial.Bounds)) == 0);
+		}
+	}
+}
+
+BENCHMARK(GridParallelScaling)
+{
+	GeometryGenerator geoGen;
+
+	// About 4 million vertices, written straight into preallocated buffers so that
+	// only the generation is timed.
+	const uint32 m = 2048;
+	const uint32 n = 2048;
+
+	GeometryGenerator::MeshSize size = GeometryGenerator::GridSize(m, n);
+	GeometryGenerator::MeshData meshData;
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices32.resize(size.IndexCount);
+
+	GeometryGenerator::MeshStreams out = GeometryGenerator::GetStreams(meshData);
+
+	double serialMs = Tests::Time([&] { geoGen.CreateGrid(20.0f, 20.0f, m, n, out); });
+	std::printf("  CreateGrid %ux%u: %.2f ms\n", m, n, serialMs);
+
+	uint32 coreCount = DefaultThreadCount();
+	for(uint32 threadCount = 1; ; threadCount *= 2)
+	{
+		threadCount = std::min(threadCount, coreCount);
+
+		double ms = Tests::Time([&] { geoGen.CreateGridParallel(20.0f, 20.0f, m, n, out, threadCount); });
+		std::printf("  CreateGridParallel, %2u threads: %.2f ms (%.2fx)\n", threadCount, ms, serialMs / ms);
+
+		if(threadCount == coreCount)
+			break;
+	}
+}
+
+TEST(StreamsAreNeverCooked)
+{
+	GeometryGenerator geoGen;
+
+	const GeometryGenerator::ShapeDesc shapes[] =
+	{
+		GeometryGenerator::ShapeDesc::Box(1.0f, 2.0f, 3.0f, 2),
+		GeometryGenerator::ShapeDesc::Geosphere(1.0f, 3),
+		GeometryGenerator::ShapeDesc::Sphere(1.0f, 12, 8),
+		GeometryGenerator::ShapeDesc::Cylinder(1.0f, 0.5f, 2.0f, 12, 4),
+		GeometryGenerator::ShapeDesc::Grid(4.0f, 4.0f, 9, 5)
+	};
+
+	for(const GeometryGenerator::ShapeDesc& desc : shapes)
+	{
+		geoGen.SetCooked(false);
+		GeometryGenerator::MeshData uncooked = geoGen.Create(desc);
+
+		// The stream overload ignores the cooked setting and fills exactly GetSize.
+		geoGen.SetCooked(true);
+
+		GeometryGenerator::MeshSize size = GeometryGenerator::GetSize(desc);
+		GeometryGenerator::MeshData streamed;
+		streamed.Vertices.resize(size.VertexCount);
+		streamed.Indices32.resize(size.IndexCount);
+
+		CHECK(geoGen.Create(desc, GeometryGenerator::GetStreams(streamed)));
+		CHECK(SameMesh(uncooked, streamed));
+	}
+}
+
+TEST(GeneratedBoundsMatchComputeBounds)
+{
+	GeometryGenerator geoGen;
+
+	const GeometryGenerator::ShapeDesc shapes[] =
+	{
+		GeometryGenerator::ShapeDesc::Box(1.0f, 2.0f, 3.0f, 2),
+		GeometryGenerator::ShapeDesc::Geosphere(1.5f, 3),
+		GeometryGenerator::ShapeDesc::Sphere(0.5f, 13, 9),
+		GeometryGenerator::ShapeDesc::Cylinder(1.0f, 0.5f, 2.0f, 12, 4),
+		GeometryGenerator::ShapeDesc::Grid(4.0f, 6.0f, 9, 5)
+	};
+
+	for(const GeometryGenerator::ShapeDesc& desc : shapes)
+	{
+		GeometryGenerator::MeshData meshData = geoGen.Create(desc);
+
+		BoundingBox box;
+		BoundingSphere sphere;
+		MathHelper::ComputeBounds(&meshData.Vertices[0].Position, sizeof(GeometryGenerator::Vertex),
+			meshData.Vertices.size(), box, sphere);
+
+		CHECK(std::memcmp(&meshData.Bounds, &box, sizeof(box)) == 0);
+
+		// The generated sphere is measured from the origin, so it may be larger than
+		// the one measured from the box center by at most the center's offset.
+		float offset = XMVectorGetX(XMVector3Length(XMLoadFloat3(&box.Center)));
+		CHECK(std::memcmp(&meshData.SphereBounds.Center, &sphere.Center, sizeof(sphere.Center)) == 0);
+		CHECK(meshData.SphereBounds.Radius >= sphere.Radius);
+		CHECK(meshData.SphereBounds.Radius <= sphere.Radius + offset + 1e-5f);
+	}
+}
+
+BENCHMARK(BoundsMillionVertices)
+{
+	GeometryGenerator geoGen;
+
+	// 1000x1000 grid: one million vertices.
+	const uint32 m = 1000;
+	const uint32 n = 1000;
+
+	GeometryGenerator::MeshSize size = GeometryGenerator::GridSize(m, n);
+	GeometryGenerator::MeshData meshData;
+	meshData.Vertices.resize(size.VertexCount);
+	meshData.Indices32.resize(size.IndexCount);
+
+	GeometryGenerator::MeshStreams out = GeometryGenerator::GetStreams(meshData);
+	GeometryGenerator::MeshStreams outNoBounds = out;
+	outNoBounds.Bounds = nullptr;
+	outNoBounds.SphereBounds = nullptr;
+
+	double withBoundsMs = Tests::Time([&] { geoGen.CreateGrid(20.0f, 20.0f, m, n, out); });
+	double withoutBoundsMs = Tests::Time([&] { geoGen.CreateGrid(20.0f, 20.0f, m, n, outNoBounds); });
+
+	std::printf("  CreateGrid, 1M vertices: %.2f ms with bounds, %.2f ms without\n", withBoundsMs, withoutBoundsMs);
+
+	// The standalone batch routine against a per-vertex DirectXMath loop.
+	const XMFLOAT3* positions = &meshData.Vertices[0].Position;
+	const size_t stride = sizeof(GeometryGenerator::Vertex);
+	const size_t count = meshData.Vertices.size();
+
+	BoundingBox box;
+	BoundingSphere sphere;
+	double batchMs = Tests::Time([&] { MathHelper::ComputeBounds(positions, stride, count, box, sphere); });
+
+	double scalarMs = Tests::Time([&]
+	{
+		XMVECTOR vMin = XMLoadFloat3(positions);
+		XMVECTOR vMax = vMin;
+		for(size_t i = 1; i < count; ++i)
+		{
+			XMVECTOR p = XMLoadFloat3(&meshData.Vertices[i].Position);
+			vMin = XMVectorMin(vMin, p);
+			vMax = XMVectorMax(vMax, p);
+		}
+
+		BoundingBox::CreateFromPoints(box, vMin, vMax);
+	});
+
+	std::printf("  MathHelper::ComputeBounds, 1M vertices: %.2f ms (box and sphere)\n", batchMs);
+	std::printf("  Per-vertex XMVectorMin/Max loop: %.2f ms (box only)\n", scalarMs);
+}
+
+TEST(EmptyGridIsEmpty)
+{
+	GeometryGenerator geoGen;
+
+	// Grids without a single quad, which would otherwise divide by zero when
+	// spacing the vertices.
+	const uint32 sizes[][2] = { { 0, 0 }, { 0, 5 }, { 5, 0 }, { 1, 5 }, { 5, 1 } };
+
+	for(const auto& size : sizes)
+	{
+		GeometryGenerator::MeshSize gridSize = GeometryGenerator::GridSize(size[0], size[1]);
+		CHECK(gridSize.VertexCount == 0);
+		CHECK(gridSize.IndexCount == 0);
+
+		GeometryGenerator::MeshData serial = geoGen.CreateGrid(20.0f, 30.0f, size[0], size[1]);
+		CHECK(serial.Vertices.empty());
+		CHECK(serial.Indices32.empty());
+
+		for(uint32 threadCount : { 1u, 4u })
+		{
+			GeometryGenerator::MeshData parallel = geoGen.CreateGridParallel(20.0f, 30.0f, size[0], size[1], threadCount);
+			CHECK(parallel.Vertices.empty());
+			CHECK(parallel.Indices32.empty());
+
+			// The stream overload succeeds without writing anything.
+			GeometryGenerator::MeshStreams out;
+			CHECK(geoGen.CreateGridParallel(20.0f, 30.0f, size[0], size[1], out, threadCount));
+		}
+	}
+}
+
+TEST(SplitIndices16KeepsEveryTriangle)
+{
+	GeometryGenerator geoGen;
+
+	// 300x300 is 90000 vertices, more than 16-bit indices can address.
+	GeometryGenerator::MeshData large = geoGen.CreateGrid(30.0f, 30.0f, 300, 300);
+	CHECK(large.Vertices.size() > 65536);
+
+	GeometryGenerator::SplitMeshData split = GeometryGenerator::SplitIndices16(large);
+	CHECK(split.Parts.size() >= 2);
+	CheckSplit(large, split, 65536);
+
+	// Small parts, and a mesh that already fits, which is one part.
+	GeometryGenerator::MeshData small = geoGen.CreateGeosphere(1.0f, 2);
+	CheckSplit(small, GeometryGenerator::SplitIndices16(small, 50), 50);
+
+	GeometryGenerator::SplitMeshData whole = GeometryGenerator::SplitIndices16(small);
+	CHECK(whole.Parts.size() == 1);
+	CHECK(whole.Vertices.size() == small.Vertices.size());
+	CheckSplit(small, whole, 65536);
+
+	// Both paths drop a trailing partial triangle.
+	small.Indices32.push_back(0);
+	CheckSplit(small, GeometryGenerator::SplitIndices16(small), 65536);
+	CheckSplit(small, GeometryGenerator::SplitIndices16(small, 50), 50);
+}
@@ -0,0 +1,78 @@
+//***************************************************************************************
+// Main.cpp
+//
+// Usage: Tests.exe [-bench] [name]
+//***************************************************************************************
+
+#include "Tests.h"
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	struct Entry
+	{
+		const char* Name;
+		Tests::Function Function;
+		bool Benchmark;
+	};
+
+	// Function-local so that it exists before the first static Registrar runs.
+	std::vector<Entry>& GetEntries()
+	{
+		static std::vector<Entry> entries;
+		return entries;
+	}
+
+	int gFailures = 0;
+}
+
+Tests::Registrar::Registrar(const char* name, Function function, bool benchmark)
+{
+	GetEntries().push_back({ name, function, benchmark });
+}
+
+void Tests::Fail(const char* file, int line, const char* expression)
+{
+	std::printf("%s(%d): CHECK(%s) failed\n", file, line, expression);
+	++gFailures;
+}
+
+int main(int argc, char* argv[])
+{
+	bool runBenchmarks = false;
+	const char* filter = nullptr;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		if(std::strcmp(argv[i], "-bench") == 0)
+			runBenchmarks = true;
+		else
+			filter = argv[i];
+	}
+
+	int testCount = 0;
+	int failedTests = 0;
+
+	for(const Entry& entry : GetEntries())
+	{
+		if(entry.Benchmark && !runBenchmarks)
+			continue;
+
+		if(filter != nullptr && std::strstr(entry.Name, filter) == nullptr)
+			continue;
+
+		std::printf("[ %s ]\n", entry.Name);
+
+		int failuresBefore = gFailures;
+		entry.Function();
+
+		++testCount;
+		if(gFailures != failuresBefore)
+			++failedTests;
+	}
+
+	std::printf("%d run, %d failed\n", testCount, failedTests);
+
+	return failedTests == 0 ? 0 : 1;
+}
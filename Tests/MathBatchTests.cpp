@@ -0,0 +1,250 @@
+//***************************************************************************************
+// MathBatchTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/MathBatch.h"
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+namespace
+{
+	const MathBatch::Path Paths[] = { MathBatch::Path::Scalar, MathBatch::Path::SSE2, MathBatch::Path::AVX2 };
+	const char* PathNames[] = { "Scalar", "SSE2", "AVX2" };
+
+	// Interleaved like a vertex, so every kernel runs with a stride.
+	struct Vertex
+	{
+		XMFLOAT3 Position;
+		XMFLOAT3 Normal;
+	};
+
+	std::vector<Vertex> RandomVertices(size_t count)
+	{
+		std::mt19937 rng(11);
+		std::uniform_real_distribution<float> dist(-10.0f, 10.0f);
+
+		std::vector<Vertex> vertices(count);
+		for(Vertex& v : vertices)
+		{
+			v.Position = XMFLOAT3(dist(rng), dist(rng), dist(rng));
+			v.Normal = XMFLOAT3(dist(rng), dist(rng), dist(rng));
+		}
+
+		if(count > 0)
+			vertices[0].Normal = XMFLOAT3(0.0f, 0.0f, 0.0f);
+
+		return vertices;
+	}
+
+	std::vector<XMFLOAT4X4> RandomAffineMatrices(size_t count)
+	{
+		std::mt19937 rng(13);
+		std::uniform_real_distribution<float> angle(0.0f, XM_2PI);
+		std::uniform_real_distribution<float> scale(0.25f, 4.0f);
+		std::uniform_real_distribution<float> offset(-100.0f, 100.0f);
+
+		std::vector<XMFLOAT4X4> matrices(count);
+		for(XMFLOAT4X4& m : matrices)
+		{
+			XMMATRIX M = XMMatrixScaling(scale(rng), scale(rng), scale(rng)) *
+				XMMatrixRotationX(angle(rng)) * XMMatrixRotationY(angle(rng)) *
+				XMMatrixTranslation(offset(rng), offset(rng), offset(rng));
+			XMStoreFloat4x4(&m, M);
+		}
+
+		return matrices;
+	}
+
+	XMMATRIX TestMatrix()
+	{
+		return XMMatrixScaling(2.0f, 0.5f, 3.0f) * XMMatrixRotationX(0.7f) * XMMatrixRotationY(-1.3f) *
+			XMMatrixTranslation(5.0f, -2.0f, 8.0f);
+	}
+
+	bool Near(float a, float b, float tolerance)
+	{
+		return std::fabs(a - b) <= tolerance*(1.0f + std::fabs(b));
+	}
+
+	bool Near(const XMFLOAT3& a, const XMFLOAT3& b, float tolerance)
+	{
+		return Near(a.x, b.x, tolerance) && Near(a.y, b.y, tolerance) && Near(a.z, b.z, tolerance);
+	}
+
+	bool Near(const XMFLOAT4X4& a, const XMFLOAT4X4& b, float tolerance)
+	{
+		for(int i = 0; i < 4; ++i)
+			for(int j = 0; j < 4; ++j)
+				if(!Near(a.m[i][j], b.m[i][j], tolerance))
+					return false;
+
+		return true;
+	}
+
+	// Restores the path the kernels picked when a test or benchmark ends.
+	struct PathScope
+	{
+		MathBatch::Path Saved = MathBatch::GetPath();
+		~PathScope() { MathBatch::SetPath(Saved); }
+	};
+}
+
+TEST(MathBatchPathsAgree)
+{
+	PathScope scope;
+
+	// Counts that leave every tail length for the 4- and 8-wide kernels.
+	const size_t counts[] = { 0, 1, 2, 3, 5, 7, 8, 9, 15, 1001 };
+	const float tolerance = 1e-5f;
+
+	XMMATRIX M = TestMatrix();
+	XMMATRIX invTranspose = MathHelper::InverseTranspose(M, MatrixKind::Affine);
+
+	for(size_t count : counts)
+	{
+		std::vector<Vertex> input = RandomVertices(count);
+		std::vector<XMFLOAT4X4> matrices = RandomAffineMatrices(count);
+
+		std::vector<const XMFLOAT4X4*> pointers(count);
+		for(size_t i = 0; i < count; ++i)
+			pointers[i] = &matrices[i];
+
+		for(MathBatch::Path path : Paths)
+		{
+			MathBatch::SetPath(path);
+
+			// Unsupported paths fall back; that one has already been checked.
+			if(MathBatch::GetPath() != path)
+				continue;
+
+			std::vector<Vertex> output(count);
+			if(count > 0)
+			{
+				MathBatch::TransformPositions(&output[0].Position, sizeof(Vertex), &input[0].Position, sizeof(Vertex), count, M);
+				MathBatch::TransformNormals(&output[0].Normal, sizeof(Vertex), &input[0].Normal, sizeof(Vertex), count, M);
+			}
+
+			for(size_t i = 0; i < count; ++i)
+			{
+				XMFLOAT3 position;
+				XMStoreFloat3(&position, XMVector3TransformCoord(XMLoadFloat3(&input[i].Position), M));
+				CHECK(Near(output[i].Position, position, tolerance));
+
+				XMFLOAT3 normal;
+				XMStoreFloat3(&normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&input[i].Normal), invTranspose)));
+				CHECK(Near(output[i].Normal, normal, tolerance));
+			}
+
+			// 256-byte elements, like constant buffers, so the streaming stores apply.
+			struct alignas(256) Constants { XMFLOAT4X4 World; };
+			std::vector<Constants> stored(count), storedIndirect(count), streamed(count), streamedIndirect(count);
+			std::vector<XMFLOAT4X4> inverses(count);
+
+			if(count > 0)
+			{
+				MathBatch::StoreTransposed(&stored[0], sizeof(Constants), &matrices[0], sizeof(XMFLOAT4X4), count);
+				MathBatch::StoreTransposed(&storedIndirect[0], sizeof(Constants), pointers.data(), count);
+				MathBatch::StreamTransposed(&streamed[0], sizeof(Constants), &matrices[0], sizeof(XMFLOAT4X4), count);
+				MathBatch::StreamTransposed(&streamedIndirect[0], sizeof(Constants), pointers.data(), count);
+				MathBatch::InverseTranspose(&inverses[0], sizeof(XMFLOAT4X4), &matrices[0], sizeof(XMFLOAT4X4), count, MatrixKind::Affine);
+			}
+
+			for(size_t i = 0; i < count; ++i)
+			{
+				XMFLOAT4X4 transposed;
+				XMStoreFloat4x4(&transposed, XMMatrixTranspose(XMLoadFloat4x4(&matrices[i])));
+
+				// Transposing only moves values, so every path must be exact.
+				CHECK(std::memcmp(&stored[i].World, &transposed, sizeof(transposed)) == 0);
+				CHECK(std::memcmp(&storedIndirect[i].World, &transposed, sizeof(transposed)) == 0);
+				CHECK(std::memcmp(&streamed[i].World, &transposed, sizeof(transposed)) == 0);
+				CHECK(std::memcmp(&streamedIndirect[i].World, &transposed, sizeof(transposed)) == 0);
+
+				XMFLOAT4X4 inverse;
+				XMStoreFloat4x4(&inverse, MathHelper::InverseTranspose(XMLoadFloat4x4(&matrices[i]), MatrixKind::Affine));
+				CHECK(Near(inverses[i], inverse, tolerance));
+			}
+		}
+	}
+}
+
+BENCHMARK(MathBatchKernels)
+{
+	PathScope scope;
+
+	const size_t vertexCount = 1000000;
+	const size_t matrixCount = 10000;
+
+	XMMATRIX M = TestMatrix();
+	std::vector<Vertex> input = RandomVertices(vertexCount);
+	std::vector<Vertex> output(vertexCount);
+
+	std::vector<XMFLOAT4X4> matrices = RandomAffineMatrices(matrixCount);
+	std::vector<XMFLOAT4X4> results(matrixCount);
+
+	// The per-element DirectXMath loops the kernels replace.
+	double positionsMs = Tests::Time([&]
+	{
+		for(size_t i = 0; i < vertexCount; ++i)
+			XMStoreFloat3(&output[i].Position, XMVector3TransformCoord(XMLoadFloat3(&input[i].Position), M));
+	});
+
+	double normalsMs = Tests::Time([&]
+	{
+		XMMATRIX invTranspose = MathHelper::InverseTranspose(M, MatrixKind::Affine);
+		for(size_t i = 0; i < vertexCount; ++i)
+			XMStoreFloat3(&output[i].Normal, XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&input[i].Normal), invTranspose)));
+	});
+
+	double transposeMs = Tests::Time([&]
+	{
+		for(size_t i = 0; i < matrixCount; ++i)
+			XMStoreFloat4x4(&results[i], XMMatrixTranspose(XMLoadFloat4x4(&matrices[i])));
+	});
+
+	double inverseMs = Tests::Time([&]
+	{
+		for(size_t i = 0; i < matrixCount; ++i)
+			XMStoreFloat4x4(&results[i], MathHelper::InverseTranspose(XMLoadFloat4x4(&matrices[i]), MatrixKind::Affine));
+	});
+
+	std::printf("  %-8s positions %.2f ms, normals %.2f ms, transpose %.3f ms, inverse-transpose %.3f ms\n",
+		"XMath", positionsMs, normalsMs, transposeMs, inverseMs);
+
+	for(int p = 0; p < 3; ++p)
+	{
+		MathBatch::SetPath(Paths[p]);
+		if(MathBatch::GetPath() != Paths[p])
+			continue;
+
+		positionsMs = Tests::Time([&]
+		{
+			MathBatch::TransformPositions(&output[0].Position, sizeof(Vertex), &input[0].Position, sizeof(Vertex), vertexCount, M);
+		});
+
+		normalsMs = Tests::Time([&]
+		{
+			MathBatch::TransformNormals(&output[0].Normal, sizeof(Vertex), &input[0].Normal, sizeof(Vertex), vertexCount, M);
+		});
+
+		transposeMs = Tests::Time([&]
+		{
+			MathBatch::StoreTransposed(&results[0], sizeof(XMFLOAT4X4), &matrices[0], sizeof(XMFLOAT4X4), matrixCount);
+		});
+
+		inverseMs = Tests::Time([&]
+		{
+			MathBatch::InverseTranspose(&results[0], sizeof(XMFLOAT4X4), &matrices[0], sizeof(XMFLOAT4X4), matrixCount, MatrixKind::Affine);
+		});
+
+		std::printf("  %-8s positions %.2f ms, normals %.2f ms, transpose %.3f ms, inverse-transpose %.3f ms\n",
+			PathNames[p], positionsMs, normalsMs, transposeMs, inverseMs);
+	}
+
+	std::printf("  (%zu vertices, %zu matrices)\n", vertexCount, matrixCount);
+}
@@ -0,0 +1,368 @@
+//***************************************************************************************
+// MathHelperTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/MathHelper.h"
+#include <climits>
+#include <cmath>
+#include <vector>
+
+using namespace DirectX;
+
+using uint32 = std::uint32_t;
+
+namespace
+{
+	std::vector<uint32> Sequence(RandomStream& random, size_t count)
+	{
+		std::vector<uint32> values(count);
+		for(uint32& value : values)
+			value = random.NextUInt();
+
+		return values;
+	}
+
+	size_t CountEqual(const std::vector<uint32>& a, const std::vector<uint32>& b)
+	{
+		size_t count = 0;
+		for(size_t i = 0; i < a.size() && i < b.size(); ++i)
+			count += a[i] == b[i] ? 1 : 0;
+
+		return count;
+	}
+
+	// Sentinel written past the end of the Fill outputs, to catch writes past count.
+	const float Guard = 12345.0f;
+
+	// Entries agree to within tolerance, relative to the larger of the two.
+	bool NearMatrix(CXMMATRIX a, CXMMATRIX b, float tolerance)
+	{
+		XMFLOAT4X4 fa, fb;
+		XMStoreFloat4x4(&fa, a);
+		XMStoreFloat4x4(&fb, b);
+
+		for(int i = 0; i < 4; ++i)
+		{
+			for(int j = 0; j < 4; ++j)
+			{
+				float x = fa.m[i][j];
+				float y = fb.m[i][j];
+				if(std::fabs(x - y) > tolerance*(1.0f + fmaxf(std::fabs(x), std::fabs(y))))
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	XMMATRIX RandomRotation(RandomStream& random)
+	{
+		return XMMatrixRotationRollPitchYaw(random.NextFloat(-XM_PI, XM_PI),
+			random.NextFloat(-XM_PI, XM_PI), random.NextFloat(-XM_PI, XM_PI));
+	}
+
+	XMMATRIX RandomTranslation(RandomStream& random)
+	{
+		return XMMatrixTranslation(random.NextFloat(-10.0f, 10.0f),
+			random.NextFloat(-10.0f, 10.0f), random.NextFloat(-10.0f, 10.0f));
+	}
+
+	// A matrix of the given kind, with random parameters.
+	XMMATRIX RandomMatrix(RandomStream& random, MatrixKind kind)
+	{
+		switch(kind)
+		{
+		case MatrixKind::Rigid:
+			return RandomRotation(random) * RandomTranslation(random);
+		case MatrixKind::UniformScale:
+		{
+			float s = random.NextFloat(0.25f, 4.0f);
+			return XMMatrixScaling(s, s, s) * RandomRotation(random) * RandomTranslation(random);
+		}
+		case MatrixKind::Affine:
+			return XMMatrixScaling(random.NextFloat(0.25f, 4.0f), random.NextFloat(0.25f, 4.0f), random.NextFloat(0.25f, 4.0f)) *
+				RandomRotation(random) * XMMatrixScaling(random.NextFloat(0.25f, 4.0f), 1.0f, 1.0f) * RandomRotation(random) *
+				RandomTranslation(random);
+		case MatrixKind::Perspective:
+		{
+			float nearZ = random.NextFloat(0.1f, 2.0f);
+			float farZ = random.NextFloat(50.0f, 1000.0f);
+			float l = random.NextFloat(-2.0f, -0.5f);
+			float b = random.NextFloat(-2.0f, -0.5f);
+			return random.NextInt(0, 1) == 0 ?
+				XMMatrixPerspectiveFovLH(random.NextFloat(0.2f, 2.0f), random.NextFloat(0.5f, 2.0f), nearZ, farZ) :
+				XMMatrixPerspectiveOffCenterLH(l, l + random.NextFloat(0.5f, 4.0f), b, b + random.NextFloat(0.5f, 4.0f), nearZ, farZ);
+		}
+		default:
+		{
+			// Affine, then a projective fourth column.
+			XMMATRIX M = RandomMatrix(random, MatrixKind::Affine);
+			M.r[0] = XMVectorSetW(M.r[0], random.NextFloat(-0.1f, 0.1f));
+			M.r[1] = XMVectorSetW(M.r[1], random.NextFloat(-0.1f, 0.1f));
+			M.r[2] = XMVectorSetW(M.r[2], random.NextFloat(-0.1f, 0.1f));
+			return M;
+		}
+		}
+	}
+
+	const MatrixKind Kinds[] = { MatrixKind::Rigid, MatrixKind::UniformScale, MatrixKind::Affine, MatrixKind::Perspective, MatrixKind::General };
+
+	// Inverse-transpose as the general path defines it: the translation is zeroed
+	// out before inverting.
+	XMMATRIX ReferenceInverseTranspose(CXMMATRIX M)
+	{
+		XMMATRIX A = M;
+		A.r[3] = XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f);
+		return XMMatrixTranspose(XMMatrixInverse(nullptr, A));
+	}
+}
+
+TEST(RandomStreamIsDeterministicPerSeedAndStream)
+{
+	RandomStream a(42, 7);
+	RandomStream b(42, 7);
+	CHECK(Sequence(a, 1000) == Sequence(b, 1000));
+
+	// The Fill functions draw from their own generators, but just as repeatably.
+	std::vector<float> fa(103), fb(103);
+	a.FillFloats(fa.data(), fa.size());
+	b.FillFloats(fb.data(), fb.size());
+	CHECK(fa == fb);
+
+	// Seeding again starts the same sequence over.
+	RandomStream fresh(42, 7);
+	std::vector<uint32> expected = Sequence(fresh, 100);
+	a.Seed(42, 7);
+	CHECK(Sequence(a, 100) == expected);
+
+	// The default stream is stream 0.
+	RandomStream c(42);
+	RandomStream d(42, 0);
+	CHECK(Sequence(c, 100) == Sequence(d, 100));
+}
+
+TEST(RandomStreamsAreIndependent)
+{
+	const size_t count = 4000;
+
+	RandomStream base(42, 0);
+	std::vector<uint32> baseValues = Sequence(base, count);
+
+	// Neighbouring streams, a different seed, and seed and stream swapped.
+	RandomStream others[] = { RandomStream(42, 1), RandomStream(42, 2), RandomStream(43, 0), RandomStream(0, 42) };
+	for(RandomStream& other : others)
+	{
+		std::vector<uint32> otherValues = Sequence(other, count);
+
+		// Two independent 32-bit sequences almost never agree, whether at the same
+		// position or shifted by one.
+		CHECK(CountEqual(baseValues, otherValues) < 3);
+		CHECK(CountEqual(std::vector<uint32>(baseValues.begin() + 1, baseValues.end()), otherValues) < 3);
+
+		// Uncorrelated: the product of two uniform [0, 1) values averages 1/4, with
+		// a standard deviation of about 0.0035 over this many samples.
+		RandomStream x(42, 0);
+		RandomStream y = other;
+		double sum = 0.0;
+		for(size_t i = 0; i < count; ++i)
+			sum += (double)x.NextFloat() * y.NextFloat();
+		CHECK(std::fabs(sum/count - 0.25) < 0.02);
+	}
+
+	// The four lanes of the Fill generators are independent of each other.
+	std::vector<float> f(4*count);
+	base.FillFloats(f.data(), f.size());
+	for(int lane = 1; lane < 4; ++lane)
+	{
+		size_t equal = 0;
+		double sum = 0.0;
+		for(size_t i = 0; i < count; ++i)
+		{
+			equal += f[4*i] == f[4*i + lane] ? 1 : 0;
+			sum += (double)f[4*i] * f[4*i + lane];
+		}
+
+		CHECK(equal < 3);
+		CHECK(std::fabs(sum/count - 0.25) < 0.02);
+	}
+}
+
+TEST(RandomStreamStaysInRange)
+{
+	RandomStream random(5, 3);
+
+	float low = 1.0f;
+	float high = 0.0f;
+	for(int i = 0; i < 10000; ++i)
+	{
+		float f = random.NextFloat();
+		CHECK(f >= 0.0f && f < 1.0f);
+		low = fminf(low, f);
+		high = fmaxf(high, f);
+
+		float g = random.NextFloat(-4.0f, 4.0f);
+		CHECK(g >= -4.0f && g < 4.0f);
+	}
+
+	// The whole range is used.
+	CHECK(low < 0.001f && high > 0.999f);
+
+	// Both ends of an int range come up, and nothing outside it.
+	bool seen[7] = {};
+	for(int i = 0; i < 1000; ++i)
+	{
+		int k = random.NextInt(-3, 3);
+		CHECK(k >= -3 && k <= 3);
+		if(k >= -3 && k <= 3)
+			seen[k + 3] = true;
+	}
+	for(bool s : seen)
+		CHECK(s);
+
+	CHECK(random.NextInt(5, 5) == 5);
+
+	// The full int range does not overflow.
+	bool negative = false;
+	bool positive = false;
+	for(int i = 0; i < 100; ++i)
+	{
+		int k = random.NextInt(INT_MIN, INT_MAX);
+		negative = negative || k < 0;
+		positive = positive || k > 0;
+	}
+	CHECK(negative && positive);
+
+	// Counts that are not a multiple of the four lanes fill exactly count values.
+	const size_t counts[] = { 0, 1, 3, 4, 5, 1001 };
+	for(size_t count : counts)
+	{
+		std::vector<float> f(count + 1, Guard);
+		random.FillFloats(f.data(), count, -4.0f, 4.0f);
+
+		for(size_t i = 0; i < count; ++i)
+			CHECK(f[i] >= -4.0f && f[i] < 4.0f);
+		CHECK(f[count] == Guard);
+	}
+}
+
+TEST(RandomStreamMakesUnitVectors)
+{
+	RandomStream random(9, 1);
+
+	// Unit length, and spread evenly: the mean of n uniform unit vectors has a
+	// standard deviation of about 0.58/sqrt(n) per component.
+	const size_t count = 4001;
+
+	std::vector<XMFLOAT3> filled(count + 1, XMFLOAT3(Guard, Guard, Guard));
+	random.FillUnitVec3(filled.data(), count);
+	CHECK(filled[count].x == Guard);
+
+	XMVECTOR fillSum = XMVectorZero();
+	XMVECTOR nextSum = XMVectorZero();
+	for(size_t i = 0; i < count; ++i)
+	{
+		XMVECTOR v = XMLoadFloat3(&filled[i]);
+		CHECK(std::fabs(XMVectorGetX(XMVector3Length(v)) - 1.0f) < 1e-5f);
+		fillSum += v;
+
+		XMVECTOR w = random.NextUnitVec3();
+		CHECK(std::fabs(XMVectorGetX(XMVector3Length(w)) - 1.0f) < 1e-5f);
+		CHECK(XMVectorGetW(w) == 0.0f);
+		nextSum += w;
+	}
+
+	CHECK(XMVectorGetX(XMVector3Length(fillSum)) / count < 0.05f);
+	CHECK(XMVectorGetX(XMVector3Length(nextSum)) / count < 0.05f);
+}
+
+TEST(RandomStreamMakesHemisphereVectors)
+{
+	RandomStream random(9, 2);
+
+	XMVECTOR n = XMVector3Normalize(XMVectorSet(1.0f, 2.0f, -2.0f, 0.0f));
+
+	// On the hemisphere around n, and uniform over it: the cosine to n is then
+	// uniform in [0, 1] with mean 1/2, and the part orthogonal to n averages out.
+	const size_t count = 4001;
+
+	std::vector<XMFLOAT3> filled(count + 1, XMFLOAT3(Guard, Guard, Guard));
+	random.FillHemisphereUnitVec3(filled.data(), count, n);
+	CHECK(filled[count].x == Guard);
+
+	double fillCos = 0.0;
+	double nextCos = 0.0;
+	XMVECTOR fillSum = XMVectorZero();
+	XMVECTOR nextSum = XMVectorZero();
+	for(size_t i = 0; i < count; ++i)
+	{
+		XMVECTOR v = XMLoadFloat3(&filled[i]);
+		float cosV = XMVectorGetX(XMVector3Dot(v, n));
+		CHECK(std::fabs(XMVectorGetX(XMVector3Length(v)) - 1.0f) < 1e-5f);
+		CHECK(cosV >= -1e-6f);
+		fillCos += cosV;
+		fillSum += v;
+
+		XMVECTOR w = random.NextHemisphereUnitVec3(n);
+		float cosW = XMVectorGetX(XMVector3Dot(w, n));
+		CHECK(std::fabs(XMVectorGetX(XMVector3Length(w)) - 1.0f) < 1e-5f);
+		CHECK(cosW >= -1e-6f);
+		nextCos += cosW;
+		nextSum += w;
+	}
+
+	CHECK(std::fabs(fillCos/count - 0.5) < 0.03);
+	CHECK(std::fabs(nextCos/count - 0.5) < 0.03);
+
+	CHECK(XMVectorGetX(XMVector3Length(fillSum/(float)count - 0.5f*n)) < 0.05f);
+	CHECK(XMVectorGetX(XMVector3Length(nextSum/(float)count - 0.5f*n)) < 0.05f);
+}
+
+TEST(InverseMatchesGeneralInversePerKind)
+{
+	RandomStream random(16);
+
+	for(MatrixKind kind : Kinds)
+	{
+		for(int i = 0; i < 200; ++i)
+		{
+			XMMATRIX M = RandomMatrix(random, kind);
+			XMMATRIX inverse = MathHelper::Inverse(M, kind);
+
+			CHECK(NearMatrix(inverse, XMMatrixInverse(nullptr, M), 1e-3f));
+			CHECK(NearMatrix(inverse*M, XMMatrixIdentity(), 1e-3f));
+
+			// A tagged matrix inverts the same way.
+			CHECK(NearMatrix(TaggedMatrix(M, kind).Inverse().Load(), inverse, 0.0f));
+		}
+	}
+}
+
+TEST(InverseTransposeMatchesGeneralPerKind)
+{
+	RandomStream random(17);
+
+	const MatrixKind kinds[] = { MatrixKind::Rigid, MatrixKind::UniformScale, MatrixKind::Affine, MatrixKind::General };
+	for(MatrixKind kind : kinds)
+	{
+		for(int i = 0; i < 200; ++i)
+		{
+			XMMATRIX M = RandomMatrix(random, kind);
+			XMMATRIX reference = ReferenceInverseTranspose(M);
+
+			CHECK(NearMatrix(MathHelper::InverseTranspose(M, kind), reference, 1e-3f));
+
+			// Without a kind the matrix is taken as general, which is right for
+			// every kind.
+			CHECK(NearMatrix(MathHelper::InverseTranspose(M), reference, 1e-3f));
+		}
+	}
+
+	// The affine shortcut ignores a projective fourth column, so it is only the
+	// default's answer for matrices that really are affine.
+	XMMATRIX M = XMMatrixScaling(2.0f, 0.5f, 3.0f) * XMMatrixRotationX(0.7f) * XMMatrixTranslation(5.0f, -2.0f, 8.0f);
+	M.r[0] = XMVectorSetW(M.r[0], 0.5f);
+	M.r[1] = XMVectorSetW(M.r[1], -0.25f);
+	M.r[2] = XMVectorSetW(M.r[2], 0.3f);
+	CHECK(!NearMatrix(MathHelper::InverseTranspose(M, MatrixKind::Affine), MathHelper::InverseTranspose(M), 1e-3f));
+}
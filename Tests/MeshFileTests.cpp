@@ -0,0 +1,234 @@
+//***************************************************************************************
+// MeshFileTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/MeshFile.h"
+#include "../Common/MappedFile.h"
+#include "../Common/GeometryGenerator.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#pragma comment(lib, "d3dcompiler.lib")
+
+using Microsoft::WRL::ComPtr;
+using namespace DirectX;
+
+using uint32 = std::uint32_t;
+
+namespace
+{
+	const wchar_t* MeshFileName = L"MeshFileTests.bin";
+	const uint32 ContentVersion = 7;
+
+	// Deletes the test's file however it ends.
+	struct FileScope
+	{
+		~FileScope()
+		{
+			std::remove("MeshFileTests.bin");
+		}
+	};
+
+	// A box and a sphere in one pair of buffers with 16-bit indices, each with its
+	// own bounds and transform.
+	void BuildGeometry(MeshGeometry& geo, MeshFile::TransformMap& transforms)
+	{
+		GeometryGenerator geoGen;
+		GeometryGenerator::MeshData box = geoGen.CreateBox(1.0f, 2.0f, 3.0f, 0);
+		GeometryGenerator::MeshData sphere = geoGen.CreateSphere(0.5f, 8, 6);
+
+		std::vector<GeometryGenerator::Vertex> vertices = box.Vertices;
+		vertices.insert(vertices.end(), sphere.Vertices.begin(), sphere.Vertices.end());
+
+		std::vector<std::uint16_t> indices = box.GetIndices16();
+		std::vector<std::uint16_t> sphereIndices = sphere.GetIndices16();
+		indices.insert(indices.end(), sphereIndices.begin(), sphereIndices.end());
+
+		UINT vbByteSize = (UINT)(vertices.size()*sizeof(GeometryGenerator::Vertex));
+		UINT ibByteSize = (UINT)(indices.size()*sizeof(std::uint16_t));
+
+		ThrowIfFailed(D3DCreateBlob(vbByteSize, geo.VertexBufferCPU.GetAddressOf()));
+		std::memcpy(geo.VertexBufferCPU->GetBufferPointer(), vertices.data(), vbByteSize);
+
+		ThrowIfFailed(D3DCreateBlob(ibByteSize, geo.IndexBufferCPU.GetAddressOf()));
+		std::memcpy(geo.IndexBufferCPU->GetBufferPointer(), indices.data(), ibByteSize);
+
+		geo.Name = "testGeo";
+		geo.VertexByteStride = sizeof(GeometryGenerator::Vertex);
+		geo.VertexBufferByteSize = vbByteSize;
+		geo.IndexFormat = DXGI_FORMAT_R16_UINT;
+		geo.IndexBufferByteSize = ibByteSize;
+
+		SubmeshGeometry boxSubmesh;
+		boxSubmesh.IndexCount = (UINT)box.Indices32.size();
+		boxSubmesh.StartIndexLocation = 0;
+		boxSubmesh.BaseVertexLocation = 0;
+		boxSubmesh.Bounds = BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(0.5f, 1.0f, 1.5f));
+
+		SubmeshGeometry sphereSubmesh;
+		sphereSubmesh.IndexCount = (UINT)sphere.Indices32.size();
+		sphereSubmesh.StartIndexLocation = boxSubmesh.IndexCount;
+		sphereSubmesh.BaseVertexLocation = (INT)box.Vertices.size();
+		sphereSubmesh.Bounds = BoundingBox(XMFLOAT3(1.0f, 2.0f, 3.0f), XMFLOAT3(0.5f, 0.5f, 0.5f));
+
+		geo.DrawArgs["box"] = boxSubmesh;
+		geo.DrawArgs["sphere"] = sphereSubmesh;
+
+		XMStoreFloat4x4(&transforms["box"], XMMatrixScaling(2.0f, 3.0f, 4.0f));
+		XMStoreFloat4x4(&transforms["sphere"], XMMatrixTranslation(5.0f, 6.0f, 7.0f));
+	}
+
+	bool SameBytes(ID3DBlob* a, ID3DBlob* b)
+	{
+		return a->GetBufferSize() == b->GetBufferSize() &&
+			std::memcmp(a->GetBufferPointer(), b->GetBufferPointer(), a->GetBufferSize()) == 0;
+	}
+
+	bool SameFloats(const void* a, const void* b, size_t size)
+	{
+		return std::memcmp(a, b, size) == 0;
+	}
+
+	// The saved file, read back into memory.
+	std::vector<std::uint8_t> ReadFile()
+	{
+		MappedFile file;
+		if(!file.Open(MeshFileName))
+			return {};
+
+		return std::vector<std::uint8_t>(file.GetData(), file.GetData() + file.GetSize());
+	}
+
+	bool Load(MeshGeometry& geo)
+	{
+		return MeshFile::Load(MeshFileName, ContentVersion, geo);
+	}
+}
+
+TEST(MeshFileRoundTrip)
+{
+	FileScope files;
+
+	MeshGeometry geo;
+	MeshFile::TransformMap transforms;
+	BuildGeometry(geo, transforms);
+
+	CHECK(MeshFile::Save(MeshFileName, ContentVersion, geo, &transforms));
+
+	MeshGeometry loaded;
+	MeshFile::TransformMap loadedTransforms;
+	CHECK(MeshFile::Load(MeshFileName, ContentVersion, loaded, &loadedTransforms));
+
+	CHECK(loaded.Name == geo.Name);
+	CHECK(loaded.VertexByteStride == geo.VertexByteStride);
+	CHECK(loaded.VertexBufferByteSize == geo.VertexBufferByteSize);
+	CHECK(loaded.IndexFormat == geo.IndexFormat);
+	CHECK(loaded.IndexBufferByteSize == geo.IndexBufferByteSize);
+	CHECK(SameBytes(loaded.VertexBufferCPU.Get(), geo.VertexBufferCPU.Get()));
+	CHECK(SameBytes(loaded.IndexBufferCPU.Get(), geo.IndexBufferCPU.Get()));
+
+	CHECK(loaded.DrawArgs.size() == geo.DrawArgs.size());
+	CHECK(loadedTransforms.size() == transforms.size());
+	for(auto& e : geo.DrawArgs)
+	{
+		auto it = loaded.DrawArgs.find(e.first);
+		CHECK(it != loaded.DrawArgs.end());
+
+		const SubmeshGeometry& expected = e.second;
+		const SubmeshGeometry& submesh = it->second;
+		CHECK(submesh.IndexCount == expected.IndexCount);
+		CHECK(submesh.StartIndexLocation == expected.StartIndexLocation);
+		CHECK(submesh.BaseVertexLocation == expected.BaseVertexLocation);
+		CHECK(SameFloats(&submesh.Bounds.Center, &expected.Bounds.Center, sizeof(XMFLOAT3)));
+		CHECK(SameFloats(&submesh.Bounds.Extents, &expected.Bounds.Extents, sizeof(XMFLOAT3)));
+		CHECK(SameFloats(&loadedTransforms[e.first], &transforms[e.first], sizeof(XMFLOAT4X4)));
+	}
+
+	// Either blob keeps the mapping open on its own.
+	ComPtr<ID3DBlob> vertices = loaded.VertexBufferCPU;
+	loaded.VertexBufferCPU = nullptr;
+	loaded.IndexBufferCPU = nullptr;
+	CHECK(std::memcmp(vertices->GetBufferPointer(), geo.VertexBufferCPU->GetBufferPointer(), geo.VertexBufferByteSize) == 0);
+}
+
+TEST(MeshFileRejectsOtherContentVersion)
+{
+	FileScope files;
+
+	MeshGeometry geo;
+	MeshFile::TransformMap transforms;
+	BuildGeometry(geo, transforms);
+	CHECK(MeshFile::Save(MeshFileName, ContentVersion, geo, &transforms));
+
+	MeshGeometry loaded;
+	CHECK(!MeshFile::Load(MeshFileName, ContentVersion + 1, loaded));
+	CHECK(loaded.VertexBufferCPU == nullptr);
+	CHECK(loaded.DrawArgs.empty());
+}
+
+TEST(MeshFileRejectsTruncatedFile)
+{
+	FileScope files;
+
+	MeshGeometry geo;
+	MeshFile::TransformMap transforms;
+	BuildGeometry(geo, transforms);
+	CHECK(MeshFile::Save(MeshFileName, ContentVersion, geo, &transforms));
+
+	std::vector<std::uint8_t> bytes = ReadFile();
+	CHECK(!bytes.empty());
+
+	// Cut inside the index buffer, inside the submesh table, and inside the header.
+	const size_t sizes[] = { bytes.size() - 1, 100, 16 };
+	for(size_t size : sizes)
+	{
+		CHECK(MappedFile::Write(MeshFileName, bytes.data(), size));
+
+		MeshGeometry loaded;
+		CHECK(!Load(loaded));
+	}
+}
+
+TEST(MeshFileRejectsSubmeshPastIndexBuffer)
+{
+	FileScope files;
+
+	MeshGeometry geo;
+	MeshFile::TransformMap transforms;
+	BuildGeometry(geo, transforms);
+
+	// Save writes the table as is; Load must not hand out a range it cannot draw.
+	UINT indexCount = geo.IndexBufferByteSize / sizeof(std::uint16_t);
+	geo.DrawArgs["sphere"].StartIndexLocation = indexCount - geo.DrawArgs["sphere"].IndexCount + 1;
+	CHECK(MeshFile::Save(MeshFileName, ContentVersion, geo));
+
+	MeshGeometry loaded;
+	CHECK(!Load(loaded));
+
+	geo.DrawArgs["sphere"].StartIndexLocation = indexCount - geo.DrawArgs["sphere"].IndexCount;
+	CHECK(MeshFile::Save(MeshFileName, ContentVersion, geo));
+	CHECK(Load(loaded));
+}
+
+TEST(MeshFileRejectsPartialVertices)
+{
+	FileScope files;
+
+	MeshGeometry geo;
+	MeshFile::TransformMap transforms;
+	BuildGeometry(geo, transforms);
+
+	MeshGeometry loaded;
+
+	geo.VertexByteStride = 0;
+	CHECK(MeshFile::Save(MeshFileName, ContentVersion, geo));
+	CHECK(!Load(loaded));
+
+	// A stride that does not divide the buffer leaves a partial vertex at the end.
+	geo.VertexByteStride = sizeof(GeometryGenerator::Vertex) + 1;
+	CHECK(geo.VertexBufferByteSize % geo.VertexByteStride != 0);
+	CHECK(MeshFile::Save(MeshFileName, ContentVersion, geo));
+	CHECK(!Load(loaded));
+}
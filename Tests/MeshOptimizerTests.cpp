@@ -0,0 +1,342 @@
+//***************************************************************************************
+// MeshOptimizerTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/GeometryGenerator.h"
+#include "../Common/MeshOptimizer.h"
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+
+using uint32 = std::uint32_t;
+using Vertex = GeometryGenerator::Vertex;
+
+namespace
+{
+	Vertex MakeVertex(float x, float y, float z)
+	{
+		return Vertex(x, y, z, 0.0f, 1.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f);
+	}
+
+	bool Near(const XMFLOAT3& a, const XMFLOAT3& b, float tolerance)
+	{
+		return std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance && std::abs(a.z - b.z) <= tolerance;
+	}
+
+	float ACMR(const GeometryGenerator::MeshData& meshData)
+	{
+		return MeshOptimizer::AnalyzeVertexCache(meshData.Indices32.data(), meshData.Indices32.size(),
+			(uint32)meshData.Vertices.size()).ACMR;
+	}
+
+	// Puts the triangles in a random order, each with its corners rotated by a
+	// random amount, which keeps the winding.
+	void ShuffleTriangles(GeometryGenerator::MeshData& meshData, std::uint32_t seed)
+	{
+		std::mt19937 random(seed);
+
+		std::vector<uint32>& indices = meshData.Indices32;
+		size_t triCount = indices.size() / 3;
+		for(size_t t = triCount; t > 1; --t)
+		{
+			size_t u = random() % t;
+			for(size_t k = 0; k < 3; ++k)
+				std::swap(indices[(t-1)*3+k], indices[u*3+k]);
+		}
+
+		for(size_t t = 0; t < triCount; ++t)
+			std::rotate(&indices[t*3], &indices[t*3] + random() % 3, &indices[t*3] + 3);
+	}
+
+	using Corner = std::array<float, 3>;
+	using Triangle = std::array<Corner, 3>;
+
+	// The triangles as position triples, each rotated to start at its smallest
+	// corner so that the winding is kept but the starting corner does not matter,
+	// and sorted.
+	std::vector<Triangle> TriangleSet(const GeometryGenerator::MeshData& meshData)
+	{
+		std::vector<Triangle> triangles;
+		for(size_t t = 0; t + 2 < meshData.Indices32.size(); t += 3)
+		{
+			Triangle triangle;
+			for(size_t k = 0; k < 3; ++k)
+			{
+				const XMFLOAT3& p = meshData.Vertices[meshData.Indices32[t+k]].Position;
+				triangle[k] = { p.x, p.y, p.z };
+			}
+
+			std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+			triangles.push_back(triangle);
+		}
+
+		std::sort(triangles.begin(), triangles.end());
+		return triangles;
+	}
+
+	// Whether the vertices are in the order the indices first use them, with none
+	// left unused.
+	bool InFirstUseOrder(const GeometryGenerator::MeshData& meshData)
+	{
+		uint32 next = 0;
+		for(uint32 i : meshData.Indices32)
+		{
+			if(i > next)
+				return false;
+			if(i == next)
+				++next;
+		}
+
+		return next == meshData.Vertices.size();
+	}
+
+	std::vector<GeometryGenerator::MeshData> TestMeshes()
+	{
+		GeometryGenerator geoGen;
+		return { geoGen.CreateGrid(20.0f, 30.0f, 40, 30), geoGen.CreateSphere(1.0f, 40, 30), geoGen.CreateGeosphere(1.0f, 4) };
+	}
+}
+
+TEST(WeldMergesAcrossHashCells)
+{
+	MeshOptimizer::WeldTolerance tolerance;
+	tolerance.Position = 0.01f;
+
+	// Two triangles sharing an edge, each with its own copies of the edge's
+	// vertices.  The copies are within the tolerance but on the other side of a
+	// cell boundary, at multiples of 0.01 on every axis.
+	GeometryGenerator::MeshData meshData;
+	meshData.Vertices =
+	{
+		MakeVertex(0.0f,    0.0f,    0.0f),
+		MakeVertex(0.0f,    0.0f,    1.0f),
+		MakeVertex(1.0099f, 0.0099f, 0.0099f),
+
+		MakeVertex(1.0101f, 0.0101f, 0.0101f), // Copy of 2, one cell up on every axis.
+		MakeVertex(0.0f,    0.0f,    1.0f),    // Exact copy of 1.
+		MakeVertex(1.0f,    0.0f,    1.0f),
+
+		MakeVertex(1.03f,   0.0f,    0.0f)     // Near 2, but not within the tolerance.
+	};
+	meshData.Indices32 = { 0, 1, 2,  3, 4, 5,  6, 5, 3 };
+
+	std::vector<XMFLOAT3> trianglesBefore;
+	for(uint32 i : meshData.Indices32)
+		trianglesBefore.push_back(meshData.Vertices[i].Position);
+
+	uint32 removed = MeshOptimizer::WeldVertices(meshData, tolerance);
+
+	CHECK(removed == 2);
+	CHECK(meshData.Vertices.size() == 5);
+
+	// The second triangle now uses the first one's vertices, which are kept.
+	CHECK(meshData.Indices32.size() == 9);
+	if(meshData.Indices32.size() != 9)
+		return;
+
+	CHECK(meshData.Indices32[3] == meshData.Indices32[2]);
+	CHECK(meshData.Indices32[4] == meshData.Indices32[1]);
+	CHECK(meshData.Indices32[8] == meshData.Indices32[2]);
+
+	// Every corner is still within the tolerance of where it was.
+	for(size_t i = 0; i < meshData.Indices32.size(); ++i)
+		CHECK(Near(meshData.Vertices[meshData.Indices32[i]].Position, trianglesBefore[i], tolerance.Position));
+}
+
+TEST(WeldRemapsIndicesOfGeneratedMeshes)
+{
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData box = geoGen.CreateBox(1.0f, 2.0f, 3.0f, 0);
+
+	// Each face has its own corners, since the normals differ.
+	GeometryGenerator::MeshData welded = box;
+	CHECK(MeshOptimizer::WeldVertices(welded) == 0);
+	CHECK(welded.Indices32 == box.Indices32);
+
+	// Comparing positions only leaves the 8 corners of the box and every triangle.
+	MeshOptimizer::WeldTolerance positionOnly;
+	positionOnly.Normal = FLT_MAX;
+	positionOnly.TangentU = FLT_MAX;
+	positionOnly.TexC = FLT_MAX;
+
+	welded = box;
+	CHECK(MeshOptimizer::WeldVertices(welded, positionOnly) == box.Vertices.size() - 8);
+	CHECK(welded.Vertices.size() == 8);
+	CHECK(welded.Indices32.size() == box.Indices32.size());
+
+	for(size_t i = 0; i < box.Indices32.size() && i < welded.Indices32.size(); ++i)
+	{
+		CHECK(welded.Indices32[i] < welded.Vertices.size());
+		CHECK(Near(welded.Vertices[welded.Indices32[i]].Position, box.Vertices[box.Indices32[i]].Position, 0.0f));
+	}
+}
+
+TEST(WeldRemovesCollapsedTriangles)
+{
+	MeshOptimizer::WeldTolerance tolerance;
+	tolerance.Position = 0.001f;
+
+	// The middle triangle is a sliver whose two near corners weld together, so it
+	// is dropped, while the last triangle is kept on the welded corner.
+	GeometryGenerator::MeshData meshData;
+	meshData.Vertices =
+	{
+		MakeVertex(0.0f,    0.0f, 0.0f),
+		MakeVertex(0.0f,    0.0f, 1.0f),
+		MakeVertex(1.0f,    0.0f, 0.0f),
+
+		MakeVertex(1.0005f, 0.0f, 0.0f), // Welds to 2.
+		MakeVertex(1.0f,    0.0f, 1.0f),
+		MakeVertex(2.0f,    0.0f, 0.0f)
+	};
+	meshData.Indices32 = { 0, 1, 2,  2, 4, 3,  3, 4, 5 };
+
+	uint32 removed = MeshOptimizer::WeldVertices(meshData, tolerance);
+
+	CHECK(removed == 1);
+	CHECK(meshData.Vertices.size() == 5);
+	CHECK(meshData.Indices32.size() == 6);
+
+	for(size_t t = 0; t + 2 < meshData.Indices32.size(); t += 3)
+	{
+		uint32 i0 = meshData.Indices32[t];
+		uint32 i1 = meshData.Indices32[t+1];
+		uint32 i2 = meshData.Indices32[t+2];
+		CHECK(i0 != i1 && i1 != i2 && i0 != i2);
+	}
+
+	// A triangle whose corners all weld into one point goes as well, with its
+	// vertices.
+	GeometryGenerator::MeshData speck;
+	speck.Vertices = { MakeVertex(0.0f, 0.0f, 0.0f), MakeVertex(0.0001f, 0.0f, 0.0f), MakeVertex(0.0f, 0.0001f, 0.0f) };
+	speck.Indices32 = { 0, 1, 2 };
+
+	CHECK(MeshOptimizer::WeldVertices(speck, tolerance) == 3);
+	CHECK(speck.Vertices.empty());
+	CHECK(speck.Indices32.empty());
+}
+
+TEST(OptimizeVertexCacheLowersACMR)
+{
+	std::uint32_t seed = 1;
+	for(GeometryGenerator::MeshData meshData : TestMeshes())
+	{
+		ShuffleTriangles(meshData, seed++);
+		const std::vector<Triangle> triangles = TriangleSet(meshData);
+		const size_t vertexCount = meshData.Vertices.size();
+
+		// A random order misses the cache on nearly every corner.
+		float shuffled = ACMR(meshData);
+		CHECK(shuffled > 2.0f);
+
+		MeshOptimizer::OptimizeVertexCache(meshData.Indices32.data(), meshData.Indices32.size(), (uint32)vertexCount);
+
+		// Regular meshes come out at well under one miss per triangle.
+		float optimized = ACMR(meshData);
+		CHECK(optimized < 0.5f*shuffled);
+		CHECK(optimized < 1.0f);
+
+		// The same triangles, with the same winding, and the vertices untouched.
+		CHECK(meshData.Vertices.size() == vertexCount);
+		CHECK(TriangleSet(meshData) == triangles);
+
+		// Optimizing again does not make it worse.
+		for(int pass = 0; pass < 3; ++pass)
+		{
+			MeshOptimizer::OptimizeVertexCache(meshData.Indices32.data(), meshData.Indices32.size(), (uint32)vertexCount);
+
+			float again = ACMR(meshData);
+			CHECK(again <= optimized);
+			optimized = again;
+		}
+
+		CHECK(TriangleSet(meshData) == triangles);
+	}
+}
+
+TEST(OptimizeVertexFetchUsesFirstUseOrder)
+{
+	std::uint32_t seed = 100;
+	for(GeometryGenerator::MeshData meshData : TestMeshes())
+	{
+		ShuffleTriangles(meshData, seed++);
+		MeshOptimizer::OptimizeVertexCache(meshData.Indices32.data(), meshData.Indices32.size(), (uint32)meshData.Vertices.size());
+
+		// An unreferenced vertex, which is removed.
+		meshData.Vertices.push_back(MakeVertex(100.0f, 100.0f, 100.0f));
+		CHECK(!InFirstUseOrder(meshData));
+
+		GeometryGenerator::MeshData before = meshData;
+		float acmr = ACMR(meshData);
+
+		MeshOptimizer::OptimizeVertexFetch(meshData);
+
+		CHECK(InFirstUseOrder(meshData));
+		CHECK(meshData.Vertices.size() == before.Vertices.size() - 1);
+
+		// The triangle order is kept, so the cache behaves the same, and every
+		// index was remapped to a copy of the vertex it used.
+		CHECK(meshData.Indices32.size() == before.Indices32.size());
+		CHECK(ACMR(meshData) == acmr);
+
+		bool remapped = true;
+		for(size_t i = 0; i < meshData.Indices32.size(); ++i)
+		{
+			const Vertex& v = meshData.Vertices[meshData.Indices32[i]];
+			const Vertex& w = before.Vertices[before.Indices32[i]];
+			remapped = remapped && std::memcmp(&v, &w, sizeof(Vertex)) == 0;
+		}
+		CHECK(remapped);
+
+		// A mesh already in first-use order is left as it is.
+		GeometryGenerator::MeshData again = meshData;
+		MeshOptimizer::OptimizeVertexFetch(again);
+		CHECK(again.Indices32 == meshData.Indices32);
+		CHECK(std::memcmp(again.Vertices.data(), meshData.Vertices.data(), meshData.Vertices.size()*sizeof(Vertex)) == 0);
+	}
+}
+
+TEST(OptimizeReportsStatsAndCookedMeshesAreOptimized)
+{
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData meshData = geoGen.CreateGrid(10.0f, 10.0f, 25, 25);
+	ShuffleTriangles(meshData, 7);
+
+	const std::vector<Triangle> triangles = TriangleSet(meshData);
+	float shuffled = ACMR(meshData);
+
+	MeshOptimizer::OptimizeStats stats = MeshOptimizer::Optimize(meshData);
+
+	CHECK(stats.Before.ACMR == shuffled);
+	CHECK(stats.After.ACMR == ACMR(meshData));
+	CHECK(stats.After.ACMR < stats.Before.ACMR);
+	CHECK(stats.After.ATVR < stats.Before.ATVR);
+	CHECK(InFirstUseOrder(meshData));
+	CHECK(TriangleSet(meshData) == triangles);
+
+	// Cooked meshes come out of the generator welded and optimized: the sphere's
+	// triangles are all kept, and none of its shared vertices are duplicated.
+	GeometryGenerator::MeshData uncooked = geoGen.CreateSphere(1.0f, 24, 16);
+
+	geoGen.SetCooked(true);
+	CHECK(geoGen.IsCooked());
+	GeometryGenerator::MeshData cooked = geoGen.CreateSphere(1.0f, 24, 16);
+
+	CHECK(cooked.Indices32.size() == uncooked.Indices32.size());
+	CHECK(cooked.Vertices.size() <= uncooked.Vertices.size());
+	CHECK(InFirstUseOrder(cooked));
+	CHECK(ACMR(cooked) <= ACMR(uncooked));
+
+	GeometryGenerator::MeshData optimized = uncooked;
+	MeshOptimizer::WeldVertices(optimized);
+	MeshOptimizer::Optimize(optimized);
+	CHECK(cooked.Indices32 == optimized.Indices32);
+	CHECK(cooked.Vertices.size() == optimized.Vertices.size());
+}
@@ -0,0 +1,188 @@
+//***************************************************************************************
+// MeshSimplifierTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/GeometryGenerator.h"
+#include "../Common/MeshSimplifier.h"
+#include <algorithm>
+#include <set>
+#include <utility>
+#include <vector>
+
+using namespace DirectX;
+
+using uint32 = std::uint32_t;
+
+namespace
+{
+	// True when no triangle repeats a vertex or has zero area.
+	bool HasNoDegenerateTriangles(const GeometryGenerator::MeshData& meshData, const std::vector<uint32>& indices)
+	{
+		for(size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			uint32 i0 = indices[i];
+			uint32 i1 = indices[i+1];
+			uint32 i2 = indices[i+2];
+
+			if(i0 == i1 || i1 == i2 || i0 == i2)
+				return false;
+
+			XMVECTOR p0 = XMLoadFloat3(&meshData.Vertices[i0].Position);
+			XMVECTOR p1 = XMLoadFloat3(&meshData.Vertices[i1].Position);
+			XMVECTOR p2 = XMLoadFloat3(&meshData.Vertices[i2].Position);
+			if(XMVectorGetX(XMVector3LengthSq(XMVector3Cross(p1 - p0, p2 - p0))) <= 0.0f)
+				return false;
+		}
+
+		return true;
+	}
+
+	// Edges used by exactly one triangle, as (smaller, larger) vertex pairs.
+	std::set<std::pair<uint32, uint32>> BorderEdges(const std::vector<uint32>& indices)
+	{
+		std::set<std::pair<uint32, uint32>> once;
+		std::set<std::pair<uint32, uint32>> more;
+
+		for(size_t i = 0; i + 2 < indices.size(); i += 3)
+		{
+			for(size_t k = 0; k < 3; ++k)
+			{
+				uint32 a = indices[i + k];
+				uint32 b = indices[i + (k+1)%3];
+				auto edge = std::make_pair(std::min(a, b), std::max(a, b));
+
+				if(more.count(edge) != 0)
+					continue;
+
+				if(!once.insert(edge).second)
+				{
+					once.erase(edge);
+					more.insert(edge);
+				}
+			}
+		}
+
+		return once;
+	}
+}
+
+TEST(SimplifyReachesTargetCount)
+{
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData meshData = geoGen.CreateGeosphere(1.0f, 4);
+
+	const uint32 targets[] = { 3000, 600, 120 };
+	for(uint32 target : targets)
+	{
+		// An error bound as large as the mesh lets every collapse through.
+		std::vector<uint32> indices = MeshSimplifier::Simplify(meshData, target, 1.0f);
+
+		CHECK(!indices.empty());
+		CHECK(indices.size() % 3 == 0);
+		CHECK(indices.size() <= target);
+		CHECK(HasNoDegenerateTriangles(meshData, indices));
+	}
+
+	// A mesh already below the target comes back unchanged.
+	CHECK(MeshSimplifier::Simplify(meshData, (uint32)meshData.Indices32.size(), 1.0f) == meshData.Indices32);
+}
+
+TEST(SimplifyStaysWithinErrorBound)
+{
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData meshData = geoGen.CreateGeosphere(1.0f, 4);
+
+	const float maxErrors[] = { 0.001f, 0.005f, 0.02f };
+	size_t previousSize = meshData.Indices32.size() + 1;
+
+	for(float maxError : maxErrors)
+	{
+		float error = -1.0f;
+		std::vector<uint32> indices = MeshSimplifier::Simplify(meshData, 0, maxError, &error);
+
+		CHECK(error >= 0.0f && error <= maxError);
+		CHECK(HasNoDegenerateTriangles(meshData, indices));
+
+		// A looser bound allows more collapses.
+		CHECK(indices.size() < previousSize);
+		previousSize = indices.size();
+	}
+
+	// Every collapse on a sphere moves the surface, so a bound of almost nothing
+	// allows none of them.
+	float error = -1.0f;
+	std::vector<uint32> indices = MeshSimplifier::Simplify(meshData, 0, 1e-7f, &error);
+	CHECK(indices == meshData.Indices32);
+	CHECK(error == 0.0f);
+}
+
+TEST(SimplifyKeepsBordersInPlace)
+{
+	GeometryGenerator geoGen;
+
+	// Flat, so every interior collapse is free and only the borders hold the
+	// simplification back.
+	const uint32 m = 17;
+	const uint32 n = 9;
+	GeometryGenerator::MeshData meshData = geoGen.CreateGrid(16.0f, 8.0f, m, n);
+
+	std::vector<uint32> indices = MeshSimplifier::Simplify(meshData, 0, 1.0f);
+
+	CHECK(indices.size() < meshData.Indices32.size());
+	CHECK(HasNoDegenerateTriangles(meshData, indices));
+
+	// The outline is made of the same edges, so every border vertex is still used
+	// where it was.
+	CHECK(BorderEdges(indices) == BorderEdges(meshData.Indices32));
+
+	std::vector<bool> used(meshData.Vertices.size(), false);
+	for(uint32 i : indices)
+		used[i] = true;
+
+	for(uint32 i = 0; i < m; ++i)
+	{
+		for(uint32 j = 0; j < n; ++j)
+		{
+			if(i == 0 || j == 0 || i == m-1 || j == n-1)
+				CHECK(used[i*n+j]);
+		}
+	}
+}
+
+TEST(LodChainLevelsShareTheVertices)
+{
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData meshData = geoGen.CreateGeosphere(1.0f, 4);
+
+	const float maxError = 0.02f;
+	MeshSimplifier::LodChain chain = MeshSimplifier::BuildLodChain(meshData, 4, 0.5f, maxError);
+
+	CHECK(chain.Levels.size() >= 2);
+	CHECK(chain.Mesh.Vertices.size() == meshData.Vertices.size());
+
+	// The levels are back to back, each smaller than the one before, and draw
+	// from the one vertex buffer.
+	UINT nextIndex = 0;
+	UINT previousCount = (UINT)meshData.Indices32.size() + 1;
+	for(const MeshSimplifier::LodLevel& level : chain.Levels)
+	{
+		const SubmeshGeometry& submesh = level.Submesh;
+
+		CHECK(submesh.StartIndexLocation == nextIndex);
+		CHECK(submesh.BaseVertexLocation == 0);
+		CHECK(submesh.IndexCount < previousCount);
+		CHECK(level.Error <= maxError);
+
+		std::vector<uint32> indices(chain.Mesh.Indices32.begin() + submesh.StartIndexLocation,
+			chain.Mesh.Indices32.begin() + submesh.StartIndexLocation + submesh.IndexCount);
+		CHECK(HasNoDegenerateTriangles(chain.Mesh, indices));
+
+		nextIndex += submesh.IndexCount;
+		previousCount = submesh.IndexCount;
+	}
+
+	CHECK(nextIndex == chain.Mesh.Indices32.size());
+	CHECK(chain.Levels[0].Submesh.IndexCount == meshData.Indices32.size());
+	CHECK(chain.Levels[0].Error == 0.0f);
+}
@@ -0,0 +1,138 @@
+//***************************************************************************************
+// MeshletBuilderTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/GeometryGenerator.h"
+#include "../Common/MathHelper.h"
+#include "../Common/MeshletBuilder.h"
+#include <vector>
+
+using namespace DirectX;
+
+using uint32 = std::uint32_t;
+
+namespace
+{
+	// True when the meshlet's index range lies inside one of the ranges Cull kept.
+	bool IsDrawn(const MeshletBuilder::Meshlet& m, const std::vector<MeshletBuilder::DrawRange>& ranges)
+	{
+		for(const MeshletBuilder::DrawRange& range : ranges)
+		{
+			if(m.StartIndexLocation >= range.StartIndexLocation &&
+			   m.StartIndexLocation + m.IndexCount <= range.StartIndexLocation + range.IndexCount)
+				return true;
+		}
+
+		return false;
+	}
+}
+
+TEST(MeshletsRespectLimitsAndCoverEveryTriangle)
+{
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData meshData = geoGen.CreateGeosphere(1.0f, 3);
+
+	const uint32 limits[][2] = { { 64, 126 }, { 3, 1 }, { 16, 8 }, { 256, 64 } };
+
+	for(const auto& limit : limits)
+	{
+		MeshletBuilder::MeshletData meshlets = MeshletBuilder::Build(meshData, limit[0], limit[1]);
+
+		// The triangles keep their order, so the reordered list is the input.
+		CHECK(meshlets.Indices == meshData.Indices32);
+
+		// The meshlets tile the index list back to back, so every triangle is in
+		// exactly one of them.
+		uint32 nextIndex = 0;
+		uint32 nextVertex = 0;
+		uint32 nextPrimitive = 0;
+		for(const MeshletBuilder::Meshlet& m : meshlets.Meshlets)
+		{
+			CHECK(m.VertexCount >= 3 && m.VertexCount <= limit[0]);
+			CHECK(m.PrimitiveCount >= 1 && m.PrimitiveCount <= limit[1]);
+			CHECK(m.IndexCount == 3*m.PrimitiveCount);
+
+			CHECK(m.StartIndexLocation == nextIndex);
+			CHECK(m.VertexOffset == nextVertex);
+			CHECK(m.PrimitiveOffset == nextPrimitive);
+			nextIndex += m.IndexCount;
+			nextVertex += m.VertexCount;
+			nextPrimitive += m.PrimitiveCount;
+
+			// The local triangles name the same vertices as the index list.
+			for(uint32 i = 0; i < m.IndexCount; ++i)
+			{
+				uint32 local = meshlets.PrimitiveIndices[m.PrimitiveOffset*3 + i];
+				CHECK(local < m.VertexCount);
+				CHECK(meshlets.UniqueVertexIndices[m.VertexOffset + local] == meshlets.Indices[m.StartIndexLocation + i]);
+			}
+		}
+
+		CHECK(nextIndex == meshData.Indices32.size());
+		CHECK(nextVertex == meshlets.UniqueVertexIndices.size());
+		CHECK(nextPrimitive*3 == meshlets.PrimitiveIndices.size());
+	}
+}
+
+TEST(MeshletCullRejectsBackFacingAndOutOfView)
+{
+	GeometryGenerator geoGen;
+	GeometryGenerator::MeshData meshData = geoGen.CreateGeosphere(1.0f, 3);
+	MeshletBuilder::MeshletData meshlets = MeshletBuilder::Build(meshData, 16, 16);
+
+	XMFLOAT3 eyePos(0.0f, 0.0f, -5.0f);
+	XMVECTOR eye = XMLoadFloat3(&eyePos);
+	XMVECTOR up = XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+	XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*XM_PI, 1.0f, 1.0f, 100.0f);
+
+	//
+	// Looking at the sphere, which is all in view: only the back-facing meshlets
+	// are rejected, and every front-facing triangle is still drawn.
+	//
+
+	XMFLOAT4 planes[6];
+	MathHelper::ExtractFrustumPlanes(XMMatrixLookAtLH(eye, XMVectorZero(), up)*proj, planes);
+
+	std::vector<MeshletBuilder::DrawRange> ranges;
+	uint32 visibleCount = MeshletBuilder::Cull(meshlets, planes, eyePos, ranges);
+
+	CHECK(visibleCount > 0);
+	CHECK(visibleCount < meshlets.Meshlets.size());
+
+	uint32 drawnCount = 0;
+	for(const MeshletBuilder::Meshlet& m : meshlets.Meshlets)
+	{
+		if(IsDrawn(m, ranges))
+		{
+			++drawnCount;
+			continue;
+		}
+
+		// Clockwise triangles are front facing, so a rejected triangle's normal
+		// points away from the eye.
+		for(uint32 i = 0; i < m.IndexCount; i += 3)
+		{
+			const uint32* tri = &meshlets.Indices[m.StartIndexLocation + i];
+			XMVECTOR p0 = XMLoadFloat3(&meshData.Vertices[tri[0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&meshData.Vertices[tri[1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&meshData.Vertices[tri[2]].Position);
+
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+			CHECK(XMVectorGetX(XMVector3Dot(n, p0 - eye)) > 0.0f);
+		}
+	}
+
+	// The ranges hold exactly the survivors.
+	CHECK(drawnCount == visibleCount);
+
+	//
+	// Looking away from the sphere: every meshlet is outside the frustum.
+	//
+
+	MathHelper::ExtractFrustumPlanes(XMMatrixLookAtLH(eye, XMVectorSet(0.0f, 0.0f, -10.0f, 1.0f), up)*proj, planes);
+
+	ranges.clear();
+	CHECK(MeshletBuilder::Cull(meshlets, planes, eyePos, ranges) == 0);
+	CHECK(ranges.empty());
+}
@@ -0,0 +1,189 @@
+//***************************************************************************************
+// OcclusionCullerTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/OcclusionCuller.h"
+#include "../Common/GeometryGenerator.h"
+#include "../Common/MathHelper.h"
+#include <cstring>
+
+#pragma comment(lib, "d3dcompiler.lib")
+
+using namespace DirectX;
+
+using uint32 = std::uint32_t;
+
+namespace
+{
+	// Copies meshData into the CPU blobs of a MeshGeometry, as AddOccluder reads them.
+	void BuildGeometry(const GeometryGenerator::MeshData& meshData, MeshGeometry& geo, SubmeshGeometry& submesh)
+	{
+		UINT vbByteSize = (UINT)(meshData.Vertices.size()*sizeof(GeometryGenerator::Vertex));
+		UINT ibByteSize = (UINT)(meshData.Indices32.size()*sizeof(uint32));
+
+		ThrowIfFailed(D3DCreateBlob(vbByteSize, geo.VertexBufferCPU.GetAddressOf()));
+		std::memcpy(geo.VertexBufferCPU->GetBufferPointer(), meshData.Vertices.data(), vbByteSize);
+
+		ThrowIfFailed(D3DCreateBlob(ibByteSize, geo.IndexBufferCPU.GetAddressOf()));
+		std::memcpy(geo.IndexBufferCPU->GetBufferPointer(), meshData.Indices32.data(), ibByteSize);
+
+		geo.VertexByteStride = sizeof(GeometryGenerator::Vertex);
+		geo.VertexBufferByteSize = vbByteSize;
+		geo.IndexFormat = DXGI_FORMAT_R32_UINT;
+		geo.IndexBufferByteSize = ibByteSize;
+
+		submesh.IndexCount = (UINT)meshData.Indices32.size();
+		submesh.StartIndexLocation = 0;
+		submesh.BaseVertexLocation = 0;
+	}
+
+	// Looking down +z from 20 units in front of the origin.
+	XMMATRIX TestViewProj()
+	{
+		XMMATRIX view = XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, -20.0f, 1.0f), XMVectorZero(), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+		XMMATRIX proj = XMMatrixPerspectiveFovLH(0.25f*XM_PI, 16.0f/9.0f, 1.0f, 1000.0f);
+		return view*proj;
+	}
+}
+
+TEST(OcclusionBoxBehindWall)
+{
+	GeometryGenerator geoGen;
+	MeshGeometry wall;
+	SubmeshGeometry wallSubmesh;
+	BuildGeometry(geoGen.CreateBox(1.0f, 1.0f, 1.0f, 0), wall, wallSubmesh);
+
+	XMMATRIX viewProj = TestViewProj();
+
+	// A 10x10 wall at the origin, facing the camera.
+	OcclusionCuller culler;
+	culler.Begin(viewProj);
+	CHECK(culler.AddOccluder(wall, wallSubmesh, DXGI_FORMAT_R32G32B32_FLOAT, XMMatrixScaling(10.0f, 10.0f, 1.0f)));
+	culler.Rasterize();
+
+	CHECK(culler.GetTriangleCount() > 0);
+	CHECK(culler.GetDepth(culler.GetWidth()/2, culler.GetHeight()/2) < 1.0f);
+	CHECK(culler.GetDepth(0, 0) == 1.0f);
+
+	CHECK(!culler.IsVisible(BoundingBox(XMFLOAT3(0.0f, 0.0f, 10.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+	CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0.0f, 0.0f, -5.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+
+	// Behind the wall but sticking out past its edge.
+	CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(9.0f, 0.0f, 10.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+	CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0.0f, 0.0f, 10.0f), XMFLOAT3(20.0f, 1.0f, 1.0f))));
+
+	// The wall does not hide itself.
+	CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0.0f, 0.0f, 0.0f), XMFLOAT3(5.0f, 5.0f, 0.5f))));
+
+	// Off screen.
+	CHECK(!culler.IsVisible(BoundingBox(XMFLOAT3(200.0f, 0.0f, 10.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+
+	// With the wall gone, the box is visible again.
+	culler.Begin(viewProj);
+	culler.Rasterize();
+	CHECK(culler.IsVisible(BoundingBox(XMFLOAT3(0.0f, 0.0f, 10.0f), XMFLOAT3(1.0f, 1.0f, 1.0f))));
+}
+
+TEST(OcclusionThreadCountsAgree)
+{
+	GeometryGenerator geoGen;
+	MeshGeometry sphere;
+	SubmeshGeometry sphereSubmesh;
+	BuildGeometry(geoGen.CreateGeosphere(1.0f, 3), sphere, sphereSubmesh);
+
+	XMMATRIX viewProj = TestViewProj();
+
+	std::vector<XMFLOAT4X4> worlds(300);
+	for(XMFLOAT4X4& world : worlds)
+	{
+		XMMATRIX translation = XMMatrixTranslation(MathHelper::RandF(-15.0f, 15.0f),
+			MathHelper::RandF(-8.0f, 8.0f), MathHelper::RandF(0.0f, 30.0f));
+		XMStoreFloat4x4(&world, XMMatrixScaling(2.0f, 2.0f, 2.0f)*translation);
+	}
+
+	// Bands are drawn in submission order, so the depth buffer must not depend on
+	// how many threads draw it.
+	std::vector<float> reference;
+	const uint32 threadCounts[] = { 1, 2, 3, 8 };
+	for(uint32 threadCount : threadCounts)
+	{
+		OcclusionCuller::Desc desc;
+		desc.ThreadCount = threadCount;
+		desc.MinTrianglesPerThread = 1;
+
+		OcclusionCuller culler(desc);
+		culler.Begin(viewProj);
+		for(const XMFLOAT4X4& world : worlds)
+			culler.AddOccluder(sphere, sphereSubmesh, DXGI_FORMAT_R32G32B32_FLOAT, XMLoadFloat4x4(&world));
+		culler.Rasterize();
+
+		std::vector<float> depth;
+		for(uint32 y = 0; y < culler.GetHeight(); ++y)
+		{
+			for(uint32 x = 0; x < culler.GetWidth(); ++x)
+				depth.push_back(culler.GetDepth(x, y));
+		}
+
+		if(reference.empty())
+			reference = depth;
+		CHECK(depth == reference);
+	}
+}
+
+BENCHMARK(OcclusionRasterize)
+{
+	GeometryGenerator geoGen;
+	MeshGeometry box;
+	MeshGeometry sphere;
+	SubmeshGeometry boxSubmesh;
+	SubmeshGeometry sphereSubmesh;
+	BuildGeometry(geoGen.CreateBox(1.0f, 1.0f, 1.0f, 0), box, boxSubmesh);
+	BuildGeometry(geoGen.CreateGeosphere(1.0f, 3), sphere, sphereSubmesh);
+
+	XMMATRIX viewProj = TestViewProj();
+
+	// A light frame like ShapesApp's, and a heavy one with 300 spheres.
+	const uint32 occluderCounts[] = { 11, 300 };
+	for(uint32 occluderCount : occluderCounts)
+	{
+		const MeshGeometry& geo = occluderCount < 100 ? box : sphere;
+		const SubmeshGeometry& submesh = occluderCount < 100 ? boxSubmesh : sphereSubmesh;
+
+		std::vector<XMFLOAT4X4> worlds(occluderCount);
+		for(XMFLOAT4X4& world : worlds)
+		{
+			XMMATRIX translation = XMMatrixTranslation(MathHelper::RandF(-15.0f, 15.0f),
+				MathHelper::RandF(-8.0f, 8.0f), MathHelper::RandF(0.0f, 30.0f));
+			XMStoreFloat4x4(&world, XMMatrixScaling(2.0f, 2.0f, 2.0f)*translation);
+		}
+
+		std::vector<BoundingBox> boxes(100000);
+		std::vector<uint32> indices;
+		for(BoundingBox& b : boxes)
+		{
+			b.Center = XMFLOAT3(MathHelper::RandF(-20.0f, 20.0f), MathHelper::RandF(-10.0f, 10.0f), MathHelper::RandF(5.0f, 60.0f));
+			b.Extents = XMFLOAT3(0.5f, 0.5f, 0.5f);
+		}
+
+		OcclusionCuller culler;
+		double rasterizeMs = Tests::Time([&]()
+		{
+			culler.Begin(viewProj);
+			for(const XMFLOAT4X4& world : worlds)
+				culler.AddOccluder(geo, submesh, DXGI_FORMAT_R32G32B32_FLOAT, XMLoadFloat4x4(&world));
+			culler.Rasterize();
+		}, 20);
+
+		double cullMs = Tests::Time([&]()
+		{
+			indices.resize(boxes.size());
+			for(uint32 i = 0; i < (uint32)indices.size(); ++i)
+				indices[i] = i;
+			culler.Cull(boxes, indices);
+		});
+
+		std::printf("  %3u occluders, %7zu triangles: rasterize %.3f ms, cull 100000 boxes %.3f ms (%zu visible)\n",
+			occluderCount, culler.GetTriangleCount(), rasterizeMs, cullMs, indices.size());
+	}
+}
@@ -0,0 +1,211 @@
+//***************************************************************************************
+// ProfilerTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/MappedFile.h"
+#include "../Common/Profiler.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+using uint32 = Profiler::uint32;
+
+namespace
+{
+	const wchar_t* TraceFile = L"ProfilerTests.json";
+
+	// Deletes the test's trace however it ends.
+	struct FileScope
+	{
+		~FileScope()
+		{
+			std::remove("ProfilerTests.json");
+		}
+	};
+
+	// Waits until the clock has passed t, so that events ending at t fall in the
+	// frame the next EndFrame closes.
+	void WaitPast(std::int64_t t)
+	{
+		while(GameTimer::CurrentTimeNs() <= t)
+			std::this_thread::yield();
+	}
+
+	const Profiler::ScopeStats* FindScope(const char* name)
+	{
+		for(const Profiler::ScopeStats& stats : Profiler::GetFrameStats())
+		{
+			if(std::strcmp(stats.Name, name) == 0)
+				return &stats;
+		}
+
+		return nullptr;
+	}
+
+	bool Near(double a, double b)
+	{
+		return std::fabs(a - b) <= 1e-9*(1.0 + std::fabs(b));
+	}
+
+	// The trace id of the first complete event named name, or -1.
+	long long TraceThread(const std::string& json, const std::string& name)
+	{
+		std::string key = "{\"name\":\"" + name + "\",\"ph\":\"X\",\"pid\":1,\"tid\":";
+		size_t at = json.find(key);
+		if(at == std::string::npos)
+			return -1;
+
+		return std::strtoll(json.c_str() + at + key.size(), nullptr, 10);
+	}
+
+	// The name of trace thread tid, as escaped in the JSON.
+	std::string TraceThreadName(const std::string& json, long long tid)
+	{
+		std::string key = "\"tid\":" + std::to_string(tid) + ",\"args\":{\"name\":\"";
+		size_t at = json.find(key);
+		if(at == std::string::npos)
+			return std::string();
+
+		// Skip escaped quotes to find the closing one.
+		size_t begin = at + key.size();
+		size_t end = begin;
+		while(end < json.size() && json[end] != '"')
+			end += json[end] == '\\' ? 2 : 1;
+
+		return json.substr(begin, end - begin);
+	}
+}
+
+TEST(ProfilerEndFrameSumsScopesByName)
+{
+	Profiler::EndFrame();
+
+	const std::int64_t Ms = 1000000;
+	std::int64_t t = GameTimer::CurrentTimeNs() + 1;
+
+	// The same name through a different pointer, as a literal from another
+	// translation unit would be.
+	static const char sameName[] = "ProfilerTestA";
+
+	Profiler::Record("ProfilerTestA", t - 1*Ms, t);
+	Profiler::Record("ProfilerTestB", t + 1 - 5*Ms, t + 1);
+	Profiler::Record(sameName, t + 2 - 2*Ms, t + 2);
+	std::thread([t]() { Profiler::Record("ProfilerTestB", t + 3 - Ms/2, t + 3); }).join();
+
+	WaitPast(t + 3);
+	Profiler::EndFrame();
+
+	const Profiler::ScopeStats* a = FindScope("ProfilerTestA");
+	const Profiler::ScopeStats* b = FindScope("ProfilerTestB");
+	CHECK(a != nullptr && a->Count == 2 && Near(a->TotalMs, 3.0));
+	CHECK(b != nullptr && b->Count == 2 && Near(b->TotalMs, 5.5));
+
+	// Largest total first.
+	const std::vector<Profiler::ScopeStats>& stats = Profiler::GetFrameStats();
+	for(size_t i = 1; i < stats.size(); ++i)
+		CHECK(stats[i-1].TotalMs >= stats[i].TotalMs);
+	CHECK(b < a);
+
+	// A frame only counts the scopes that ended in it: the ones above are gone,
+	// and one that ends after EndFrame is counted by the frame it ends in.
+	std::int64_t late = GameTimer::CurrentTimeNs() + 20*Ms;
+	Profiler::Record("ProfilerTestLate", late - Ms, late);
+	Profiler::EndFrame();
+
+	CHECK(FindScope("ProfilerTestA") == nullptr);
+	CHECK(FindScope("ProfilerTestLate") == nullptr);
+
+	WaitPast(late);
+	Profiler::EndFrame();
+
+	const Profiler::ScopeStats* lateStats = FindScope("ProfilerTestLate");
+	CHECK(lateStats != nullptr && lateStats->Count == 1 && Near(lateStats->TotalMs, 1.0));
+}
+
+TEST(ProfilerRingKeepsTheNewestEvents)
+{
+	Profiler::EndFrame();
+
+	// Wrap the ring.  Event i lasts i + 1 ns, so the total tells which events were
+	// kept.
+	const uint32 count = Profiler::EventsPerThread + 100;
+	std::int64_t t = GameTimer::CurrentTimeNs() + 1;
+	for(uint32 i = 0; i < count; ++i)
+		Profiler::Record("ProfilerTestWrap", t + i - (i + 1), t + i);
+
+	WaitPast(t + count);
+	Profiler::EndFrame();
+
+	// The oldest slot is the next one the owner writes, so a reader never trusts
+	// it, and a full ring gives up all but one of its events: the newest.
+	const uint32 kept = Profiler::EventsPerThread - 1;
+
+	double expectedMs = 0.0;
+	for(uint32 i = count - kept; i < count; ++i)
+		expectedMs += (i + 1)*1e-6;
+
+	const Profiler::ScopeStats* wrap = FindScope("ProfilerTestWrap");
+	CHECK(wrap != nullptr && wrap->Count == kept);
+	CHECK(wrap != nullptr && Near(wrap->TotalMs, expectedMs));
+}
+
+TEST(ProfilerTraceEscapesNamesAndSeparatesThreads)
+{
+	FileScope files;
+
+	Profiler::EndFrame();
+
+	std::int64_t t = GameTimer::CurrentTimeNs() + 1;
+	Profiler::Record("ProfilerTest \"quoted\" back\\slash\nline\ttab\x01", t - 1000, t);
+
+	// A thread that names itself and exits, and then one that takes over its
+	// buffer, since it is the only one free.
+	std::thread([t]()
+	{
+		Profiler::SetThreadName("ProfilerTest \"Loader\"");
+		Profiler::Record("ProfilerTestOld", t - 1000, t + 1);
+	}).join();
+
+	std::thread([t]()
+	{
+		Profiler::Record("ProfilerTestNew", t - 1000, t + 2);
+	}).join();
+
+	// Taking over the buffer lost nothing.
+	WaitPast(t + 2);
+	Profiler::EndFrame();
+
+	const Profiler::ScopeStats* oldStats = FindScope("ProfilerTestOld");
+	const Profiler::ScopeStats* newStats = FindScope("ProfilerTestNew");
+	CHECK(oldStats != nullptr && oldStats->Count == 1);
+	CHECK(newStats != nullptr && newStats->Count == 1);
+
+	CHECK(Profiler::WriteChromeTrace(TraceFile));
+
+	std::string json;
+	{
+		MappedFile file;
+		CHECK(file.Open(TraceFile));
+		if(file.IsOpen())
+			json.assign(reinterpret_cast<const char*>(file.GetData()), file.GetSize());
+	}
+
+	CHECK(json.find("\"ProfilerTest \\\"quoted\\\" back\\\\slash\\nline\\ttab\\u0001\"") != std::string::npos);
+
+	// Nothing unescaped is left, apart from the final line break.
+	bool clean = true;
+	for(size_t i = 0; i + 1 < json.size(); ++i)
+		clean = clean && (unsigned char)json[i] >= 0x20;
+	CHECK(clean);
+
+	// Each thread has its own track and name, though they shared the buffer.
+	long long oldThread = TraceThread(json, "ProfilerTestOld");
+	long long newThread = TraceThread(json, "ProfilerTestNew");
+	CHECK(oldThread >= 0 && newThread >= 0 && oldThread != newThread);
+	CHECK(TraceThreadName(json, oldThread) == "ProfilerTest \\\"Loader\\\"");
+	CHECK(TraceThreadName(json, newThread) == "Worker " + std::to_string(newThread));
+}
@@ -0,0 +1,180 @@
+//***************************************************************************************
+// RingAllocatorTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/RingAllocator.h"
+#include <cstdint>
+#include <vector>
+
+using uint64 = RingAllocator::uint64;
+
+namespace
+{
+	struct Range
+	{
+		uint64 Offset;
+		uint64 Size;
+	};
+
+	bool Overlap(const Range& a, const Range& b)
+	{
+		return a.Offset < b.Offset + b.Size && b.Offset < a.Offset + a.Size;
+	}
+
+	// Allocates size bytes, checking the range fits the buffer and is aligned.
+	bool Allocate(RingAllocator& ring, uint64 size, uint64 alignment, Range& range)
+	{
+		uint64 offset = ~0ull;
+		if(!ring.TryAllocate(size, alignment, offset))
+			return false;
+
+		CHECK(offset % alignment == 0);
+		CHECK(offset + size <= ring.GetCapacity());
+		range = { offset, size };
+		return true;
+	}
+}
+
+TEST(RingAllocatorWrapsAroundRetiredFrames)
+{
+	RingAllocator ring(1024);
+
+	// Frame 1 takes [0, 400), and frame 2, aligned to 256, [512, 912).
+	Range a, b, c;
+	CHECK(Allocate(ring, 400, 16, a) && a.Offset == 0);
+	ring.EndFrame(1);
+	CHECK(Allocate(ring, 400, 256, b) && b.Offset == 512);
+	ring.EndFrame(2);
+
+	// The padding counts as used.
+	CHECK(ring.GetUsed() == 912);
+	CHECK(ring.GetFramesInFlight() == 2);
+
+	// Frame 3 does not fit at the end, and the start is still in use by frame 1.
+	CHECK(!ring.TryAllocate(300, 16, c.Offset));
+	CHECK(ring.GetUsed() == 912);
+
+	// Once frame 1 retires it wraps to the start, giving up the end of the buffer.
+	ring.Retire(1);
+	CHECK(ring.GetUsed() == 512);
+	CHECK(ring.GetFramesInFlight() == 1);
+	CHECK(Allocate(ring, 300, 16, c) && c.Offset == 0);
+	CHECK(!Overlap(c, b));
+	CHECK(ring.GetUsed() == 512 + 112 + 300);
+
+	// Wrapped, the free space is only up to frame 2, which owns the padding before
+	// its start.
+	Range d;
+	CHECK(!ring.TryAllocate(112, 16, d.Offset));
+	CHECK(Allocate(ring, 96, 16, d) && d.Offset == 304);
+	CHECK(!Overlap(d, b));
+	CHECK(!ring.TryAllocate(16, 16, d.Offset));
+	ring.EndFrame(3);
+
+	// Retiring frame 2 frees [400, 912).  The end skipped by the wrap stays in use
+	// until frame 3 retires.
+	ring.Retire(2);
+	CHECK(ring.GetUsed() == 512);
+
+	Range e;
+	CHECK(!ring.TryAllocate(513, 16, e.Offset));
+	CHECK(Allocate(ring, 512, 16, e) && e.Offset == 400);
+	CHECK(!Overlap(e, c) && !Overlap(e, d));
+	ring.EndFrame(4);
+
+	// Everything retired: the next allocation starts over at 0, and a whole-buffer
+	// request fits.
+	ring.Retire(4);
+	CHECK(ring.GetUsed() == 0);
+	CHECK(ring.GetFramesInFlight() == 0);
+
+	Range f;
+	CHECK(Allocate(ring, 1024, 256, f) && f.Offset == 0);
+	CHECK(ring.GetHighWaterMark() == 1024);
+}
+
+TEST(RingAllocatorStallsUntilTheGpuCatchesUp)
+{
+	// Three frames in flight, each writing 300 bytes, in a ring that holds three.
+	RingAllocator ring(1024);
+
+	std::vector<Range> live;
+	uint64 completed = 0;
+	uint64 fence = 0;
+	int stalls = 0;
+
+	for(int frame = 0; frame < 200; ++frame)
+	{
+		Range range;
+		while(!Allocate(ring, 300, 4, range))
+		{
+			// Full: wait for the oldest frame in flight, as the GPU would finish it.
+			stalls++;
+			CHECK(completed < fence);
+			ring.Retire(++completed);
+			live.erase(live.begin());
+		}
+
+		// Nothing handed out overlaps memory a frame in flight may still read.
+		for(const Range& other : live)
+			CHECK(!Overlap(range, other));
+
+		live.push_back(range);
+		ring.EndFrame(++fence);
+
+		CHECK(ring.GetUsed() <= ring.GetCapacity());
+		CHECK(ring.GetFramesInFlight() == live.size());
+	}
+
+	// The ring never held more than three frames, so every frame after the third
+	// stalled.
+	CHECK(stalls == 197);
+	CHECK(ring.GetHighWaterMark() <= 1024);
+
+	// A failed request changes nothing.
+	uint64 used = ring.GetUsed();
+	uint64 offset = 0;
+	CHECK(!ring.TryAllocate(2048, 4, offset));
+	CHECK(ring.GetUsed() == used);
+}
+
+TEST(RingAllocatorGrowsAndKeepsTheHighWaterMark)
+{
+	RingAllocator ring(512);
+
+	Range a;
+	CHECK(Allocate(ring, 400, 16, a));
+	ring.EndFrame(1);
+
+	// What does not fit even in an empty ring needs a larger buffer: twice the size,
+	// or enough for the request, whichever is larger.
+	CHECK(ring.GetGrowCapacity(100, 16) == 1024);
+	CHECK(ring.GetGrowCapacity(2000, 256) == 2304);
+	CHECK(ring.GetGrowCapacity(1000, 16) == 1024);
+
+	uint64 offset = 0;
+	CHECK(!ring.TryAllocate(1000, 16, offset));
+	ring.Reset(ring.GetGrowCapacity(1000, 16));
+
+	// The new buffer starts empty, with no frames in flight; the old one is the
+	// owner's to release.  The high-water mark covers both.
+	CHECK(ring.GetCapacity() == 1024);
+	CHECK(ring.GetUsed() == 0);
+	CHECK(ring.GetFramesInFlight() == 0);
+	CHECK(ring.GetHighWaterMark() == 400);
+
+	Range b;
+	CHECK(Allocate(ring, 1000, 16, b) && b.Offset == 0);
+	CHECK(ring.GetHighWaterMark() == 1000);
+	ring.EndFrame(2);
+
+	// Retiring a fence from the old buffer's frames does not free the new one's.
+	ring.Retire(1);
+	CHECK(ring.GetUsed() == 1000);
+	ring.Retire(2);
+	CHECK(ring.GetUsed() == 0);
+
+	ring.ResetHighWaterMark();
+	CHECK(ring.GetHighWaterMark() == 0);
+}
@@ -0,0 +1,170 @@
+//***************************************************************************************
+// StreamingCopyTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/StreamingCopy.h"
+#include "../Common/UploadBuffer.h"
+#include "../Common/MathHelper.h"
+#include <cstring>
+#include <vector>
+
+#pragma comment(lib, "D3D12.lib")
+#pragma comment(lib, "dxgi.lib")
+
+using namespace DirectX;
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	// The size of the per-object constants of the later chapters.
+	struct ObjectConstants
+	{
+		XMFLOAT4X4 World = MathHelper::Identity4x4();
+		XMFLOAT4X4 TexTransform = MathHelper::Identity4x4();
+	};
+
+	const UINT ElementCount = 10000;
+
+	std::vector<ObjectConstants> RandomConstants(UINT count)
+	{
+		std::vector<ObjectConstants> constants(count);
+		for(ObjectConstants& c : constants)
+		{
+			XMStoreFloat4x4(&c.World, XMMatrixTranslation(MathHelper::RandF(), MathHelper::RandF(), MathHelper::RandF()));
+			XMStoreFloat4x4(&c.TexTransform, XMMatrixScaling(MathHelper::RandF(), MathHelper::RandF(), 1.0f));
+		}
+
+		return constants;
+	}
+
+	// The same device d3dApp creates: the default adapter, or WARP without one.
+	ComPtr<ID3D12Device> CreateDevice(bool& warp)
+	{
+		ComPtr<ID3D12Device> device;
+		warp = false;
+		if(SUCCEEDED(D3D12CreateDevice(nullptr, D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device))))
+			return device;
+
+		ComPtr<IDXGIFactory4> factory;
+		ComPtr<IDXGIAdapter> warpAdapter;
+		if(FAILED(CreateDXGIFactory1(IID_PPV_ARGS(&factory))) ||
+			FAILED(factory->EnumWarpAdapter(IID_PPV_ARGS(&warpAdapter))) ||
+			FAILED(D3D12CreateDevice(warpAdapter.Get(), D3D_FEATURE_LEVEL_11_0, IID_PPV_ARGS(&device))))
+			return nullptr;
+
+		warp = true;
+		return device;
+	}
+}
+
+TEST(StreamingCopyMatchesMemcpy)
+{
+	const size_t sizes[] = { 0, 1, 15, 63, 64, 65, 200, 4096 + 13 };
+
+	std::vector<BYTE> src(8192);
+	for(size_t i = 0; i < src.size(); ++i)
+		src[i] = (BYTE)(i*31 + 7);
+
+	// Every alignment of the destination within a cache line.
+	for(size_t size : sizes)
+	{
+		for(size_t offset = 0; offset < 64; ++offset)
+		{
+			std::vector<BYTE> expected(8192 + 128, 0xcd);
+			std::vector<BYTE> actual(expected);
+
+			BYTE* dst = reinterpret_cast<BYTE*>((reinterpret_cast<std::uintptr_t>(actual.data()) + 63) & ~(std::uintptr_t)63) + offset;
+			size_t start = dst - actual.data();
+
+			std::memcpy(&expected[start], &src[3], size);
+			StreamingCopy::Copy(dst, &src[3], size);
+
+			CHECK(expected == actual);
+		}
+	}
+}
+
+TEST(StreamingCopyStridedPadsElements)
+{
+	std::vector<ObjectConstants> constants = RandomConstants(37);
+	const size_t stride = d3dUtil::CalcConstantBufferByteSize(sizeof(ObjectConstants));
+
+	std::vector<BYTE> buffer(stride*constants.size() + 64, 0xcd);
+	BYTE* dst = reinterpret_cast<BYTE*>((reinterpret_cast<std::uintptr_t>(buffer.data()) + 63) & ~(std::uintptr_t)63);
+
+	StreamingCopy::CopyStrided(dst, stride, constants.data(), sizeof(ObjectConstants), sizeof(ObjectConstants), constants.size());
+
+	for(size_t i = 0; i < constants.size(); ++i)
+		CHECK(std::memcmp(dst + i*stride, &constants[i], sizeof(ObjectConstants)) == 0);
+
+	// An unaligned stride goes element by element, and leaves the gaps alone.
+	std::vector<BYTE> packed(200*constants.size(), 0xcd);
+	StreamingCopy::CopyStrided(packed.data() + 1, 200, constants.data(), sizeof(ObjectConstants), sizeof(ObjectConstants), constants.size());
+
+	for(size_t i = 0; i < constants.size(); ++i)
+	{
+		CHECK(std::memcmp(&packed[1 + i*200], &constants[i], sizeof(ObjectConstants)) == 0);
+		CHECK(packed[1 + i*200 + sizeof(ObjectConstants)] == 0xcd);
+	}
+}
+
+// Writes ElementCount constant buffer elements the old way, one memcpy per
+// element, and with the range and emplace writers.  The upload heap is
+// write-combined on hardware adapters, which is what the streaming stores are
+// for; WARP keeps it in cached memory, so its numbers only show the overhead.
+// The cached rows are the same copies into an ordinary heap buffer, for
+// comparison.
+BENCHMARK(UploadBufferWrites)
+{
+	std::vector<ObjectConstants> constants = RandomConstants(ElementCount);
+
+	bool warp = false;
+	ComPtr<ID3D12Device> device = CreateDevice(warp);
+	if(device == nullptr)
+	{
+		std::printf("  no D3D12 device, skipped\n");
+		return;
+	}
+
+	UploadBuffer<ObjectConstants> buffer(device.Get(), ElementCount, true);
+
+	double perElement = Tests::Time([&]()
+	{
+		for(UINT i = 0; i < ElementCount; ++i)
+			buffer.CopyData(i, constants[i]);
+	});
+
+	double range = Tests::Time([&]()
+	{
+		buffer.CopyData(0, constants.data(), ElementCount);
+	});
+
+	double emplace = Tests::Time([&]()
+	{
+		buffer.EmplaceData(0, ElementCount, [&](UINT i, ObjectConstants& c)
+		{
+			c = constants[i];
+		});
+	});
+
+	std::printf("  %u elements, upload heap (%s):\n", ElementCount, warp ? "WARP, cached" : "hardware, write-combined");
+	std::printf("    per-element memcpy %.3f ms, range CopyData %.3f ms, EmplaceData %.3f ms\n", perElement, range, emplace);
+
+	const size_t stride = buffer.ElementByteSize();
+	std::vector<BYTE> cached(stride*ElementCount + 64);
+	BYTE* dst = reinterpret_cast<BYTE*>((reinterpret_cast<std::uintptr_t>(cached.data()) + 63) & ~(std::uintptr_t)63);
+
+	double cachedMemcpy = Tests::Time([&]()
+	{
+		for(UINT i = 0; i < ElementCount; ++i)
+			std::memcpy(dst + i*stride, &constants[i], sizeof(ObjectConstants));
+	});
+
+	double cachedStreaming = Tests::Time([&]()
+	{
+		StreamingCopy::CopyStrided(dst, stride, constants.data(), sizeof(ObjectConstants), sizeof(ObjectConstants), ElementCount);
+	});
+
+	std::printf("  cached memory: per-element memcpy %.3f ms, streaming %.3f ms\n", cachedMemcpy, cachedStreaming);
+}
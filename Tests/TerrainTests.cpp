@@ -0,0 +1,289 @@
+//***************************************************************************************
+// TerrainTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/Terrain.h"
+#include <algorithm>
+#include <cmath>
+#include <set>
+#include <vector>
+
+using namespace DirectX;
+
+using uint32 = std::uint32_t;
+
+namespace
+{
+	Terrain::Desc TestDesc()
+	{
+		Terrain::Desc desc;
+		desc.Width = 256.0f;
+		desc.Depth = 128.0f;
+		desc.ChunkCells = 8;
+		desc.MaxLevel = 4;
+		desc.SkirtDepth = 1.5f;
+		desc.LodDistance = 1.0f;
+		desc.ThreadCount = 2;
+		return desc;
+	}
+
+	// The bounds Select measures a node by before its mesh is generated: its area,
+	// with the height range of a flat terrain and the skirts below it.
+	BoundingBox NodeBounds(const Terrain::Desc& desc, const Terrain::ChunkId& id)
+	{
+		float scale = 1.0f / (float)(1u << id.Level);
+		float width = desc.Width*scale;
+		float depth = desc.Depth*scale;
+
+		return BoundingBox(
+			XMFLOAT3(-0.5f*desc.Width + (id.X + 0.5f)*width, -0.5f*desc.SkirtDepth, 0.5f*desc.Depth - (id.Z + 0.5f)*depth),
+			XMFLOAT3(0.5f*width, 0.5f*desc.SkirtDepth, 0.5f*depth));
+	}
+
+	// How much nearer than LodDistance times its size the eye is to the node.
+	// Select splits the nodes where this is positive.
+	float SplitMargin(const Terrain::Desc& desc, const Terrain::ChunkId& id, const XMFLOAT3& eyePos)
+	{
+		BoundingBox bounds = NodeBounds(desc, id);
+
+		float dx = std::max(std::abs(eyePos.x - bounds.Center.x) - bounds.Extents.x, 0.0f);
+		float dy = std::max(std::abs(eyePos.y - bounds.Center.y) - bounds.Extents.y, 0.0f);
+		float dz = std::max(std::abs(eyePos.z - bounds.Center.z) - bounds.Extents.z, 0.0f);
+		float distance = std::sqrt(dx*dx + dy*dy + dz*dz);
+
+		float size = 2.0f*std::max(bounds.Extents.x, bounds.Extents.z);
+		return desc.LodDistance*size - distance;
+	}
+
+	Terrain::ChunkId Parent(const Terrain::ChunkId& id)
+	{
+		Terrain::ChunkId parent;
+		parent.Level = id.Level - 1;
+		parent.X = id.X / 2;
+		parent.Z = id.Z / 2;
+		return parent;
+	}
+
+	float Flat(float x, float z)
+	{
+		return 0.0f;
+	}
+}
+
+TEST(TerrainSelectionFollowsLodDistance)
+{
+	Terrain::Desc desc = TestDesc();
+	Terrain terrain(desc, Flat);
+
+	// Near the -x, +z corner of the world.
+	XMFLOAT3 eyePos(-120.0f, 5.0f, 60.0f);
+
+	std::vector<Terrain::Chunk> chunks;
+	terrain.Select(eyePos, nullptr, chunks);
+
+	// The chunks tile the world: they cover its area, and none of them is inside
+	// another.
+	float area = 0.0f;
+	std::set<std::pair<uint32, std::pair<uint32, uint32>>> selected;
+	for(const Terrain::Chunk& chunk : chunks)
+	{
+		BoundingBox bounds = NodeBounds(desc, chunk.Id);
+		area += 4.0f*bounds.Extents.x*bounds.Extents.z;
+		selected.insert({ chunk.Id.Level, { chunk.Id.X, chunk.Id.Z } });
+	}
+
+	CHECK(std::abs(area - desc.Width*desc.Depth) < 1e-3f*desc.Width*desc.Depth);
+
+	uint32 maxLevel = 0;
+	uint32 minLevel = desc.MaxLevel;
+	for(const Terrain::Chunk& chunk : chunks)
+	{
+		CHECK(chunk.Mesh != nullptr);
+
+		for(Terrain::ChunkId ancestor = chunk.Id; ancestor.Level > 0; )
+		{
+			ancestor = Parent(ancestor);
+			CHECK(selected.count({ ancestor.Level, { ancestor.X, ancestor.Z } }) == 0);
+		}
+
+		// Every chunk is as fine as its distance asks for: its parent was close
+		// enough to split, and it was not.
+		if(chunk.Id.Level > 0)
+			CHECK(SplitMargin(desc, Parent(chunk.Id), eyePos) > 0.0f);
+		if(chunk.Id.Level < desc.MaxLevel)
+			CHECK(SplitMargin(desc, chunk.Id, eyePos) <= 0.0f);
+
+		maxLevel = std::max(maxLevel, chunk.Id.Level);
+		minLevel = std::min(minLevel, chunk.Id.Level);
+	}
+
+	// Finest under the eye, coarser far away.
+	CHECK(maxLevel == desc.MaxLevel);
+	CHECK(minLevel < maxLevel);
+}
+
+TEST(TerrainSelectionSkipsChunksOutsideFrustum)
+{
+	Terrain::Desc desc = TestDesc();
+	Terrain terrain(desc, Flat);
+
+	XMFLOAT3 eyePos(0.0f, 20.0f, 0.0f);
+
+	std::vector<Terrain::Chunk> all;
+	terrain.Select(eyePos, nullptr, all);
+
+	// Looking down +x, so the -x half of the world is behind the eye.
+	XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&eyePos), XMVectorSet(100.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+
+	BoundingFrustum viewFrustum;
+	BoundingFrustum::CreateFromMatrix(viewFrustum, XMMatrixPerspectiveFovLH(0.25f*XM_PI, 1.0f, 1.0f, 1000.0f));
+
+	BoundingFrustum frustum;
+	viewFrustum.Transform(frustum, XMMatrixInverse(nullptr, view));
+
+	std::vector<Terrain::Chunk> visible;
+	terrain.Select(eyePos, &frustum, visible);
+
+	CHECK(!visible.empty());
+	CHECK(visible.size() < all.size());
+
+	for(const Terrain::Chunk& chunk : visible)
+	{
+		CHECK(frustum.Contains(terrain.GetBounds(chunk.Id)) != DISJOINT);
+		CHECK(terrain.GetBounds(chunk.Id).Center.x + terrain.GetBounds(chunk.Id).Extents.x > 0.0f);
+	}
+}
+
+TEST(TerrainChunksHangSkirtsFromTheirBorder)
+{
+	Terrain::Desc desc = TestDesc();
+	Terrain terrain(desc, [](float x, float z) { return 0.05f*x + 0.02f*z; });
+
+	Terrain::ChunkId id;
+	id.Level = 2;
+	id.X = 1;
+	id.Z = 3;
+
+	Terrain::MeshPtr mesh = terrain.GetChunk(id);
+
+	uint32 cells = desc.ChunkCells;
+	uint32 n = cells + 1;
+	uint32 gridVertexCount = n*n;
+	uint32 borderCount = 4*cells;
+
+	CHECK(mesh->Vertices.size() == gridVertexCount + borderCount);
+	CHECK(mesh->Indices32.size() == 6*cells*cells + 6*borderCount);
+
+	BoundingBox area = NodeBounds(desc, id);
+
+	// Every skirt vertex is SkirtDepth below a border vertex of the grid.
+	for(uint32 k = 0; k < borderCount; ++k)
+	{
+		const XMFLOAT3& skirt = mesh->Vertices[gridVertexCount + k].Position;
+
+		bool onBorder =
+			std::abs(std::abs(skirt.x - area.Center.x) - area.Extents.x) < 1e-3f ||
+			std::abs(std::abs(skirt.z - area.Center.z) - area.Extents.z) < 1e-3f;
+		CHECK(onBorder);
+
+		float height = 0.05f*skirt.x + 0.02f*skirt.z;
+		CHECK(std::abs(skirt.y - (height - desc.SkirtDepth)) < 1e-3f);
+	}
+
+	// The skirt triangles face outward, like the rest of the surface: clockwise
+	// seen from outside the chunk.
+	for(size_t i = 6*cells*cells; i < mesh->Indices32.size(); i += 3)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&mesh->Vertices[mesh->Indices32[i]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&mesh->Vertices[mesh->Indices32[i+1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&mesh->Vertices[mesh->Indices32[i+2]].Position);
+
+		XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+		XMVECTOR outward = (p0 + p1 + p2)/3.0f - XMLoadFloat3(&area.Center);
+		outward = XMVectorSetY(outward, 0.0f);
+
+		CHECK(XMVectorGetX(XMVector3Dot(normal, outward)) > 0.0f);
+	}
+
+	// The bounds reach down to the bottom of the skirts.
+	float lowest = mesh->Vertices[0].Position.y;
+	for(const GeometryGenerator::Vertex& v : mesh->Vertices)
+		lowest = std::min(lowest, v.Position.y);
+
+	CHECK(std::abs(mesh->Bounds.Center.y - mesh->Bounds.Extents.y - lowest) < 1e-3f);
+}
+
+TEST(TerrainCacheEvictsLeastRecentlyUsed)
+{
+	Terrain::Desc desc = TestDesc();
+	desc.MaxCachedChunks = 3;
+	Terrain terrain(desc, Flat);
+
+	std::vector<Terrain::Key> evicted;
+	terrain.SetEvictFunction([&](const Terrain::ChunkId& id) { evicted.push_back(Terrain::MakeKey(id)); });
+
+	auto chunkId = [](uint32 x)
+	{
+		Terrain::ChunkId id;
+		id.Level = 2;
+		id.X = x;
+		return id;
+	};
+
+	Terrain::MeshPtr a = terrain.GetChunk(chunkId(0));
+	terrain.GetChunk(chunkId(1));
+	terrain.GetChunk(chunkId(2));
+	CHECK(terrain.GetCachedChunkCount() == 3);
+	CHECK(terrain.GetStats().Generated == 3);
+
+	// Using 0 again makes 1 the least recently used, so 3 pushes 1 out.
+	CHECK(terrain.GetChunk(chunkId(0)) == a);
+	terrain.GetChunk(chunkId(3));
+
+	Terrain::Stats stats = terrain.GetStats();
+	CHECK(stats.Hits == 1);
+	CHECK(stats.Generated == 4);
+	CHECK(stats.Evicted == 1);
+	CHECK(terrain.GetCachedChunkCount() == 3);
+	CHECK(evicted == std::vector<Terrain::Key>({ Terrain::MakeKey(chunkId(1)) }));
+
+	CHECK(terrain.GetChunk(chunkId(0)) == a);
+	CHECK(terrain.GetChunk(chunkId(3)) != nullptr);
+	CHECK(terrain.GetStats().Hits == 3);
+
+	// 1 was dropped, so it is generated again, and 2 goes.
+	terrain.GetChunk(chunkId(1));
+	CHECK(terrain.GetStats().Generated == 5);
+	CHECK(terrain.GetStats().Evicted == 2);
+	terrain.GetChunk(chunkId(2));
+	CHECK(terrain.GetStats().Generated == 6);
+
+	// A selection larger than the cache keeps its meshes, and the cache is trimmed
+	// once it is done.
+	std::vector<Terrain::Chunk> chunks;
+	terrain.Select(XMFLOAT3(0.0f, 5.0f, 0.0f), nullptr, chunks);
+
+	CHECK(chunks.size() > desc.MaxCachedChunks);
+	CHECK(terrain.GetCachedChunkCount() == desc.MaxCachedChunks);
+	for(const Terrain::Chunk& chunk : chunks)
+		CHECK(chunk.Mesh != nullptr);
+
+	// Every chunk dropped was reported with its id: 1, 2 and 0 above, then the
+	// selection.  The chunks selected are the most recently used, so the ones not
+	// selected go first, and all but the last three selected go after them.
+	CHECK(evicted.size() == terrain.GetStats().Evicted);
+	CHECK(evicted.size() > 3 && evicted[1] == Terrain::MakeKey(chunkId(2)) && evicted[2] == Terrain::MakeKey(chunkId(0)));
+
+	std::set<Terrain::Key> selected;
+	for(const Terrain::Chunk& chunk : chunks)
+		selected.insert(Terrain::MakeKey(chunk.Id));
+
+	size_t selectedAndEvicted = 0;
+	for(size_t i = 3; i < evicted.size(); ++i)
+		selectedAndEvicted += selected.count(evicted[i]);
+	CHECK(selectedAndEvicted == chunks.size() - desc.MaxCachedChunks);
+
+	// The meshes handed out stay valid after they are evicted.
+	CHECK(a->Vertices.size() > 0);
+}
@@ -0,0 +1,60 @@
+//***************************************************************************************
+// Tests.h
+//
+// Small console test runner for the CPU-side code in Common.  TEST bodies check
+// results with CHECK and always run; BENCHMARK bodies time code with Tests::Time
+// and print the results, and only run when Tests.exe is given -bench.  A name
+// on the command line runs only the tests and benchmarks whose name contains it.
+//***************************************************************************************
+
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+namespace Tests
+{
+	using Function = void(*)();
+
+	// Adds a test or benchmark to the list main runs.  Used by the macros below.
+	struct Registrar
+	{
+		Registrar(const char* name, Function function, bool benchmark);
+	};
+
+	// Records a failed CHECK.
+	void Fail(const char* file, int line, const char* expression);
+
+	// Calls func repeats times and returns the fastest run in milliseconds.  The
+	// fastest run is the one least disturbed by the rest of the system.
+	template<typename Func>
+	double Time(Func func, int repeats = 5)
+	{
+		double best = 0.0;
+		for(int i = 0; i < repeats; ++i)
+		{
+			auto start = std::chrono::steady_clock::now();
+			func();
+			auto end = std::chrono::steady_clock::now();
+
+			double ms = std::chrono::duration<double, std::milli>(end - start).count();
+			if(i == 0 || ms < best)
+				best = ms;
+		}
+
+		return best;
+	}
+}
+
+#define TEST(name) \
+	static void name(); \
+	static Tests::Registrar name##Registrar(#name, name, false); \
+	static void name()
+
+#define BENCHMARK(name) \
+	static void name(); \
+	static Tests::Registrar name##Registrar(#name, name, true); \
+	static void name()
+
+#define CHECK(expression) \
+	((expression) ? (void)0 : Tests::Fail(__FILE__, __LINE__, #expression))
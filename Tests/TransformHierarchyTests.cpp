@@ -0,0 +1,187 @@
+//***************************************************************************************
+// TransformHierarchyTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/TransformHierarchy.h"
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+using namespace DirectX;
+
+using uint32 = TransformHierarchy::uint32;
+
+namespace
+{
+	const uint32 None = TransformHierarchy::None;
+
+	// The world matrix of node, from the local matrices up to its root.
+	XMMATRIX ReferenceWorld(const TransformHierarchy& h, uint32 node)
+	{
+		XMMATRIX local = XMLoadFloat4x4(&h.GetLocal(node));
+		uint32 parent = h.GetParent(node);
+		return parent == None ? local : XMMatrixMultiply(local, ReferenceWorld(h, parent));
+	}
+
+	bool WorldIsCurrent(const TransformHierarchy& h, uint32 node)
+	{
+		XMFLOAT4X4 expected;
+		XMStoreFloat4x4(&expected, ReferenceWorld(h, node));
+		const XMFLOAT4X4& world = h.GetWorld(node);
+
+		for(int i = 0; i < 4; ++i)
+		{
+			for(int j = 0; j < 4; ++j)
+			{
+				if(std::fabs(world.m[i][j] - expected.m[i][j]) > 1e-4f*(1.0f + std::fabs(expected.m[i][j])))
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool SameMatrix(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+	{
+		return std::memcmp(&a, &b, sizeof(XMFLOAT4X4)) == 0;
+	}
+
+	XMMATRIX Local(float angle, float x, float y, float z)
+	{
+		return XMMatrixRotationY(angle)*XMMatrixTranslation(x, y, z);
+	}
+}
+
+TEST(TransformUpdateTouchesOnlyTheChangedSubtree)
+{
+	// The tree, added in depth-first order and with slots that do not follow
+	// either order:
+	//
+	//   a (no slot)
+	//   +- b (5)
+	//   |  +- d (1)
+	//   |  |  +- g (0)
+	//   |  +- e (6)
+	//   +- c (2)
+	//      +- f (3)
+	//
+	// so breadth-first it is a, b, c, d, e, f, g.
+	TransformHierarchy h(1);
+	uint32 a = h.AddNode(None, Local(0.1f, 0.0f, 1.0f, 0.0f));
+	uint32 b = h.AddNode(a, Local(0.2f, 1.0f, 0.0f, 0.0f), 5);
+	uint32 d = h.AddNode(b, Local(0.3f, 0.0f, 0.0f, 2.0f), 1);
+	uint32 g = h.AddNode(d, Local(0.4f, 3.0f, 0.0f, 0.0f), 0);
+	uint32 c = h.AddNode(a, Local(0.5f, -1.0f, 0.0f, 0.0f), 2);
+	uint32 f = h.AddNode(c, Local(0.6f, 0.0f, 2.0f, 0.0f), 3);
+	uint32 e = h.AddNode(b, Local(0.7f, 0.0f, -2.0f, 0.0f), 6);
+	const uint32 nodes[] = { a, b, c, d, e, f, g };
+
+	CHECK(h.GetNodeCount() == 7);
+	CHECK(h.GetParent(g) == d);
+	CHECK(h.GetSlot(e) == 6);
+	CHECK(h.GetSlot(a) == None);
+
+	// The first update computes everything, and reports every slot breadth-first.
+	std::vector<uint32> changed;
+	h.Update(changed);
+	CHECK(changed == std::vector<uint32>({ 5, 2, 1, 6, 3, 0 }));
+
+	for(uint32 node : nodes)
+		CHECK(WorldIsCurrent(h, node));
+
+	// Nothing moved, so nothing changes.
+	h.Update(changed);
+	CHECK(changed.empty());
+
+	std::vector<XMFLOAT4X4> before;
+	for(uint32 node : nodes)
+		before.push_back(h.GetWorld(node));
+
+	// Moving b updates b, d, e and g, parents before children, and leaves the
+	// other branch alone.
+	h.SetLocal(b, Local(-0.2f, 4.0f, 0.0f, 1.0f));
+	h.Update(changed);
+	CHECK(changed == std::vector<uint32>({ 5, 1, 6, 0 }));
+
+	for(size_t i = 0; i < _countof(nodes); ++i)
+	{
+		uint32 node = nodes[i];
+		bool inSubtree = node == b || node == d || node == e || node == g;
+
+		CHECK(WorldIsCurrent(h, node));
+		CHECK(SameMatrix(h.GetWorld(node), before[i]) == !inSubtree);
+	}
+
+	// Setting a deep node and a shallow one in the other branch, deepest first,
+	// still comes out a level at a time.
+	h.SetLocal(g, Local(1.0f, 0.0f, 0.0f, 0.0f));
+	h.SetLocal(c, Local(1.0f, 0.0f, 0.0f, 0.0f));
+	h.Update(changed);
+	CHECK(changed == std::vector<uint32>({ 2, 3, 0 }));
+
+	// Setting a node twice reports it once.
+	h.SetLocal(e, Local(2.0f, 0.0f, 0.0f, 0.0f));
+	h.SetLocal(e, Local(3.0f, 0.0f, 0.0f, 0.0f));
+	h.Update(changed);
+	CHECK(changed == std::vector<uint32>({ 6 }));
+
+	// Moving the root, which has no slot, reports everything under it.
+	h.SetLocal(a, Local(0.0f, 0.0f, 5.0f, 0.0f));
+	h.Update(changed);
+	CHECK(changed == std::vector<uint32>({ 5, 2, 1, 6, 3, 0 }));
+
+	for(uint32 node : nodes)
+		CHECK(WorldIsCurrent(h, node));
+
+	// A node added later goes into its level, and the next update recomputes the
+	// whole tree.
+	uint32 k = h.AddNode(c, Local(0.0f, 1.0f, 1.0f, 1.0f), 4);
+	h.Update(changed);
+	CHECK(changed == std::vector<uint32>({ 5, 2, 1, 6, 3, 4, 0 }));
+	CHECK(WorldIsCurrent(h, k));
+}
+
+TEST(TransformUpdateSplitsLargeLevels)
+{
+	// Levels large enough to be split across threads.
+	const uint32 rowCount = 3;
+	const uint32 leafCount = 5000;
+
+	TransformHierarchy h(4);
+	uint32 root = h.AddNode(None, XMMatrixIdentity());
+
+	std::vector<uint32> rows;
+	std::vector<uint32> leaves;
+	uint32 slot = 0;
+	for(uint32 r = 0; r < rowCount; ++r)
+		rows.push_back(h.AddNode(root, Local(0.0f, 0.0f, 0.0f, 10.0f*r)));
+
+	for(uint32 r = 0; r < rowCount; ++r)
+	{
+		for(uint32 i = 0; i < leafCount; ++i)
+			leaves.push_back(h.AddNode(rows[r], Local(0.001f*i, (float)i, 0.0f, 0.0f), slot++));
+	}
+
+	std::vector<uint32> changed;
+	h.Update(changed);
+	CHECK(changed.size() == rowCount*leafCount);
+	for(uint32 i = 0; i < changed.size(); ++i)
+		CHECK(changed[i] == i);
+
+	// Every row moves, so the whole leaf level is recomputed at once.
+	for(uint32 r = 0; r < rowCount; ++r)
+		h.SetLocal(rows[r], Local(0.5f, 1.0f, 0.0f, 10.0f*r));
+	h.Update(changed);
+	CHECK(changed.size() == rowCount*leafCount);
+
+	// One row moves: only its leaves, split across threads, in order.
+	h.SetLocal(rows[1], Local(-0.5f, 2.0f, 0.0f, 10.0f));
+	h.Update(changed);
+	CHECK(changed.size() == leafCount);
+	for(uint32 i = 0; i < changed.size(); ++i)
+		CHECK(changed[i] == leafCount + i);
+
+	for(uint32 leaf : leaves)
+		CHECK(WorldIsCurrent(h, leaf));
+}
@@ -0,0 +1,149 @@
+//***************************************************************************************
+// VertexQuantizerTests.cpp
+//***************************************************************************************
+
+#include "Tests.h"
+#include "../Common/VertexQuantizer.h"
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+namespace
+{
+	struct Input
+	{
+		XMFLOAT3 Position;
+		XMFLOAT3 Normal;
+		XMFLOAT4 Color;
+	};
+
+	struct Output
+	{
+		XMUSHORTN4 Position;
+		XMSHORTN2 Normal;
+		XMCOLOR Color;
+	};
+
+	std::vector<Input> RandomInputs(size_t count)
+	{
+		std::mt19937 rng(7);
+		std::uniform_real_distribution<float> position(-10.0f, 10.0f);
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::uniform_real_distribution<float> color(-0.25f, 1.25f);
+
+		std::vector<Input> inputs(count);
+		for(Input& v : inputs)
+		{
+			v.Position = XMFLOAT3(position(rng), position(rng), position(rng));
+			XMStoreFloat3(&v.Normal, XMVector3Normalize(XMVectorSet(unit(rng), unit(rng), unit(rng), 0.0f)));
+			v.Color = XMFLOAT4(color(rng), color(rng), color(rng), color(rng));
+		}
+
+		// Axis-aligned and zero vectors hit the folding and divide-by-zero cases.
+		if(count > 3)
+		{
+			inputs[0].Normal = XMFLOAT3(0.0f, 0.0f, -1.0f);
+			inputs[1].Normal = XMFLOAT3(-1.0f, 0.0f, 0.0f);
+			inputs[2].Normal = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		}
+
+		return inputs;
+	}
+
+	void Encode(const std::vector<Input>& inputs, std::vector<Output>& outputs, const VertexQuantizer::Dequantization& dequantization)
+	{
+		outputs.assign(inputs.size(), Output());
+		if(inputs.empty())
+			return;
+
+		VertexQuantizer::EncodePositions(&outputs[0].Position, sizeof(Output), &inputs[0].Position, sizeof(Input), inputs.size(), dequantization);
+		VertexQuantizer::EncodeDirections(&outputs[0].Normal, sizeof(Output), &inputs[0].Normal, sizeof(Input), inputs.size());
+		VertexQuantizer::EncodeColors(&outputs[0].Color, sizeof(Output), &inputs[0].Color, sizeof(Input), inputs.size());
+	}
+
+	bool Near(int a, int b)
+	{
+		// Ties may round either way.
+		return std::abs(a - b) <= 1;
+	}
+}
+
+TEST(QuantizerBatchMatchesPerVertex)
+{
+	const size_t counts[] = { 0, 1, 3, 4, 5, 7, 1001 };
+
+	for(size_t count : counts)
+	{
+		std::vector<Input> inputs = RandomInputs(count);
+		VertexQuantizer::Dequantization dequantization =
+			VertexQuantizer::ComputeDequantization(count > 0 ? &inputs[0].Position : nullptr, sizeof(Input), count);
+
+		std::vector<Output> outputs;
+		Encode(inputs, outputs, dequantization);
+
+		XMVECTOR bias = XMLoadFloat3(&dequantization.Bias);
+		XMVECTOR invScale = XMVectorReplicate(1.0f / dequantization.Scale);
+
+		for(size_t i = 0; i < count; ++i)
+		{
+			XMUSHORTN4 position;
+			XMStoreUShortN4(&position, XMVectorSetW((XMLoadFloat3(&inputs[i].Position) - bias) * invScale, 1.0f));
+
+			CHECK(Near(outputs[i].Position.x, position.x));
+			CHECK(Near(outputs[i].Position.y, position.y));
+			CHECK(Near(outputs[i].Position.z, position.z));
+			CHECK(outputs[i].Position.w == 0xffff);
+
+			XMCOLOR color;
+			XMStoreColor(&color, XMLoadFloat4(&inputs[i].Color));
+			for(int shift = 0; shift < 32; shift += 8)
+				CHECK(Near((outputs[i].Color.c >> shift) & 0xff, (color.c >> shift) & 0xff));
+
+			// The decoded normal is within the precision of 16-bit components.
+			XMVECTOR e = XMLoadShortN2(&outputs[i].Normal);
+			float ex = XMVectorGetX(e);
+			float ey = XMVectorGetY(e);
+			XMVECTOR n = XMVectorSet(ex, ey, 1.0f - std::abs(ex) - std::abs(ey), 0.0f);
+			float t = XMVectorGetZ(n) < 0.0f ? -XMVectorGetZ(n) : 0.0f;
+			n = XMVectorSetX(n, ex >= 0.0f ? ex - t : ex + t);
+			n = XMVectorSetY(n, ey >= 0.0f ? ey - t : ey + t);
+
+			XMVECTOR expected = XMLoadFloat3(&inputs[i].Normal);
+			if(XMVector3Equal(expected, XMVectorZero()))
+				CHECK(outputs[i].Normal.x == 0 && outputs[i].Normal.y == 0);
+			else
+				CHECK(XMVectorGetX(XMVector3Length(XMVector3Normalize(n) - expected)) < 1e-3f);
+		}
+	}
+}
+
+BENCHMARK(QuantizerBatch)
+{
+	const size_t count = 1000000;
+	std::vector<Input> inputs = RandomInputs(count);
+	std::vector<Output> outputs(count);
+
+	VertexQuantizer::Dequantization dequantization =
+		VertexQuantizer::ComputeDequantization(&inputs[0].Position, sizeof(Input), count);
+
+	double batchMs = Tests::Time([&] { Encode(inputs, outputs, dequantization); });
+
+	double perVertexMs = Tests::Time([&]
+	{
+		XMVECTOR bias = XMLoadFloat3(&dequantization.Bias);
+		XMVECTOR invScale = XMVectorReplicate(1.0f / dequantization.Scale);
+
+		for(size_t i = 0; i < count; ++i)
+		{
+			XMStoreUShortN4(&outputs[i].Position, XMVectorSetW((XMLoadFloat3(&inputs[i].Position) - bias) * invScale, 1.0f));
+			XMStoreColor(&outputs[i].Color, XMLoadFloat4(&inputs[i].Color));
+		}
+	});
+
+	std::printf("  Positions, normals and colors of %zu vertices: %.2f ms\n", count, batchMs);
+	std::printf("  Per-vertex DirectXMath positions and colors only: %.2f ms\n", perVertexMs);
+}